@@ -0,0 +1,263 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Compares b2World::QueryAABBs() and RayCastClosest() with calling
+// QueryAABB() and RayCast() once per box or ray. Build it with the library
+// sources, leaving out the other programs under Unittests and Benchmark.
+// The world is a few thousand circles over a long chain with an edge tree.
+// Each batch call is timed on the calling thread and then with a
+// b2ThreadPool, and its results are checked against the per-call ones.
+// The exit status is 1 if any result differs.
+
+#include <Box2D/Box2D.h>
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+// Circles in the world.
+static const int32 k_bodyCount = 4000;
+// Vertices of the chain under them.
+static const int32 k_chainVertexCount = 2000;
+// Boxes queried and rays cast.
+static const int32 k_queryCount = 20000;
+// Workers of the thread pool.
+static const int32 k_workerCount = 3;
+
+// Next value of a random sequence.
+static uint32 Random(uint32* seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+// A random coordinate in [0, range), with a resolution of 0.1.
+static float32 RandomCoordinate(uint32* seed, int32 range)
+{
+	return (float32)(Random(seed) % (range * 10)) * 0.1f;
+}
+
+// Keeps the closest hit that isn't a sensor, as RayCastClosest() does.
+class ClosestRayCastCallback : public b2RayCastCallback
+{
+public:
+	ClosestRayCastCallback() : m_fixture(NULL), m_fraction(1.0f) {}
+
+	float32 ReportFixture(b2Fixture* fixture, const b2Vec2& point,
+						  const b2Vec2& normal, float32 fraction)
+	{
+		B2_NOT_USED(point);
+		B2_NOT_USED(normal);
+		if (fixture->IsSensor())
+		{
+			return -1.0f;
+		}
+		m_fixture = fixture;
+		m_fraction = fraction;
+		return fraction;
+	}
+
+	b2Fixture* m_fixture;
+	float32 m_fraction;
+};
+
+// Collects every fixture reported.
+class CollectQueryCallback : public b2QueryCallback
+{
+public:
+	bool ReportFixture(b2Fixture* fixture)
+	{
+		m_fixtures.push_back(fixture);
+		return true;
+	}
+
+	std::vector<b2Fixture*> m_fixtures;
+};
+
+static void CreateWorld(b2World* world)
+{
+	uint32 seed = 1;
+	for (int32 i = 0; i < k_bodyCount; ++i)
+	{
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(RandomCoordinate(&seed, 200),
+							 RandomCoordinate(&seed, 200));
+		b2Body* body = world->CreateBody(&bodyDef);
+		b2CircleShape circle;
+		circle.m_radius = 0.3f + (float32)(Random(&seed) % 10) * 0.05f;
+		b2FixtureDef fixtureDef;
+		fixtureDef.shape = &circle;
+		fixtureDef.isSensor = i % 17 == 0;
+		body->CreateFixture(&fixtureDef);
+	}
+
+	std::vector<b2Vec2> vertices(k_chainVertexCount);
+	for (int32 i = 0; i < k_chainVertexCount; ++i)
+	{
+		vertices[i].Set((float32)i * 0.1f, sinf((float32)i * 0.05f));
+	}
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2ChainShape chain;
+	chain.CreateChain(&vertices[0], k_chainVertexCount);
+	chain.SetEdgeTree(true);
+	ground->CreateFixture(&chain, 0.0f);
+
+	// Settle the proxies into the broad-phase.
+	world->Step(1.0f / 60.0f, 1, 1);
+}
+
+// Count the rays whose batch hit differs from the per-call one.
+static int32 CompareRayCasts(const std::vector<ClosestRayCastCallback>& calls,
+							 const std::vector<b2RayCastHit>& hits)
+{
+	int32 errors = 0;
+	for (int32 i = 0; i < k_queryCount; ++i)
+	{
+		if (calls[i].m_fixture != hits[i].fixture ||
+			(hits[i].fixture &&
+			 b2Abs(calls[i].m_fraction - hits[i].fraction) > 1e-6f))
+		{
+			++errors;
+		}
+	}
+	return errors;
+}
+
+// Count the boxes whose batch fixtures differ from the per-call ones.
+static int32 CompareQueries(std::vector<CollectQueryCallback>* calls,
+							const std::vector<b2Fixture*>& fixtures,
+							const std::vector<int32>& starts)
+{
+	int32 errors = 0;
+	for (int32 i = 0; i < k_queryCount; ++i)
+	{
+		std::vector<b2Fixture*> batch(fixtures.begin() + starts[i],
+									  fixtures.begin() + starts[i + 1]);
+		std::vector<b2Fixture*>& call = (*calls)[i].m_fixtures;
+		std::sort(batch.begin(), batch.end());
+		std::sort(call.begin(), call.end());
+		if (batch != call)
+		{
+			++errors;
+		}
+	}
+	return errors;
+}
+
+int main()
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	CreateWorld(&world);
+
+	uint32 seed = 2;
+	std::vector<b2Vec2> points1(k_queryCount);
+	std::vector<b2Vec2> points2(k_queryCount);
+	std::vector<b2AABB> aabbs(k_queryCount);
+	for (int32 i = 0; i < k_queryCount; ++i)
+	{
+		points1[i].Set(RandomCoordinate(&seed, 200),
+					   RandomCoordinate(&seed, 200));
+		points2[i] = points1[i] +
+			b2Vec2(RandomCoordinate(&seed, 40) - 20.0f,
+				   RandomCoordinate(&seed, 40) - 25.0f);
+		aabbs[i].lowerBound = points1[i];
+		aabbs[i].upperBound = points1[i] +
+			b2Vec2(RandomCoordinate(&seed, 5), RandomCoordinate(&seed, 5));
+	}
+
+	int32 errors = 0;
+	b2ThreadPool pool(k_workerCount);
+
+	// Ray casts.
+	std::vector<ClosestRayCastCallback> rayCalls(k_queryCount);
+	float32 rayCallTime;
+	{
+		b2Timer timer;
+		for (int32 i = 0; i < k_queryCount; ++i)
+		{
+			world.RayCast(&rayCalls[i], points1[i], points2[i]);
+		}
+		rayCallTime = timer.GetMilliseconds();
+	}
+	std::vector<b2RayCastHit> hits(k_queryCount);
+	float32 rayBatchTime;
+	{
+		b2Timer timer;
+		world.RayCastClosest(&points1[0], &points2[0], k_queryCount,
+							 &hits[0]);
+		rayBatchTime = timer.GetMilliseconds();
+		errors += CompareRayCasts(rayCalls, hits);
+	}
+	float32 rayPoolTime;
+	{
+		world.SetTaskExecutor(&pool);
+		b2Timer timer;
+		world.RayCastClosest(&points1[0], &points2[0], k_queryCount,
+							 &hits[0]);
+		rayPoolTime = timer.GetMilliseconds();
+		world.SetTaskExecutor(NULL);
+		errors += CompareRayCasts(rayCalls, hits);
+	}
+	printf("%d ray casts: per call %.1f ms, batch %.1f ms, "
+		   "batch with %d workers %.1f ms\n", k_queryCount, rayCallTime,
+		   rayBatchTime, k_workerCount, rayPoolTime);
+
+	// AABB queries. The batch is sized by a first call with no capacity,
+	// which isn't timed.
+	std::vector<CollectQueryCallback> queryCalls(k_queryCount);
+	float32 queryCallTime;
+	{
+		b2Timer timer;
+		for (int32 i = 0; i < k_queryCount; ++i)
+		{
+			world.QueryAABB(&queryCalls[i], aabbs[i]);
+		}
+		queryCallTime = timer.GetMilliseconds();
+	}
+	std::vector<int32> starts(k_queryCount + 1);
+	const int32 found = world.QueryAABBs(&aabbs[0], k_queryCount, NULL, 0,
+										 &starts[0]);
+	std::vector<b2Fixture*> fixtures(b2Max(found, 1));
+	float32 queryBatchTime;
+	{
+		b2Timer timer;
+		world.QueryAABBs(&aabbs[0], k_queryCount, &fixtures[0], found,
+						 &starts[0]);
+		queryBatchTime = timer.GetMilliseconds();
+		errors += CompareQueries(&queryCalls, fixtures, starts);
+	}
+	float32 queryPoolTime;
+	{
+		world.SetTaskExecutor(&pool);
+		b2Timer timer;
+		world.QueryAABBs(&aabbs[0], k_queryCount, &fixtures[0], found,
+						 &starts[0]);
+		queryPoolTime = timer.GetMilliseconds();
+		world.SetTaskExecutor(NULL);
+		errors += CompareQueries(&queryCalls, fixtures, starts);
+	}
+	printf("%d AABB queries, %d fixtures: per call %.1f ms, batch %.1f ms, "
+		   "batch with %d workers %.1f ms\n", k_queryCount, found,
+		   queryCallTime, queryBatchTime, k_workerCount, queryPoolTime);
+
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
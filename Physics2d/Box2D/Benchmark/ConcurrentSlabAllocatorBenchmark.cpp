@@ -0,0 +1,260 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Contention benchmark for b2ConcurrentSlabAllocator. Build it with the
+// library sources and LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES=1, leaving out
+// the other programs under Unittests and Benchmark. It runs two tests:
+// - Several threads allocate and free items at random, each through its
+//   own cache. b2SlabAllocator behind a mutex does the same for
+//   comparison.
+// - Several threads create handles for disjoint ranges of a particle
+//   system's particles, each through its own b2ParticleHandleCache. One
+//   thread creating all of them does the same for comparison.
+// Each thread checks that nobody else was handed its items. The exit
+// status is 1 if any check fails.
+
+#include <Box2D/Box2D.h>
+#include <Box2D/Common/b2ConcurrentSlabAllocator.h>
+#include <Box2D/Common/b2SlabAllocator.h>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#if !LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+#error Build with LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES=1.
+#endif
+
+// Threads in each test.
+static const int32 k_threadCount = 8;
+// Allocations or frees per thread in the allocator test.
+static const int32 k_operationCount = 400000;
+// Items each thread holds at most in the allocator test.
+static const int32 k_heldCount = 200;
+// Small slabs, so slabs are allocated while other threads allocate.
+static const uint32 k_itemsPerSlab = 64;
+// Particles whose handles are created in the handle test.
+static const int32 k_particleCount = 200000;
+
+struct Item : public b2TypedIntrusiveListNode<Item>
+{
+	Item() : owner(-1) {}
+	int32 owner;
+};
+
+typedef b2ConcurrentSlabAllocator<Item> ConcurrentAllocator;
+
+// Next value of a thread's random sequence.
+static uint32 Random(uint32* seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+// Allocate and free items at random through the thread's own cache.
+static void ConcurrentWorker(ConcurrentAllocator* allocator, int32 thread,
+							 std::atomic<int32>* errors)
+{
+	ConcurrentAllocator::Cache cache(allocator);
+	Item* held[k_heldCount] = { NULL };
+	uint32 seed = thread * 7919 + 1;
+	for (int32 i = 0; i < k_operationCount; ++i)
+	{
+		Item*& item = held[Random(&seed) % k_heldCount];
+		if (item)
+		{
+			if (item->owner != thread)
+			{
+				++*errors;
+			}
+			item->owner = -1;
+			allocator->Free(&cache, item);
+			item = NULL;
+		}
+		else
+		{
+			item = allocator->Allocate(&cache);
+			if (!item || item->owner != -1)
+			{
+				++*errors;
+			}
+			if (item)
+			{
+				item->owner = thread;
+			}
+		}
+	}
+	for (int32 i = 0; i < k_heldCount; ++i)
+	{
+		if (held[i])
+		{
+			held[i]->owner = -1;
+			allocator->Free(&cache, held[i]);
+		}
+	}
+}
+
+// The same as ConcurrentWorker(), with every operation under one lock.
+static void LockedWorker(b2SlabAllocator<Item>* allocator, std::mutex* lock,
+						 int32 thread)
+{
+	Item* held[k_heldCount] = { NULL };
+	uint32 seed = thread * 7919 + 1;
+	for (int32 i = 0; i < k_operationCount; ++i)
+	{
+		Item*& item = held[Random(&seed) % k_heldCount];
+		std::lock_guard<std::mutex> guard(*lock);
+		if (item)
+		{
+			allocator->Free(item);
+			item = NULL;
+		}
+		else
+		{
+			item = allocator->Allocate();
+		}
+	}
+	std::lock_guard<std::mutex> guard(*lock);
+	for (int32 i = 0; i < k_heldCount; ++i)
+	{
+		if (held[i])
+		{
+			allocator->Free(held[i]);
+		}
+	}
+}
+
+// Create the handles of particles [begin, end) through the thread's cache.
+static void HandleWorker(b2ParticleSystem* system, int32 begin, int32 end)
+{
+	b2ParticleHandleCache cache(system->GetParticleHandleAllocator());
+	for (int32 i = begin; i < end; ++i)
+	{
+		system->GetParticleHandleFromIndex(i, &cache);
+	}
+}
+
+// Count the particles whose handle is missing or doesn't point back.
+static int32 CheckHandles(b2ParticleSystem* system)
+{
+	int32 errors = 0;
+	for (int32 i = 0; i < system->GetParticleCount(); ++i)
+	{
+		const b2ParticleHandle* handle = system->GetParticleHandleFromIndex(i);
+		if (!handle || handle->GetIndex() != i)
+		{
+			++errors;
+		}
+	}
+	return errors;
+}
+
+static b2ParticleSystem* CreateParticles(b2World* world)
+{
+	b2ParticleSystemDef systemDef;
+	b2ParticleSystem* system = world->CreateParticleSystem(&systemDef);
+	b2ParticleDef def;
+	for (int32 i = 0; i < k_particleCount; ++i)
+	{
+		def.position.Set((float32)(i % 1000), (float32)(i / 1000));
+		system->CreateParticle(def);
+	}
+	return system;
+}
+
+int main()
+{
+	std::atomic<int32> errors(0);
+
+	float32 concurrentTime;
+	{
+		ConcurrentAllocator allocator(k_itemsPerSlab);
+		b2Timer timer;
+		std::vector<std::thread> threads;
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads.push_back(std::thread(ConcurrentWorker, &allocator, i,
+										  &errors));
+		}
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads[i].join();
+		}
+		concurrentTime = timer.GetMilliseconds();
+	}
+
+	float32 lockedTime;
+	{
+		b2SlabAllocator<Item> allocator(k_itemsPerSlab);
+		std::mutex lock;
+		b2Timer timer;
+		std::vector<std::thread> threads;
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads.push_back(std::thread(LockedWorker, &allocator, &lock, i));
+		}
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads[i].join();
+		}
+		lockedTime = timer.GetMilliseconds();
+	}
+	printf("allocator, %d threads: concurrent %.1f ms, mutex %.1f ms\n",
+		   k_threadCount, concurrentTime, lockedTime);
+
+	float32 threadedHandleTime;
+	{
+		b2World world(b2Vec2_zero);
+		b2ParticleSystem* system = CreateParticles(&world);
+		system->PrepareParticleHandles();
+		b2Timer timer;
+		std::vector<std::thread> threads;
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads.push_back(std::thread(
+				HandleWorker, system, i * k_particleCount / k_threadCount,
+				(i + 1) * k_particleCount / k_threadCount));
+		}
+		for (int32 i = 0; i < k_threadCount; ++i)
+		{
+			threads[i].join();
+		}
+		threadedHandleTime = timer.GetMilliseconds();
+		errors += CheckHandles(system);
+	}
+
+	float32 serialHandleTime;
+	{
+		b2World world(b2Vec2_zero);
+		b2ParticleSystem* system = CreateParticles(&world);
+		b2Timer timer;
+		for (int32 i = 0; i < k_particleCount; ++i)
+		{
+			system->GetParticleHandleFromIndex(i);
+		}
+		serialHandleTime = timer.GetMilliseconds();
+		errors += CheckHandles(system);
+	}
+	printf("%d particle handles: %d threads %.1f ms, one thread %.1f ms\n",
+		   k_particleCount, k_threadCount, threadedHandleTime,
+		   serialHandleTime);
+
+	printf("%d errors\n", errors.load());
+	return errors.load() ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Times b2World::Step() on a contact-heavy scene, a walled pile of boxes
+// and circles, split into the collide and solve phases b2Profile reports.
+// Build it with the library sources, leaving out the other programs under
+// Unittests and Benchmark. It is meant to be built against two revisions of
+// the library and the times compared, e.g. before and after a change to how
+// the world walks its bodies and contacts each step. The pile is left to
+// settle first, so the timed steps are dominated by resting contacts.
+//
+// The exit status is 0.
+
+#include <Box2D/Box2D.h>
+#include <stdio.h>
+
+// Bodies of the pile.
+static const int32 k_columnCount = 40;
+static const int32 k_rowCount = 50;
+// Steps run before and during the timing.
+static const int32 k_warmupStepCount = 300;
+static const int32 k_stepCount = 600;
+
+static const float32 k_timeStep = 1.0f / 60.0f;
+static const int32 k_velocityIterations = 8;
+static const int32 k_positionIterations = 3;
+
+static void CreateScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.Set(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.Set(b2Vec2(-40.0f, 0.0f), b2Vec2(-40.0f, 100.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.Set(b2Vec2(40.0f, 0.0f), b2Vec2(40.0f, 100.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+	for (int32 row = 0; row < k_rowCount; ++row)
+	{
+		for (int32 column = 0; column < k_columnCount; ++column)
+		{
+			b2BodyDef def;
+			def.type = b2_dynamicBody;
+			// Stagger the rows so the pile doesn't stand in neat columns.
+			def.position.Set(-39.0f + 1.9f * column + 0.1f * (row % 3),
+							 0.6f + 1.1f * row);
+			b2Body* body = world->CreateBody(&def);
+			if ((row + column) % 2)
+			{
+				body->CreateFixture(&box, 1.0f);
+			}
+			else
+			{
+				body->CreateFixture(&circle, 1.0f);
+			}
+		}
+	}
+}
+
+int main()
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	CreateScene(&world);
+	for (int32 i = 0; i < k_warmupStepCount; ++i)
+	{
+		world.Step(k_timeStep, k_velocityIterations, k_positionIterations);
+	}
+
+	float32 collideTime = 0.0f;
+	float32 solveTime = 0.0f;
+	float32 stepTime = 0.0f;
+	for (int32 i = 0; i < k_stepCount; ++i)
+	{
+		world.Step(k_timeStep, k_velocityIterations, k_positionIterations);
+		const b2Profile& profile = world.GetProfile();
+		collideTime += profile.collide;
+		solveTime += profile.solve;
+		stepTime += profile.step;
+	}
+	printf("%d bodies, %d contacts, %d steps: collide %.1f ms, "
+		   "solve %.1f ms, step %.1f ms\n", world.GetBodyCount(),
+		   world.GetContactCount(), k_stepCount, collideTime, solveTime,
+		   stepTime);
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Compares b2DistanceBatch() with calling b2Distance() once per pair.
+// Build it with the library sources, leaving out the other programs under
+// Unittests and Benchmark. Random polygons and circles in random poses are
+// paired up and their distances computed cold, as for new pairs, and then
+// again warm started from the caches after the poses move a little. Each
+// batch is timed on the calling thread and with a b2ThreadPool, and its
+// outputs are checked against the per-call ones.
+//
+// The exit status is 1 if any output differs.
+
+#include <Box2D/Box2D.h>
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+// Shapes, and transforms they are placed with.
+static const int32 k_shapeCount = 256;
+static const int32 k_transformCount = 4096;
+// Pairs whose distance is computed.
+static const int32 k_pairCount = 200000;
+// Workers of the thread pool.
+static const int32 k_workerCount = 3;
+
+// Small linear congruential generator, so every platform sees the same
+// shapes.
+static uint32 s_seed = 12345;
+
+static float32 RandomFloat(float32 lo, float32 hi)
+{
+	s_seed = s_seed * 1664525 + 1013904223;
+	return lo + (hi - lo) * (float32)(s_seed >> 8) / (float32)(1 << 24);
+}
+
+static int32 RandomIndex(int32 count)
+{
+	return b2Min((int32)RandomFloat(0.0f, (float32)count), count - 1);
+}
+
+// The shapes are kept alive for the proxies, which point at their
+// vertices.
+struct Shapes
+{
+	b2PolygonShape polygons[k_shapeCount];
+	b2CircleShape circles[k_shapeCount];
+};
+
+static void CreateProxies(Shapes* shapes, std::vector<b2DistanceProxy>* proxies)
+{
+	for (int32 i = 0; i < k_shapeCount; ++i)
+	{
+		if (i % 4 == 0)
+		{
+			shapes->circles[i].m_radius = RandomFloat(0.2f, 1.0f);
+			(*proxies)[i].Set(&shapes->circles[i], 0);
+			continue;
+		}
+		const int32 count = 3 + RandomIndex(b2_maxPolygonVertices - 2);
+		b2Vec2 points[b2_maxPolygonVertices];
+		for (int32 j = 0; j < count; ++j)
+		{
+			const float32 angle = 2.0f * b2_pi *
+				((float32)j + RandomFloat(0.0f, 0.5f)) / (float32)count;
+			const float32 radius = RandomFloat(0.5f, 1.0f);
+			points[j].Set(radius * cosf(angle), radius * sinf(angle));
+		}
+		shapes->polygons[i].Set(points, count);
+		(*proxies)[i].Set(&shapes->polygons[i], 0);
+	}
+}
+
+// Compute every pair with b2Distance().
+static void DistanceLoop(std::vector<b2DistanceOutput>* outputs,
+						 std::vector<b2SimplexCache>* caches,
+						 const std::vector<b2DistancePair>& pairs,
+						 const std::vector<b2DistanceProxy>& proxies,
+						 const std::vector<b2Transform>& transforms)
+{
+	b2DistanceInput input;
+	input.useRadii = true;
+	for (int32 i = 0; i < k_pairCount; ++i)
+	{
+		const b2DistancePair& pair = pairs[i];
+		input.proxyA = proxies[pair.proxyA];
+		input.proxyB = proxies[pair.proxyB];
+		input.transformA = transforms[pair.transformA];
+		input.transformB = transforms[pair.transformB];
+		b2Distance(&(*outputs)[i], &(*caches)[i], &input);
+	}
+}
+
+// Count the outputs and caches which differ.
+static int32 Compare(const std::vector<b2DistanceOutput>& outputs1,
+					 const std::vector<b2SimplexCache>& caches1,
+					 const std::vector<b2DistanceOutput>& outputs2,
+					 const std::vector<b2SimplexCache>& caches2)
+{
+	int32 errors = 0;
+	for (int32 i = 0; i < k_pairCount; ++i)
+	{
+		const b2DistanceOutput& a = outputs1[i];
+		const b2DistanceOutput& b = outputs2[i];
+		if (a.pointA != b.pointA || a.pointB != b.pointB ||
+			a.distance != b.distance || a.iterations != b.iterations ||
+			caches1[i].count != caches2[i].count ||
+			caches1[i].metric != caches2[i].metric)
+		{
+			++errors;
+		}
+	}
+	return errors;
+}
+
+// Move every transform a little, as between two steps.
+static void MoveTransforms(std::vector<b2Transform>* transforms)
+{
+	for (int32 i = 0; i < k_transformCount; ++i)
+	{
+		b2Transform& xf = (*transforms)[i];
+		xf.p += b2Vec2(RandomFloat(-0.05f, 0.05f), RandomFloat(-0.05f, 0.05f));
+		xf.q.Set(xf.q.GetAngle() + RandomFloat(-0.05f, 0.05f));
+	}
+}
+
+int main()
+{
+	Shapes* shapes = new Shapes;
+	std::vector<b2DistanceProxy> proxies(k_shapeCount);
+	CreateProxies(shapes, &proxies);
+	std::vector<b2Transform> transforms(k_transformCount);
+	for (int32 i = 0; i < k_transformCount; ++i)
+	{
+		transforms[i].Set(b2Vec2(RandomFloat(-4.0f, 4.0f),
+								 RandomFloat(-4.0f, 4.0f)),
+						  RandomFloat(-b2_pi, b2_pi));
+	}
+	std::vector<b2DistancePair> pairs(k_pairCount);
+	for (int32 i = 0; i < k_pairCount; ++i)
+	{
+		pairs[i].proxyA = RandomIndex(k_shapeCount);
+		pairs[i].proxyB = RandomIndex(k_shapeCount);
+		pairs[i].transformA = RandomIndex(k_transformCount);
+		pairs[i].transformB = RandomIndex(k_transformCount);
+	}
+
+	b2SimplexCache emptyCache;
+	emptyCache.count = 0;
+	std::vector<b2SimplexCache> loopCaches(k_pairCount, emptyCache);
+	std::vector<b2SimplexCache> batchCaches(k_pairCount, emptyCache);
+	std::vector<b2SimplexCache> poolCaches(k_pairCount, emptyCache);
+	std::vector<b2DistanceOutput> loopOutputs(k_pairCount);
+	std::vector<b2DistanceOutput> batchOutputs(k_pairCount);
+	std::vector<b2DistanceOutput> poolOutputs(k_pairCount);
+	b2ThreadPool pool(k_workerCount);
+
+	int32 errors = 0;
+	const char* passes[] = { "cold", "warm" };
+	for (uint32 pass = 0; pass < B2_ARRAY_SIZE(passes); ++pass)
+	{
+		if (pass > 0)
+		{
+			MoveTransforms(&transforms);
+		}
+
+		b2Timer loopTimer;
+		DistanceLoop(&loopOutputs, &loopCaches, pairs, proxies, transforms);
+		const float32 loopTime = loopTimer.GetMilliseconds();
+
+		b2Timer batchTimer;
+		b2DistanceBatch(&batchOutputs[0], &batchCaches[0], &pairs[0],
+						k_pairCount, &proxies[0], &transforms[0], true, NULL);
+		const float32 batchTime = batchTimer.GetMilliseconds();
+
+		b2Timer poolTimer;
+		b2DistanceBatch(&poolOutputs[0], &poolCaches[0], &pairs[0],
+						k_pairCount, &proxies[0], &transforms[0], true,
+						&pool);
+		const float32 poolTime = poolTimer.GetMilliseconds();
+
+		errors += Compare(loopOutputs, loopCaches, batchOutputs, batchCaches);
+		errors += Compare(loopOutputs, loopCaches, poolOutputs, poolCaches);
+		printf("%d %s pairs: b2Distance %.1f ms, batch %.1f ms, "
+			   "batch with %d workers %.1f ms\n", k_pairCount, passes[pass],
+			   loopTime, batchTime, k_workerCount, poolTime);
+	}
+
+	delete shapes;
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
@@ -30,7 +30,10 @@
 #include <Box2D/Common/b2Settings.h>
 #include <Box2D/Common/b2Draw.h>
 #include <Box2D/Common/b2Stat.h>
+#include <Box2D/Common/b2Snapshot.h>
 #include <Box2D/Common/b2Timer.h>
+#include <Box2D/Common/b2Trace.h>
+#include <Box2D/Common/b2TaskExecutor.h>
 
 #include <Box2D/Collision/Shapes/b2CircleShape.h>
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
@@ -47,6 +50,8 @@
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
 #include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Dynamics/b2Level.h>
+#include <Box2D/Dynamics/b2Replay.h>
 
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 
@@ -19,13 +19,28 @@
 
 #include <Box2D/Collision/Shapes/b2ChainShape.h>
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
+#include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Common/b2BlockAllocator.h>
 #include <new>
 #include <memory.h>
+#include <stdint.h>
 #include <string.h>
 
 b2ChainShape::~b2ChainShape()
 {
-	b2Free(m_vertices);
+	if (m_edgeTree)
+	{
+		m_edgeTree->~b2DynamicTree();
+		m_edgeTreeAllocator->Free(m_edgeTree, sizeof(b2DynamicTree));
+		m_edgeTreeAllocator->Free(m_edgeTreeLeaves,
+								  (m_count - 1) * sizeof(int32));
+		m_edgeTree = NULL;
+		m_edgeTreeLeaves = NULL;
+	}
+	if (!m_sharedVertices)
+	{
+		b2Free(m_vertices);
+	}
 	m_vertices = NULL;
 	m_count = 0;
 }
@@ -79,6 +94,23 @@ void b2ChainShape::CreateChain(const b2Vec2* vertices, int32 count)
 	m_nextVertex.SetZero();
 }
 
+void b2ChainShape::ShareVertices(const b2Vec2* vertices, int32 count)
+{
+	b2Assert(m_vertices == NULL && m_count == 0);
+	b2Assert(count >= 2);
+
+	// The shape never writes its vertices.
+	m_vertices = const_cast<b2Vec2*>(vertices);
+	m_count = count;
+	m_sharedVertices = true;
+
+	m_hasPrevVertex = false;
+	m_hasNextVertex = false;
+
+	m_prevVertex.SetZero();
+	m_nextVertex.SetZero();
+}
+
 void b2ChainShape::SetPrevVertex(const b2Vec2& prevVertex)
 {
 	m_prevVertex = prevVertex;
@@ -95,14 +127,73 @@ b2Shape* b2ChainShape::Clone(b2BlockAllocator* allocator) const
 {
 	void* mem = allocator->Allocate(sizeof(b2ChainShape));
 	b2ChainShape* clone = new (mem) b2ChainShape;
-	clone->CreateChain(m_vertices, m_count);
+	if (m_sharedVertices)
+	{
+		clone->ShareVertices(m_vertices, m_count);
+	}
+	else
+	{
+		clone->CreateChain(m_vertices, m_count);
+	}
 	clone->m_prevVertex = m_prevVertex;
 	clone->m_nextVertex = m_nextVertex;
 	clone->m_hasPrevVertex = m_hasPrevVertex;
 	clone->m_hasNextVertex = m_hasNextVertex;
+	if (m_useEdgeTree)
+	{
+		clone->m_useEdgeTree = true;
+		clone->BuildEdgeTree(allocator->GetAllocator());
+	}
 	return clone;
 }
 
+void b2ChainShape::SetEdgeTree(bool flag)
+{
+	b2Assert(m_edgeTree == NULL);
+	m_useEdgeTree = flag;
+}
+
+void b2ChainShape::BuildEdgeTree(b2Allocator* allocator)
+{
+	b2Assert(m_edgeTree == NULL);
+	const int32 edgeCount = m_count - 1;
+	b2Transform identity;
+	identity.SetIdentity();
+
+	b2AABB* aabbs = (b2AABB*)b2Alloc(edgeCount * sizeof(b2AABB));
+	void** userData = (void**)b2Alloc(edgeCount * sizeof(void*));
+	for (int32 i = 0; i < edgeCount; ++i)
+	{
+		ComputeAABB(&aabbs[i], identity, i);
+		userData[i] = (void*)(intptr_t)i;
+	}
+
+	m_edgeTreeBounds.lowerBound = m_vertices[0];
+	m_edgeTreeBounds.upperBound = m_vertices[0];
+	for (int32 i = 1; i < m_count; ++i)
+	{
+		m_edgeTreeBounds.lowerBound =
+			b2Min(m_edgeTreeBounds.lowerBound, m_vertices[i]);
+		m_edgeTreeBounds.upperBound =
+			b2Max(m_edgeTreeBounds.upperBound, m_vertices[i]);
+	}
+
+	m_edgeTreeAllocator = allocator;
+	m_edgeTree = new (allocator->Allocate(sizeof(b2DynamicTree)))
+		b2DynamicTree(allocator);
+	m_edgeTreeLeaves = (int32*)allocator->Allocate(edgeCount * sizeof(int32));
+	m_edgeTree->CreateProxies(aabbs, userData, edgeCount, m_edgeTreeLeaves);
+
+	b2Free(userData);
+	b2Free(aabbs);
+}
+
+const b2AABB& b2ChainShape::GetEdgeFatAABB(int32 index) const
+{
+	b2Assert(m_edgeTree && 0 <= index && index < m_count - 1);
+	return m_edgeTree->GetFatAABB(m_edgeTreeLeaves[index]);
+}
+
 int32 b2ChainShape::GetChildCount() const
 {
 	// edge count = vertex count - 1
@@ -177,6 +268,13 @@ bool b2ChainShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 
 void b2ChainShape::ComputeAABB(b2AABB* aabb, const b2Transform& xf, int32 childIndex) const
 {
+	if (childIndex == b2_edgeTreeChildIndex)
+	{
+		b2Assert(m_edgeTree);
+		*aabb = b2Mul(xf, m_edgeTreeBounds);
+		return;
+	}
+
 	b2Assert(childIndex < m_count);
 
 	int32 i1 = childIndex;
@@ -23,6 +23,12 @@
 #include <Box2D/Collision/Shapes/b2Shape.h>
 
 class b2EdgeShape;
+class b2Allocator;
+class b2DynamicTree;
+
+/// Child index of the single broad-phase proxy of a chain with an edge
+/// tree, which stands for all of its edges. See b2ChainShape::SetEdgeTree().
+const int32 b2_edgeTreeChildIndex = -1;
 
 /// A chain shape is a free form sequence of line segments.
 /// The chain has two-sided collision, so you can use inside and outside collision.
@@ -35,7 +41,8 @@ class b2ChainShape : public b2Shape
 public:
 	b2ChainShape();
 
-	/// The destructor frees the vertices using b2Free.
+	/// The destructor frees the vertices using b2Free, unless they are
+	/// shared.
 	~b2ChainShape();
 
 	/// Create a loop. This automatically adjusts connectivity.
@@ -48,6 +55,14 @@ public:
 	/// @param count the vertex count
 	void CreateChain(const b2Vec2* vertices, int32 count);
 
+	/// Use vertices kept by the caller, such as the chains of a mapped
+	/// b2Level, rather than a copy. Loops must repeat their first vertex
+	/// at the end. Connectivity is set as for CreateChain(). The vertices
+	/// must outlive the shape and its clones, which share them.
+	/// @param vertices an array of vertices, these are not copied
+	/// @param count the vertex count
+	void ShareVertices(const b2Vec2* vertices, int32 count);
+
 	/// Establish connectivity to a vertex that precedes the first vertex.
 	/// Don't call this for loops.
 	void SetPrevVertex(const b2Vec2& prevVertex);
@@ -56,7 +71,29 @@ public:
 	/// Don't call this for loops.
 	void SetNextVertex(const b2Vec2& nextVertex);
 
-	/// Implement b2Shape. Vertices are cloned using b2Alloc.
+	/// Give fixtures of this chain a single broad-phase proxy instead of
+	/// one per edge. The fixture's shape keeps a tree over its edges, which
+	/// finds the edges near the fixtures overlapping the proxy. This keeps
+	/// long chains, such as terrain, from filling the broad-phase. Meant
+	/// for chains on static bodies: on moving bodies the chain's pairs are
+	/// updated every step. Set this before creating fixtures, and don't
+	/// move the vertices of fixtures using it.
+	void SetEdgeTree(bool flag);
+
+	/// Is an edge tree used? See SetEdgeTree().
+	bool IsEdgeTreeEnabled() const { return m_useEdgeTree; }
+
+	/// Get the edge tree of a fixture's chain, or NULL. The leaves hold the
+	/// edges' fat AABBs in the chain's frame and the edge index as user
+	/// data.
+	const b2DynamicTree* GetEdgeTree() const { return m_edgeTree; }
+
+	/// Get the fat AABB of an edge in the edge tree, in the chain's frame.
+	const b2AABB& GetEdgeFatAABB(int32 index) const;
+
+	/// Implement b2Shape. Vertices are cloned using b2Alloc, unless they
+	/// are shared. Clones with SetEdgeTree() build their edge tree, which
+	/// comes from allocator's b2Allocator so a world accounts for it.
 	b2Shape* Clone(b2BlockAllocator* allocator) const;
 
 	/// @see b2Shape::GetChildCount
@@ -76,6 +113,8 @@ public:
 	bool RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
 					const b2Transform& transform, int32 childIndex) const;
 
+	/// b2_edgeTreeChildIndex gives the AABB of the whole chain when it has
+	/// an edge tree.
 	/// @see b2Shape::ComputeAABB
 	void ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const;
 
@@ -83,7 +122,7 @@ public:
 	/// @see b2Shape::ComputeMass
 	void ComputeMass(b2MassData* massData, float32 density) const;
 
-	/// The vertices. Owned by this class.
+	/// The vertices. Owned by this class unless m_sharedVertices is set.
 	b2Vec2* m_vertices;
 
 	/// The vertex count.
@@ -91,6 +130,23 @@ public:
 
 	b2Vec2 m_prevVertex, m_nextVertex;
 	bool m_hasPrevVertex, m_hasNextVertex;
+
+	/// Are the vertices kept by someone else? See ShareVertices().
+	bool m_sharedVertices;
+
+private:
+	// Build the tree over the edges and the bounds of the chain, taking
+	// its memory from allocator.
+	void BuildEdgeTree(b2Allocator* allocator);
+
+	bool m_useEdgeTree;
+	b2DynamicTree* m_edgeTree;
+	// Where the edge tree and its leaves come from.
+	b2Allocator* m_edgeTreeAllocator;
+	// The tree leaf of each edge.
+	int32* m_edgeTreeLeaves;
+	// The chain's AABB in its own frame.
+	b2AABB m_edgeTreeBounds;
 };
 
 inline b2ChainShape::b2ChainShape()
@@ -101,6 +157,11 @@ inline b2ChainShape::b2ChainShape()
 	m_count = 0;
 	m_hasPrevVertex = false;
 	m_hasNextVertex = false;
+	m_sharedVertices = false;
+	m_useEdgeTree = false;
+	m_edgeTree = NULL;
+	m_edgeTreeAllocator = NULL;
+	m_edgeTreeLeaves = NULL;
 }
 
 #endif
@@ -25,6 +25,7 @@ b2Shape* b2PolygonShape::Clone(b2BlockAllocator* allocator) const
 	void* mem = allocator->Allocate(sizeof(b2PolygonShape));
 	b2PolygonShape* clone = new (mem) b2PolygonShape;
 	*clone = *this;
+	clone->UpdateSoa();
 	return clone;
 }
 
@@ -40,6 +41,7 @@ void b2PolygonShape::SetAsBox(float32 hx, float32 hy)
 	m_normals[2].Set(0.0f, 1.0f);
 	m_normals[3].Set(-1.0f, 0.0f);
 	m_centroid.SetZero();
+	UpdateSoa();
 }
 
 void b2PolygonShape::SetAsBox(float32 hx, float32 hy, const b2Vec2& center, float32 angle)
@@ -65,6 +67,7 @@ void b2PolygonShape::SetAsBox(float32 hx, float32 hy, const b2Vec2& center, floa
 		m_vertices[i] = b2Mul(xf, m_vertices[i]);
 		m_normals[i] = b2Mul(xf.q, m_normals[i]);
 	}
+	UpdateSoa();
 }
 
 int32 b2PolygonShape::GetChildCount() const
@@ -239,6 +242,7 @@ void b2PolygonShape::Set(const b2Vec2* vertices, int32 count)
 
 	// Compute the polygon centroid.
 	m_centroid = ComputeCentroid(m_vertices, m);
+	UpdateSoa();
 }
 
 bool b2PolygonShape::TestPoint(const b2Transform& xf, const b2Vec2& p) const
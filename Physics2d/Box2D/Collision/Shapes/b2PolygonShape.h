@@ -22,6 +22,16 @@
 
 #include <Box2D/Collision/Shapes/b2Shape.h>
 
+/// The SIMD polygon collision path needs the structure-of-arrays copy of the
+/// polygon's vertices and normals.
+#if defined(LIQUIDFUN_SIMD_NEON) || defined(LIQUIDFUN_SIMD_SSE)
+#define LIQUIDFUN_SIMD_POLYGON 1
+#endif
+
+/// Number of lanes in the padded structure-of-arrays polygon data. This is
+/// b2_maxPolygonVertices rounded up to a whole number of 4-wide registers.
+#define b2_maxPolygonSoaVertices	((b2_maxPolygonVertices + 3) & ~3)
+
 /// A convex polygon. It is assumed that the interior of the polygon is to
 /// the left of each edge.
 /// Polygons have a maximum number of vertices equal to b2_maxPolygonVertices.
@@ -100,6 +110,28 @@ public:
 	b2Vec2 m_vertices[b2_maxPolygonVertices];
 	b2Vec2 m_normals[b2_maxPolygonVertices];
 	int32 m_count;
+
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+	/// Structure-of-arrays copy of m_vertices and m_normals. Lanes beyond
+	/// m_count replicate element 0, so min/max reductions over all lanes give
+	/// the same answer as over the first m_count lanes.
+	/// This is refreshed by Set(), SetAsBox() and Clone(), so a shape passed
+	/// to b2Body::CreateFixture() may be filled in directly. If you write
+	/// m_vertices or m_normals of a fixture's shape, call UpdateSoa()
+	/// afterwards.
+	float32 m_soaVertexX[b2_maxPolygonSoaVertices];
+	float32 m_soaVertexY[b2_maxPolygonSoaVertices];
+	float32 m_soaNormalX[b2_maxPolygonSoaVertices];
+	float32 m_soaNormalY[b2_maxPolygonSoaVertices];
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
+
+	/// Refresh the structure-of-arrays copy of the vertices and normals used
+	/// by the SIMD collision path. This is a no-op in non-SIMD builds.
+	void UpdateSoa();
+
+	/// Check that the structure-of-arrays copy matches m_vertices and
+	/// m_normals. Always true in non-SIMD builds.
+	bool IsSoaCurrent() const;
 };
 
 inline b2PolygonShape::b2PolygonShape()
@@ -110,6 +142,39 @@ inline b2PolygonShape::b2PolygonShape()
 	m_centroid.SetZero();
 }
 
+inline bool b2PolygonShape::IsSoaCurrent() const
+{
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+	for (int32 i = 0; i < b2_maxPolygonSoaVertices; ++i)
+	{
+		const int32 j = i < m_count ? i : 0;
+		if (m_soaVertexX[i] != m_vertices[j].x ||
+			m_soaVertexY[i] != m_vertices[j].y ||
+			m_soaNormalX[i] != m_normals[j].x ||
+			m_soaNormalY[i] != m_normals[j].y)
+		{
+			return false;
+		}
+	}
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
+	return true;
+}
+
+inline void b2PolygonShape::UpdateSoa()
+{
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+	b2Assert(0 <= m_count && m_count <= b2_maxPolygonVertices);
+	for (int32 i = 0; i < b2_maxPolygonSoaVertices; ++i)
+	{
+		const int32 j = i < m_count ? i : 0;
+		m_soaVertexX[i] = m_vertices[j].x;
+		m_soaVertexY[i] = m_vertices[j].y;
+		m_soaNormalX[i] = m_normals[j].x;
+		m_soaNormalY[i] = m_normals[j].y;
+	}
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
+}
+
 inline const b2Vec2& b2PolygonShape::GetVertex(int32 index) const
 {
 	b2Assert(0 <= index && index < m_count);
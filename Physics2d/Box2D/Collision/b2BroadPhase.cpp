@@ -17,6 +17,7 @@
 */
 
 #include <Box2D/Collision/b2BroadPhase.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 b2BroadPhase::b2BroadPhase()
 {
@@ -45,6 +46,17 @@ int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
 	return proxyId;
 }
 
+void b2BroadPhase::CreateProxies(const b2AABB* aabbs, void* const* userData,
+								  int32 count, int32* proxyIds)
+{
+	m_tree.CreateProxies(aabbs, userData, count, proxyIds);
+	m_proxyCount += count;
+	for (int32 i = 0; i < count; ++i)
+	{
+		BufferMove(proxyIds[i]);
+	}
+}
+
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
@@ -117,3 +129,38 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 
 	return true;
 }
+
+void b2BroadPhase::Save(b2SnapshotWriter* writer) const
+{
+	m_tree.Save(writer);
+	writer->Write(m_proxyCount);
+	writer->Write(m_moveCount);
+	writer->WriteArray(m_moveBuffer, m_moveCount);
+}
+
+void b2BroadPhase::Load(b2SnapshotReader* reader)
+{
+	const int32 proxyCount = m_tree.Load(reader);
+	reader->Read(&m_proxyCount);
+	if (m_proxyCount != proxyCount)
+	{
+		reader->SetError();
+	}
+	const int32 moveCount = reader->ReadCount(sizeof(int32));
+	if (moveCount > m_moveCapacity)
+	{
+		b2Free(m_moveBuffer);
+		m_moveCapacity = moveCount;
+		m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+	}
+	m_moveCount = moveCount;
+	reader->ReadArray(m_moveBuffer, m_moveCount);
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		// Moves are nulled when their proxy is destroyed.
+		if (m_moveBuffer[i] != e_nullProxy && IsProxy(m_moveBuffer[i]) == false)
+		{
+			reader->SetError();
+		}
+	}
+}
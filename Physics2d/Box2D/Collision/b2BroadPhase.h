@@ -49,6 +49,11 @@ public:
 	/// UpdatePairs is called.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
 
+	/// Create count proxies with one tree build, writing their ids to
+	/// proxyIds. See b2DynamicTree::CreateProxies().
+	void CreateProxies(const b2AABB* aabbs, void* const* userData,
+					   int32 count, int32* proxyIds);
+
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
 
@@ -62,9 +67,15 @@ public:
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
+	/// Is the id that of a proxy?
+	bool IsProxy(int32 proxyId) const;
+
 	/// Get user data from a proxy. Returns NULL if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
 
+	/// Set user data for a proxy, e.g. after Load().
+	void SetUserData(int32 proxyId, void* userData);
+
 	/// Test overlap of fat AABBs.
 	bool TestOverlap(int32 proxyIdA, int32 proxyIdB) const;
 
@@ -90,6 +101,20 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Query several AABBs at once. See b2DynamicTree::QueryPacket().
+	void QueryPacket(b2TreeQueryPacketFunction function, void* context,
+					 const b2AABB* aabbs, int32 count) const
+	{
+		m_tree.QueryPacket(function, context, aabbs, count);
+	}
+
+	/// Ray-cast several rays at once. See b2DynamicTree::RayCastPacket().
+	void RayCastPacket(b2TreeRayCastPacketFunction function, void* context,
+					   b2RayCastInput* inputs, int32 count) const
+	{
+		m_tree.RayCastPacket(function, context, inputs, count);
+	}
+
 	/// Get the height of the embedded tree.
 	int32 GetTreeHeight() const;
 
@@ -99,11 +124,23 @@ public:
 	/// Get the quality metric of the embedded tree.
 	float32 GetTreeQuality() const;
 
+	/// Get the number of bytes held by the tree and the move and pair
+	/// buffers.
+	int32 GetMemoryUsage() const;
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Write the tree and the proxies waiting for new pairs to a snapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Replace the proxies with those written by Save(). Their user data
+	/// must be set again with SetUserData(). Invalid data flags an error
+	/// on the reader.
+	void Load(b2SnapshotReader* reader);
+
 private:
 
 	friend class b2DynamicTree;
@@ -144,6 +181,11 @@ inline bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
 	return false;
 }
 
+inline bool b2BroadPhase::IsProxy(int32 proxyId) const
+{
+	return m_tree.IsProxy(proxyId);
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
 	return m_tree.GetUserData(proxyId);
@@ -166,6 +208,13 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline int32 b2BroadPhase::GetMemoryUsage() const
+{
+	return m_tree.GetNodeBytes() +
+		m_moveCapacity * (int32)sizeof(int32) +
+		m_pairCapacity * (int32)sizeof(b2Pair);
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
 	return m_tree.GetHeight();
@@ -249,6 +298,11 @@ inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) cons
 	m_tree.RayCast(callback, input);
 }
 
+inline void b2BroadPhase::SetUserData(int32 proxyId, void* userData)
+{
+	m_tree.SetUserData(proxyId, userData);
+}
+
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
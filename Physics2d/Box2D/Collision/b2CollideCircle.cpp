@@ -24,6 +24,15 @@ void b2CollideCircles(
 	b2Manifold* manifold,
 	const b2CircleShape* circleA, const b2Transform& xfA,
 	const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollideCircles(manifold, circleA, xfA, circleB, xfB, 0.0f);
+}
+
+void b2CollideCircles(
+	b2Manifold* manifold,
+	const b2CircleShape* circleA, const b2Transform& xfA,
+	const b2CircleShape* circleB, const b2Transform& xfB,
+	float32 speculativeDistance)
 {
 	manifold->pointCount = 0;
 
@@ -33,7 +42,7 @@ void b2CollideCircles(
 	b2Vec2 d = pB - pA;
 	float32 distSqr = b2Dot(d, d);
 	float32 rA = circleA->m_radius, rB = circleB->m_radius;
-	float32 radius = rA + rB;
+	float32 radius = rA + rB + speculativeDistance;
 	if (distSqr > radius * radius)
 	{
 		return;
@@ -52,6 +61,15 @@ void b2CollidePolygonAndCircle(
 	b2Manifold* manifold,
 	const b2PolygonShape* polygonA, const b2Transform& xfA,
 	const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollidePolygonAndCircle(manifold, polygonA, xfA, circleB, xfB, 0.0f);
+}
+
+void b2CollidePolygonAndCircle(
+	b2Manifold* manifold,
+	const b2PolygonShape* polygonA, const b2Transform& xfA,
+	const b2CircleShape* circleB, const b2Transform& xfB,
+	float32 speculativeDistance)
 {
 	manifold->pointCount = 0;
 
@@ -62,7 +80,8 @@ void b2CollidePolygonAndCircle(
 	// Find the min separating edge.
 	int32 normalIndex = 0;
 	float32 separation = -b2_maxFloat;
-	float32 radius = polygonA->m_radius + circleB->m_radius;
+	float32 radius = polygonA->m_radius + circleB->m_radius +
+		speculativeDistance;
 	int32 vertexCount = polygonA->m_count;
 	const b2Vec2* vertices = polygonA->m_vertices;
 	const b2Vec2* normals = polygonA->m_normals;
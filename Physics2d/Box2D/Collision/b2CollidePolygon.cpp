@@ -19,57 +19,234 @@
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
 
+#if defined(LIQUIDFUN_SIMD_SSE)
+#include <xmmintrin.h>
+#elif defined(LIQUIDFUN_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+// Define LIQUIDFUN_SIMD_TEST_VS_REFERENCE to run both SIMD and reference
+// versions of b2CollidePolygons, and assert that the resulting manifolds
+// match. Any scene with polygon-polygon contacts then acts as a fuzz test
+// of the SIMD path. Unittests/CollidePolygon fuzzes random polygons
+// directly.
+// #define LIQUIDFUN_SIMD_TEST_VS_REFERENCE
+
+// Compute the separation between poly1 and poly2 along the normal of
+// poly1's edge. xf takes poly1's local frame to poly2's.
+static inline float32 b2EdgeSeparation(int32 edge,
+									   const b2PolygonShape* poly1,
+									   const b2PolygonShape* poly2,
+									   const b2Transform& xf)
+{
+	int32 count2 = poly2->m_count;
+	const b2Vec2* v2s = poly2->m_vertices;
+
+	// Get poly1 normal in frame2.
+	b2Vec2 n = b2Mul(xf.q, poly1->m_normals[edge]);
+	b2Vec2 v1 = b2Mul(xf, poly1->m_vertices[edge]);
+
+	// Find deepest point for normal i.
+	float32 si = b2_maxFloat;
+	for (int32 j = 0; j < count2; ++j)
+	{
+		float32 sij = b2Dot(n, v2s[j] - v1);
+		if (sij < si)
+		{
+			si = sij;
+		}
+	}
+	return si;
+}
+
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
-static float32 b2FindMaxSeparation(int32* edgeIndex,
+// The runner-up separation is returned in secondSeparation.
+static float32 b2FindMaxSeparation_Reference(int32* edgeIndex,
+								 float32* secondSeparation,
 								 const b2PolygonShape* poly1, const b2Transform& xf1,
 								 const b2PolygonShape* poly2, const b2Transform& xf2)
 {
 	int32 count1 = poly1->m_count;
-	int32 count2 = poly2->m_count;
-	const b2Vec2* n1s = poly1->m_normals;
-	const b2Vec2* v1s = poly1->m_vertices;
-	const b2Vec2* v2s = poly2->m_vertices;
 	b2Transform xf = b2MulT(xf2, xf1);
 
 	int32 bestIndex = 0;
 	float32 maxSeparation = -b2_maxFloat;
+	float32 nextSeparation = -b2_maxFloat;
 	for (int32 i = 0; i < count1; ++i)
 	{
-		// Get poly1 normal in frame2.
-		b2Vec2 n = b2Mul(xf.q, n1s[i]);
-		b2Vec2 v1 = b2Mul(xf, v1s[i]);
+		float32 si = b2EdgeSeparation(i, poly1, poly2, xf);
+		if (si > maxSeparation)
+		{
+			nextSeparation = maxSeparation;
+			maxSeparation = si;
+			bestIndex = i;
+		}
+		else if (si > nextSeparation)
+		{
+			nextSeparation = si;
+		}
+	}
 
-		// Find deepest point for normal i.
-		float32 si = b2_maxFloat;
+	*edgeIndex = bestIndex;
+	*secondSeparation = nextSeparation;
+	return maxSeparation;
+}
+
+// Find the edge of poly2 whose normal is most anti-parallel to normal1.
+// normal1 is expressed in poly2's frame.
+static int32 b2FindIncidentEdgeIndex_Reference(const b2Vec2& normal1,
+											 const b2PolygonShape* poly2)
+{
+	int32 count2 = poly2->m_count;
+	const b2Vec2* normals2 = poly2->m_normals;
+
+	int32 index = 0;
+	float32 minDot = b2_maxFloat;
+	for (int32 i = 0; i < count2; ++i)
+	{
+		float32 dot = b2Dot(normal1, normals2[i]);
+		if (dot < minDot)
+		{
+			minDot = dot;
+			index = i;
+		}
+	}
+	return index;
+}
+
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+
+// Thin wrappers so the SIMD kernels below can be written once for both
+// instruction sets. Loads are unaligned since shapes come from
+// b2BlockAllocator, which only guarantees pointer alignment.
+#if defined(LIQUIDFUN_SIMD_SSE)
+typedef __m128 b2Float4;
+static inline b2Float4 b2Load4(const float32* p) { return _mm_loadu_ps(p); }
+static inline void b2Store4(float32* p, b2Float4 a) { _mm_storeu_ps(p, a); }
+static inline b2Float4 b2Splat4(float32 f) { return _mm_set1_ps(f); }
+static inline b2Float4 b2Add4(b2Float4 a, b2Float4 b) { return _mm_add_ps(a, b); }
+static inline b2Float4 b2Sub4(b2Float4 a, b2Float4 b) { return _mm_sub_ps(a, b); }
+static inline b2Float4 b2Mul4(b2Float4 a, b2Float4 b) { return _mm_mul_ps(a, b); }
+static inline b2Float4 b2Min4(b2Float4 a, b2Float4 b) { return _mm_min_ps(a, b); }
+#else
+typedef float32x4_t b2Float4;
+static inline b2Float4 b2Load4(const float32* p) { return vld1q_f32(p); }
+static inline void b2Store4(float32* p, b2Float4 a) { vst1q_f32(p, a); }
+static inline b2Float4 b2Splat4(float32 f) { return vdupq_n_f32(f); }
+static inline b2Float4 b2Add4(b2Float4 a, b2Float4 b) { return vaddq_f32(a, b); }
+static inline b2Float4 b2Sub4(b2Float4 a, b2Float4 b) { return vsubq_f32(a, b); }
+static inline b2Float4 b2Mul4(b2Float4 a, b2Float4 b) { return vmulq_f32(a, b); }
+static inline b2Float4 b2Min4(b2Float4 a, b2Float4 b) { return vminq_f32(a, b); }
+#endif // defined(LIQUIDFUN_SIMD_SSE)
+
+// SIMD version of b2FindMaxSeparation_Reference. Four reference edges of
+// poly1 are tested at once: their normals and vertices are rotated into
+// poly2's frame lane-wise, then every vertex of poly2 is broadcast against
+// them. Each lane evaluates exactly the same expressions as the scalar code.
+static float32 b2FindMaxSeparation_Simd(int32* edgeIndex,
+								 float32* secondSeparation,
+								 const b2PolygonShape* poly1, const b2Transform& xf1,
+								 const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	int32 count1 = poly1->m_count;
+	int32 count2 = poly2->m_count;
+	const b2Vec2* v2s = poly2->m_vertices;
+	b2Transform xf = b2MulT(xf2, xf1);
+
+	const b2Float4 c = b2Splat4(xf.q.c);
+	const b2Float4 s = b2Splat4(xf.q.s);
+	const b2Float4 px = b2Splat4(xf.p.x);
+	const b2Float4 py = b2Splat4(xf.p.y);
+
+	float32 separations[b2_maxPolygonSoaVertices];
+	for (int32 i = 0; i < count1; i += 4)
+	{
+		// Get poly1 normals and vertices in frame2.
+		const b2Float4 n1x = b2Load4(poly1->m_soaNormalX + i);
+		const b2Float4 n1y = b2Load4(poly1->m_soaNormalY + i);
+		const b2Float4 v1x = b2Load4(poly1->m_soaVertexX + i);
+		const b2Float4 v1y = b2Load4(poly1->m_soaVertexY + i);
+		const b2Float4 nx = b2Sub4(b2Mul4(c, n1x), b2Mul4(s, n1y));
+		const b2Float4 ny = b2Add4(b2Mul4(s, n1x), b2Mul4(c, n1y));
+		const b2Float4 vx =
+			b2Add4(b2Sub4(b2Mul4(c, v1x), b2Mul4(s, v1y)), px);
+		const b2Float4 vy =
+			b2Add4(b2Add4(b2Mul4(s, v1x), b2Mul4(c, v1y)), py);
+
+		// Find deepest point for each normal.
+		b2Float4 si = b2Splat4(b2_maxFloat);
 		for (int32 j = 0; j < count2; ++j)
 		{
-			float32 sij = b2Dot(n, v2s[j] - v1);
-			if (sij < si)
-			{
-				si = sij;
-			}
+			const b2Float4 dx = b2Sub4(b2Splat4(v2s[j].x), vx);
+			const b2Float4 dy = b2Sub4(b2Splat4(v2s[j].y), vy);
+			si = b2Min4(si, b2Add4(b2Mul4(nx, dx), b2Mul4(ny, dy)));
 		}
+		b2Store4(separations + i, si);
+	}
 
-		if (si > maxSeparation)
+	// Reduce in edge order so ties resolve like the scalar loop.
+	int32 bestIndex = 0;
+	float32 maxSeparation = -b2_maxFloat;
+	float32 nextSeparation = -b2_maxFloat;
+	for (int32 i = 0; i < count1; ++i)
+	{
+		if (separations[i] > maxSeparation)
 		{
-			maxSeparation = si;
+			nextSeparation = maxSeparation;
+			maxSeparation = separations[i];
 			bestIndex = i;
 		}
+		else if (separations[i] > nextSeparation)
+		{
+			nextSeparation = separations[i];
+		}
 	}
 
 	*edgeIndex = bestIndex;
+	*secondSeparation = nextSeparation;
 	return maxSeparation;
 }
 
+// SIMD version of b2FindIncidentEdgeIndex_Reference.
+static int32 b2FindIncidentEdgeIndex_Simd(const b2Vec2& normal1,
+										const b2PolygonShape* poly2)
+{
+	int32 count2 = poly2->m_count;
+	const b2Float4 nx = b2Splat4(normal1.x);
+	const b2Float4 ny = b2Splat4(normal1.y);
+
+	float32 dots[b2_maxPolygonSoaVertices];
+	for (int32 i = 0; i < count2; i += 4)
+	{
+		const b2Float4 n2x = b2Load4(poly2->m_soaNormalX + i);
+		const b2Float4 n2y = b2Load4(poly2->m_soaNormalY + i);
+		b2Store4(dots + i, b2Add4(b2Mul4(nx, n2x), b2Mul4(ny, n2y)));
+	}
+
+	int32 index = 0;
+	float32 minDot = b2_maxFloat;
+	for (int32 i = 0; i < count2; ++i)
+	{
+		if (dots[i] < minDot)
+		{
+			minDot = dots[i];
+			index = i;
+		}
+	}
+	return index;
+}
+
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
+
 static void b2FindIncidentEdge(b2ClipVertex c[2],
 							 const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1,
-							 const b2PolygonShape* poly2, const b2Transform& xf2)
+							 const b2PolygonShape* poly2, const b2Transform& xf2,
+							 bool reference)
 {
 	const b2Vec2* normals1 = poly1->m_normals;
 
 	int32 count2 = poly2->m_count;
 	const b2Vec2* vertices2 = poly2->m_vertices;
-	const b2Vec2* normals2 = poly2->m_normals;
 
 	b2Assert(0 <= edge1 && edge1 < poly1->m_count);
 
@@ -77,17 +254,14 @@ static void b2FindIncidentEdge(b2ClipVertex c[2],
 	b2Vec2 normal1 = b2MulT(xf2.q, b2Mul(xf1.q, normals1[edge1]));
 
 	// Find the incident edge on poly2.
-	int32 index = 0;
-	float32 minDot = b2_maxFloat;
-	for (int32 i = 0; i < count2; ++i)
-	{
-		float32 dot = b2Dot(normal1, normals2[i]);
-		if (dot < minDot)
-		{
-			minDot = dot;
-			index = i;
-		}
-	}
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+	int32 index = reference ?
+		b2FindIncidentEdgeIndex_Reference(normal1, poly2) :
+		b2FindIncidentEdgeIndex_Simd(normal1, poly2);
+#else
+	B2_NOT_USED(reference);
+	int32 index = b2FindIncidentEdgeIndex_Reference(normal1, poly2);
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
 
 	// Build the clip vertices for the incident edge.
 	int32 i1 = index;
@@ -112,23 +286,63 @@ static void b2FindIncidentEdge(b2ClipVertex c[2],
 // Find incident edge
 // Clip
 
-// The normal points from 1 to 2
-void b2CollidePolygons(b2Manifold* manifold,
-					  const b2PolygonShape* polyA, const b2Transform& xfA,
-					  const b2PolygonShape* polyB, const b2Transform& xfB)
+static inline float32 b2FindMaxSeparation(int32* edgeIndex,
+								 float32* secondSeparation,
+								 const b2PolygonShape* poly1, const b2Transform& xf1,
+								 const b2PolygonShape* poly2, const b2Transform& xf2,
+								 bool reference)
 {
-	manifold->pointCount = 0;
-	float32 totalRadius = polyA->m_radius + polyB->m_radius;
+#if defined(LIQUIDFUN_SIMD_POLYGON)
+	if (!reference)
+	{
+		return b2FindMaxSeparation_Simd(edgeIndex, secondSeparation,
+										poly1, xf1, poly2, xf2);
+	}
+#else
+	B2_NOT_USED(reference);
+#endif // defined(LIQUIDFUN_SIMD_POLYGON)
+	return b2FindMaxSeparation_Reference(edgeIndex, secondSeparation,
+										 poly1, xf1, poly2, xf2);
+}
 
-	int32 edgeA = 0;
-	float32 separationA = b2FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB);
-	if (separationA > totalRadius)
-		return;
+// Largest distance from a polygon's local origin to any of its vertices.
+static float32 b2ComputeVertexRadius(const b2PolygonShape* poly)
+{
+	float32 radiusSquared = 0.0f;
+	for (int32 i = 0; i < poly->m_count; ++i)
+	{
+		radiusSquared = b2Max(radiusSquared, poly->m_vertices[i].LengthSquared());
+	}
+	return b2Sqrt(radiusSquared);
+}
 
-	int32 edgeB = 0;
-	float32 separationB = b2FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA);
-	if (separationB > totalRadius)
-		return;
+// Bound how far any edge separation can have moved since the cache was
+// filled. For a relative motion of dp and d(theta), each separation
+// changes by at most |dp| + |d(theta)| * (rA + rB + 2 |p|), where rA and rB
+// are the vertex radii and p is the cached relative translation.
+static float32 b2ComputeSeparationDrift(const b2SeparatingAxisCache* cache,
+										const b2Transform& xf)
+{
+	b2Rot dq = b2MulT(cache->relative.q, xf.q);
+	if (dq.c <= 0.0f)
+	{
+		return b2_maxFloat;
+	}
+	// |theta| <= pi/2 * |sin(theta)| for |theta| <= pi/2.
+	float32 angle = 0.5f * b2_pi * b2Abs(dq.s);
+	return b2Distance(xf.p, cache->relative.p) + angle * cache->radius;
+}
+
+static void b2CollidePolygonsInternal(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2Transform& xfA,
+					  const b2PolygonShape* polyB, const b2Transform& xfB,
+					  b2SeparatingAxisCache* cache,
+					  float32 speculativeDistance, bool reference)
+{
+	manifold->pointCount = 0;
+	float32 totalRadius = polyA->m_radius + polyB->m_radius +
+		speculativeDistance;
+	b2Transform xfAB = b2MulT(xfB, xfA);
 
 	const b2PolygonShape* poly1;	// reference polygon
 	const b2PolygonShape* poly2;	// incident polygon
@@ -137,15 +351,110 @@ void b2CollidePolygons(b2Manifold* manifold,
 	uint8 flip;
 	const float32 k_tol = 0.1f * b2_linearSlop;
 
-	if (separationB > separationA + k_tol)
+	// Try the cached axis first. Any axis with a separation above the total
+	// radius proves the polygons are apart. If the pair has barely moved
+	// relative to each other, the cached reference edge is still the one the
+	// full search would pick.
+	bool useCache = false;
+	if (cache && cache->edge >= 0)
+	{
+		float32 separation;
+		if (cache->flip)
+		{
+			b2Assert(cache->edge < polyB->m_count);
+			separation = b2EdgeSeparation(cache->edge, polyB, polyA,
+										  b2MulT(xfA, xfB));
+		}
+		else
+		{
+			b2Assert(cache->edge < polyA->m_count);
+			separation = b2EdgeSeparation(cache->edge, polyA, polyB, xfAB);
+		}
+		if (separation > totalRadius)
+			return;
+
+		useCache = cache->margin > 0.0f &&
+			b2ComputeSeparationDrift(cache, xfAB) < cache->margin;
+	}
+
+	if (useCache)
+	{
+		edge1 = cache->edge;
+		flip = cache->flip;
+	}
+	else
+	{
+		int32 edgeA = 0;
+		float32 nextA;
+		float32 separationA = b2FindMaxSeparation(&edgeA, &nextA,
+												  polyA, xfA, polyB, xfB,
+												  reference);
+		if (separationA > totalRadius)
+		{
+			if (cache)
+			{
+				cache->edge = edgeA;
+				cache->flip = 0;
+				cache->margin = -1.0f;
+			}
+			return;
+		}
+
+		int32 edgeB = 0;
+		float32 nextB;
+		float32 separationB = b2FindMaxSeparation(&edgeB, &nextB,
+												  polyB, xfB, polyA, xfA,
+												  reference);
+		if (separationB > totalRadius)
+		{
+			if (cache)
+			{
+				cache->edge = edgeB;
+				cache->flip = 1;
+				cache->margin = -1.0f;
+			}
+			return;
+		}
+
+		// The margin is how far every separation may drift before the
+		// choice below, or the early outs above, could change.
+		float32 margin;
+		if (separationB > separationA + k_tol)
+		{
+			edge1 = edgeB;
+			flip = 1;
+			margin = b2Min(0.5f * (separationB - nextB),
+						   0.5f * (separationB - separationA - k_tol));
+			margin = b2Min(margin, totalRadius - separationA);
+		}
+		else
+		{
+			edge1 = edgeA;
+			flip = 0;
+			margin = b2Min(0.5f * (separationA - nextA),
+						   0.5f * (separationA + k_tol - separationB));
+			margin = b2Min(margin, totalRadius - separationB);
+		}
+
+		if (cache)
+		{
+			cache->relative = xfAB;
+			cache->radius = b2ComputeVertexRadius(polyA) +
+				b2ComputeVertexRadius(polyB) + 2.0f * xfAB.p.Length();
+			// Leave headroom for rounding in the separations themselves.
+			cache->margin = margin - 0.01f * b2_linearSlop;
+			cache->edge = edge1;
+			cache->flip = flip;
+		}
+	}
+
+	if (flip)
 	{
 		poly1 = polyB;
 		poly2 = polyA;
 		xf1 = xfB;
 		xf2 = xfA;
-		edge1 = edgeB;
 		manifold->type = b2Manifold::e_faceB;
-		flip = 1;
 	}
 	else
 	{
@@ -153,13 +462,11 @@ void b2CollidePolygons(b2Manifold* manifold,
 		poly2 = polyB;
 		xf1 = xfA;
 		xf2 = xfB;
-		edge1 = edgeA;
 		manifold->type = b2Manifold::e_faceA;
-		flip = 0;
 	}
 
 	b2ClipVertex incidentEdge[2];
-	b2FindIncidentEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+	b2FindIncidentEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2, reference);
 
 	int32 count1 = poly1->m_count;
 	const b2Vec2* vertices1 = poly1->m_vertices;
@@ -237,3 +544,77 @@ void b2CollidePolygons(b2Manifold* manifold,
 
 	manifold->pointCount = pointCount;
 }
+
+#if defined(LIQUIDFUN_SIMD_TEST_VS_REFERENCE)
+static bool b2ManifoldsApproximatelyEqual(const b2Manifold& a,
+										  const b2Manifold& b)
+{
+	static const float32 MAX_POINT_DIFF = b2_linearSlop * 0.01f;
+	if (a.pointCount != b.pointCount)
+		return false;
+	if (a.pointCount == 0)
+		return true;
+	if (a.type != b.type ||
+		b2DistanceSquared(a.localNormal, b.localNormal) >
+			MAX_POINT_DIFF * MAX_POINT_DIFF ||
+		b2DistanceSquared(a.localPoint, b.localPoint) >
+			MAX_POINT_DIFF * MAX_POINT_DIFF)
+		return false;
+	for (int32 i = 0; i < a.pointCount; ++i)
+	{
+		if (a.points[i].id.key != b.points[i].id.key ||
+			b2DistanceSquared(a.points[i].localPoint,
+							  b.points[i].localPoint) >
+				MAX_POINT_DIFF * MAX_POINT_DIFF)
+			return false;
+	}
+	return true;
+}
+#endif // defined(LIQUIDFUN_SIMD_TEST_VS_REFERENCE)
+
+void b2CollidePolygons(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2Transform& xfA,
+					  const b2PolygonShape* polyB, const b2Transform& xfB)
+{
+	b2CollidePolygons(manifold, polyA, xfA, polyB, xfB, NULL, 0.0f);
+}
+
+void b2CollidePolygons(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2Transform& xfA,
+					  const b2PolygonShape* polyB, const b2Transform& xfB,
+					  b2SeparatingAxisCache* cache, float32 speculativeDistance)
+{
+	// Cached margins are only valid for the radius they were computed with.
+	// Entries stay usable afterwards since drift is measured from the
+	// configuration that filled them.
+	if (speculativeDistance > 0.0f)
+	{
+		cache = NULL;
+	}
+
+	#if defined(LIQUIDFUN_SIMD_POLYGON)
+		// Shapes written directly after their fixture was created have stale
+		// SIMD data. See b2PolygonShape::UpdateSoa().
+		b2Assert(polyA->IsSoaCurrent() && polyB->IsSoaCurrent());
+		b2CollidePolygonsInternal(manifold, polyA, xfA, polyB, xfB, cache,
+								  speculativeDistance, false);
+	#else
+		b2CollidePolygonsInternal(manifold, polyA, xfA, polyB, xfB, cache,
+								  speculativeDistance, true);
+	#endif
+
+	#if defined(LIQUIDFUN_SIMD_TEST_VS_REFERENCE)
+		b2Manifold reference;
+		b2CollidePolygonsInternal(&reference, polyA, xfA, polyB, xfB, NULL,
+								  speculativeDistance, true);
+		b2Assert(b2ManifoldsApproximatelyEqual(*manifold, reference));
+	#endif // defined(LIQUIDFUN_SIMD_TEST_VS_REFERENCE)
+}
+
+void b2CollidePolygonsReference(b2Manifold* manifold,
+					  const b2PolygonShape* polyA, const b2Transform& xfA,
+					  const b2PolygonShape* polyB, const b2Transform& xfB)
+{
+	b2CollidePolygonsInternal(manifold, polyA, xfA, polyB, xfB, NULL, 0.0f,
+							  true);
+}
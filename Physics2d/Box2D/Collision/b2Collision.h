@@ -136,6 +136,19 @@ enum b2PointState
 void b2GetPointStates(b2PointState state1[b2_maxManifoldPoints], b2PointState state2[b2_maxManifoldPoints],
 					  const b2Manifold* manifold1, const b2Manifold* manifold2);
 
+/// Used to warm start b2CollidePolygons between steps. Set edge to -1
+/// before the first call. The cache remembers the last separating axis or
+/// reference edge, and how far the pair may move relative to each other
+/// before the full separating axis search has to run again.
+struct b2SeparatingAxisCache
+{
+	b2Transform relative;	///< polygon A in polygon B's frame when the cache was filled
+	float32 radius;			///< scales relative rotation into separation drift
+	float32 margin;			///< allowed separation drift, negative if the axis only proves separation
+	int32 edge;				///< cached edge index or -1 if empty
+	uint8 flip;				///< 1 if edge belongs to polygon B
+};
+
 /// Used for computing contact manifolds.
 struct b2ClipVertex
 {
@@ -225,11 +238,43 @@ void b2CollidePolygonAndCircle(b2Manifold* manifold,
 							   const b2PolygonShape* polygonA, const b2Transform& xfA,
 							   const b2CircleShape* circleB, const b2Transform& xfB);
 
+/// Compute the collision manifold between two circles, also keeping a point
+/// when the surfaces are apart by no more than speculativeDistance.
+void b2CollideCircles(b2Manifold* manifold,
+					  const b2CircleShape* circleA, const b2Transform& xfA,
+					  const b2CircleShape* circleB, const b2Transform& xfB,
+					  float32 speculativeDistance);
+
+/// Compute the collision manifold between a polygon and a circle, also
+/// keeping a point when the surfaces are apart by no more than
+/// speculativeDistance.
+void b2CollidePolygonAndCircle(b2Manifold* manifold,
+							   const b2PolygonShape* polygonA, const b2Transform& xfA,
+							   const b2CircleShape* circleB, const b2Transform& xfB,
+							   float32 speculativeDistance);
+
 /// Compute the collision manifold between two polygons.
 void b2CollidePolygons(b2Manifold* manifold,
 					   const b2PolygonShape* polygonA, const b2Transform& xfA,
 					   const b2PolygonShape* polygonB, const b2Transform& xfB);
 
+/// Compute the collision manifold between two polygons, warm starting the
+/// separating axis search from the cache. The cache is input/output, may be
+/// NULL, and gives the same manifold as the uncached version. Points are
+/// also kept when the surfaces are apart by no more than
+/// speculativeDistance; the cache is bypassed while that is non-zero.
+void b2CollidePolygons(b2Manifold* manifold,
+					   const b2PolygonShape* polygonA, const b2Transform& xfA,
+					   const b2PolygonShape* polygonB, const b2Transform& xfB,
+					   b2SeparatingAxisCache* cache, float32 speculativeDistance);
+
+/// Compute the collision manifold between two polygons with the scalar
+/// implementation, even in SIMD builds. The SIMD path is checked against
+/// this.
+void b2CollidePolygonsReference(b2Manifold* manifold,
+								const b2PolygonShape* polygonA, const b2Transform& xfA,
+								const b2PolygonShape* polygonB, const b2Transform& xfB);
+
 /// Compute the collision manifold between an edge and a circle.
 void b2CollideEdgeAndCircle(b2Manifold* manifold,
 							   const b2EdgeShape* polygonA, const b2Transform& xfA,
@@ -240,6 +285,21 @@ void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 							   const b2EdgeShape* edgeA, const b2Transform& xfA,
 							   const b2PolygonShape* circleB, const b2Transform& xfB);
 
+/// Compute the collision manifold between an edge and a circle, also keeping
+/// a point when the surfaces are apart by no more than speculativeDistance.
+void b2CollideEdgeAndCircle(b2Manifold* manifold,
+							   const b2EdgeShape* polygonA, const b2Transform& xfA,
+							   const b2CircleShape* circleB, const b2Transform& xfB,
+							   float32 speculativeDistance);
+
+/// Compute the collision manifold between an edge and a polygon, also
+/// keeping points when the surfaces are apart by no more than
+/// speculativeDistance.
+void b2CollideEdgeAndPolygon(b2Manifold* manifold,
+							   const b2EdgeShape* edgeA, const b2Transform& xfA,
+							   const b2PolygonShape* circleB, const b2Transform& xfB,
+							   float32 speculativeDistance);
+
 /// Clipping for contact manifolds.
 int32 b2ClipSegmentToLine(b2ClipVertex vOut[2], const b2ClipVertex vIn[2],
 							const b2Vec2& normal, float32 offset, int32 vertexIndexA);
@@ -249,6 +309,12 @@ bool b2TestOverlap(	const b2Shape* shapeA, int32 indexA,
 					const b2Shape* shapeB, int32 indexB,
 					const b2Transform& xfA, const b2Transform& xfB);
 
+/// Compute an AABB bounding a box moved by a transform.
+b2AABB b2Mul(const b2Transform& xf, const b2AABB& aabb);
+
+/// Compute an AABB bounding a box moved by the inverse of a transform.
+b2AABB b2MulT(const b2Transform& xf, const b2AABB& aabb);
+
 // ---------------- Inline Functions ------------------------------------------
 
 inline bool b2AABB::IsValid() const
@@ -274,4 +340,29 @@ inline bool b2TestOverlap(const b2AABB& a, const b2AABB& b)
 	return true;
 }
 
+inline b2AABB b2Mul(const b2Transform& xf, const b2AABB& aabb)
+{
+	b2Vec2 c = b2Mul(xf, aabb.GetCenter());
+	b2Vec2 e = aabb.GetExtents();
+	b2Vec2 r(b2Abs(xf.q.c) * e.x + b2Abs(xf.q.s) * e.y,
+			 b2Abs(xf.q.s) * e.x + b2Abs(xf.q.c) * e.y);
+	b2AABB out;
+	out.lowerBound = c - r;
+	out.upperBound = c + r;
+	return out;
+}
+
+inline b2AABB b2MulT(const b2Transform& xf, const b2AABB& aabb)
+{
+	// The inverse rotation has the same absolute sine and cosine.
+	b2Vec2 c = b2MulT(xf, aabb.GetCenter());
+	b2Vec2 e = aabb.GetExtents();
+	b2Vec2 r(b2Abs(xf.q.c) * e.x + b2Abs(xf.q.s) * e.y,
+			 b2Abs(xf.q.s) * e.x + b2Abs(xf.q.c) * e.y);
+	b2AABB out;
+	out.lowerBound = c - r;
+	out.upperBound = c + r;
+	return out;
+}
+
 #endif
@@ -24,6 +24,7 @@
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
 #include <Box2D/Collision/Shapes/b2ChainShape.h>
 #include <Box2D/Collision/Shapes/b2PolygonShape.h>
+#include <Box2D/Common/b2TaskExecutor.h>
 
 // GJK using Voronoi regions (Christer Ericson) and Barycentric coordinates.
 int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
@@ -444,17 +445,22 @@ void b2Simplex::Solve3()
 	m_count = 3;
 }
 
-void b2Distance(b2DistanceOutput* output,
-				b2SimplexCache* cache,
-				const b2DistanceInput* input)
+// Shared by b2Distance and b2DistanceBatch so both produce identical results.
+// The global statistics are only updated when updateStats is set, since
+// batches may run on several threads.
+static void b2Distance(b2DistanceOutput* output,
+					   b2SimplexCache* cache,
+					   const b2DistanceProxy* proxyA,
+					   const b2Transform& transformA,
+					   const b2DistanceProxy* proxyB,
+					   const b2Transform& transformB,
+					   bool useRadii,
+					   bool updateStats)
 {
-	++b2_gjkCalls;
-
-	const b2DistanceProxy* proxyA = &input->proxyA;
-	const b2DistanceProxy* proxyB = &input->proxyB;
-
-	b2Transform transformA = input->transformA;
-	b2Transform transformB = input->transformB;
+	if (updateStats)
+	{
+		++b2_gjkCalls;
+	}
 
 	// Initialize the simplex.
 	b2Simplex simplex;
@@ -552,7 +558,6 @@ void b2Distance(b2DistanceOutput* output,
 
 		// Iteration count is equated to the number of support point calls.
 		++iter;
-		++b2_gjkIters;
 
 		// Check for duplicate support points. This is the main termination criteria.
 		bool duplicate = false;
@@ -575,7 +580,11 @@ void b2Distance(b2DistanceOutput* output,
 		++simplex.m_count;
 	}
 
-	b2_gjkMaxIters = b2Max(b2_gjkMaxIters, iter);
+	if (updateStats)
+	{
+		b2_gjkIters += iter;
+		b2_gjkMaxIters = b2Max(b2_gjkMaxIters, iter);
+	}
 
 	// Prepare output.
 	simplex.GetWitnessPoints(&output->pointA, &output->pointB);
@@ -586,7 +595,7 @@ void b2Distance(b2DistanceOutput* output,
 	simplex.WriteCache(cache);
 
 	// Apply radii if requested.
-	if (input->useRadii)
+	if (useRadii)
 	{
 		float32 rA = proxyA->m_radius;
 		float32 rB = proxyB->m_radius;
@@ -612,3 +621,64 @@ void b2Distance(b2DistanceOutput* output,
 		}
 	}
 }
+
+void b2Distance(b2DistanceOutput* output,
+				b2SimplexCache* cache,
+				const b2DistanceInput* input)
+{
+	b2Distance(output, cache, &input->proxyA, input->transformA,
+			   &input->proxyB, input->transformB, input->useRadii, true);
+}
+
+// The arguments of a b2DistanceBatch call, shared by its ranges.
+struct b2DistanceBatchContext
+{
+	b2DistanceOutput* outputs;
+	b2SimplexCache* caches;
+	const b2DistancePair* pairs;
+	const b2DistanceProxy* proxies;
+	const b2Transform* transforms;
+	bool useRadii;
+};
+
+static void b2DistanceBatchRange(void* context, int32 begin, int32 end)
+{
+	const b2DistanceBatchContext* batch = (b2DistanceBatchContext*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		const b2DistancePair& pair = batch->pairs[i];
+		b2Distance(&batch->outputs[i], &batch->caches[i],
+				   &batch->proxies[pair.proxyA],
+				   batch->transforms[pair.transformA],
+				   &batch->proxies[pair.proxyB],
+				   batch->transforms[pair.transformB],
+				   batch->useRadii, false);
+	}
+}
+
+void b2DistanceBatch(b2DistanceOutput* outputs,
+					 b2SimplexCache* caches,
+					 const b2DistancePair* pairs,
+					 int32 count,
+					 const b2DistanceProxy* proxies,
+					 const b2Transform* transforms,
+					 bool useRadii,
+					 b2TaskExecutor* executor)
+{
+	b2DistanceBatchContext batch;
+	batch.outputs = outputs;
+	batch.caches = caches;
+	batch.pairs = pairs;
+	batch.proxies = proxies;
+	batch.transforms = transforms;
+	batch.useRadii = useRadii;
+	if (executor && count > b2_minDistanceBatchRange)
+	{
+		executor->ParallelFor(&b2DistanceBatchRange, &batch, count,
+							  b2_minDistanceBatchRange);
+	}
+	else
+	{
+		b2DistanceBatchRange(&batch, 0, count);
+	}
+}
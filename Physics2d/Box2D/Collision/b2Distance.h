@@ -23,6 +23,7 @@
 #include <Box2D/Common/b2Math.h>
 
 class b2Shape;
+class b2TaskExecutor;
 
 /// A distance proxy is used by the GJK algorithm.
 /// It encapsulates any shape.
@@ -90,6 +91,37 @@ void b2Distance(b2DistanceOutput* output,
 				b2SimplexCache* cache, 
 				const b2DistanceInput* input);
 
+/// Fewest queries of b2DistanceBatch run together on one thread.
+const int32 b2_minDistanceBatchRange = 64;
+
+/// One query of b2DistanceBatch. Proxies and transforms are referenced by
+/// index so that many queries can share the same shapes and poses.
+struct b2DistancePair
+{
+	int32 proxyA;		///< index into the batch's proxy array
+	int32 proxyB;		///< index into the batch's proxy array
+	int32 transformA;	///< index into the batch's transform array
+	int32 transformB;	///< index into the batch's transform array
+};
+
+/// Compute the closest points for count queries. outputs[i] and caches[i]
+/// belong to pairs[i]; keep the caches between frames to warm start each
+/// pair, and set their count to zero for new pairs. Each query gives exactly
+/// the result b2Distance would for the same proxies, transforms and cache.
+/// The queries are spread over executor's threads in ranges of
+/// b2_minDistanceBatchRange, or run on the calling thread if executor is
+/// NULL. Batched queries don't update the global GJK statistics
+/// (b2_gjkCalls and friends); each output's iterations can be summed
+/// instead. See Benchmark/DistanceBatchBenchmark.cpp.
+void b2DistanceBatch(b2DistanceOutput* outputs,
+					 b2SimplexCache* caches,
+					 const b2DistancePair* pairs,
+					 int32 count,
+					 const b2DistanceProxy* proxies,
+					 const b2Transform* transforms,
+					 bool useRadii,
+					 b2TaskExecutor* executor);
+
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -18,16 +18,32 @@
 */
 
 #include <Box2D/Collision/b2DynamicTree.h>
+#include <Box2D/Common/b2Allocator.h>
+#include <Box2D/Common/b2Lanes.h>
+#include <Box2D/Common/b2Snapshot.h>
+#include <algorithm>
 #include <memory.h>
 #include <string.h>
 
 b2DynamicTree::b2DynamicTree()
+{
+	m_allocator = NULL;
+	Initialize();
+}
+
+b2DynamicTree::b2DynamicTree(b2Allocator* allocator)
+{
+	m_allocator = allocator;
+	Initialize();
+}
+
+void b2DynamicTree::Initialize()
 {
 	m_root = b2_nullNode;
 
 	m_nodeCapacity = 16;
 	m_nodeCount = 0;
-	m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	m_nodes = AllocateNodes(m_nodeCapacity);
 	memset(m_nodes, 0, m_nodeCapacity * sizeof(b2TreeNode));
 
 	// Build a linked list for the free list.
@@ -48,7 +64,27 @@ b2DynamicTree::b2DynamicTree()
 b2DynamicTree::~b2DynamicTree()
 {
 	// This frees the entire tree in one shot.
-	b2Free(m_nodes);
+	FreeNodes(m_nodes, m_nodeCapacity);
+}
+
+b2TreeNode* b2DynamicTree::AllocateNodes(int32 capacity)
+{
+	const int32 size = capacity * (int32)sizeof(b2TreeNode);
+	if (m_allocator)
+	{
+		return (b2TreeNode*)m_allocator->Allocate(size);
+	}
+	return (b2TreeNode*)b2Alloc(size);
+}
+
+void b2DynamicTree::FreeNodes(b2TreeNode* nodes, int32 capacity)
+{
+	if (m_allocator)
+	{
+		m_allocator->Free(nodes, capacity * (int32)sizeof(b2TreeNode));
+		return;
+	}
+	b2Free(nodes);
 }
 
 // Allocate a node from the pool. Grow the pool if necessary.
@@ -58,24 +94,7 @@ int32 b2DynamicTree::AllocateNode()
 	if (m_freeList == b2_nullNode)
 	{
 		b2Assert(m_nodeCount == m_nodeCapacity);
-
-		// The free list is empty. Rebuild a bigger pool.
-		b2TreeNode* oldNodes = m_nodes;
-		m_nodeCapacity *= 2;
-		m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
-		memcpy(m_nodes, oldNodes, m_nodeCount * sizeof(b2TreeNode));
-		b2Free(oldNodes);
-
-		// Build a linked list for the free list. The parent
-		// pointer becomes the "next" pointer.
-		for (int32 i = m_nodeCount; i < m_nodeCapacity - 1; ++i)
-		{
-			m_nodes[i].next = i + 1;
-			m_nodes[i].height = -1;
-		}
-		m_nodes[m_nodeCapacity-1].next = b2_nullNode;
-		m_nodes[m_nodeCapacity-1].height = -1;
-		m_freeList = m_nodeCount;
+		ReserveNodes(2 * m_nodeCapacity);
 	}
 
 	// Peel a node off the free list.
@@ -90,6 +109,33 @@ int32 b2DynamicTree::AllocateNode()
 	return nodeId;
 }
 
+void b2DynamicTree::ReserveNodes(int32 capacity)
+{
+	if (capacity <= m_nodeCapacity)
+	{
+		return;
+	}
+
+	// Rebuild a bigger pool.
+	b2TreeNode* oldNodes = m_nodes;
+	const int32 oldCapacity = m_nodeCapacity;
+	m_nodeCapacity = capacity;
+	m_nodes = AllocateNodes(m_nodeCapacity);
+	memcpy(m_nodes, oldNodes, oldCapacity * sizeof(b2TreeNode));
+	FreeNodes(oldNodes, oldCapacity);
+
+	// Put the new nodes at the front of the free list. The parent
+	// pointer becomes the "next" pointer.
+	for (int32 i = oldCapacity; i < m_nodeCapacity - 1; ++i)
+	{
+		m_nodes[i].next = i + 1;
+		m_nodes[i].height = -1;
+	}
+	m_nodes[m_nodeCapacity-1].next = m_freeList;
+	m_nodes[m_nodeCapacity-1].height = -1;
+	m_freeList = oldCapacity;
+}
+
 // Return a node to the pool.
 void b2DynamicTree::FreeNode(int32 nodeId)
 {
@@ -120,6 +166,100 @@ int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 	return proxyId;
 }
 
+// A leaf of a subtree being built, with the Morton code of its center.
+struct b2TreeBuildLeaf
+{
+	bool operator<(const b2TreeBuildLeaf& other) const
+	{
+		return code < other.code;
+	}
+
+	uint32 code;
+	int32 node;
+};
+
+// Spread the low 16 bits of x out to the even bits.
+static inline uint32 b2SpreadBits(uint32 x)
+{
+	x &= 0x0000ffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+void b2DynamicTree::CreateProxies(const b2AABB* aabbs, void* const* userData,
+								  int32 count, int32* proxyIds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// A subtree of count leaves has count - 1 internal nodes.
+	ReserveNodes(b2Max(m_nodeCapacity, m_nodeCount + 2 * count - 1));
+
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2Vec2 lower(b2_maxFloat, b2_maxFloat);
+	b2Vec2 upper(-b2_maxFloat, -b2_maxFloat);
+	for (int32 i = 0; i < count; ++i)
+	{
+		const int32 proxyId = AllocateNode();
+		m_nodes[proxyId].aabb.lowerBound = aabbs[i].lowerBound - r;
+		m_nodes[proxyId].aabb.upperBound = aabbs[i].upperBound + r;
+		m_nodes[proxyId].userData = userData[i];
+		m_nodes[proxyId].height = 0;
+		proxyIds[i] = proxyId;
+		const b2Vec2 center = aabbs[i].GetCenter();
+		lower = b2Min(lower, center);
+		upper = b2Max(upper, center);
+	}
+
+	// Sort the leaves along a Morton curve through their centers, so that
+	// leaves close on the curve are close in space.
+	b2TreeBuildLeaf* leaves =
+		(b2TreeBuildLeaf*)b2Alloc(count * sizeof(b2TreeBuildLeaf));
+	const b2Vec2 extent = upper - lower;
+	const float32 scale = 65535.0f / b2Max(b2Max(extent.x, extent.y),
+										   b2_epsilon);
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2Vec2 cell = scale * (aabbs[i].GetCenter() - lower);
+		leaves[i].code = b2SpreadBits((uint32)cell.x) |
+			(b2SpreadBits((uint32)cell.y) << 1);
+		leaves[i].node = proxyIds[i];
+	}
+	std::sort(leaves, leaves + count);
+
+	// Build the new leaves into a subtree and insert that as a whole.
+	InsertLeaf(BuildSubtree(leaves, count));
+	b2Free(leaves);
+}
+
+int32 b2DynamicTree::BuildSubtree(const b2TreeBuildLeaf* leaves,
+								  int32 count)
+{
+	if (count == 1)
+	{
+		return leaves[0].node;
+	}
+
+	// Halving the sorted leaves splits them in space too.
+	const int32 half = count / 2;
+	const int32 child1 = BuildSubtree(leaves, half);
+	const int32 child2 = BuildSubtree(leaves + half, count - half);
+	const int32 parent = AllocateNode();
+	m_nodes[parent].child1 = child1;
+	m_nodes[parent].child2 = child2;
+	m_nodes[parent].height =
+		1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
+	m_nodes[parent].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+	m_nodes[child1].parent = parent;
+	m_nodes[child2].parent = parent;
+	return parent;
+}
+
 void b2DynamicTree::DestroyProxy(int32 proxyId)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -656,6 +796,207 @@ void b2DynamicTree::ValidateMetrics(int32 index) const
 	ValidateMetrics(child2);
 }
 
+void b2DynamicTree::QueryPacket(b2TreeQueryPacketFunction function,
+								void* context, const b2AABB* aabbs,
+								int32 count) const
+{
+	b2Assert(b2_treePacketSize == b2_laneCount);
+	b2Assert(0 < count && count <= b2_treePacketSize);
+
+	// Unused lanes repeat the first AABB and are masked off.
+	float32 lowerX[b2_laneCount], lowerY[b2_laneCount];
+	float32 upperX[b2_laneCount], upperY[b2_laneCount];
+	for (int32 l = 0; l < b2_laneCount; ++l)
+	{
+		const b2AABB& aabb = aabbs[l < count ? l : 0];
+		lowerX[l] = aabb.lowerBound.x;
+		lowerY[l] = aabb.lowerBound.y;
+		upperX[l] = aabb.upperBound.x;
+		upperY[l] = aabb.upperBound.y;
+	}
+	const b2Lanes lx = b2LanesLoad(lowerX);
+	const b2Lanes ly = b2LanesLoad(lowerY);
+	const b2Lanes ux = b2LanesLoad(upperX);
+	const b2Lanes uy = b2LanesLoad(upperY);
+	const int32 lanes = (1 << count) - 1;
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root);
+
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2TreeNode* node = m_nodes + nodeId;
+
+		// b2TestOverlap() on every lane.
+		const b2Lanes overlap = b2LanesAnd(
+			b2LanesAnd(
+				b2LanesLessEqual(b2LanesSplat(node->aabb.lowerBound.x), ux),
+				b2LanesLessEqual(b2LanesSplat(node->aabb.lowerBound.y), uy)),
+			b2LanesAnd(
+				b2LanesLessEqual(lx, b2LanesSplat(node->aabb.upperBound.x)),
+				b2LanesLessEqual(ly, b2LanesSplat(node->aabb.upperBound.y))));
+		const int32 mask = b2LanesMaskBits(overlap) & lanes;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			function(context, nodeId, mask);
+		}
+		else
+		{
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
+}
+
+void b2DynamicTree::RayCastPacket(b2TreeRayCastPacketFunction function,
+								  void* context, b2RayCastInput* inputs,
+								  int32 count) const
+{
+	b2Assert(b2_treePacketSize == b2_laneCount);
+	b2Assert(0 < count && count <= b2_treePacketSize);
+
+	// The per ray values of RayCast(). Unused lanes repeat the first ray
+	// and are masked off.
+	float32 p1x[b2_laneCount], p1y[b2_laneCount];
+	float32 vx[b2_laneCount], vy[b2_laneCount];
+	float32 absVx[b2_laneCount], absVy[b2_laneCount];
+	for (int32 l = 0; l < b2_laneCount; ++l)
+	{
+		const b2RayCastInput& input = inputs[l < count ? l : 0];
+		b2Vec2 r = input.p2 - input.p1;
+		b2Assert(r.LengthSquared() > 0.0f);
+		r.Normalize();
+
+		// v is perpendicular to the segment.
+		b2Vec2 v = b2Cross(1.0f, r);
+		p1x[l] = input.p1.x;
+		p1y[l] = input.p1.y;
+		vx[l] = v.x;
+		vy[l] = v.y;
+		absVx[l] = b2Abs(v.x);
+		absVy[l] = b2Abs(v.y);
+	}
+	const b2Lanes px = b2LanesLoad(p1x);
+	const b2Lanes py = b2LanesLoad(p1y);
+	const b2Lanes nx = b2LanesLoad(vx);
+	const b2Lanes ny = b2LanesLoad(vy);
+	const b2Lanes absNx = b2LanesLoad(absVx);
+	const b2Lanes absNy = b2LanesLoad(absVy);
+	int32 lanes = (1 << count) - 1;
+
+	// Bounding boxes of the segments, rebuilt when a ray is clipped.
+	b2Lanes lx, ly, ux, uy;
+	{
+		float32 lowerX[b2_laneCount], lowerY[b2_laneCount];
+		float32 upperX[b2_laneCount], upperY[b2_laneCount];
+		for (int32 l = 0; l < b2_laneCount; ++l)
+		{
+			const b2RayCastInput& input = inputs[l < count ? l : 0];
+			b2Vec2 t = input.p1 + input.maxFraction * (input.p2 - input.p1);
+			lowerX[l] = b2Min(input.p1.x, t.x);
+			lowerY[l] = b2Min(input.p1.y, t.y);
+			upperX[l] = b2Max(input.p1.x, t.x);
+			upperY[l] = b2Max(input.p1.y, t.y);
+		}
+		lx = b2LanesLoad(lowerX);
+		ly = b2LanesLoad(lowerY);
+		ux = b2LanesLoad(upperX);
+		uy = b2LanesLoad(upperY);
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root);
+
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (nodeId == b2_nullNode)
+		{
+			continue;
+		}
+
+		const b2TreeNode* node = m_nodes + nodeId;
+
+		// The segment bounding boxes must overlap the node.
+		b2Lanes hit = b2LanesAnd(
+			b2LanesAnd(
+				b2LanesLessEqual(b2LanesSplat(node->aabb.lowerBound.x), ux),
+				b2LanesLessEqual(b2LanesSplat(node->aabb.lowerBound.y), uy)),
+			b2LanesAnd(
+				b2LanesLessEqual(lx, b2LanesSplat(node->aabb.upperBound.x)),
+				b2LanesLessEqual(ly, b2LanesSplat(node->aabb.upperBound.y))));
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = node->aabb.GetCenter();
+		b2Vec2 h = node->aabb.GetExtents();
+		const b2Lanes separation = b2LanesSub(
+			b2LanesAbs(b2LanesAdd(
+				b2LanesMul(nx, b2LanesSub(px, b2LanesSplat(c.x))),
+				b2LanesMul(ny, b2LanesSub(py, b2LanesSplat(c.y))))),
+			b2LanesAdd(b2LanesMul(absNx, b2LanesSplat(h.x)),
+					   b2LanesMul(absNy, b2LanesSplat(h.y))));
+		hit = b2LanesAnd(hit, b2LanesLessEqual(separation, b2LanesSplat(0.0f)));
+
+		const int32 mask = b2LanesMaskBits(hit) & lanes;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			lanes &= ~function(context, nodeId, mask, inputs);
+			if (lanes == 0)
+			{
+				// The client has terminated every ray.
+				return;
+			}
+
+			// Update the segment bounding boxes of clipped rays.
+			float32 lowerX[b2_laneCount], lowerY[b2_laneCount];
+			float32 upperX[b2_laneCount], upperY[b2_laneCount];
+			b2LanesStore(lowerX, lx);
+			b2LanesStore(lowerY, ly);
+			b2LanesStore(upperX, ux);
+			b2LanesStore(upperY, uy);
+			for (int32 l = 0; l < count; ++l)
+			{
+				if (mask & (1 << l))
+				{
+					const b2RayCastInput& input = inputs[l];
+					b2Vec2 t = input.p1 +
+						input.maxFraction * (input.p2 - input.p1);
+					lowerX[l] = b2Min(input.p1.x, t.x);
+					lowerY[l] = b2Min(input.p1.y, t.y);
+					upperX[l] = b2Max(input.p1.x, t.x);
+					upperY[l] = b2Max(input.p1.y, t.y);
+				}
+			}
+			lx = b2LanesLoad(lowerX);
+			ly = b2LanesLoad(lowerY);
+			ux = b2LanesLoad(upperX);
+			uy = b2LanesLoad(upperY);
+		}
+		else
+		{
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
+}
+
 void b2DynamicTree::Validate() const
 {
 	B2_DEBUG_STATEMENT(ValidateStructure(m_root));
@@ -782,3 +1123,102 @@ void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 		m_nodes[i].aabb.upperBound -= newOrigin;
 	}
 }
+
+void b2DynamicTree::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_root);
+	writer->Write(m_nodeCount);
+	writer->Write(m_nodeCapacity);
+	writer->Write(m_freeList);
+	writer->Write(m_path);
+	writer->Write(m_insertionCount);
+	writer->WriteArray(m_nodes, m_nodeCapacity);
+}
+
+int32 b2DynamicTree::Load(b2SnapshotReader* reader)
+{
+	reader->Read(&m_root);
+	reader->Read(&m_nodeCount);
+	const int32 capacity = reader->ReadCount(sizeof(b2TreeNode));
+	if (capacity == 0 || m_nodeCount < 0 || m_nodeCount > capacity)
+	{
+		reader->SetError();
+		return 0;
+	}
+	if (capacity != m_nodeCapacity)
+	{
+		FreeNodes(m_nodes, m_nodeCapacity);
+		m_nodeCapacity = capacity;
+		m_nodes = AllocateNodes(m_nodeCapacity);
+	}
+	reader->Read(&m_freeList);
+	reader->Read(&m_path);
+	reader->Read(&m_insertionCount);
+	reader->ReadArray(m_nodes, m_nodeCapacity);
+
+	// The saved user data only meant something to the process that saved
+	// it.
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		m_nodes[i].userData = NULL;
+	}
+
+	// Check the nodes form a tree of m_nodeCount nodes, each reached once
+	// from its parent, and that the rest are free.
+	int32* stack = (int32*)b2Alloc((m_nodeCapacity + 1) * sizeof(int32));
+	int32 stackCount = 0;
+	int32 nodeCount = 0;
+	int32 leafCount = 0;
+	bool valid = m_root == b2_nullNode ||
+		(0 <= m_root && m_root < m_nodeCapacity &&
+		 m_nodes[m_root].parent == b2_nullNode);
+	if (valid && m_root != b2_nullNode)
+	{
+		stack[stackCount++] = m_root;
+	}
+	while (valid && stackCount > 0)
+	{
+		const int32 nodeId = stack[--stackCount];
+		const b2TreeNode* node = m_nodes + nodeId;
+		++nodeCount;
+		if (nodeCount > m_nodeCount || node->height < 0)
+		{
+			valid = false;
+		}
+		else if (node->IsLeaf())
+		{
+			valid = node->child2 == b2_nullNode && node->height == 0;
+			++leafCount;
+		}
+		else
+		{
+			const int32 child1 = node->child1;
+			const int32 child2 = node->child2;
+			valid = node->height > 0 && child1 != child2 &&
+				0 <= child1 && child1 < m_nodeCapacity &&
+				0 <= child2 && child2 < m_nodeCapacity &&
+				m_nodes[child1].parent == nodeId &&
+				m_nodes[child2].parent == nodeId;
+			stack[stackCount++] = child1;
+			stack[stackCount++] = child2;
+		}
+	}
+	b2Free(stack);
+	int32 freeIndex = m_freeList;
+	for (int32 i = nodeCount; valid && i < m_nodeCapacity; ++i)
+	{
+		valid = 0 <= freeIndex && freeIndex < m_nodeCapacity &&
+			m_nodes[freeIndex].height == -1;
+		if (valid)
+		{
+			freeIndex = m_nodes[freeIndex].next;
+		}
+	}
+	if (valid == false || nodeCount != m_nodeCount ||
+		freeIndex != b2_nullNode)
+	{
+		reader->SetError();
+		return 0;
+	}
+	return leafCount;
+}
@@ -24,6 +24,28 @@
 
 #define b2_nullNode (-1)
 
+/// Most queries b2DynamicTree::QueryPacket() and RayCastPacket() test at
+/// once.
+#define b2_treePacketSize 4
+
+/// Function called by b2DynamicTree::QueryPacket() for a leaf overlapping
+/// some of the AABBs. laneMask has bit i set if the leaf overlaps aabbs[i].
+typedef void (*b2TreeQueryPacketFunction)(void* context, int32 proxyId,
+										  int32 laneMask);
+
+/// Function called by b2DynamicTree::RayCastPacket() for a leaf some of the
+/// rays may hit. laneMask has bit i set if inputs[i] may hit it. Lower
+/// inputs[i].maxFraction to clip ray i. Return a mask of the rays to stop
+/// casting.
+typedef int32 (*b2TreeRayCastPacketFunction)(void* context, int32 proxyId,
+											 int32 laneMask,
+											 b2RayCastInput* inputs);
+
+class b2Allocator;
+class b2SnapshotWriter;
+class b2SnapshotReader;
+struct b2TreeBuildLeaf;
+
 /// A node in the dynamic tree. The client does not interact with this directly.
 struct b2TreeNode
 {
@@ -64,12 +86,23 @@ public:
 	/// Constructing the tree initializes the node pool.
 	b2DynamicTree();
 
+	/// Take the node pool from allocator rather than b2Alloc(). The
+	/// allocator must outlive the tree.
+	explicit b2DynamicTree(b2Allocator* allocator);
+
 	/// Destroy the tree, freeing the node pool.
 	~b2DynamicTree();
 
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
 
+	/// Create count proxies at once, writing their ids to proxyIds. The
+	/// proxies are sorted along a space filling curve and built into a
+	/// balanced subtree, which is inserted as a whole, so this is much
+	/// faster than creating them one by one and gives a better tree.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData,
+					   int32 count, int32* proxyIds);
+
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
@@ -79,6 +112,9 @@ public:
 	/// @return true if the proxy was re-inserted.
 	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
 
+	/// Is the id that of a proxy in the tree?
+	bool IsProxy(int32 proxyId) const;
+
 	/// Get proxy user data.
 	/// @return the proxy user data or 0 if the id is invalid.
 	void* GetUserData(int32 proxyId) const;
@@ -86,6 +122,9 @@ public:
 	/// Get the fat AABB for a proxy.
 	const b2AABB& GetFatAABB(int32 proxyId) const;
 
+	/// Set proxy user data.
+	void SetUserData(int32 proxyId, void* userData);
+
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
 	template <typename T>
@@ -101,6 +140,19 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Query up to b2_treePacketSize AABBs in one walk of the tree, testing
+	/// each node against all of them at once with SIMD. Leaves are reported
+	/// once, with the AABBs they overlap.
+	void QueryPacket(b2TreeQueryPacketFunction function, void* context,
+					 const b2AABB* aabbs, int32 count) const;
+
+	/// Ray-cast up to b2_treePacketSize rays in one walk of the tree, with
+	/// the tests of RayCast() done for all of them at once with SIMD. This
+	/// is faster than casting them one by one when they are close together
+	/// and go the same way, so they visit mostly the same nodes.
+	void RayCastPacket(b2TreeRayCastPacketFunction function, void* context,
+					   b2RayCastInput* inputs, int32 count) const;
+
 	/// Validate this tree. For testing.
 	void Validate() const;
 
@@ -115,6 +167,9 @@ public:
 	/// Get the ratio of the sum of the node areas to the root area.
 	float32 GetAreaRatio() const;
 
+	/// Get the number of bytes held by the node pool.
+	int32 GetNodeBytes() const;
+
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
@@ -123,11 +178,35 @@ public:
 	/// @param newOrigin the new origin with respect to the old origin
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	/// Write the tree to a snapshot. Proxy user data is written as the raw
+	/// pointers.
+	void Save(b2SnapshotWriter* writer) const;
+
+	/// Replace the tree with one written by Save(). The user data of the
+	/// proxies must be set again with SetUserData(). Invalid data flags an
+	/// error on the reader.
+	/// @return the number of proxies.
+	int32 Load(b2SnapshotReader* reader);
+
 private:
 
+	// Set up an empty node pool.
+	void Initialize();
+
 	int32 AllocateNode();
 	void FreeNode(int32 node);
 
+	// Allocate and free node pools, from m_allocator if there is one.
+	b2TreeNode* AllocateNodes(int32 capacity);
+	void FreeNodes(b2TreeNode* nodes, int32 capacity);
+
+	// Grow the node pool to hold at least capacity nodes.
+	void ReserveNodes(int32 capacity);
+
+	// Build a subtree over leaves sorted along a space filling curve and
+	// return its root.
+	int32 BuildSubtree(const b2TreeBuildLeaf* leaves, int32 count);
+
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
@@ -151,8 +230,23 @@ private:
 	uint32 m_path;
 
 	int32 m_insertionCount;
+
+	// Where the node pool comes from, NULL for b2Alloc().
+	b2Allocator* m_allocator;
 };
 
+inline int32 b2DynamicTree::GetNodeBytes() const
+{
+	return m_nodeCapacity * (int32)sizeof(b2TreeNode);
+}
+
+inline bool b2DynamicTree::IsProxy(int32 proxyId) const
+{
+	// Only leaves have a height of 0, and free nodes have -1.
+	return 0 <= proxyId && proxyId < m_nodeCapacity &&
+		m_nodes[proxyId].height == 0;
+}
+
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -165,6 +259,12 @@ inline const b2AABB& b2DynamicTree::GetFatAABB(int32 proxyId) const
 	return m_nodes[proxyId].aabb;
 }
 
+inline void b2DynamicTree::SetUserData(int32 proxyId, void* userData)
+{
+	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
+	m_nodes[proxyId].userData = userData;
+}
+
 template <typename T>
 inline void b2DynamicTree::Query(T* callback, const b2AABB& aabb) const
 {
@@ -0,0 +1,182 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2Allocator.h>
+#include <Box2D/Common/b2Math.h>
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define B2_ALLOCATOR_MMAP 1
+#endif
+
+void* b2Allocator::Reallocate(void* p, int32 oldSize, int32 newSize)
+{
+	void* newP = Allocate(newSize);
+	if (newP)
+	{
+		memcpy(newP, p, b2Min(oldSize, newSize));
+		Free(p, oldSize);
+	}
+	return newP;
+}
+
+void* b2DefaultAllocator::Allocate(int32 size)
+{
+	return b2Alloc(size);
+}
+
+void b2DefaultAllocator::Free(void* p, int32 size)
+{
+	B2_NOT_USED(size);
+	b2Free(p);
+}
+
+void* b2DefaultAllocator::Reallocate(void* p, int32 oldSize, int32 newSize)
+{
+	return b2Realloc(p, oldSize, newSize);
+}
+
+b2HugePageAllocator::b2HugePageAllocator()
+{
+	m_hugePageAllocation = 0;
+}
+
+#if B2_ALLOCATOR_MMAP
+// Round size up to a whole number of huge pages.
+static size_t b2HugePageRound(int32 size)
+{
+	return ((size_t)size + b2_hugePageSize - 1) & ~((size_t)b2_hugePageSize - 1);
+}
+#endif // B2_ALLOCATOR_MMAP
+
+void* b2HugePageAllocator::Allocate(int32 size)
+{
+#if B2_ALLOCATOR_MMAP
+	if (size >= b2_hugePageSize)
+	{
+		size_t length = b2HugePageRound(size);
+		void* p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+					   MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			return NULL;
+		}
+#if defined(MADV_HUGEPAGE)
+		// Only a hint; the mapping is still usable if it is refused.
+		madvise(p, length, MADV_HUGEPAGE);
+#endif // defined(MADV_HUGEPAGE)
+		m_hugePageAllocation += (int32)length;
+		return p;
+	}
+#endif // B2_ALLOCATOR_MMAP
+	return b2Alloc(size);
+}
+
+void b2HugePageAllocator::Free(void* p, int32 size)
+{
+#if B2_ALLOCATOR_MMAP
+	if (size >= b2_hugePageSize)
+	{
+		size_t length = b2HugePageRound(size);
+		munmap(p, length);
+		m_hugePageAllocation -= (int32)length;
+		return;
+	}
+#endif // B2_ALLOCATOR_MMAP
+	B2_NOT_USED(size);
+	b2Free(p);
+}
+
+void* b2HugePageAllocator::Reallocate(void* p, int32 oldSize, int32 newSize)
+{
+#if B2_ALLOCATOR_MMAP
+	if (oldSize >= b2_hugePageSize && newSize >= b2_hugePageSize)
+	{
+		size_t oldLength = b2HugePageRound(oldSize);
+		size_t newLength = b2HugePageRound(newSize);
+		if (oldLength == newLength)
+		{
+			return p;
+		}
+#if defined(MREMAP_MAYMOVE)
+		// Let the kernel move the pages rather than copying them.
+		void* newP = mremap(p, oldLength, newLength, MREMAP_MAYMOVE);
+		if (newP == MAP_FAILED)
+		{
+			return NULL;
+		}
+#if defined(MADV_HUGEPAGE)
+		madvise(newP, newLength, MADV_HUGEPAGE);
+#endif // defined(MADV_HUGEPAGE)
+		m_hugePageAllocation += (int32)newLength - (int32)oldLength;
+		return newP;
+#endif // defined(MREMAP_MAYMOVE)
+	}
+	else if (oldSize < b2_hugePageSize && newSize < b2_hugePageSize)
+	{
+		return b2Realloc(p, oldSize, newSize);
+	}
+	return b2Allocator::Reallocate(p, oldSize, newSize);
+#else
+	return b2Realloc(p, oldSize, newSize);
+#endif // B2_ALLOCATOR_MMAP
+}
+
+b2AccountingAllocator::b2AccountingAllocator(b2Allocator* allocator)
+{
+	b2Assert(allocator);
+	m_allocator = allocator;
+	m_allocation = 0;
+	m_maxAllocation = 0;
+}
+
+void* b2AccountingAllocator::Allocate(int32 size)
+{
+	void* p = m_allocator->Allocate(size);
+	if (p)
+	{
+		m_allocation += size;
+		m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
+	}
+	return p;
+}
+
+void b2AccountingAllocator::Free(void* p, int32 size)
+{
+	m_allocator->Free(p, size);
+	m_allocation -= size;
+	b2Assert(m_allocation >= 0);
+}
+
+void* b2AccountingAllocator::Reallocate(void* p, int32 oldSize, int32 newSize)
+{
+	void* newP = m_allocator->Reallocate(p, oldSize, newSize);
+	if (newP)
+	{
+		m_allocation += newSize - oldSize;
+		m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
+	}
+	return newP;
+}
+
+b2Allocator* b2GetDefaultAllocator()
+{
+	static b2DefaultAllocator s_allocator;
+	return &s_allocator;
+}
@@ -0,0 +1,111 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_ALLOCATOR_H
+#define B2_ALLOCATOR_H
+
+#include <Box2D/Common/b2Settings.h>
+
+const int32 b2_hugePageSize = 2 * 1024 * 1024;	// 2M
+
+/// Source of the memory behind a world's allocators. b2BlockAllocator takes
+/// its chunks and giant allocations from it, b2StackAllocator its extra
+/// segments and b2FrameArena its chunks, so particle buffers, contacts,
+/// bodies and step scratch memory all come from here. Implement this to
+/// place a world's memory in a pool, a budget or special pages.
+class b2Allocator
+{
+public:
+	virtual ~b2Allocator() {}
+
+	/// Allocate size bytes with at least malloc alignment.
+	virtual void* Allocate(int32 size) = 0;
+
+	/// Free memory returned by Allocate(). size is the size that was
+	/// requested.
+	virtual void Free(void* p, int32 size) = 0;
+
+	/// Resize memory returned by Allocate() from oldSize to newSize bytes,
+	/// keeping the first min(oldSize, newSize) bytes. Returns NULL, leaving p
+	/// untouched, if the memory can't be allocated. By default this
+	/// allocates, copies and frees; override it to grow in place.
+	virtual void* Reallocate(void* p, int32 oldSize, int32 newSize);
+};
+
+/// Allocator which uses b2Alloc() and b2Free().
+class b2DefaultAllocator : public b2Allocator
+{
+public:
+	virtual void* Allocate(int32 size);
+	virtual void Free(void* p, int32 size);
+	virtual void* Reallocate(void* p, int32 oldSize, int32 newSize);
+};
+
+/// Allocations of b2_hugePageSize or more are mapped straight from the OS in
+/// whole huge pages and, where the OS supports it, advised to be backed by
+/// huge pages (madvise MADV_HUGEPAGE). This cuts TLB misses when stepping
+/// large particle systems. Smaller allocations use b2Alloc().
+/// On platforms without mmap every allocation uses b2Alloc().
+class b2HugePageAllocator : public b2Allocator
+{
+public:
+	b2HugePageAllocator();
+
+	virtual void* Allocate(int32 size);
+	virtual void Free(void* p, int32 size);
+	virtual void* Reallocate(void* p, int32 oldSize, int32 newSize);
+
+	/// Get the number of bytes currently mapped in huge pages.
+	int32 GetHugePageAllocation() const { return m_hugePageAllocation; }
+
+private:
+	int32 m_hugePageAllocation;
+};
+
+/// Passes every request on to another allocator and counts the bytes
+/// outstanding. b2World draws all of its memory through one of these so it
+/// can report and cap its footprint.
+class b2AccountingAllocator : public b2Allocator
+{
+public:
+	/// Take memory from allocator, which must outlive this.
+	explicit b2AccountingAllocator(b2Allocator* allocator);
+
+	virtual void* Allocate(int32 size);
+	virtual void Free(void* p, int32 size);
+	virtual void* Reallocate(void* p, int32 oldSize, int32 newSize);
+
+	/// Get the allocator requests are passed on to.
+	b2Allocator* GetAllocator() const { return m_allocator; }
+
+	/// Get the number of bytes currently allocated.
+	int32 GetAllocation() const { return m_allocation; }
+
+	/// Get the most bytes ever allocated at once.
+	int32 GetMaxAllocation() const { return m_maxAllocation; }
+
+private:
+	b2Allocator* m_allocator;
+	int32 m_allocation;
+	int32 m_maxAllocation;
+};
+
+/// Get the allocator used when a world is not given one.
+b2Allocator* b2GetDefaultAllocator();
+
+#endif
@@ -18,10 +18,12 @@
 */
 
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Math.h>
 #include <limits.h>
 #include <memory.h>
 #include <stddef.h>
 #include <string.h>
+#include <algorithm>
 #include <new> // For placement new
 
 int32 b2BlockAllocator::s_blockSizes[b2_blockSizes] =
@@ -55,16 +57,42 @@ struct b2Block
 	b2Block* next;
 };
 
+static bool b2ChunkAddressLessThan(const b2Chunk& a, const b2Chunk& b)
+{
+	return a.blocks < b.blocks;
+}
+
 b2BlockAllocator::b2BlockAllocator()
+{
+	Init(b2GetDefaultAllocator());
+}
+
+b2BlockAllocator::b2BlockAllocator(b2Allocator* allocator)
+{
+	Init(allocator);
+}
+
+void b2BlockAllocator::Init(b2Allocator* allocator)
 {
 	b2Assert((uint32)b2_blockSizes < UCHAR_MAX);
+	b2Assert(allocator);
+
+	m_allocator = allocator;
+	m_giants.SetAllocator(allocator);
+	m_giantBytes = 0;
 
 	m_chunkSpace = b2_chunkArrayIncrement;
 	m_chunkCount = 0;
-	m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+	m_chunks = (b2Chunk*)m_allocator->Allocate(m_chunkSpace * sizeof(b2Chunk));
 
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_liveBlocks, 0, sizeof(m_liveBlocks));
+	memset(m_maxLiveBlocks, 0, sizeof(m_maxLiveBlocks));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+#if B2_BLOCK_ALLOCATOR_HISTOGRAM
+	memset(m_sizeHistogram, 0, sizeof(m_sizeHistogram));
+#endif // B2_BLOCK_ALLOCATOR_HISTOGRAM
 
 	if (s_blockSizeLookupInitialized == false)
 	{
@@ -91,10 +119,10 @@ b2BlockAllocator::~b2BlockAllocator()
 {
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
-		b2Free(m_chunks[i].blocks);
+		m_allocator->Free(m_chunks[i].blocks, b2_chunkSize);
 	}
 
-	b2Free(m_chunks);
+	m_allocator->Free(m_chunks, m_chunkSpace * sizeof(b2Chunk));
 }
 
 uint32 b2BlockAllocator::GetNumGiantAllocations() const
@@ -102,6 +130,33 @@ uint32 b2BlockAllocator::GetNumGiantAllocations() const
 	return m_giants.GetList().GetLength();
 }
 
+int32 b2BlockAllocator::GetAllocationCost(int32 size) const
+{
+	if (size <= 0)
+	{
+		return 0;
+	}
+	if (size > b2_maxBlockSize)
+	{
+		return size;
+	}
+	if (m_freeLists[s_blockSizeLookup[size]])
+	{
+		return 0;
+	}
+	int32 cost = b2_chunkSize;
+	if (m_chunkCount == m_chunkSpace)
+	{
+		cost += b2_chunkArrayIncrement * sizeof(b2Chunk);
+	}
+	return cost;
+}
+
+int32 b2BlockAllocator::GetChunkBytes() const
+{
+	return m_chunkCount * b2_chunkSize + m_chunkSpace * (int32)sizeof(b2Chunk);
+}
+
 void* b2BlockAllocator::Allocate(int32 size)
 {
 	if (size == 0)
@@ -111,12 +166,24 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 	if (size > b2_maxBlockSize)
 	{
-		return m_giants.Allocate(size);
+		void* p = m_giants.Allocate(size);
+		if (p)
+		{
+			m_giantBytes += size;
+		}
+		return p;
 	}
 
 	int32 index = s_blockSizeLookup[size];
 	b2Assert(0 <= index && index < b2_blockSizes);
 
+#if B2_BLOCK_ALLOCATOR_HISTOGRAM
+	++m_sizeHistogram[size];
+#endif // B2_BLOCK_ALLOCATOR_HISTOGRAM
+
+	++m_liveBlocks[index];
+	m_maxLiveBlocks[index] = b2Max(m_maxLiveBlocks[index], m_liveBlocks[index]);
+
 	if (m_freeLists[index])
 	{
 		b2Block* block = m_freeLists[index];
@@ -128,15 +195,16 @@ void* b2BlockAllocator::Allocate(int32 size)
 		if (m_chunkCount == m_chunkSpace)
 		{
 			b2Chunk* oldChunks = m_chunks;
+			int32 oldChunkSpace = m_chunkSpace;
 			m_chunkSpace += b2_chunkArrayIncrement;
-			m_chunks = (b2Chunk*)b2Alloc(m_chunkSpace * sizeof(b2Chunk));
+			m_chunks = (b2Chunk*)m_allocator->Allocate(m_chunkSpace * sizeof(b2Chunk));
 			memcpy(m_chunks, oldChunks, m_chunkCount * sizeof(b2Chunk));
 			memset(m_chunks + m_chunkCount, 0, b2_chunkArrayIncrement * sizeof(b2Chunk));
-			b2Free(oldChunks);
+			m_allocator->Free(oldChunks, oldChunkSpace * sizeof(b2Chunk));
 		}
 
 		b2Chunk* chunk = m_chunks + m_chunkCount;
-		chunk->blocks = (b2Block*)b2Alloc(b2_chunkSize);
+		chunk->blocks = (b2Block*)m_allocator->Allocate(b2_chunkSize);
 #if DEBUG
 		memset(chunk->blocks, 0xcd, b2_chunkSize);
 #endif
@@ -155,6 +223,7 @@ void* b2BlockAllocator::Allocate(int32 size)
 
 		m_freeLists[index] = chunk->blocks->next;
 		++m_chunkCount;
+		++m_chunkCounts[index];
 
 		return chunk->blocks;
 	}
@@ -172,6 +241,7 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	if (size > b2_maxBlockSize)
 	{
 		m_giants.Free(p);
+		m_giantBytes -= size;
 		return;
 	}
 
@@ -209,17 +279,182 @@ void b2BlockAllocator::Free(void* p, int32 size)
 	b2Block* block = (b2Block*)p;
 	block->next = m_freeLists[index];
 	m_freeLists[index] = block;
+	--m_liveBlocks[index];
+}
+
+void* b2BlockAllocator::Reallocate(void* p, int32 oldSize, int32 newSize)
+{
+	if (p == NULL || oldSize == 0)
+	{
+		return Allocate(newSize);
+	}
+
+	if (newSize == 0)
+	{
+		Free(p, oldSize);
+		return NULL;
+	}
+
+	if (oldSize > b2_maxBlockSize && newSize > b2_maxBlockSize)
+	{
+		void* newP = m_giants.Reallocate(p, newSize);
+		if (newP)
+		{
+			m_giantBytes += newSize - oldSize;
+		}
+		return newP;
+	}
+
+	if (oldSize <= b2_maxBlockSize && 0 < newSize && newSize <= b2_maxBlockSize &&
+		s_blockSizeLookup[oldSize] == s_blockSizeLookup[newSize])
+	{
+		return p;
+	}
+
+	void* newP = Allocate(newSize);
+	if (newP)
+	{
+		memcpy(newP, p, b2Min(oldSize, newSize));
+		Free(p, oldSize);
+	}
+	return newP;
 }
 
 void b2BlockAllocator::Clear()
 {
 	for (int32 i = 0; i < m_chunkCount; ++i)
 	{
-		b2Free(m_chunks[i].blocks);
+		m_allocator->Free(m_chunks[i].blocks, b2_chunkSize);
 	}
 
 	m_chunkCount = 0;
 	memset(m_chunks, 0, m_chunkSpace * sizeof(b2Chunk));
 
 	memset(m_freeLists, 0, sizeof(m_freeLists));
+	memset(m_liveBlocks, 0, sizeof(m_liveBlocks));
+	memset(m_chunkCounts, 0, sizeof(m_chunkCounts));
+}
+
+int32 b2BlockAllocator::Trim()
+{
+	if (m_chunkCount == 0)
+	{
+		return 0;
+	}
+
+	// Count the free blocks in each chunk, finding a block's chunk by
+	// binary search on the chunk addresses.
+	std::sort(m_chunks, m_chunks + m_chunkCount, b2ChunkAddressLessThan);
+	const int32 freeCountsSize = m_chunkCount * sizeof(int32);
+	int32* freeCounts = (int32*)m_allocator->Allocate(freeCountsSize);
+	memset(freeCounts, 0, freeCountsSize);
+	for (int32 index = 0; index < b2_blockSizes; ++index)
+	{
+		for (b2Block* block = m_freeLists[index]; block; block = block->next)
+		{
+			b2Chunk key;
+			key.blocks = block;
+			b2Chunk* chunk = std::upper_bound(m_chunks, m_chunks + m_chunkCount,
+											  key, b2ChunkAddressLessThan) - 1;
+			b2Assert(chunk >= m_chunks && chunk->blockSize == s_blockSizes[index]);
+			++freeCounts[chunk - m_chunks];
+		}
+	}
+
+	// Flag the chunks with no live blocks by clearing their block size.
+	int32 trimmed = 0;
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		b2Chunk* chunk = m_chunks + i;
+		if (freeCounts[i] == b2_chunkSize / chunk->blockSize)
+		{
+			--m_chunkCounts[s_blockSizeLookup[chunk->blockSize]];
+			chunk->blockSize = 0;
+			++trimmed;
+		}
+	}
+	m_allocator->Free(freeCounts, freeCountsSize);
+
+	if (trimmed == 0)
+	{
+		return 0;
+	}
+
+	// Drop the flagged chunks' blocks from the free lists, keeping the
+	// order of the rest.
+	for (int32 index = 0; index < b2_blockSizes; ++index)
+	{
+		b2Block** link = m_freeLists + index;
+		while (*link)
+		{
+			b2Chunk key;
+			key.blocks = *link;
+			b2Chunk* chunk = std::upper_bound(m_chunks, m_chunks + m_chunkCount,
+											  key, b2ChunkAddressLessThan) - 1;
+			if (chunk->blockSize == 0)
+			{
+				*link = (*link)->next;
+			}
+			else
+			{
+				link = &(*link)->next;
+			}
+		}
+	}
+
+	int32 count = 0;
+	for (int32 i = 0; i < m_chunkCount; ++i)
+	{
+		if (m_chunks[i].blockSize == 0)
+		{
+			m_allocator->Free(m_chunks[i].blocks, b2_chunkSize);
+		}
+		else
+		{
+			m_chunks[count++] = m_chunks[i];
+		}
+	}
+	memset(m_chunks + count, 0, (m_chunkCount - count) * sizeof(b2Chunk));
+	m_chunkCount = count;
+
+	return trimmed;
+}
+
+void b2BlockAllocator::GetSizeClassStats(int32 sizeClass, b2BlockSizeClassStats* stats) const
+{
+	b2Assert(0 <= sizeClass && sizeClass < b2_blockSizes);
+	int32 blockSize = s_blockSizes[sizeClass];
+	stats->blockSize = blockSize;
+	stats->liveBlocks = m_liveBlocks[sizeClass];
+	stats->chunkCount = m_chunkCounts[sizeClass];
+	stats->freeBlocks = m_chunkCounts[sizeClass] * (b2_chunkSize / blockSize) -
+		m_liveBlocks[sizeClass];
+	stats->maxLiveBlocks = m_maxLiveBlocks[sizeClass];
+}
+
+void b2BlockAllocator::Dump() const
+{
+	b2Log("block size, live blocks, free blocks, chunks, peak live blocks\n");
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		b2BlockSizeClassStats stats;
+		GetSizeClassStats(i, &stats);
+		b2Log("%d, %d, %d, %d, %d\n", stats.blockSize, stats.liveBlocks,
+			  stats.freeBlocks, stats.chunkCount, stats.maxLiveBlocks);
+	}
+	b2Log("giant allocations: %d\n", GetNumGiantAllocations());
+
+#if B2_BLOCK_ALLOCATOR_HISTOGRAM
+	b2Log("requested size, allocations, block size, wasted bytes\n");
+	for (int32 size = 1; size <= b2_maxBlockSize; ++size)
+	{
+		if (m_sizeHistogram[size] == 0)
+		{
+			continue;
+		}
+		int32 blockSize = s_blockSizes[s_blockSizeLookup[size]];
+		b2Log("%d, %u, %d, %u\n", size, m_sizeHistogram[size], blockSize,
+			  m_sizeHistogram[size] * (blockSize - size));
+	}
+#endif // B2_BLOCK_ALLOCATOR_HISTOGRAM
 }
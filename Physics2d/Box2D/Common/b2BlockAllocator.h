@@ -19,6 +19,7 @@
 #ifndef B2_BLOCK_ALLOCATOR_H
 #define B2_BLOCK_ALLOCATOR_H
 
+#include <Box2D/Common/b2Allocator.h>
 #include <Box2D/Common/b2Settings.h>
 #include <Box2D/Common/b2TrackedBlock.h>
 
@@ -30,6 +31,16 @@ const int32 b2_chunkArrayIncrement = 128;
 struct b2Block;
 struct b2Chunk;
 
+/// Usage of one block size class in a b2BlockAllocator.
+struct b2BlockSizeClassStats
+{
+	int32 blockSize;		///< size of each block in bytes
+	int32 liveBlocks;		///< blocks currently allocated
+	int32 freeBlocks;		///< blocks in this class's chunks that are free
+	int32 chunkCount;		///< chunks holding blocks of this size
+	int32 maxLiveBlocks;	///< most blocks ever allocated at once
+};
+
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
@@ -37,28 +48,84 @@ class b2BlockAllocator
 {
 public:
 	b2BlockAllocator();
+
+	/// Take chunks and giant allocations from allocator, which must outlive
+	/// this.
+	explicit b2BlockAllocator(b2Allocator* allocator);
+
 	~b2BlockAllocator();
 
-	/// Allocate memory. This uses b2Alloc if the size is larger than b2_maxBlockSize.
+	/// Allocate memory. This goes straight to the b2Allocator if the size is
+	/// larger than b2_maxBlockSize.
 	void* Allocate(int32 size);
 
-	/// Free memory. This uses b2Free if the size is larger than b2_maxBlockSize.
+	/// Free memory. This goes straight to the b2Allocator if the size is
+	/// larger than b2_maxBlockSize.
 	void Free(void* p, int32 size);
 
+	/// Resize memory from Allocate() from oldSize to newSize bytes, keeping
+	/// the first min(oldSize, newSize) bytes. Giant allocations are resized
+	/// with b2Allocator::Reallocate() so they can grow in place. A block
+	/// whose size class doesn't change is returned as is. A newSize of 0
+	/// frees p and returns NULL.
+	void* Reallocate(void* p, int32 oldSize, int32 newSize);
+
 	void Clear();
 
+	/// Return chunks that have no allocated blocks to the b2Allocator.
+	/// @return the number of chunks released.
+	int32 Trim();
+
 	/// Returns the number of allocations larger than the max block size.
 	uint32 GetNumGiantAllocations() const;
 
+	/// Get the allocator chunks and giant allocations come from.
+	b2Allocator* GetAllocator() const { return m_allocator; }
+
+	/// Get the number of bytes Allocate(size) would take from the
+	/// b2Allocator: none if a free block of that size is available, a chunk
+	/// if not, and size itself for allocations larger than b2_maxBlockSize.
+	int32 GetAllocationCost(int32 size) const;
+
+	/// Get the number of bytes held in chunks, whether or not their blocks
+	/// are allocated.
+	int32 GetChunkBytes() const;
+
+	/// Get the number of bytes in allocations larger than the max block
+	/// size.
+	int32 GetGiantBytes() const { return m_giantBytes; }
+
+	/// Get the usage of a size class, 0 <= sizeClass < b2_blockSizes.
+	void GetSizeClassStats(int32 sizeClass, b2BlockSizeClassStats* stats) const;
+
+	/// Log the usage of every size class with b2Log. With
+	/// B2_BLOCK_ALLOCATOR_HISTOGRAM defined this also lists how many
+	/// allocations were made of each requested size and the bytes they waste.
+	void Dump() const;
+
 private:
+	void Init(b2Allocator* allocator);
+
+	b2Allocator* m_allocator;
+
 	b2Chunk* m_chunks;
 	int32 m_chunkCount;
 	int32 m_chunkSpace;
 
 	b2Block* m_freeLists[b2_blockSizes];
 
+	int32 m_liveBlocks[b2_blockSizes];
+	int32 m_maxLiveBlocks[b2_blockSizes];
+	int32 m_chunkCounts[b2_blockSizes];
+
+#if B2_BLOCK_ALLOCATOR_HISTOGRAM
+	// Number of allocations made of each requested size.
+	uint32 m_sizeHistogram[b2_maxBlockSize + 1];
+#endif // B2_BLOCK_ALLOCATOR_HISTOGRAM
+
 	// Record giant allocations--ones bigger than the max block size
 	b2TrackedBlockAllocator m_giants;
+	int32 m_giantBytes;
 
 	static int32 s_blockSizes[b2_blockSizes];
 	static uint8 s_blockSizeLookup[b2_maxBlockSize + 1];
@@ -0,0 +1,362 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_CONCURRENT_SLAB_ALLOCATOR_H
+#define B2_CONCURRENT_SLAB_ALLOCATOR_H
+
+#include <atomic>
+#include <new>
+#include <thread>
+#include <Box2D/Common/b2Math.h>
+#include <Box2D/Common/b2Settings.h>
+#include <Box2D/Common/b2TrackedBlock.h>
+
+/// Number of items moved between a cache and the shared free stack at once.
+const int32 b2_concurrentSlabBatchSize = 32;
+
+/// Maximum number of slabs a b2ConcurrentSlabAllocator allocates.
+const uint32 b2_maxConcurrentSlabs = 1 << 10;
+
+/// Maximum number of items in one slab of a b2ConcurrentSlabAllocator.
+/// Larger slabs are capped to this.
+const uint32 b2_concurrentSlabItemBits = 20;
+const uint32 b2_maxItemsPerConcurrentSlab = 1 << b2_concurrentSlabItemBits;
+
+/// Allocator for fixed sized items from slabs, like b2SlabAllocator, which
+/// can be used from several threads at once.
+/// Each thread allocates and frees through its own Cache, a magazine of
+/// free items. Caches exchange batches of b2_concurrentSlabBatchSize items
+/// with a lock-free stack shared by all threads, so a thread only touches
+/// shared state once per batch. Only allocating a new slab takes a lock.
+/// Allocate() and Free() without a cache use a cache built into the
+/// allocator, which must only be used by one thread at a time.
+/// All objects in a slab are constructed when the slab is created and
+/// destructed when the allocator is destroyed.
+template<typename T>
+class b2ConcurrentSlabAllocator
+{
+private:
+	// An item and its bookkeeping. Nodes are referred to by their index
+	// plus one, so that 0 means none. The top bits of an index select the
+	// slab and the bottom b2_concurrentSlabItemBits the node in it.
+	struct Node
+	{
+		// Must be first so that a T* is also a Node*.
+		T item;
+		// Reference to this node.
+		uint32 ref;
+		// Next node in the same batch while this is free.
+		uint32 next;
+		// First node of the next batch while this node heads a batch on the
+		// shared stack. Atomic since a thread that lost the race to pop
+		// this batch may still be reading it.
+		std::atomic<uint32> nextBatch;
+	};
+
+public:
+	/// Free items owned by one thread. Each thread using the allocator needs
+	/// its own cache. The cached items go back to the allocator when the
+	/// cache is destroyed, so it must not outlive the allocator.
+	class Cache
+	{
+	public:
+		explicit Cache(b2ConcurrentSlabAllocator* allocator) :
+			m_allocator(allocator),
+			m_count(0)
+		{
+		}
+
+		~Cache()
+		{
+			Flush();
+		}
+
+		/// Return all cached items to the shared stack.
+		void Flush()
+		{
+			while (m_count > 0)
+			{
+				m_allocator->Spill(this, b2Min(m_count,
+											   b2_concurrentSlabBatchSize));
+			}
+		}
+
+	private:
+		friend class b2ConcurrentSlabAllocator;
+
+		b2ConcurrentSlabAllocator* m_allocator;
+		int32 m_count;
+		Node* m_nodes[2 * b2_concurrentSlabBatchSize];
+	};
+
+	/// Initialize the allocator to allocate itemsPerSlab of type T for each
+	/// slab that is allocated.
+	b2ConcurrentSlabAllocator(const uint32 itemsPerSlab) :
+		m_itemsPerSlab(itemsPerSlab),
+		m_head(0),
+		m_slabCount(0),
+		m_cache(this)
+	{
+		m_growing.clear();
+	}
+
+	/// Free all allocated slabs. Every cache must have been destroyed or
+	/// flushed and no thread may be using the allocator.
+	~b2ConcurrentSlabAllocator()
+	{
+		m_cache.Flush();
+		FreeAllSlabs();
+	}
+
+	/// Set size of the next allocated slab using the number of items per
+	/// slab.  Setting this value to zero disables further slab allocation.
+	void SetItemsPerSlab(uint32 itemsPerSlab)
+	{
+		m_itemsPerSlab.store(itemsPerSlab, std::memory_order_relaxed);
+	}
+
+	// Get the size of the next allocated slab.
+	uint32 GetItemsPerSlab() const
+	{
+		return m_itemsPerSlab.load(std::memory_order_relaxed);
+	}
+
+	/// Set the allocator slabs are taken from. Must be called before the
+	/// first slab is allocated.
+	void SetAllocator(b2Allocator* allocator)
+	{
+		m_slabs.SetAllocator(allocator);
+	}
+
+	/// Allocate an item using the built-in cache.
+	T* Allocate()
+	{
+		return Allocate(&m_cache);
+	}
+
+	/// Free an item using the built-in cache.
+	void Free(T *object)
+	{
+		Free(&m_cache, object);
+	}
+
+	/// Allocate an item using the calling thread's cache. Returns NULL if
+	/// no more slabs can be allocated.
+	T* Allocate(Cache* cache)
+	{
+		b2Assert(cache->m_allocator == this);
+		if (cache->m_count == 0 && !Refill(cache))
+		{
+			return NULL;
+		}
+		return &cache->m_nodes[--cache->m_count]->item;
+	}
+
+	/// Free an item using the calling thread's cache. The item may have been
+	/// allocated by any thread.
+	void Free(Cache* cache, T *object)
+	{
+		b2Assert(cache->m_allocator == this);
+		b2Assert(object);
+		if (cache->m_count == (int32)B2_ARRAY_SIZE(cache->m_nodes))
+		{
+			Spill(cache, b2_concurrentSlabBatchSize);
+		}
+		cache->m_nodes[cache->m_count++] = (Node*)object;
+	}
+
+	/// Get the number of slabs allocated.
+	uint32 GetSlabCount() const
+	{
+		return m_slabCount;
+	}
+
+private:
+	// Get a node from its reference.
+	Node* GetNode(uint32 ref) const
+	{
+		const uint32 index = ref - 1;
+		Node* const nodes = m_slabNodes[index >> b2_concurrentSlabItemBits].load(
+			std::memory_order_acquire);
+		return nodes + (index & (b2_maxItemsPerConcurrentSlab - 1));
+	}
+
+	// Push the batch of nodes headed by first onto the shared stack. The
+	// stack head holds a reference in its low 32 bits and a count of the
+	// changes made to it in the high 32 bits, so a pop that read a head
+	// which has since been popped and pushed again fails.
+	void PushBatch(Node* first)
+	{
+		uint64 head = m_head.load(std::memory_order_relaxed);
+		uint64 newHead;
+		do
+		{
+			first->nextBatch.store((uint32)head, std::memory_order_relaxed);
+			newHead = (((head >> 32) + 1) << 32) | first->ref;
+		} while (!m_head.compare_exchange_weak(head, newHead,
+											   std::memory_order_release,
+											   std::memory_order_relaxed));
+	}
+
+	// Pop a batch off the shared stack, returning its first node or NULL if
+	// the stack is empty.
+	Node* PopBatch()
+	{
+		uint64 head = m_head.load(std::memory_order_acquire);
+		for (;;)
+		{
+			const uint32 ref = (uint32)head;
+			if (!ref)
+			{
+				return NULL;
+			}
+			Node* const first = GetNode(ref);
+			const uint64 newHead = (((head >> 32) + 1) << 32) |
+				first->nextBatch.load(std::memory_order_relaxed);
+			if (m_head.compare_exchange_weak(head, newHead,
+											 std::memory_order_acquire,
+											 std::memory_order_acquire))
+			{
+				return first;
+			}
+		}
+	}
+
+	// Move count nodes from the top of a cache to the shared stack.
+	void Spill(Cache* cache, int32 count)
+	{
+		b2Assert(0 < count && count <= cache->m_count);
+		Node** const nodes = cache->m_nodes + cache->m_count - count;
+		for (int32 i = 0; i < count - 1; ++i)
+		{
+			nodes[i]->next = nodes[i + 1]->ref;
+		}
+		nodes[count - 1]->next = 0;
+		PushBatch(nodes[0]);
+		cache->m_count -= count;
+	}
+
+	// Fill an empty cache with a batch from the shared stack, allocating a
+	// slab if the stack is empty. Returns false if no slab can be
+	// allocated.
+	bool Refill(Cache* cache)
+	{
+		b2Assert(cache->m_count == 0);
+		Node* node;
+		while ((node = PopBatch()) == NULL)
+		{
+			if (!AllocateSlab())
+			{
+				return false;
+			}
+		}
+		for (;;)
+		{
+			cache->m_nodes[cache->m_count++] = node;
+			if (!node->next)
+			{
+				break;
+			}
+			node = GetNode(node->next);
+		}
+		return true;
+	}
+
+	// Allocate a slab, construct its nodes and push them onto the shared
+	// stack. Threads which wait here while another thread allocates a slab
+	// take from that slab rather than allocating their own.
+	bool AllocateSlab()
+	{
+		while (m_growing.test_and_set(std::memory_order_acquire))
+		{
+			// Let the thread allocating the slab run when there are more
+			// threads than cores.
+			std::this_thread::yield();
+		}
+		bool allocated = (uint32)m_head.load(std::memory_order_acquire) != 0;
+		const uint32 count = b2Min(GetItemsPerSlab(),
+								   b2_maxItemsPerConcurrentSlab);
+		if (!allocated && count && m_slabCount < b2_maxConcurrentSlabs)
+		{
+			Node* const nodes = (Node*)m_slabs.Allocate(sizeof(Node) * count);
+			if (nodes)
+			{
+				const uint32 firstRef =
+					(m_slabCount << b2_concurrentSlabItemBits) + 1;
+				for (uint32 i = 0; i < count; ++i)
+				{
+					Node* const node = new (nodes + i) Node;
+					node->ref = firstRef + i;
+				}
+				m_slabItemCounts[m_slabCount] = count;
+				m_slabNodes[m_slabCount].store(nodes,
+											   std::memory_order_release);
+				++m_slabCount;
+
+				for (uint32 i = 0; i < count; i += b2_concurrentSlabBatchSize)
+				{
+					const uint32 end = b2Min(i + b2_concurrentSlabBatchSize,
+											 count);
+					for (uint32 j = i; j < end - 1; ++j)
+					{
+						nodes[j].next = nodes[j + 1].ref;
+					}
+					nodes[end - 1].next = 0;
+					PushBatch(nodes + i);
+				}
+				allocated = true;
+			}
+		}
+		m_growing.clear(std::memory_order_release);
+		return allocated;
+	}
+
+	// Destroy all objects and free all slabs.
+	void FreeAllSlabs()
+	{
+		for (uint32 s = 0; s < m_slabCount; ++s)
+		{
+			Node* const nodes = m_slabNodes[s].load(std::memory_order_relaxed);
+			for (uint32 i = 0; i < m_slabItemCounts[s]; ++i)
+			{
+				nodes[i].~Node();
+			}
+			m_slabs.Free(nodes);
+		}
+		m_slabCount = 0;
+		m_head.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	/// Contains a list of b2TrackedBlock instances where each b2TrackedBlock's
+	/// associated user memory contains the nodes of a slab.
+	b2TrackedBlockAllocator m_slabs;
+	/// Number of items to allocate in the next allocated slab.
+	std::atomic<uint32> m_itemsPerSlab;
+	/// Head of the shared stack of free batches.
+	std::atomic<uint64> m_head;
+	/// Held while a slab is allocated.
+	std::atomic_flag m_growing;
+	/// The nodes of each slab and how many there are.
+	std::atomic<Node*> m_slabNodes[b2_maxConcurrentSlabs];
+	uint32 m_slabItemCounts[b2_maxConcurrentSlabs];
+	uint32 m_slabCount;
+	/// Cache used by Allocate() and Free() without a cache.
+	Cache m_cache;
+};
+
+#endif  // B2_CONCURRENT_SLAB_ALLOCATOR_H
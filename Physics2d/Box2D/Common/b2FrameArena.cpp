@@ -0,0 +1,132 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2FrameArena.h>
+#include <Box2D/Common/b2Math.h>
+#include <stdint.h>
+
+// Space reserved at the start of each chunk for its header, keeping the
+// chunk data aligned.
+static const int32 b2_frameArenaHeaderSize =
+	(sizeof(b2FrameArenaChunk) + b2_mallocAlignment - 1) & ~(b2_mallocAlignment - 1);
+
+// Bytes taken from the allocator for a chunk with capacity bytes of data.
+// The allocator only guarantees malloc alignment, so leave room to align the
+// header to b2_mallocAlignment.
+static inline int32 b2FrameArenaChunkBytes(int32 capacity)
+{
+	return b2_mallocAlignment + b2_frameArenaHeaderSize + capacity;
+}
+
+b2FrameArena::b2FrameArena()
+{
+	Init(b2GetDefaultAllocator());
+}
+
+b2FrameArena::b2FrameArena(b2Allocator* allocator)
+{
+	Init(allocator);
+}
+
+void b2FrameArena::Init(b2Allocator* allocator)
+{
+	b2Assert(allocator);
+	m_allocator = allocator;
+	m_chunk = NULL;
+	m_data = NULL;
+	m_index = 0;
+	m_chunkCount = 0;
+	m_allocation = 0;
+	m_maxAllocation = 0;
+}
+
+b2FrameArena::~b2FrameArena()
+{
+	while (m_chunk)
+	{
+		b2FrameArenaChunk* next = m_chunk->next;
+		m_allocator->Free(m_chunk, b2FrameArenaChunkBytes(m_chunk->capacity));
+		m_chunk = next;
+	}
+}
+
+void b2FrameArena::AddChunk(int32 capacity)
+{
+	char* memory = (char*)m_allocator->Allocate(b2FrameArenaChunkBytes(capacity));
+	b2FrameArenaChunk* chunk = (b2FrameArenaChunk*)memory;
+	chunk->next = m_chunk;
+	chunk->capacity = capacity;
+	m_chunk = chunk;
+	++m_chunkCount;
+
+	uintptr_t data = (uintptr_t)memory + b2_frameArenaHeaderSize;
+	data = (data + b2_mallocAlignment - 1) & ~((uintptr_t)b2_mallocAlignment - 1);
+	m_data = (char*)data;
+	m_index = 0;
+}
+
+void* b2FrameArena::Allocate(int32 size)
+{
+	b2Assert(size >= 0);
+	const int32 roundedSize = (size + b2_mallocAlignment - 1) & ~(b2_mallocAlignment - 1);
+	if (m_chunk == NULL || m_index + roundedSize > m_chunk->capacity)
+	{
+		int32 capacity = b2_frameArenaChunkSize;
+		if (m_chunk)
+		{
+			capacity = 2 * m_chunk->capacity;
+		}
+		AddChunk(b2Max(capacity, roundedSize));
+	}
+
+	void* p = m_data + m_index;
+	m_index += roundedSize;
+	m_allocation += roundedSize;
+	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
+	return p;
+}
+
+void b2FrameArena::Reset()
+{
+	if (m_chunkCount > 1)
+	{
+		// Pieces of the older chunks were wasted when an allocation did not
+		// fit, so size the replacement for the whole peak.
+		while (m_chunk)
+		{
+			b2FrameArenaChunk* next = m_chunk->next;
+			m_allocator->Free(m_chunk, b2FrameArenaChunkBytes(m_chunk->capacity));
+			m_chunk = next;
+		}
+		m_chunkCount = 0;
+		AddChunk(m_maxAllocation);
+	}
+
+	m_index = 0;
+	m_allocation = 0;
+}
+
+int32 b2FrameArena::GetChunkBytes() const
+{
+	int32 bytes = 0;
+	for (b2FrameArenaChunk* chunk = m_chunk; chunk; chunk = chunk->next)
+	{
+		bytes += b2FrameArenaChunkBytes(chunk->capacity);
+	}
+	return bytes;
+}
@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_FRAME_ARENA_H
+#define B2_FRAME_ARENA_H
+
+#include <Box2D/Common/b2Allocator.h>
+#include <Box2D/Common/b2Settings.h>
+
+const int32 b2_frameArenaChunkSize = 64 * 1024;	// 64k
+
+struct b2FrameArenaChunk
+{
+	b2FrameArenaChunk* next;
+	int32 capacity;
+};
+
+/// Scratch memory that lives until the end of the world step. Allocations
+/// are bumped from a chunk and aligned to b2_mallocAlignment. They are never
+/// freed one by one, so unlike b2StackAllocator they need not be nested, and
+/// they all go away with Reset(). An arena is not thread safe: each thread
+/// that needs scratch memory should have its own.
+class b2FrameArena
+{
+public:
+	b2FrameArena();
+
+	/// Take chunks from allocator, which must outlive this.
+	explicit b2FrameArena(b2Allocator* allocator);
+
+	~b2FrameArena();
+
+	/// Allocate size bytes aligned to b2_mallocAlignment.
+	void* Allocate(int32 size);
+
+	/// Release every allocation. Chunks are kept. If the allocations since
+	/// the last reset needed more than one chunk, they are replaced by a
+	/// single chunk big enough for all of them.
+	void Reset();
+
+	/// Get the number of bytes allocated since the last reset.
+	int32 GetAllocation() const;
+
+	/// Get the most bytes ever allocated between two resets.
+	int32 GetMaxAllocation() const;
+
+	/// Get the number of bytes held in chunks.
+	int32 GetChunkBytes() const;
+
+private:
+
+	void Init(b2Allocator* allocator);
+	void AddChunk(int32 capacity);
+
+	b2Allocator* m_allocator;
+
+	b2FrameArenaChunk* m_chunk;
+	char* m_data;
+	int32 m_index;
+	int32 m_chunkCount;
+
+	int32 m_allocation;
+	int32 m_maxAllocation;
+};
+
+inline int32 b2FrameArena::GetAllocation() const
+{
+	return m_allocation;
+}
+
+inline int32 b2FrameArena::GetMaxAllocation() const
+{
+	return m_maxAllocation;
+}
+
+#endif
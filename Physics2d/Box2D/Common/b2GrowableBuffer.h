@@ -19,13 +19,23 @@
 #define B2_GROWABLE_BUFFER_H
 
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Math.h>
 #include <string.h>
 #include <memory.h>
 #include <algorithm>
 
+/// Factor a b2GrowableBuffer's capacity grows by when it is full.
+const float32 b2_growableBufferGrowthFactor = 2.0f;
+
+/// Number of consecutive b2GrowableBuffer::Shrink() calls that must find a
+/// buffer at most a quarter full before it gives memory back.
+const int32 b2_growableBufferShrinkDelay = 60;
 
 /// A simple array-like container, similar to std::vector.
 /// If we ever start using stl, we should replace this with std::vector.
+/// Growing and shrinking resize the buffer with
+/// b2BlockAllocator::Reallocate() so large buffers can change size in
+/// place.
 template <typename T>
 class b2GrowableBuffer
 {
@@ -34,7 +44,9 @@ public:
 		data(NULL),
 		count(0),
 		capacity(0),
-		allocator(&allocator)
+		allocator(&allocator),
+		growthFactor(b2_growableBufferGrowthFactor),
+		underusedCount(0)
 	{
 	#if defined(LIQUIDFUN_SIMD_NEON)
 		// b2ParticleAssembly.neon.s assumes these values are at fixed offsets.
@@ -50,7 +62,9 @@ public:
 		data(NULL),
 		count(rhs.count),
 		capacity(rhs.capacity),
-		allocator(rhs.allocator)
+		allocator(rhs.allocator),
+		growthFactor(rhs.growthFactor),
+		underusedCount(0)
 	{
 		if (rhs.data != NULL)
 		{
@@ -78,28 +92,49 @@ public:
 		if (capacity >= newCapacity)
 			return;
 
-		// Reallocate and copy.
-		T* newData = (T*) allocator->Allocate(sizeof(T) * newCapacity);
-		if (data)
-		{
-			memcpy(newData, data, sizeof(T) * count);
-			allocator->Free(data, sizeof(T) * capacity);
-		}
-
-		// Update pointer and capacity.
-		capacity = newCapacity;
-		data = newData;
+		SetCapacity(newCapacity);
 	}
 
 	void Grow()
 	{
-		// Double the capacity.
-		int32 newCapacity = capacity ? 2 * capacity
-						  : b2_minParticleSystemBufferCapacity;
+		// Scale the capacity by the growth factor.
+		int32 newCapacity = capacity ?
+			b2Max(capacity + 1, (int32)(capacity * growthFactor)) :
+			b2_minParticleSystemBufferCapacity;
 		b2Assert(newCapacity > capacity);
 		Reserve(newCapacity);
 	}
 
+	/// Set the factor the capacity grows by when the buffer is full.
+	/// Must be greater than one.
+	void SetGrowthFactor(float32 factor)
+	{
+		b2Assert(factor > 1.0f);
+		growthFactor = factor;
+	}
+
+	/// Halve the capacity, but not below minCapacity or
+	/// b2_minParticleSystemBufferCapacity, once the buffer has been at most
+	/// a quarter full for b2_growableBufferShrinkDelay calls in a row. The
+	/// gap between the grow and shrink thresholds and the delay stop a
+	/// buffer whose size swings from step to step from being resized every
+	/// step. Call this once per step.
+	void Shrink(int32 minCapacity)
+	{
+		minCapacity = b2Max(minCapacity, b2_minParticleSystemBufferCapacity);
+		if (4 * count > capacity || capacity <= minCapacity)
+		{
+			underusedCount = 0;
+			return;
+		}
+		if (++underusedCount < b2_growableBufferShrinkDelay)
+		{
+			return;
+		}
+		underusedCount = 0;
+		SetCapacity(b2Max(capacity / 2, minCapacity));
+	}
+
 	void Free()
 	{
 		if (data == NULL)
@@ -109,6 +144,17 @@ public:
 		data = NULL;
 		capacity = 0;
 		count = 0;
+		underusedCount = 0;
+	}
+
+	/// Exchange the contents of two buffers with the same allocator.
+	void Swap(b2GrowableBuffer<T>& other)
+	{
+		b2Assert(allocator == other.allocator);
+		b2Swap(data, other.data);
+		b2Swap(count, other.count);
+		b2Swap(capacity, other.capacity);
+		b2Swap(underusedCount, other.underusedCount);
 	}
 
 	void Shorten(const T* newEnd)
@@ -190,10 +236,20 @@ public:
 	}
 
 private:
+	void SetCapacity(int32 newCapacity)
+	{
+		b2Assert(newCapacity >= count);
+		data = (T*) allocator->Reallocate(data, sizeof(T) * capacity,
+										  sizeof(T) * newCapacity);
+		capacity = newCapacity;
+	}
+
 	T* data;
 	int32 count;
 	int32 capacity;
 	b2BlockAllocator* allocator;
+	float32 growthFactor;
+	int32 underusedCount;
 };
 
 #endif // B2_GROWABLE_BUFFER_H
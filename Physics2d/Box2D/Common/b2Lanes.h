@@ -0,0 +1,111 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_LANES_H
+#define B2_LANES_H
+
+#include <Box2D/Common/b2Settings.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(LIQUIDFUN_SIMD_SSE)
+#include <xmmintrin.h>
+#endif
+
+/// Number of floats in a b2Lanes.
+#define b2_laneCount 4
+
+// Lane-wise float operations for code solving several independent problems
+// at once. Each one evaluates the same IEEE single precision operation as
+// scalar code, so results match the scalar versions bit for bit. NEON
+// builds use the portable version, since ARMv7 NEON has no correctly
+// rounded divide or square root. Only include this from source files.
+#if defined(LIQUIDFUN_SIMD_SSE)
+typedef __m128 b2Lanes;
+inline b2Lanes b2LanesLoad(const float32* p) { return _mm_loadu_ps(p); }
+inline void b2LanesStore(float32* p, b2Lanes a) { _mm_storeu_ps(p, a); }
+inline b2Lanes b2LanesSplat(float32 f) { return _mm_set1_ps(f); }
+inline b2Lanes b2LanesAdd(b2Lanes a, b2Lanes b) { return _mm_add_ps(a, b); }
+inline b2Lanes b2LanesSub(b2Lanes a, b2Lanes b) { return _mm_sub_ps(a, b); }
+inline b2Lanes b2LanesMul(b2Lanes a, b2Lanes b) { return _mm_mul_ps(a, b); }
+inline b2Lanes b2LanesDiv(b2Lanes a, b2Lanes b) { return _mm_div_ps(a, b); }
+inline b2Lanes b2LanesSqrt(b2Lanes a) { return _mm_sqrt_ps(a); }
+inline b2Lanes b2LanesNeg(b2Lanes a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+inline b2Lanes b2LanesAbs(b2Lanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+// Masks have all bits of a lane set where the comparison holds.
+inline b2Lanes b2LanesLess(b2Lanes a, b2Lanes b) { return _mm_cmplt_ps(a, b); }
+inline b2Lanes b2LanesLessEqual(b2Lanes a, b2Lanes b) { return _mm_cmple_ps(a, b); }
+inline b2Lanes b2LanesNotEqual(b2Lanes a, b2Lanes b) { return _mm_cmpneq_ps(a, b); }
+inline b2Lanes b2LanesAnd(b2Lanes a, b2Lanes b) { return _mm_and_ps(a, b); }
+// Get a bit per lane, set where the mask is.
+inline int32 b2LanesMaskBits(b2Lanes mask) { return _mm_movemask_ps(mask); }
+inline bool b2LanesAny(b2Lanes mask) { return _mm_movemask_ps(mask) != 0; }
+// a where mask is set, b elsewhere.
+inline b2Lanes b2LanesSelect(b2Lanes mask, b2Lanes a, b2Lanes b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#else
+struct b2Lanes
+{
+	float32 v[b2_laneCount];
+};
+#define B2_LANES_EACH(expression) \
+	b2Lanes r; \
+	for (int32 l = 0; l < b2_laneCount; ++l) \
+	{ \
+		r.v[l] = (expression); \
+	} \
+	return r
+inline b2Lanes b2LanesLoad(const float32* p) { B2_LANES_EACH(p[l]); }
+inline void b2LanesStore(float32* p, b2Lanes a) { memcpy(p, a.v, sizeof(a.v)); }
+inline b2Lanes b2LanesSplat(float32 f) { B2_LANES_EACH(f); }
+inline b2Lanes b2LanesAdd(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] + b.v[l]); }
+inline b2Lanes b2LanesSub(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] - b.v[l]); }
+inline b2Lanes b2LanesMul(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] * b.v[l]); }
+inline b2Lanes b2LanesDiv(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] / b.v[l]); }
+inline b2Lanes b2LanesSqrt(b2Lanes a) { B2_LANES_EACH(sqrtf(a.v[l])); }
+inline b2Lanes b2LanesNeg(b2Lanes a) { B2_LANES_EACH(-a.v[l]); }
+inline b2Lanes b2LanesAbs(b2Lanes a) { B2_LANES_EACH(fabsf(a.v[l])); }
+// Masks are 1 in the lanes where the comparison holds and 0 elsewhere.
+inline b2Lanes b2LanesLess(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] < b.v[l] ? 1.0f : 0.0f); }
+inline b2Lanes b2LanesLessEqual(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] <= b.v[l] ? 1.0f : 0.0f); }
+inline b2Lanes b2LanesNotEqual(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] != b.v[l] ? 1.0f : 0.0f); }
+inline b2Lanes b2LanesAnd(b2Lanes a, b2Lanes b) { B2_LANES_EACH(a.v[l] * b.v[l]); }
+// Get a bit per lane, set where the mask is.
+inline int32 b2LanesMaskBits(b2Lanes mask)
+{
+	int32 bits = 0;
+	for (int32 l = 0; l < b2_laneCount; ++l)
+	{
+		if (mask.v[l] != 0.0f)
+		{
+			bits |= 1 << l;
+		}
+	}
+	return bits;
+}
+inline bool b2LanesAny(b2Lanes mask) { return b2LanesMaskBits(mask) != 0; }
+// a where mask is set, b elsewhere.
+inline b2Lanes b2LanesSelect(b2Lanes mask, b2Lanes a, b2Lanes b)
+{
+	B2_LANES_EACH(mask.v[l] != 0.0f ? a.v[l] : b.v[l]);
+}
+#undef B2_LANES_EACH
+#endif // defined(LIQUIDFUN_SIMD_SSE)
+
+#endif
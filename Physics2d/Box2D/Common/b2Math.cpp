@@ -92,3 +92,188 @@ void b2Mat33::GetSymInverse33(b2Mat33* M) const
 	M->ez.y = M->ey.z;
 	M->ez.z = det * (a11 * a22 - a12 * a12);
 }
+
+#if B2_DETERMINISTIC
+
+// The polynomials below are the minimax approximations from fdlibm, which
+// are accurate to about 2^-58 over their reduced ranges. Evaluating them in
+// double and rounding once to float gives the float result to within an
+// ulp, using only operations that IEEE 754 defines exactly.
+
+// Reduce angle to r in [-pi/4, pi/4] such that angle = r + quadrant * pi/2.
+static float64 b2ReduceAngle(float32 angle, int32* quadrant)
+{
+	// fmod() is exact, so this is too, though it drifts from a whole number
+	// of turns for angles of millions of turns.
+	const float64 a = fmod((float64)angle, 6.28318530717958623200e+00);
+	// pi/2 split in two so that k * pi/2 is exact.
+	const float64 pio2Hi = 1.57079632673412561417e+00;
+	const float64 pio2Lo = 6.07710050650619224932e-11;
+	const float64 k = floor(a * 6.36619772367581382433e-01 + 0.5);
+	*quadrant = (int32)k & 3;
+	return (a - k * pio2Hi) - k * pio2Lo;
+}
+
+// sin(r) for r in [-pi/4, pi/4].
+static float64 b2SinKernel(float64 r)
+{
+	const float64 z = r * r;
+	const float64 p = -1.66666666666666324348e-01 + z *
+		(8.33333333332248946124e-03 + z *
+		(-1.98412698298579493134e-04 + z *
+		(2.75573137070700676789e-06 + z *
+		(-2.50507602534068634195e-08 + z *
+		1.58969099521155010221e-10))));
+	return r + r * z * p;
+}
+
+// cos(r) for r in [-pi/4, pi/4].
+static float64 b2CosKernel(float64 r)
+{
+	const float64 z = r * r;
+	const float64 p = 4.16666666666666019037e-02 + z *
+		(-1.38888888888741095749e-03 + z *
+		(2.48015872894767294178e-05 + z *
+		(-2.75573143513906633035e-07 + z *
+		(2.08757232129817482790e-09 + z *
+		-1.13596475577881948265e-11))));
+	return 1.0 - 0.5 * z + z * z * p;
+}
+
+float32 b2DeterministicSin(float32 angle)
+{
+	int32 quadrant;
+	const float64 r = b2ReduceAngle(angle, &quadrant);
+	switch (quadrant)
+	{
+	case 0:
+		return (float32)b2SinKernel(r);
+	case 1:
+		return (float32)b2CosKernel(r);
+	case 2:
+		return (float32)-b2SinKernel(r);
+	default:
+		return (float32)-b2CosKernel(r);
+	}
+}
+
+float32 b2DeterministicCos(float32 angle)
+{
+	int32 quadrant;
+	const float64 r = b2ReduceAngle(angle, &quadrant);
+	switch (quadrant)
+	{
+	case 0:
+		return (float32)b2CosKernel(r);
+	case 1:
+		return (float32)-b2SinKernel(r);
+	case 2:
+		return (float32)-b2CosKernel(r);
+	default:
+		return (float32)b2SinKernel(r);
+	}
+}
+
+// atan(t) for t in [0, 1].
+static float64 b2AtanKernel(float64 t)
+{
+	// Values of atan at the reduction points, split in two.
+	float64 hi = 0.0;
+	float64 lo = 0.0;
+	bool reduced = true;
+	if (t < 0.4375)
+	{
+		reduced = false;
+	}
+	else if (t < 0.6875)
+	{
+		// atan(t) = atan(1/2) + atan((2t - 1) / (2 + t))
+		hi = 4.63647609000806093515e-01;
+		lo = 2.26987774529616870924e-17;
+		t = (2.0 * t - 1.0) / (2.0 + t);
+	}
+	else
+	{
+		// atan(t) = pi/4 + atan((t - 1) / (t + 1))
+		hi = 7.85398163397448278999e-01;
+		lo = 3.06161699786838301793e-17;
+		t = (t - 1.0) / (t + 1.0);
+	}
+
+	const float64 z = t * t;
+	const float64 w = z * z;
+	const float64 s1 = z * (3.33333333333329318027e-01 + w *
+		(1.42857142725034663711e-01 + w *
+		(9.09088713343650656196e-02 + w *
+		(6.66107313738753120669e-02 + w *
+		(4.97687799461593236017e-02 + w *
+		1.62858201153657823623e-02)))));
+	const float64 s2 = w * (-1.99999999998764832476e-01 + w *
+		(-1.11111104054623557880e-01 + w *
+		(-7.69187620504482999495e-02 + w *
+		(-5.83357013379057348645e-02 + w *
+		-3.65315727442169155270e-02))));
+	if (!reduced)
+	{
+		return t - t * (s1 + s2);
+	}
+	return hi - ((t * (s1 + s2) - lo) - t);
+}
+
+float32 b2DeterministicAtan2(float32 y, float32 x)
+{
+	const float64 pi = 3.14159265358979311600e+00;
+	const float64 ax = fabs((float64)x);
+	const float64 ay = fabs((float64)y);
+	if (ax == 0.0 && ay == 0.0)
+	{
+		return 0.0f;
+	}
+
+	// Keep the argument of the kernel in [0, 1].
+	float64 angle;
+	if (ay <= ax)
+	{
+		angle = b2AtanKernel(ay / ax);
+	}
+	else
+	{
+		angle = 0.5 * pi - b2AtanKernel(ax / ay);
+	}
+
+	if (x < 0.0f)
+	{
+		angle = pi - angle;
+	}
+	return (float32)(y < 0.0f ? -angle : angle);
+}
+
+float32 b2DeterministicExp(float32 x)
+{
+	// Past these the result overflows or underflows a float.
+	if (x > 88.8f)
+	{
+		return HUGE_VALF;
+	}
+	if (x < -104.0f)
+	{
+		return 0.0f;
+	}
+
+	// exp(x) = 2^k * exp(r) where r = x - k * ln(2) is in
+	// [-ln(2)/2, ln(2)/2].
+	const float64 ln2Hi = 6.93147180369123816490e-01;
+	const float64 ln2Lo = 1.90821492927058770002e-10;
+	const float64 k = floor((float64)x * 1.44269504088896338700e+00 + 0.5);
+	const float64 r = ((float64)x - k * ln2Hi) - k * ln2Lo;
+
+	// The Taylor series to r^12 is within 2^-55 of exp(r) over the range.
+	float64 p = 1.0;
+	for (int32 i = 12; i > 0; --i)
+	{
+		p = 1.0 + p * r / (float64)i;
+	}
+	return (float32)ldexp(p, (int32)k);
+}
+
+#endif // B2_DETERMINISTIC
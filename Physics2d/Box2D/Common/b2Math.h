@@ -49,8 +49,29 @@ inline float32 b2InvSqrt(float32 x)
 	return x;
 }
 
+// sqrtf() is correctly rounded on every IEEE 754 platform, so it is used
+// even in deterministic builds.
 #define	b2Sqrt(x)	sqrtf(x)
+
+#if B2_DETERMINISTIC
+/// Versions of libm functions which give the same result on every platform.
+/// They only use basic IEEE 754 double arithmetic, and are accurate to
+/// about an ulp of the float result.
+float32 b2DeterministicSin(float32 angle);
+float32 b2DeterministicCos(float32 angle);
+float32 b2DeterministicAtan2(float32 y, float32 x);
+float32 b2DeterministicExp(float32 x);
+
+#define	b2Sin(x)	b2DeterministicSin(x)
+#define	b2Cos(x)	b2DeterministicCos(x)
+#define	b2Atan2(y, x)	b2DeterministicAtan2(y, x)
+#define	b2Exp(x)	b2DeterministicExp(x)
+#else
+#define	b2Sin(x)	sinf(x)
+#define	b2Cos(x)	cosf(x)
 #define	b2Atan2(y, x)	atan2f(y, x)
+#define	b2Exp(x)	expf(x)
+#endif // B2_DETERMINISTIC
 
 /// A 2D column vector.
 struct b2Vec2
@@ -365,16 +386,16 @@ struct b2Rot
 	explicit b2Rot(float32 angle)
 	{
 		/// TODO_ERIN optimize
-		s = sinf(angle);
-		c = cosf(angle);
+		s = b2Sin(angle);
+		c = b2Cos(angle);
 	}
 
 	/// Set using an angle in radians.
 	void Set(float32 angle)
 	{
 		/// TODO_ERIN optimize
-		s = sinf(angle);
-		c = cosf(angle);
+		s = b2Sin(angle);
+		c = b2Cos(angle);
 	}
 
 	/// Set to the identity rotation
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 
 b2Version b2_version = {2, 3, 0};
 
@@ -102,6 +103,25 @@ void b2Free(void* mem)
 	b2_freeCallback(mem, b2_callbackData);
 }
 
+void* b2Realloc(void* mem, int32 oldSize, int32 newSize)
+{
+	if (mem == NULL)
+	{
+		return b2Alloc(newSize);
+	}
+	if (b2_allocCallback == b2AllocDefault)
+	{
+		return realloc(mem, newSize);
+	}
+	void* newMem = b2Alloc(newSize);
+	if (newMem)
+	{
+		memcpy(newMem, mem, oldSize < newSize ? oldSize : newSize);
+		b2Free(mem);
+	}
+	return newMem;
+}
+
 void b2SetNumAllocs(const int32 numAllocs)
 {
 	b2_numAllocs = numAllocs;
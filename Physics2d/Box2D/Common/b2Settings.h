@@ -82,6 +82,24 @@ typedef unsigned long long uint64;
 #endif
 #endif
 
+// Define B2_DETERMINISTIC to 1, when building both the library and the code
+// including it, for steps which are bitwise reproducible across platforms
+// and compilers. The library must also be compiled with -ffp-contract=off,
+// as the Physics2d target is, so multiplies and adds aren't fused;
+// b2Math.h replaces libm functions whose results vary between platforms
+// and the SIMD paths are compiled out, so every platform runs the same
+// scalar operations. Pair with b2World::SetDeterministic().
+#if B2_DETERMINISTIC
+#if defined(__FAST_MATH__)
+#error B2_DETERMINISTIC cannot be used with -ffast-math.
+#endif
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+#error B2_DETERMINISTIC needs float math evaluated in float (e.g. SSE2).
+#endif
+#undef LIQUIDFUN_SIMD_NEON
+#undef LIQUIDFUN_SIMD_SSE
+#endif // B2_DETERMINISTIC
+
 /// @file
 /// Global tuning constants based on meters-kilograms-seconds (MKS) units.
 ///
@@ -209,12 +227,22 @@ typedef unsigned long long uint64;
 
 // Memory Allocation
 
+/// Alignment (in bytes) of memory returned by b2TrackedBlock and
+/// b2FrameArena, enough for aligned SIMD loads.
+const int32 b2_mallocAlignment = 32;
+
 /// Implement this function to use your own memory allocator.
 void* b2Alloc(int32 size);
 
 /// If you implement b2Alloc, you should also implement this function.
 void b2Free(void* mem);
 
+/// Resize memory returned by b2Alloc() to newSize bytes, keeping the first
+/// min(oldSize, newSize) bytes. This uses realloc() when the default
+/// allocator is in use, so the memory can often grow in place. Otherwise it
+/// allocates, copies and frees with the callbacks.
+void* b2Realloc(void* mem, int32 oldSize, int32 newSize);
+
 /// Use this function to override b2Alloc() without recompiling this library.
 typedef void* (*b2AllocFunction)(int32 size, void* callbackData);
 /// Use this function to override b2Free() without recompiling this library.
@@ -101,6 +101,13 @@ public:
 		return m_itemsPerSlab;
 	}
 
+	/// Set the allocator slabs are taken from. Must be called before the
+	/// first slab is allocated.
+	void SetAllocator(b2Allocator* allocator)
+	{
+		m_slabs.SetAllocator(allocator);
+	}
+
 	/// Allocate a item from the slab.
 	T* Allocate()
 	{
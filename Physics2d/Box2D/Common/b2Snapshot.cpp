@@ -0,0 +1,203 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2Snapshot.h>
+#include <Box2D/Common/b2Math.h>
+#include <stdint.h>
+#include <string.h>
+
+b2Snapshot::b2Snapshot()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_capacity = 0;
+}
+
+b2Snapshot::~b2Snapshot()
+{
+	if (m_data)
+	{
+		b2Free(m_data);
+	}
+}
+
+void b2Snapshot::Reserve(int32 capacity)
+{
+	if (capacity <= m_capacity)
+	{
+		return;
+	}
+	if (m_data)
+	{
+		m_data = (uint8*)b2Realloc(m_data, m_capacity, capacity);
+	}
+	else
+	{
+		m_data = (uint8*)b2Alloc(capacity);
+	}
+	m_capacity = capacity;
+}
+
+void b2Snapshot::SetData(const void* data, int32 size)
+{
+	b2Assert(size >= 0);
+	Reserve(size);
+	if (size > 0)
+	{
+		memcpy(m_data, data, size);
+	}
+	m_size = size;
+}
+
+void b2SnapshotWriter::Write(const void* data, int32 size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	b2Snapshot* snapshot = m_snapshot;
+	const int32 end = snapshot->m_size + size;
+	if (end > snapshot->m_capacity)
+	{
+		snapshot->Reserve(b2Max(end, 2 * snapshot->m_capacity));
+	}
+	memcpy(snapshot->m_data + snapshot->m_size, data, size);
+	snapshot->m_size = end;
+}
+
+void b2SnapshotWriter::WritePointer(const void* pointer)
+{
+	Write((uint64)(uintptr_t)pointer);
+}
+
+void b2SnapshotWriter::WriteVarint(uint32 value)
+{
+	b2Snapshot* snapshot = m_snapshot;
+	const int32 maxSize = 5;
+	if (snapshot->m_size + maxSize > snapshot->m_capacity)
+	{
+		snapshot->Reserve(b2Max(snapshot->m_size + maxSize,
+								2 * snapshot->m_capacity));
+	}
+	uint8* out = snapshot->m_data + snapshot->m_size;
+	while (value >= 0x80)
+	{
+		*out++ = (uint8)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8)value;
+	snapshot->m_size = (int32)(out - snapshot->m_data);
+}
+
+void b2SnapshotWriter::WriteSignedVarint(int32 value)
+{
+	// Zigzag encoding: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+	WriteVarint(((uint32)value << 1) ^ (uint32)(value >> 31));
+}
+
+b2SnapshotReader::b2SnapshotReader(const void* data, int32 size)
+{
+	m_data = (const uint8*)data;
+	m_size = size;
+	m_position = 0;
+	m_error = false;
+}
+
+void b2SnapshotReader::Read(void* data, int32 size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	if (size > m_size - m_position)
+	{
+		memset(data, 0, size);
+		m_position = m_size;
+		m_error = true;
+		return;
+	}
+	memcpy(data, m_data + m_position, size);
+	m_position += size;
+}
+
+void b2SnapshotReader::Read(bool* value)
+{
+	uint8 byte = 0;
+	Read(&byte, (int32)sizeof(bool));
+	if (byte > 1)
+	{
+		m_error = true;
+		byte = 0;
+	}
+	*value = byte != 0;
+}
+
+void* b2SnapshotReader::ReadPointer()
+{
+	return (void*)(uintptr_t)Read<uint64>();
+}
+
+uint32 b2SnapshotReader::ReadVarint()
+{
+	uint32 value = 0;
+	for (int32 shift = 0; shift < 35; shift += 7)
+	{
+		if (m_position == m_size)
+		{
+			m_error = true;
+			return 0;
+		}
+		const uint8 byte = m_data[m_position++];
+		value |= (uint32)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	m_error = true;
+	return value;
+}
+
+int32 b2SnapshotReader::ReadSignedVarint()
+{
+	const uint32 value = ReadVarint();
+	return (int32)(value >> 1) ^ -(int32)(value & 1);
+}
+
+int32 b2SnapshotReader::ReadIndex(int32 count)
+{
+	const int32 index = Read<int32>();
+	if (index < 0 || index >= count)
+	{
+		m_error = true;
+		return -1;
+	}
+	return index;
+}
+
+int32 b2SnapshotReader::ReadCount(int32 minSize)
+{
+	b2Assert(minSize > 0);
+	const int32 count = Read<int32>();
+	if (count < 0 || count > GetRemaining() / minSize)
+	{
+		m_error = true;
+		return 0;
+	}
+	return count;
+}
@@ -0,0 +1,179 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_SNAPSHOT_H
+#define B2_SNAPSHOT_H
+
+#include <Box2D/Common/b2Settings.h>
+
+/// A binary image of the state of a world. See b2World::SaveSnapshot().
+/// The bytes are kept when a snapshot is saved over, so saving one every
+/// step only allocates while the world grows.
+/// Snapshots hold values in the byte order of the machine that saved them,
+/// and user data as the raw pointers, which only mean something to the
+/// process that saved them.
+class b2Snapshot
+{
+public:
+	b2Snapshot();
+	~b2Snapshot();
+
+	/// Get the bytes of the snapshot, e.g. to write them to a file.
+	const void* GetData() const;
+
+	/// Get the number of bytes in the snapshot.
+	int32 GetSize() const;
+
+	/// Replace the snapshot with a copy of size bytes, e.g. read from a
+	/// file.
+	void SetData(const void* data, int32 size);
+
+	/// Make room for at least capacity bytes.
+	void Reserve(int32 capacity);
+
+	/// Empty the snapshot, keeping its memory.
+	void Clear();
+
+private:
+	friend class b2SnapshotWriter;
+
+	b2Snapshot(const b2Snapshot&);
+	b2Snapshot& operator=(const b2Snapshot&);
+
+	uint8* m_data;
+	int32 m_size;
+	int32 m_capacity;
+};
+
+/// Appends values to a snapshot. This is an internal class.
+class b2SnapshotWriter
+{
+public:
+	explicit b2SnapshotWriter(b2Snapshot* snapshot) : m_snapshot(snapshot) {}
+
+	void Write(const void* data, int32 size);
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		Write(&value, (int32)sizeof(T));
+	}
+
+	template <typename T>
+	void WriteArray(const T* values, int32 count)
+	{
+		Write(values, count * (int32)sizeof(T));
+	}
+
+	/// Write a pointer as 64 bits.
+	void WritePointer(const void* pointer);
+
+	/// Write an integer in one to five bytes, seven bits to a byte, so
+	/// small values take little space.
+	void WriteVarint(uint32 value);
+
+	/// Write an integer which may be negative with WriteVarint(), mapping
+	/// small negative values to small unsigned values.
+	void WriteSignedVarint(int32 value);
+
+private:
+	b2Snapshot* m_snapshot;
+};
+
+/// Reads values back in the order they were written. Reading past the end
+/// reads zeros and flags an error. This is an internal class.
+class b2SnapshotReader
+{
+public:
+	b2SnapshotReader(const void* data, int32 size);
+
+	void Read(void* data, int32 size);
+
+	template <typename T>
+	void Read(T* value)
+	{
+		Read(value, (int32)sizeof(T));
+	}
+
+	/// Read a bool. A byte other than 0 or 1 flags an error and reads as
+	/// false, since it isn't a valid bool.
+	void Read(bool* value);
+
+	template <typename T>
+	void ReadArray(T* values, int32 count)
+	{
+		Read(values, count * (int32)sizeof(T));
+	}
+
+	/// Read a value, for when it can't be read in place.
+	template <typename T>
+	T Read()
+	{
+		T value;
+		Read(&value);
+		return value;
+	}
+
+	void* ReadPointer();
+
+	/// Read an integer written by b2SnapshotWriter::WriteVarint().
+	uint32 ReadVarint();
+
+	/// Read an integer written by b2SnapshotWriter::WriteSignedVarint().
+	int32 ReadSignedVarint();
+
+	/// Read an index into count items. An index out of range flags an
+	/// error and reads as -1.
+	int32 ReadIndex(int32 count);
+
+	/// Read the number of items which follow, each taking at least minSize
+	/// bytes. A negative count, or one the rest of the data can't hold,
+	/// flags an error and reads as 0.
+	int32 ReadCount(int32 minSize);
+
+	/// Flag the data as invalid, e.g. when it is inconsistent.
+	void SetError() { m_error = true; }
+
+	/// Did a read go past the end of the data, or find it invalid?
+	bool HasError() const { return m_error; }
+
+	/// Get the number of bytes left to read.
+	int32 GetRemaining() const { return m_size - m_position; }
+
+private:
+	const uint8* m_data;
+	int32 m_size;
+	int32 m_position;
+	bool m_error;
+};
+
+inline const void* b2Snapshot::GetData() const
+{
+	return m_data;
+}
+
+inline int32 b2Snapshot::GetSize() const
+{
+	return m_size;
+}
+
+inline void b2Snapshot::Clear()
+{
+	m_size = 0;
+}
+
+#endif
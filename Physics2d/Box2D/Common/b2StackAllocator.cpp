@@ -22,7 +22,23 @@
 
 b2StackAllocator::b2StackAllocator()
 {
-	m_index = 0;
+	Init(b2GetDefaultAllocator());
+}
+
+b2StackAllocator::b2StackAllocator(b2Allocator* allocator)
+{
+	Init(allocator);
+}
+
+void b2StackAllocator::Init(b2Allocator* allocator)
+{
+	b2Assert(allocator);
+	m_allocator = allocator;
+	m_segments[0].data = m_data;
+	m_segments[0].capacity = b2_stackSize;
+	m_segments[0].index = 0;
+	m_segments[0].maxIndex = 0;
+	m_segmentCount = 1;
 	m_allocation = 0;
 	m_maxAllocation = 0;
 	m_entryCount = 0;
@@ -30,27 +46,60 @@ b2StackAllocator::b2StackAllocator()
 
 b2StackAllocator::~b2StackAllocator()
 {
-	b2Assert(m_index == 0);
+	b2Assert(m_allocation == 0);
 	b2Assert(m_entryCount == 0);
+	for (int32 i = 1; i < m_segmentCount; ++i)
+	{
+		m_allocator->Free(m_segments[i].data, m_segments[i].capacity);
+	}
 }
 
-void* b2StackAllocator::Allocate(int32 size)
+int32 b2StackAllocator::GetSegment(int32 s, int32 size)
 {
-	b2Assert(m_entryCount < b2_maxStackEntries);
-	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
-	b2StackEntry* entry = m_entries + m_entryCount;
-	entry->size = roundedSize;
-	if (m_index + roundedSize > b2_stackSize)
+	b2Assert(s < b2_maxStackSegments);
+	b2StackSegment* segment = m_segments + s;
+	int32 capacity = b2Max(size, 2 * m_segments[s - 1].capacity);
+	if (s < m_segmentCount)
 	{
-		entry->data = (char*)b2Alloc(roundedSize);
-		entry->usedMalloc = true;
+		// Segments past the one holding the top entry are empty, so one
+		// that is too small can simply be replaced.
+		b2Assert(segment->index == 0);
+		if (segment->capacity >= size)
+		{
+			return s;
+		}
+		m_allocator->Free(segment->data, segment->capacity);
+		capacity = b2Max(capacity, 2 * segment->capacity);
 	}
 	else
 	{
-		entry->data = m_data + m_index;
-		entry->usedMalloc = false;
-		m_index += roundedSize;
+		b2Assert(s == m_segmentCount);
+		segment->maxIndex = 0;
+		++m_segmentCount;
 	}
+	segment->data = (char*)m_allocator->Allocate(capacity);
+	segment->capacity = capacity;
+	segment->index = 0;
+	return s;
+}
+
+void* b2StackAllocator::Allocate(int32 size)
+{
+	b2Assert(m_entryCount < b2_maxStackEntries);
+	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
+	int32 s = m_entryCount > 0 ? m_entries[m_entryCount - 1].segment : 0;
+	if (m_segments[s].index + roundedSize > m_segments[s].capacity)
+	{
+		s = GetSegment(s + 1, roundedSize);
+	}
+
+	b2StackSegment* segment = m_segments + s;
+	b2StackEntry* entry = m_entries + m_entryCount;
+	entry->data = segment->data + segment->index;
+	entry->size = roundedSize;
+	entry->segment = s;
+	segment->index += roundedSize;
+	segment->maxIndex = b2Max(segment->maxIndex, segment->index);
 
 	m_allocation += roundedSize;
 	m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
@@ -65,31 +114,28 @@ void* b2StackAllocator::Reallocate(void* p, int32 size)
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
 	B2_NOT_USED(p);
-	int32 incrementSize = size - entry->size;
+	const int32 roundedSize = (size + ALIGN_MASK) & ~ALIGN_MASK;
+	int32 incrementSize = roundedSize - entry->size;
 	if (incrementSize > 0)
 	{
-		if (entry->usedMalloc)
-		{
-			void* data = b2Alloc(size);
-			memcpy(data, entry->data, entry->size);
-			b2Free(entry->data);
-			entry->data = (char*)data;
-		}
-		else if (m_index + incrementSize > b2_stackSize)
+		b2StackSegment* segment = m_segments + entry->segment;
+		if (segment->index + incrementSize > segment->capacity)
 		{
-			void* data = b2Alloc(size);
-			memcpy(data, entry->data, entry->size);
-			m_index -= entry->size;
-			entry->data = (char*)data;
-			entry->usedMalloc = true;
+			// Move the entry to the start of the next segment.
+			int32 s = GetSegment(entry->segment + 1, roundedSize);
+			b2StackSegment* next = m_segments + s;
+			memcpy(next->data, entry->data, entry->size);
+			segment->index -= entry->size;
+			entry->data = next->data;
+			entry->segment = s;
+			segment = next;
+			segment->index = entry->size;
 		}
-		else
-		{
-			m_index += incrementSize;
-			m_allocation += incrementSize;
-			m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
-		}
-		entry->size = size;
+		segment->index += incrementSize;
+		segment->maxIndex = b2Max(segment->maxIndex, segment->index);
+		m_allocation += incrementSize;
+		m_maxAllocation = b2Max(m_maxAllocation, m_allocation);
+		entry->size = roundedSize;
 	}
 
 	return entry->data;
@@ -100,21 +146,49 @@ void b2StackAllocator::Free(void* p)
 	b2Assert(m_entryCount > 0);
 	b2StackEntry* entry = m_entries + m_entryCount - 1;
 	b2Assert(p == entry->data);
-	if (entry->usedMalloc)
+	B2_NOT_USED(p);
+	m_segments[entry->segment].index -= entry->size;
+	m_allocation -= entry->size;
+	--m_entryCount;
+}
+
+void b2StackAllocator::Reserve(int32 size)
+{
+	b2Assert(m_entryCount == 0);
+	if (size <= b2_stackSize ||
+		(m_segmentCount > 1 && m_segments[1].capacity >= size))
 	{
-		b2Free(p);
+		return;
 	}
-	else
+
+	// Allocations that overflow the built-in segment all land in segment 1,
+	// so size it for the whole amount and drop the rest.
+	for (int32 i = 1; i < m_segmentCount; ++i)
 	{
-		m_index -= entry->size;
+		m_allocator->Free(m_segments[i].data, m_segments[i].capacity);
 	}
-	m_allocation -= entry->size;
-	--m_entryCount;
-
-	p = NULL;
+	m_segmentCount = 1;
+	GetSegment(1, (size + ALIGN_MASK) & ~ALIGN_MASK);
 }
 
 int32 b2StackAllocator::GetMaxAllocation() const
 {
 	return m_maxAllocation;
 }
+
+int32 b2StackAllocator::GetSegmentCount() const
+{
+	return m_segmentCount;
+}
+
+int32 b2StackAllocator::GetSegmentCapacity(int32 segment) const
+{
+	b2Assert(0 <= segment && segment < m_segmentCount);
+	return m_segments[segment].capacity;
+}
+
+int32 b2StackAllocator::GetSegmentMaxAllocation(int32 segment) const
+{
+	b2Assert(0 <= segment && segment < m_segmentCount);
+	return m_segments[segment].maxIndex;
+}
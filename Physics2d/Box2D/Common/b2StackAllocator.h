@@ -19,21 +19,34 @@
 #ifndef B2_STACK_ALLOCATOR_H
 #define B2_STACK_ALLOCATOR_H
 
+#include <Box2D/Common/b2Allocator.h>
 #include <Box2D/Common/b2Settings.h>
 
 const int32 b2_stackSize = 100 * 1024;	// 100k
 const int32 b2_maxStackEntries = 32;
+const int32 b2_maxStackSegments = 16;
 
 struct b2StackEntry
 {
 	char* data;
 	int32 size;
-	bool usedMalloc;
+	int32 segment;
+};
+
+// A contiguous block of stack memory.
+struct b2StackSegment
+{
+	char* data;
+	int32 capacity;
+	int32 index;
+	int32 maxIndex;
 };
 
 // This is a stack allocator used for fast per step allocations.
 // You must nest allocate/free pairs. The code will assert
 // if you try to interleave multiple allocate/free pairs.
+// Allocations that don't fit the built-in segment go to further segments,
+// which are allocated on demand and kept until the allocator is destroyed.
 class b2StackAllocator
 {
 public:
@@ -41,18 +54,46 @@ public:
 	enum { ALIGN_MASK = MIN_ALIGNMENT - 1 };
 
 	b2StackAllocator();
+
+	/// Take segments beyond the built-in one from allocator, which must
+	/// outlive this.
+	explicit b2StackAllocator(b2Allocator* allocator);
+
 	~b2StackAllocator();
 
 	void* Allocate(int32 size);
 	void* Reallocate(void* p, int32 size);
 	void Free(void* p);
 
+	/// Make sure nested allocations totalling up to size bytes won't need
+	/// to allocate another segment. Nothing may be allocated from the stack
+	/// when this is called.
+	void Reserve(int32 size);
+
 	int32 GetMaxAllocation() const;
 
+	/// Get the number of segments, including the built-in one.
+	int32 GetSegmentCount() const;
+
+	/// Get the capacity of a segment in bytes.
+	int32 GetSegmentCapacity(int32 segment) const;
+
+	/// Get the most bytes ever used at once in a segment.
+	int32 GetSegmentMaxAllocation(int32 segment) const;
+
 private:
 
+	void Init(b2Allocator* allocator);
+
+	// Get segment s with room for size bytes, allocating it if needed.
+	int32 GetSegment(int32 s, int32 size);
+
+	b2Allocator* m_allocator;
+
 	char m_data[b2_stackSize];
-	int32 m_index;
+
+	b2StackSegment m_segments[b2_maxStackSegments];
+	int32 m_segmentCount;
 
 	int32 m_allocation;
 	int32 m_maxAllocation;
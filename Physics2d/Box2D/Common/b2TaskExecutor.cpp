@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <Box2D/Common/b2Math.h>
+
+#include <new>
+
+// Number of ranges a task is split into per thread, so that threads which
+// finish early can take work from slower ones.
+static const int32 b2_rangesPerThread = 4;
+
+b2ThreadPool::b2ThreadPool(int32 workerCount)
+{
+	b2Assert(workerCount >= 0);
+	m_workerCount = workerCount;
+	m_generation = 0;
+	m_busyWorkers = 0;
+	m_exit = false;
+	m_function = NULL;
+	m_context = NULL;
+	m_count = 0;
+	m_rangeSize = 0;
+	m_nextItem.store(0, std::memory_order_relaxed);
+
+	m_workers = (std::thread*)b2Alloc(
+		b2Max(workerCount, 1) * (int32)sizeof(std::thread));
+	for (int32 i = 0; i < workerCount; ++i)
+	{
+		new (m_workers + i) std::thread(&b2ThreadPool::WorkerMain, this);
+	}
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_taskStarted.notify_all();
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		m_workers[i].join();
+		m_workers[i].~thread();
+	}
+	b2Free(m_workers);
+}
+
+void b2ThreadPool::ParallelFor(b2TaskRangeFunction function, void* context,
+							   int32 count, int32 minRange)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	const int32 threadCount = m_workerCount + 1;
+	const int32 rangeCount = threadCount * b2_rangesPerThread;
+	const int32 rangeSize = b2Max(b2Max(minRange, 1),
+								  (count + rangeCount - 1) / rangeCount);
+	if (m_workerCount == 0 || count <= rangeSize)
+	{
+		// Not worth waking the workers.
+		function(context, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_function = function;
+		m_context = context;
+		m_count = count;
+		m_rangeSize = rangeSize;
+		m_nextItem.store(0, std::memory_order_relaxed);
+		m_busyWorkers = m_workerCount;
+		++m_generation;
+	}
+	m_taskStarted.notify_all();
+
+	RunRanges();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_busyWorkers > 0)
+	{
+		m_taskDone.wait(lock);
+	}
+}
+
+void b2ThreadPool::WorkerMain()
+{
+	uint32 generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_exit && m_generation == generation)
+			{
+				m_taskStarted.wait(lock);
+			}
+			if (m_exit)
+			{
+				return;
+			}
+			generation = m_generation;
+		}
+
+		RunRanges();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+		{
+			m_taskDone.notify_one();
+		}
+	}
+}
+
+void b2ThreadPool::RunRanges()
+{
+	for (;;)
+	{
+		const int32 begin = m_nextItem.fetch_add(m_rangeSize,
+												 std::memory_order_relaxed);
+		if (begin >= m_count)
+		{
+			break;
+		}
+		m_function(m_context, begin, b2Min(begin + m_rangeSize, m_count));
+	}
+}
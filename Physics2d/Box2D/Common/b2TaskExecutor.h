@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_TASK_EXECUTOR_H
+#define B2_TASK_EXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <Box2D/Common/b2Settings.h>
+
+/// Function run by b2TaskExecutor::ParallelFor() on the items [begin, end).
+typedef void (*b2TaskRangeFunction)(void* context, int32 begin, int32 end);
+
+/// Runs the parallel parts of a step. Implement this to run them on an
+/// application's own job system.
+class b2TaskExecutor
+{
+public:
+	virtual ~b2TaskExecutor() {}
+
+	/// Call function on ranges covering the items [0, count), each of at
+	/// least minRange items except the last, and return once all the calls
+	/// are done. The calls may run concurrently on any threads.
+	virtual void ParallelFor(b2TaskRangeFunction function, void* context,
+							 int32 count, int32 minRange) = 0;
+};
+
+/// Task executor which runs ranges on a pool of worker threads. The thread
+/// calling ParallelFor() works on ranges too, so a pool of workerCount
+/// workers runs workerCount + 1 ranges at once. ParallelFor() must not be
+/// called from several threads at once.
+class b2ThreadPool : public b2TaskExecutor
+{
+public:
+	/// Start workerCount worker threads.
+	explicit b2ThreadPool(int32 workerCount);
+
+	/// Stop the worker threads.
+	virtual ~b2ThreadPool();
+
+	virtual void ParallelFor(b2TaskRangeFunction function, void* context,
+							 int32 count, int32 minRange);
+
+	/// Get the number of worker threads.
+	int32 GetWorkerCount() const { return m_workerCount; }
+
+private:
+	// Body of each worker thread.
+	void WorkerMain();
+
+	// Take ranges of the current task until there are none left.
+	void RunRanges();
+
+	std::thread* m_workers;
+	int32 m_workerCount;
+
+	std::mutex m_mutex;
+	// Signalled when a task is started or the pool is destroyed.
+	std::condition_variable m_taskStarted;
+	// Signalled when the last worker leaves a task.
+	std::condition_variable m_taskDone;
+	// Changes for every task, so workers know when there is a new one.
+	uint32 m_generation;
+	int32 m_busyWorkers;
+	bool m_exit;
+
+	// The current task. Written under m_mutex before workers are woken.
+	b2TaskRangeFunction m_function;
+	void* m_context;
+	int32 m_count;
+	int32 m_rangeSize;
+	std::atomic<int32> m_nextItem;
+};
+
+#endif  // B2_TASK_EXECUTOR_H
@@ -37,7 +37,7 @@ int64 b2Timer::GetTicks()
 	return largeInteger.QuadPart;
 }
 
-b2Timer::b2Timer()
+float64 b2Timer::GetMillisecondsPerTick()
 {
 	LARGE_INTEGER largeInteger;
 
@@ -50,7 +50,12 @@ b2Timer::b2Timer()
 			s_invFrequency = 1000.0f / s_invFrequency;
 		}
 	}
+	return s_invFrequency;
+}
 
+b2Timer::b2Timer()
+{
+	GetMillisecondsPerTick();
 	m_start = GetTicks();
 }
 
@@ -80,11 +85,14 @@ SystemGetTimeFunc systemGetTimeFunc = ::clock_gettime;
 
 #elif defined(__APPLE__)
 
-typedef int (*SystemGetTimeFunc)(struct timeval * tp, void * tzp);
-SystemGetTimeFunc systemGetTimeFunc = ::gettimeofday;
+#include <mach/mach_time.h>
+
+typedef uint64_t (*SystemGetTimeFunc)();
+SystemGetTimeFunc systemGetTimeFunc = ::mach_absolute_time;
 
 #endif
 
+// Ticks are nanoseconds.
 int64 b2Timer::GetTicks()
 {
 	static const int NSEC_PER_SEC = 1000000000;
@@ -94,12 +102,24 @@ int64 b2Timer::GetTicks()
 	systemGetTimeFunc(CLOCK_MONOTONIC,&ts);
 	return ((int64)ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
 #else
-	timeval t;
-	systemGetTimeFunc(&t, 0);
-	return ((int64)t.tv_sec) * NSEC_PER_SEC + t.tv_usec * 1000;
+	// mach_absolute_time() is monotonic, unlike gettimeofday(), and counts
+	// in units given by the timebase.
+	static mach_timebase_info_data_t s_timebase;
+	if (s_timebase.denom == 0)
+	{
+		mach_timebase_info(&s_timebase);
+	}
+	B2_NOT_USED(NSEC_PER_SEC);
+	return (int64)(systemGetTimeFunc() * s_timebase.numer /
+				   s_timebase.denom);
 #endif
 }
 
+float64 b2Timer::GetMillisecondsPerTick()
+{
+	return 0.000001;
+}
+
 b2Timer::b2Timer()
 {
 	Reset();
@@ -118,6 +138,16 @@ float32 b2Timer::GetMilliseconds() const
 
 #else
 
+int64 b2Timer::GetTicks()
+{
+	return 0;
+}
+
+float64 b2Timer::GetMillisecondsPerTick()
+{
+	return 0.0;
+}
+
 b2Timer::b2Timer()
 {
 }
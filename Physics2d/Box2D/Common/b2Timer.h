@@ -37,10 +37,15 @@ public:
 	/// Get the time since construction or the last reset.
 	float32 GetMilliseconds() const;
 
-private:
-	/// Get platform specific tick count
+	/// Get platform specific tick count. Ticks count up at a constant rate
+	/// from an arbitrary point in time.
 	static int64 GetTicks();
 
+	/// Get the length of a tick in milliseconds.
+	static float64 GetMillisecondsPerTick();
+
+private:
+
 #if defined(_WIN32)
 	static float64 s_invFrequency;
 #endif
@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <Box2D/Common/b2Trace.h>
+
+#if B2_TRACE
+
+#include <Box2D/Common/b2Math.h>
+#include <stdio.h>
+#include <mutex>
+
+struct b2TraceEvent
+{
+	const char* name;
+	int64 start;
+	int64 end;
+};
+
+// The zones recorded by one thread. Buffers are kept until the process
+// exits so that the zones of threads which have finished can still be
+// written.
+struct b2TraceBuffer
+{
+	b2TraceEvent events[b2_traceBufferSize];
+	// Number of zones ever recorded. events[count % b2_traceBufferSize] is
+	// overwritten next.
+	uint32 count;
+	int32 threadId;
+	b2TraceBuffer* next;
+};
+
+static std::mutex s_traceMutex;
+static b2TraceBuffer* s_traceBuffers = NULL;
+static int32 s_traceThreadCount = 0;
+static thread_local b2TraceBuffer* s_traceBuffer = NULL;
+
+static b2TraceBuffer* b2GetTraceBuffer()
+{
+	if (s_traceBuffer == NULL)
+	{
+		b2TraceBuffer* buffer =
+			(b2TraceBuffer*)b2Alloc(sizeof(b2TraceBuffer));
+		buffer->count = 0;
+
+		std::lock_guard<std::mutex> lock(s_traceMutex);
+		buffer->threadId = s_traceThreadCount++;
+		buffer->next = s_traceBuffers;
+		s_traceBuffers = buffer;
+		s_traceBuffer = buffer;
+	}
+	return s_traceBuffer;
+}
+
+void b2TraceRecord(const char* name, int64 start, int64 end)
+{
+	b2Assert(((b2_traceBufferSize - 1) & b2_traceBufferSize) == 0);
+	b2TraceBuffer* buffer = b2GetTraceBuffer();
+	b2TraceEvent* event =
+		&buffer->events[buffer->count++ & (b2_traceBufferSize - 1)];
+	event->name = name;
+	event->start = start;
+	event->end = end;
+}
+
+bool b2TraceWrite(const char* fileName)
+{
+	FILE* file = fopen(fileName, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+
+	// Write times relative to the earliest zone kept.
+	bool empty = true;
+	int64 origin = 0;
+	for (b2TraceBuffer* buffer = s_traceBuffers; buffer;
+		 buffer = buffer->next)
+	{
+		const uint32 count = b2Min(buffer->count, b2_traceBufferSize);
+		for (uint32 i = 0; i < count; ++i)
+		{
+			if (empty || buffer->events[i].start < origin)
+			{
+				origin = buffer->events[i].start;
+				empty = false;
+			}
+		}
+	}
+
+	// Chrome expects microseconds.
+	const float64 microsecondsPerTick =
+		1000.0 * b2Timer::GetMillisecondsPerTick();
+	const char* separator = "";
+	fprintf(file, "{\"traceEvents\":[");
+	for (b2TraceBuffer* buffer = s_traceBuffers; buffer;
+		 buffer = buffer->next)
+	{
+		const uint32 count = b2Min(buffer->count, b2_traceBufferSize);
+		for (uint32 i = buffer->count - count; i != buffer->count; ++i)
+		{
+			const b2TraceEvent& event =
+				buffer->events[i & (b2_traceBufferSize - 1)];
+			fprintf(file,
+					"%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,"
+					"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					separator, event.name, buffer->threadId,
+					microsecondsPerTick * (float64)(event.start - origin),
+					microsecondsPerTick * (float64)(event.end - event.start));
+			separator = ",";
+		}
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	const bool written = ferror(file) == 0;
+	return fclose(file) == 0 && written;
+}
+
+void b2TraceClear()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	for (b2TraceBuffer* buffer = s_traceBuffers; buffer;
+		 buffer = buffer->next)
+	{
+		buffer->count = 0;
+	}
+}
+
+#else
+
+bool b2TraceWrite(const char* fileName)
+{
+	B2_NOT_USED(fileName);
+	return false;
+}
+
+void b2TraceClear()
+{
+}
+
+#endif // B2_TRACE
@@ -0,0 +1,81 @@
+/*
+* Copyright (c) 2011 Erin Catto http://box2d.org
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2_TRACE_H
+#define B2_TRACE_H
+
+#include <Box2D/Common/b2Timer.h>
+
+/// Number of zones each thread keeps. Once a thread has recorded this many
+/// zones, each new zone overwrites the oldest. Must be a power of two.
+const uint32 b2_traceBufferSize = 1 << 16;
+
+#if B2_TRACE
+
+#define B2_TRACE_JOIN2(a, b) a##b
+#define B2_TRACE_JOIN(a, b) B2_TRACE_JOIN2(a, b)
+
+/// Record the time spent in the enclosing scope as a zone called name,
+/// which must be a string literal. Zones are only recorded when B2_TRACE
+/// is defined to 1. Otherwise this expands to nothing and costs nothing.
+/// Recording needs compiler support for thread_local.
+#define b2TraceZone(name) \
+	b2TraceScope B2_TRACE_JOIN(b2_traceScope, __LINE__)(name)
+
+/// Record a zone that started and ended at the given b2Timer ticks in the
+/// calling thread's ring buffer.
+void b2TraceRecord(const char* name, int64 start, int64 end);
+
+/// Records the lifetime of this object as a zone. Use b2TraceZone().
+class b2TraceScope
+{
+public:
+	explicit b2TraceScope(const char* name) :
+		m_name(name),
+		m_start(b2Timer::GetTicks())
+	{
+	}
+
+	~b2TraceScope()
+	{
+		b2TraceRecord(m_name, m_start, b2Timer::GetTicks());
+	}
+
+private:
+	const char* m_name;
+	int64 m_start;
+};
+
+#else
+
+#define b2TraceZone(name)
+
+#endif // B2_TRACE
+
+/// Write the zones kept by all threads to a file in the Chrome trace event
+/// format, which chrome://tracing and other trace viewers load. This must
+/// not be called while other threads are recording zones.
+/// @return false if the file could not be written or B2_TRACE is not 1.
+bool b2TraceWrite(const char* fileName);
+
+/// Discard the zones kept by all threads. This must not be called while
+/// other threads are recording zones.
+void b2TraceClear();
+
+#endif
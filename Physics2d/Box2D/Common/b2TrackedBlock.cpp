@@ -17,12 +17,16 @@
 */
 
 #include <Box2D/Common/b2TrackedBlock.h>
+#include <Box2D/Common/b2Math.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <new>
 
-// Initialize this block with a reference to "this".
-b2TrackedBlock::b2TrackedBlock()
+// Initialize this block with a reference to "this" and the allocator and
+// size it was allocated with.
+b2TrackedBlock::b2TrackedBlock(b2Allocator* allocator, uint32 size) :
+	m_allocator(allocator), m_size(size)
 {
 	b2TrackedBlock** pointerToThis =
 		(b2TrackedBlock**)((uint8*)GetMemory() - sizeof(b2TrackedBlock**));
@@ -52,13 +56,20 @@ void* b2TrackedBlock::GetMemory() const
 /// bytes that can be used by the caller.
 void* b2TrackedBlock::Allocate(uint32 size)
 {
-	void* memory = (b2TrackedBlock*)b2Alloc(sizeof(b2TrackedBlock) +
-											size);
+	return Allocate(size, b2GetDefaultAllocator());
+}
+
+/// Allocate a b2TrackedBlock from allocator returning a pointer to
+/// memory of size bytes that can be used by the caller.
+void* b2TrackedBlock::Allocate(uint32 size, b2Allocator* allocator)
+{
+	const uint32 blockSize = sizeof(b2TrackedBlock) + size;
+	void* memory = allocator->Allocate(blockSize);
 	if (!memory)
 	{
 		return NULL;
 	}
-	return (new(memory) b2TrackedBlock)->GetMemory();
+	return (new(memory) b2TrackedBlock(allocator, blockSize))->GetMemory();
 }
 
 /// Get a b2TrackedBlock from a pointer to memory returned by
@@ -73,6 +84,35 @@ b2TrackedBlock* b2TrackedBlock::GetFromMemory(void *memory)
 	return *blockPtr;
 }
 
+/// Resize a block of memory returned by b2TrackedBlock::Allocate() to
+/// size bytes, keeping its contents. The block must not be in a list.
+void* b2TrackedBlock::Reallocate(void *memory, uint32 size)
+{
+	b2TrackedBlock* block = GetFromMemory(memory);
+	b2Assert(!block->InList());
+	b2Allocator* allocator = block->m_allocator;
+	const uint32 oldBlockSize = block->m_size;
+	const uint32 newBlockSize = sizeof(b2TrackedBlock) + size;
+	const ptrdiff_t offset = (uint8*)memory - (uint8*)block;
+
+	uint8* newBlock = (uint8*)allocator->Reallocate(block, oldBlockSize,
+													newBlockSize);
+	if (!newBlock)
+	{
+		return NULL;
+	}
+
+	// The new block may be aligned differently, in which case the contents
+	// move to the new aligned address before the header is rebuilt.
+	uint8* newMemory = (uint8*)((b2TrackedBlock*)newBlock)->GetMemory();
+	if (newMemory != newBlock + offset)
+	{
+		memmove(newMemory, newBlock + offset,
+				b2Min(oldBlockSize, newBlockSize) - sizeof(b2TrackedBlock));
+	}
+	return (new(newBlock) b2TrackedBlock(allocator, newBlockSize))->GetMemory();
+}
+
 /// Free a block of memory returned by b2TrackedBlock::Allocate()
 void b2TrackedBlock::Free(void *memory)
 {
@@ -83,18 +123,36 @@ void b2TrackedBlock::Free(void *memory)
 void b2TrackedBlock::Free(b2TrackedBlock *block)
 {
 	b2Assert(block);
+	b2Allocator* allocator = block->m_allocator;
+	uint32 size = block->m_size;
 	block->~b2TrackedBlock();
-	b2Free(block);
+	allocator->Free(block, size);
 }
 
 /// Allocate a block of size bytes using b2TrackedBlock::Allocate().
 void* b2TrackedBlockAllocator::Allocate(uint32 size)
 {
-	void *memory = b2TrackedBlock::Allocate(size);
+	void *memory = b2TrackedBlock::Allocate(size, m_allocator);
+	if (!memory)
+	{
+		return NULL;
+	}
 	m_blocks.InsertBefore(b2TrackedBlock::GetFromMemory(memory));
 	return memory;
 }
 
+/// Resize a block returned by Allocate() to size bytes, keeping its
+/// contents.
+void* b2TrackedBlockAllocator::Reallocate(void *memory, uint32 size)
+{
+	b2TrackedBlock* block = b2TrackedBlock::GetFromMemory(memory);
+	block->Remove();
+	void* newMemory = b2TrackedBlock::Reallocate(memory, size);
+	m_blocks.InsertBefore(b2TrackedBlock::GetFromMemory(
+		newMemory ? newMemory : memory));
+	return newMemory;
+}
+
 /// Free a block returned by Allocate().
 void b2TrackedBlockAllocator::Free(void *memory)
 {
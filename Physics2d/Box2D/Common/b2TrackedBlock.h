@@ -18,18 +18,17 @@
 #ifndef B2_TRACKED_BLOCK_H
 #define B2_TRACKED_BLOCK_H
 
+#include <Box2D/Common/b2Allocator.h>
 #include <Box2D/Common/b2IntrusiveList.h>
 #include <Box2D/Common/b2Settings.h>
 
-/// Alignment (in bytes) of user memory associated with b2TrackedBlock.
-const int32 b2_mallocAlignment = 32;
-
 /// Allocated block of memory that can be tracked in a b2IntrusiveList.
 class b2TrackedBlock : public b2TypedIntrusiveListNode<b2TrackedBlock>
 {
 private:
-	// Initialize this block with a reference to "this".
-	b2TrackedBlock();
+	// Initialize this block with a reference to "this" and the allocator
+	// and size it was allocated with.
+	b2TrackedBlock(b2Allocator* allocator, uint32 size);
 	// Remove the block from the list.
 	~b2TrackedBlock() { }
 
@@ -38,6 +37,9 @@ public:
 	void* GetMemory() const;
 
 private:
+	// Allocator the block came from and the size passed to it.
+	b2Allocator* m_allocator;
+	uint32 m_size;
 	// Padding required to align the pointer to user memory in the block
 	// to b2_mallocAlignment.
 	uint8 m_padding[b2_mallocAlignment + sizeof(b2TrackedBlock**)];
@@ -47,10 +49,19 @@ public:
 	/// bytes that can be used by the caller.
 	static void* Allocate(uint32 size);
 
+	/// Allocate a b2TrackedBlock from allocator returning a pointer to
+	/// memory of size bytes that can be used by the caller.
+	static void* Allocate(uint32 size, b2Allocator* allocator);
+
 	/// Get a b2TrackedBlock from a pointer to memory returned by
 	/// b2TrackedBlock::Allocate().
 	static b2TrackedBlock* GetFromMemory(void *memory);
 
+	/// Resize a block of memory returned by b2TrackedBlock::Allocate() to
+	/// size bytes, keeping its contents. The block must not be in a list.
+	/// Returns NULL, leaving the block untouched, on failure.
+	static void* Reallocate(void *memory, uint32 size);
+
 	/// Free a block of memory returned by b2TrackedBlock::Allocate()
 	static void Free(void *memory);
 
@@ -63,7 +74,7 @@ class b2TrackedBlockAllocator
 {
 public:
 	/// Initialize.
-	b2TrackedBlockAllocator() {}
+	b2TrackedBlockAllocator() : m_allocator(b2GetDefaultAllocator()) {}
 	/// Free all allocated blocks.
 	~b2TrackedBlockAllocator()
 	{
@@ -73,12 +84,24 @@ public:
 	/// Allocate a block of size bytes using b2TrackedBlock::Allocate().
 	void* Allocate(uint32 size);
 
+	/// Resize a block returned by Allocate() to size bytes, keeping its
+	/// contents.
+	void* Reallocate(void *memory, uint32 size);
+
 	/// Free a block returned by Allocate().
 	void Free(void *memory);
 
 	/// Free all allocated blocks.
 	void FreeAll();
 
+	/// Set the allocator blocks are taken from. Must be called while no
+	/// blocks are allocated.
+	void SetAllocator(b2Allocator* allocator)
+	{
+		b2Assert(m_blocks.IsEmpty());
+		m_allocator = allocator;
+	}
+
 	// Get the list of allocated blocks.
 	const b2TypedIntrusiveListNode<b2TrackedBlock>& GetList() const
 	{
@@ -87,6 +110,7 @@ public:
 
 private:
 	b2TypedIntrusiveListNode<b2TrackedBlock> m_blocks;
+	b2Allocator* m_allocator;
 };
 
 #endif  // B2_TRACKED_BLOCK_H
@@ -48,5 +48,6 @@ void b2CircleContact::Evaluate(b2Manifold* manifold, const b2Transform& xfA, con
 {
 	b2CollideCircles(manifold,
 					(b2CircleShape*)m_fixtureA->GetShape(), xfA,
-					(b2CircleShape*)m_fixtureB->GetShape(), xfB);
+					(b2CircleShape*)m_fixtureB->GetShape(), xfB,
+					m_speculativeDistance);
 }
@@ -30,6 +30,7 @@
 #include <Box2D/Collision/b2TimeOfImpact.h>
 #include <Box2D/Collision/Shapes/b2Shape.h>
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Snapshot.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2World.h>
@@ -138,6 +139,10 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 	m_prev = NULL;
 	m_next = NULL;
 
+	m_island = NULL;
+	m_islandPrev = NULL;
+	m_islandNext = NULL;
+
 	m_nodeA.contact = NULL;
 	m_nodeA.prev = NULL;
 	m_nodeA.next = NULL;
@@ -149,6 +154,9 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 	m_nodeB.other = NULL;
 
 	m_toiCount = 0;
+	m_toiOrder = 0;
+
+	m_speculativeDistance = 0.0f;
 
 	m_friction = b2MixFriction(m_fixtureA->m_friction, m_fixtureB->m_friction);
 	m_restitution = b2MixRestitution(m_fixtureA->m_restitution, m_fixtureB->m_restitution);
@@ -158,6 +166,40 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 
 // Update the contact manifold and touching status.
 // Note: do not assume the fixture AABBs are overlapping or are valid.
+void b2Contact::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_flags);
+	writer->Write(m_manifold);
+	writer->Write(m_speculativeDistance);
+	writer->Write(m_toiCount);
+	writer->Write(m_toi);
+	writer->Write(m_toiOrder);
+	writer->Write(m_friction);
+	writer->Write(m_restitution);
+	writer->Write(m_tangentSpeed);
+	SaveState(writer);
+}
+
+void b2Contact::Load(b2SnapshotReader* reader)
+{
+	reader->Read(&m_flags);
+	reader->Read(&m_manifold);
+	if (m_manifold.pointCount < 0 ||
+		m_manifold.pointCount > b2_maxManifoldPoints)
+	{
+		m_manifold.pointCount = 0;
+		reader->SetError();
+	}
+	reader->Read(&m_speculativeDistance);
+	reader->Read(&m_toiCount);
+	reader->Read(&m_toi);
+	reader->Read(&m_toiOrder);
+	reader->Read(&m_friction);
+	reader->Read(&m_restitution);
+	reader->Read(&m_tangentSpeed);
+	LoadState(reader);
+}
+
 void b2Contact::Update(b2ContactListener* listener)
 {
 	b2Manifold oldManifold = m_manifold;
@@ -166,6 +208,7 @@ void b2Contact::Update(b2ContactListener* listener)
 	m_flags |= e_enabledFlag;
 
 	bool touching = false;
+	bool speculative = false;
 	bool wasTouching = (m_flags & e_touchingFlag) == e_touchingFlag;
 
 	bool sensorA = m_fixtureA->IsSensor();
@@ -189,9 +232,32 @@ void b2Contact::Update(b2ContactListener* listener)
 	}
 	else
 	{
+		m_speculativeDistance = bodyA->m_speculativeDistance +
+			bodyB->m_speculativeDistance;
 		Evaluate(&m_manifold, xfA, xfB);
 		touching = m_manifold.pointCount > 0;
 
+		// Speculative points may still be apart. Only report the shapes as
+		// touching once a point reaches their skins.
+		speculative = false;
+		if (touching && m_speculativeDistance > 0.0f)
+		{
+			b2WorldManifold worldManifold;
+			worldManifold.Initialize(&m_manifold,
+									 xfA, m_fixtureA->GetShape()->m_radius,
+									 xfB, m_fixtureB->GetShape()->m_radius);
+			touching = false;
+			for (int32 i = 0; i < m_manifold.pointCount; ++i)
+			{
+				if (worldManifold.separations[i] <= 0.0f)
+				{
+					touching = true;
+					break;
+				}
+			}
+			speculative = touching == false;
+		}
+
 		// Match old contact ids to new contact ids and copy the
 		// stored impulses to warm start the solver.
 		for (int32 i = 0; i < m_manifold.pointCount; ++i)
@@ -230,6 +296,30 @@ void b2Contact::Update(b2ContactListener* listener)
 		m_flags &= ~e_touchingFlag;
 	}
 
+	if (speculative)
+	{
+		m_flags |= e_speculativeFlag;
+	}
+	else
+	{
+		m_flags &= ~e_speculativeFlag;
+	}
+
+	// Contacts the solver sees connect their bodies' islands.
+	bool linked = sensor == false && (touching || speculative);
+	if (linked != (m_island != NULL))
+	{
+		b2IslandGraph* islandGraph = &bodyA->m_world->m_islandGraph;
+		if (linked)
+		{
+			islandGraph->LinkContact(this);
+		}
+		else
+		{
+			islandGraph->UnlinkContact(this);
+		}
+	}
+
 	if (wasTouching == false && touching == true && listener)
 	{
 		listener->BeginContact(this);
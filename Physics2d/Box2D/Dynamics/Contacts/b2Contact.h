@@ -31,6 +31,9 @@ class b2World;
 class b2BlockAllocator;
 class b2StackAllocator;
 class b2ContactListener;
+struct b2PersistentIsland;
+class b2SnapshotWriter;
+class b2SnapshotReader;
 
 /// Friction mixing law. The idea is to allow either fixture to drive the restitution to zero.
 /// For example, anything slides on ice.
@@ -150,6 +153,7 @@ protected:
 	friend class b2ContactSolver;
 	friend class b2Body;
 	friend class b2Fixture;
+	friend class b2IslandGraph;
 
 	// Flags stored in m_flags
 	enum
@@ -170,7 +174,11 @@ protected:
 		e_bulletHitFlag		= 0x0010,
 
 		// This contact has a valid TOI in m_toi
-		e_toiFlag			= 0x0020
+		e_toiFlag			= 0x0020,
+
+		// The manifold only holds speculative points: the shapes are apart
+		// but may meet within the step.
+		e_speculativeFlag	= 0x0040
 	};
 
 	/// Flag this contact for filtering. Filtering will occur the next time step.
@@ -189,6 +197,16 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	// Write and read the state the contact keeps from step to step. Its
+	// fixtures are written by b2World. Invalid data flags an error on the
+	// reader.
+	void Save(b2SnapshotWriter* writer) const;
+	void Load(b2SnapshotReader* reader);
+
+	// Write and read the state a contact type keeps from step to step.
+	virtual void SaveState(b2SnapshotWriter* writer) const { B2_NOT_USED(writer); }
+	virtual void LoadState(b2SnapshotReader* reader) { B2_NOT_USED(reader); }
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
@@ -198,6 +216,16 @@ protected:
 	b2Contact* m_prev;
 	b2Contact* m_next;
 
+	// Index of this contact in b2ContactManager::m_contacts.
+	int32 m_managerIndex;
+
+	// The persistent island of a touching contact and its links in the
+	// island's contact list. NULL while the contact doesn't connect its
+	// bodies.
+	b2PersistentIsland* m_island;
+	b2Contact* m_islandPrev;
+	b2Contact* m_islandNext;
+
 	// Nodes for connecting bodies.
 	b2ContactEdge m_nodeA;
 	b2ContactEdge m_nodeB;
@@ -210,8 +238,14 @@ protected:
 
 	b2Manifold m_manifold;
 
+	// How far apart the shapes may be for the manifold to keep a point. This
+	// is non-zero when one of the bodies is speculative.
+	float32 m_speculativeDistance;
+
 	int32 m_toiCount;
 	float32 m_toi;
+	// Order of this contact's live entry in b2World's TOI queue.
+	uint32 m_toiOrder;
 
 	float32 m_friction;
 	float32 m_restitution;
@@ -54,6 +54,7 @@ struct b2ContactVelocityConstraint
 	float32 tangentSpeed;
 	int32 pointCount;
 	int32 contactIndex;
+	bool speculative;
 };
 
 struct b2ContactSolverDef
@@ -63,6 +64,7 @@ struct b2ContactSolverDef
 	int32 count;
 	b2Position* positions;
 	b2Velocity* velocities;
+	const b2InverseMass* inverseMasses;
 	b2StackAllocator* allocator;
 };
 
@@ -81,6 +83,12 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	/// Solve the constraints of the contacts at the given indices. These may
+	/// run concurrently on sets of contacts that share no dynamic bodies.
+	void SolveVelocityConstraints(const int32* indices, int32 count);
+	bool SolvePositionConstraints(const int32* indices, int32 count);
+
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -89,6 +97,10 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+
+private:
+	void SolveVelocityConstraint(b2ContactVelocityConstraint* vc);
+	float32 SolvePositionConstraint(b2ContactPositionConstraint* pc);
 };
 
 #endif
@@ -45,5 +45,6 @@ void b2EdgeAndPolygonContact::Evaluate(b2Manifold* manifold, const b2Transform&
 {
 	b2CollideEdgeAndPolygon(	manifold,
 								(b2EdgeShape*)m_fixtureA->GetShape(), xfA,
-								(b2PolygonShape*)m_fixtureB->GetShape(), xfB);
+								(b2PolygonShape*)m_fixtureB->GetShape(), xfB,
+								m_speculativeDistance);
 }
@@ -45,5 +45,6 @@ void b2PolygonAndCircleContact::Evaluate(b2Manifold* manifold, const b2Transform
 {
 	b2CollidePolygonAndCircle(	manifold,
 								(b2PolygonShape*)m_fixtureA->GetShape(), xfA,
-								(b2CircleShape*)m_fixtureB->GetShape(), xfB);
+								(b2CircleShape*)m_fixtureB->GetShape(), xfB,
+								m_speculativeDistance);
 }
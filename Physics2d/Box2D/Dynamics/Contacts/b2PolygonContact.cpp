@@ -18,7 +18,9 @@
 
 #include <Box2D/Dynamics/Contacts/b2PolygonContact.h>
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Snapshot.h>
 #include <Box2D/Collision/b2TimeOfImpact.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
@@ -42,11 +44,30 @@ b2PolygonContact::b2PolygonContact(b2Fixture* fixtureA, b2Fixture* fixtureB)
 {
 	b2Assert(m_fixtureA->GetType() == b2Shape::e_polygon);
 	b2Assert(m_fixtureB->GetType() == b2Shape::e_polygon);
+	m_axisCache.edge = -1;
 }
 
 void b2PolygonContact::Evaluate(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB)
 {
 	b2CollidePolygons(	manifold,
 						(b2PolygonShape*)m_fixtureA->GetShape(), xfA,
-						(b2PolygonShape*)m_fixtureB->GetShape(), xfB);
+						(b2PolygonShape*)m_fixtureB->GetShape(), xfB,
+						&m_axisCache, m_speculativeDistance);
+}
+
+void b2PolygonContact::SaveState(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_axisCache);
+}
+
+void b2PolygonContact::LoadState(b2SnapshotReader* reader)
+{
+	reader->Read(&m_axisCache);
+	const b2Fixture* fixture = m_axisCache.flip ? m_fixtureB : m_fixtureA;
+	if (m_axisCache.edge >=
+		((const b2PolygonShape*)fixture->GetShape())->m_count)
+	{
+		m_axisCache.edge = -1;
+		reader->SetError();
+	}
 }
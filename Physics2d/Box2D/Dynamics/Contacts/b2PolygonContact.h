@@ -34,6 +34,14 @@ public:
 	~b2PolygonContact() {}
 
 	void Evaluate(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB);
+
+private:
+	void SaveState(b2SnapshotWriter* writer) const;
+	void LoadState(b2SnapshotReader* reader);
+
+	// Separating axis carried across steps. Resting pairs rarely move far
+	// enough to change their reference edge.
+	b2SeparatingAxisCache m_axisCache;
 };
 
 #endif
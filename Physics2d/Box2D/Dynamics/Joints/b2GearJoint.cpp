@@ -21,6 +21,7 @@
 #include <Box2D/Dynamics/Joints/b2PrismaticJoint.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 // Gear Joint:
 // C0 = (coordinate1 + ratio * coordinate2)_initial
@@ -130,22 +131,22 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 
 void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
-	m_indexC = m_bodyC->m_islandIndex;
-	m_indexD = m_bodyD->m_islandIndex;
+	m_indexA = m_bodyA->m_worldIndex;
+	m_indexB = m_bodyB->m_worldIndex;
+	m_indexC = m_bodyC->m_worldIndex;
+	m_indexD = m_bodyD->m_worldIndex;
 	m_lcA = m_bodyA->m_sweep.localCenter;
 	m_lcB = m_bodyB->m_sweep.localCenter;
 	m_lcC = m_bodyC->m_sweep.localCenter;
 	m_lcD = m_bodyD->m_sweep.localCenter;
-	m_mA = m_bodyA->m_invMass;
-	m_mB = m_bodyB->m_invMass;
-	m_mC = m_bodyC->m_invMass;
-	m_mD = m_bodyD->m_invMass;
-	m_iA = m_bodyA->m_invI;
-	m_iB = m_bodyB->m_invI;
-	m_iC = m_bodyC->m_invI;
-	m_iD = m_bodyD->m_invI;
+	m_mA = data.inverseMasses[m_indexA].invMass;
+	m_mB = data.inverseMasses[m_indexB].invMass;
+	m_mC = data.inverseMasses[m_indexC].invMass;
+	m_mD = data.inverseMasses[m_indexD].invMass;
+	m_iA = data.inverseMasses[m_indexA].invI;
+	m_iB = data.inverseMasses[m_indexB].invI;
+	m_iC = data.inverseMasses[m_indexC].invI;
+	m_iD = data.inverseMasses[m_indexD].invI;
 
 	float32 aA = data.positions[m_indexA].a;
 	b2Vec2 vA = data.velocities[m_indexA].v;
@@ -417,3 +418,33 @@ void b2GearJoint::Dump()
 	b2Log("  jd.ratio = %.15lef;\n", m_ratio);
 	b2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void b2GearJoint::SaveState(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_localAnchorA);
+	writer->Write(m_localAnchorB);
+	writer->Write(m_localAnchorC);
+	writer->Write(m_localAnchorD);
+	writer->Write(m_localAxisC);
+	writer->Write(m_localAxisD);
+	writer->Write(m_referenceAngleA);
+	writer->Write(m_referenceAngleB);
+	writer->Write(m_constant);
+	writer->Write(m_ratio);
+	writer->Write(m_impulse);
+}
+
+void b2GearJoint::LoadState(b2SnapshotReader* reader)
+{
+	reader->Read(&m_localAnchorA);
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_localAnchorC);
+	reader->Read(&m_localAnchorD);
+	reader->Read(&m_localAxisC);
+	reader->Read(&m_localAxisD);
+	reader->Read(&m_referenceAngleA);
+	reader->Read(&m_referenceAngleB);
+	reader->Read(&m_constant);
+	reader->Read(&m_ratio);
+	reader->Read(&m_impulse);
+}
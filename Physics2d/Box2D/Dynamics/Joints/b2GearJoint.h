@@ -83,6 +83,8 @@ protected:
 	void InitVelocityConstraints(const b2SolverData& data);
 	void SolveVelocityConstraints(const b2SolverData& data);
 	bool SolvePositionConstraints(const b2SolverData& data);
+	void SaveState(b2SnapshotWriter* writer) const;
+	void LoadState(b2SnapshotReader* reader);
 
 	b2Joint* m_joint1;
 	b2Joint* m_joint2;
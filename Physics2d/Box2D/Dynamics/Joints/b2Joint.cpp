@@ -31,6 +31,7 @@
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 #include <new>
 
@@ -191,7 +192,9 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_bodyB = def->bodyB;
 	m_index = 0;
 	m_collideConnected = def->collideConnected;
-	m_islandFlag = false;
+	m_island = NULL;
+	m_islandPrev = NULL;
+	m_islandNext = NULL;
 	m_userData = def->userData;
 
 	m_edgeA.joint = NULL;
@@ -205,7 +208,276 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_edgeB.next = NULL;
 }
 
+void b2Joint::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_type);
+	writer->Write(m_bodyA->m_worldIndex);
+	writer->Write(m_bodyB->m_worldIndex);
+	writer->Write(m_collideConnected);
+	writer->WritePointer(m_userData);
+	if (m_type == e_gearJoint)
+	{
+		const b2GearJoint* gear = static_cast<const b2GearJoint*>(this);
+		writer->Write(gear->m_joint1->m_index);
+		writer->Write(gear->m_joint2->m_index);
+	}
+	SaveState(writer);
+}
+
+// Can a gear joint couple the joint?
+static bool b2IsGearable(const b2Joint* joint)
+{
+	return joint->GetType() == e_revoluteJoint ||
+		joint->GetType() == e_prismaticJoint;
+}
+
+b2Joint* b2Joint::Load(b2SnapshotReader* reader, b2Body** bodies,
+					   int32 bodyCount, b2Joint** joints, int32 jointCount,
+					   b2BlockAllocator* allocator)
+{
+	b2JointDef common;
+	// The type is read as an integer, as it isn't a b2JointType until
+	// it's checked.
+	const int32 type = reader->Read<int32>();
+	const int32 indexA = reader->ReadIndex(bodyCount);
+	const int32 indexB = reader->ReadIndex(bodyCount);
+	reader->Read(&common.collideConnected);
+	common.userData = reader->ReadPointer();
+	if (reader->HasError() || type <= e_unknownJoint ||
+		type >= b2_jointTypeCount || indexA == indexB)
+	{
+		reader->SetError();
+		return NULL;
+	}
+	common.type = (b2JointType)type;
+	common.bodyA = bodies[indexA];
+	common.bodyB = bodies[indexB];
+
+	// The joint is built from a default def of its type, and then the saved
+	// state replaces whatever the constructor worked out from it.
+	b2Joint* joint = NULL;
+	switch (common.type)
+	{
+	case e_distanceJoint:
+		{
+			b2DistanceJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_mouseJoint:
+		{
+			b2MouseJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_prismaticJoint:
+		{
+			b2PrismaticJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_revoluteJoint:
+		{
+			b2RevoluteJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_pulleyJoint:
+		{
+			b2PulleyJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_gearJoint:
+		{
+			b2GearJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			const int32 index1 = reader->ReadIndex(jointCount);
+			const int32 index2 = reader->ReadIndex(jointCount);
+			if (reader->HasError() ||
+				b2IsGearable(joints[index1]) == false ||
+				b2IsGearable(joints[index2]) == false)
+			{
+				reader->SetError();
+				return NULL;
+			}
+			def.joint1 = joints[index1];
+			def.joint2 = joints[index2];
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_wheelJoint:
+		{
+			b2WheelJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_weldJoint:
+		{
+			b2WeldJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_frictionJoint:
+		{
+			b2FrictionJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_ropeJoint:
+		{
+			b2RopeJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	case e_motorJoint:
+		{
+			b2MotorJointDef def;
+			static_cast<b2JointDef&>(def) = common;
+			joint = Create(&def, allocator);
+		}
+		break;
+
+	default:
+		reader->SetError();
+		return NULL;
+	}
+
+	joint->LoadState(reader);
+	return joint;
+}
+
 bool b2Joint::IsActive() const
 {
 	return m_bodyA->IsActive() && m_bodyB->IsActive();
 }
+
+template <typename T>
+bool b2Joint::SolveBatch(b2Joint** joints, int32 count,
+						 const b2SolverData& data, SolverPass pass)
+{
+	// The qualified calls are bound at compile time, so the loops below make
+	// direct calls rather than virtual ones. The solver functions are
+	// defined in their joints' own files, so they are not inlined; what is
+	// saved is the vtable load and the indirect branch per joint.
+	bool okay = true;
+	switch (pass)
+	{
+	case e_initVelocityPass:
+		for (int32 i = 0; i < count; ++i)
+		{
+			static_cast<T*>(joints[i])->T::InitVelocityConstraints(data);
+		}
+		break;
+
+	case e_solveVelocityPass:
+		for (int32 i = 0; i < count; ++i)
+		{
+			static_cast<T*>(joints[i])->T::SolveVelocityConstraints(data);
+		}
+		break;
+
+	case e_solvePositionPass:
+		for (int32 i = 0; i < count; ++i)
+		{
+			bool jointOkay =
+				static_cast<T*>(joints[i])->T::SolvePositionConstraints(data);
+			okay = okay && jointOkay;
+		}
+		break;
+	}
+	return okay;
+}
+
+bool b2Joint::Solve(b2Joint** joints, int32 count, const b2SolverData& data,
+					SolverPass pass)
+{
+	bool okay = true;
+	int32 begin = 0;
+	while (begin < count)
+	{
+		// Find the run of joints of the same type starting at begin.
+		const b2JointType type = joints[begin]->m_type;
+		int32 end = begin + 1;
+		while (end < count && joints[end]->m_type == type)
+		{
+			++end;
+		}
+
+		b2Joint** const batch = joints + begin;
+		const int32 batchCount = end - begin;
+		bool batchOkay = true;
+		switch (type)
+		{
+		case e_distanceJoint:
+			batchOkay = SolveBatch<b2DistanceJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_mouseJoint:
+			batchOkay = SolveBatch<b2MouseJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_prismaticJoint:
+			batchOkay = SolveBatch<b2PrismaticJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_revoluteJoint:
+			batchOkay = SolveBatch<b2RevoluteJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_pulleyJoint:
+			batchOkay = SolveBatch<b2PulleyJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_gearJoint:
+			batchOkay = SolveBatch<b2GearJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_wheelJoint:
+			batchOkay = SolveBatch<b2WheelJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_weldJoint:
+			batchOkay = SolveBatch<b2WeldJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_frictionJoint:
+			batchOkay = SolveBatch<b2FrictionJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_ropeJoint:
+			batchOkay = SolveBatch<b2RopeJoint>(batch, batchCount, data, pass);
+			break;
+
+		case e_motorJoint:
+			batchOkay = SolveBatch<b2MotorJoint>(batch, batchCount, data, pass);
+			break;
+
+		default:
+			b2Assert(false);
+			break;
+		}
+		okay = okay && batchOkay;
+		begin = end;
+	}
+	return okay;
+}
@@ -25,6 +25,9 @@ class b2Body;
 class b2Joint;
 struct b2SolverData;
 class b2BlockAllocator;
+struct b2PersistentIsland;
+class b2SnapshotWriter;
+class b2SnapshotReader;
 
 enum b2JointType
 {
@@ -42,6 +45,9 @@ enum b2JointType
 	e_motorJoint
 };
 
+/// Number of joint types.
+const int32 b2_jointTypeCount = e_motorJoint + 1;
+
 enum b2LimitState
 {
 	e_inactiveLimit,
@@ -153,11 +159,23 @@ protected:
 	friend class b2World;
 	friend class b2Body;
 	friend class b2Island;
+	friend class b2IslandGraph;
 	friend class b2GearJoint;
 
 	static b2Joint* Create(const b2JointDef* def, b2BlockAllocator* allocator);
 	static void Destroy(b2Joint* joint, b2BlockAllocator* allocator);
 
+	// Write the joint to a snapshot. The bodies are written as their index
+	// in b2World::m_bodies and the joints of a gear joint as their m_index.
+	void Save(b2SnapshotWriter* writer) const;
+
+	// Create a joint written by Save(), looking its bodies and joints up in
+	// the arrays. It isn't linked to the bodies or the world. Invalid data
+	// flags an error on the reader and returns NULL.
+	static b2Joint* Load(b2SnapshotReader* reader, b2Body** bodies,
+						 int32 bodyCount, b2Joint** joints, int32 jointCount,
+						 b2BlockAllocator* allocator);
+
 	b2Joint(const b2JointDef* def);
 	virtual ~b2Joint() {}
 
@@ -167,6 +185,30 @@ protected:
 	// This returns true if the position errors are within tolerance.
 	virtual bool SolvePositionConstraints(const b2SolverData& data) = 0;
 
+	// Write and read the state the joint type keeps from step to step.
+	virtual void SaveState(b2SnapshotWriter* writer) const = 0;
+	virtual void LoadState(b2SnapshotReader* reader) = 0;
+
+	// Passes of the joint solver run by Solve().
+	enum SolverPass
+	{
+		e_initVelocityPass,
+		e_solveVelocityPass,
+		e_solvePositionPass
+	};
+
+	// Run a solver pass over joints, usually grouped by type. Each run of
+	// joints of one type is solved by a loop that calls its type's function
+	// directly rather than through the vtable. For the position pass, this returns true if the
+	// position errors of all the joints are within tolerance.
+	static bool Solve(b2Joint** joints, int32 count, const b2SolverData& data,
+					  SolverPass pass);
+
+	// Run a solver pass over count joints of type T.
+	template <typename T>
+	static bool SolveBatch(b2Joint** joints, int32 count,
+						   const b2SolverData& data, SolverPass pass);
+
 	b2JointType m_type;
 	b2Joint* m_prev;
 	b2Joint* m_next;
@@ -177,7 +219,12 @@ protected:
 
 	int32 m_index;
 
-	bool m_islandFlag;
+	// The persistent island of the joint and its links in the island's
+	// joint list. NULL while a body is inactive.
+	b2PersistentIsland* m_island;
+	b2Joint* m_islandPrev;
+	b2Joint* m_islandNext;
+
 	bool m_collideConnected;
 
 	void* m_userData;
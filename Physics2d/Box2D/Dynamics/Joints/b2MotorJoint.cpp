@@ -19,6 +19,7 @@
 #include <Box2D/Dynamics/Joints/b2MotorJoint.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 // Point-to-point constraint
 // Cdot = v2 - v1
@@ -60,14 +61,14 @@ b2MotorJoint::b2MotorJoint(const b2MotorJointDef* def)
 
 void b2MotorJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_bodyA->m_worldIndex;
+	m_indexB = m_bodyB->m_worldIndex;
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassA = m_bodyA->m_invMass;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIA = m_bodyA->m_invI;
-	m_invIB = m_bodyB->m_invI;
+	m_invMassA = data.inverseMasses[m_indexA].invMass;
+	m_invMassB = data.inverseMasses[m_indexB].invMass;
+	m_invIA = data.inverseMasses[m_indexA].invI;
+	m_invIB = data.inverseMasses[m_indexB].invI;
 
 	b2Vec2 cA = data.positions[m_indexA].c;
 	float32 aA = data.positions[m_indexA].a;
@@ -302,3 +303,25 @@ void b2MotorJoint::Dump()
 	b2Log("  jd.correctionFactor = %.15lef;\n", m_correctionFactor);
 	b2Log("  joints[%d] = m_world->CreateJoint(&jd);\n", m_index);
 }
+
+void b2MotorJoint::SaveState(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_linearOffset);
+	writer->Write(m_angularOffset);
+	writer->Write(m_linearImpulse);
+	writer->Write(m_angularImpulse);
+	writer->Write(m_maxForce);
+	writer->Write(m_maxTorque);
+	writer->Write(m_correctionFactor);
+}
+
+void b2MotorJoint::LoadState(b2SnapshotReader* reader)
+{
+	reader->Read(&m_linearOffset);
+	reader->Read(&m_angularOffset);
+	reader->Read(&m_linearImpulse);
+	reader->Read(&m_angularImpulse);
+	reader->Read(&m_maxForce);
+	reader->Read(&m_maxTorque);
+	reader->Read(&m_correctionFactor);
+}
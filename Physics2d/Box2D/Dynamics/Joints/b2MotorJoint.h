@@ -103,6 +103,8 @@ protected:
 	void InitVelocityConstraints(const b2SolverData& data);
 	void SolveVelocityConstraints(const b2SolverData& data);
 	bool SolvePositionConstraints(const b2SolverData& data);
+	void SaveState(b2SnapshotWriter* writer) const;
+	void LoadState(b2SnapshotReader* reader);
 
 	// Solver shared
 	b2Vec2 m_linearOffset;
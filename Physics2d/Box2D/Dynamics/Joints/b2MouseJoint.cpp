@@ -19,6 +19,7 @@
 #include <Box2D/Dynamics/Joints/b2MouseJoint.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 // p = attached point, m = mouse point
 // C = p - m
@@ -95,10 +96,10 @@ float32 b2MouseJoint::GetDampingRatio() const
 
 void b2MouseJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexB = m_bodyB->m_worldIndex;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
-	m_invMassB = m_bodyB->m_invMass;
-	m_invIB = m_bodyB->m_invI;
+	m_invMassB = data.inverseMasses[m_indexB].invMass;
+	m_invIB = data.inverseMasses[m_indexB].invI;
 
 	b2Vec2 cB = data.positions[m_indexB].c;
 	float32 aB = data.positions[m_indexB].a;
@@ -220,3 +221,27 @@ void b2MouseJoint::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_targetA -= newOrigin;
 }
+
+void b2MouseJoint::SaveState(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_localAnchorB);
+	writer->Write(m_targetA);
+	writer->Write(m_frequencyHz);
+	writer->Write(m_dampingRatio);
+	writer->Write(m_beta);
+	writer->Write(m_impulse);
+	writer->Write(m_maxForce);
+	writer->Write(m_gamma);
+}
+
+void b2MouseJoint::LoadState(b2SnapshotReader* reader)
+{
+	reader->Read(&m_localAnchorB);
+	reader->Read(&m_targetA);
+	reader->Read(&m_frequencyHz);
+	reader->Read(&m_dampingRatio);
+	reader->Read(&m_beta);
+	reader->Read(&m_impulse);
+	reader->Read(&m_maxForce);
+	reader->Read(&m_gamma);
+}
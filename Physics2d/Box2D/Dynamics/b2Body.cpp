@@ -22,6 +22,8 @@
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
 #include <Box2D/Dynamics/Joints/b2Joint.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 {
@@ -42,6 +44,10 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 	{
 		m_flags |= e_fixedRotationFlag;
 	}
+	if (bd->speculative)
+	{
+		m_flags |= e_speculativeFlag;
+	}
 	if (bd->allowSleep)
 	{
 		m_flags |= e_autoSleepFlag;
@@ -73,33 +79,30 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 	m_prev = NULL;
 	m_next = NULL;
 
-	m_linearVelocity = bd->linearVelocity;
-	m_angularVelocity = bd->angularVelocity;
+	m_island = NULL;
+	m_islandPrev = NULL;
+	m_islandNext = NULL;
 
 	m_linearDamping = bd->linearDamping;
 	m_angularDamping = bd->angularDamping;
 	m_gravityScale = bd->gravityScale;
 
-	m_force.SetZero();
-	m_torque = 0.0f;
-
 	m_sleepTime = 0.0f;
+	m_speculativeDistance = 0.0f;
 
 	m_type = bd->type;
 
+	// b2World::CreateBody() sets the matching inverse mass in its arrays.
 	if (m_type == b2_dynamicBody)
 	{
 		m_mass = 1.0f;
-		m_invMass = 1.0f;
 	}
 	else
 	{
 		m_mass = 0.0f;
-		m_invMass = 0.0f;
 	}
 
 	m_I = 0.0f;
-	m_invI = 0.0f;
 
 	m_userData = bd->userData;
 
@@ -112,6 +115,212 @@ b2Body::~b2Body()
 	// shapes and joints are destroyed in b2World::Destroy
 }
 
+b2Velocity& b2Body::GetVelocityState()
+{
+	return m_world->m_velocities[m_worldIndex];
+}
+
+const b2Velocity& b2Body::GetVelocityState() const
+{
+	return m_world->m_velocities[m_worldIndex];
+}
+
+b2Force& b2Body::GetForceState()
+{
+	return m_world->m_forces[m_worldIndex];
+}
+
+const b2Force& b2Body::GetForceState() const
+{
+	return m_world->m_forces[m_worldIndex];
+}
+
+b2InverseMass& b2Body::GetInverseMassState()
+{
+	return m_world->m_inverseMasses[m_worldIndex];
+}
+
+const b2InverseMass& b2Body::GetInverseMassState() const
+{
+	return m_world->m_inverseMasses[m_worldIndex];
+}
+
+void b2Body::SetLinearVelocity(const b2Vec2& v)
+{
+	if (m_type == b2_staticBody)
+	{
+		return;
+	}
+
+	if (b2Dot(v,v) > 0.0f)
+	{
+		SetAwake(true);
+	}
+
+	GetVelocityState().v = v;
+}
+
+b2Vec2 b2Body::GetLinearVelocity() const
+{
+	return GetVelocityState().v;
+}
+
+void b2Body::SetAngularVelocity(float32 w)
+{
+	if (m_type == b2_staticBody)
+	{
+		return;
+	}
+
+	if (w * w > 0.0f)
+	{
+		SetAwake(true);
+	}
+
+	GetVelocityState().w = w;
+}
+
+float32 b2Body::GetAngularVelocity() const
+{
+	return GetVelocityState().w;
+}
+
+b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
+{
+	const b2Velocity& velocity = GetVelocityState();
+	return velocity.v + b2Cross(velocity.w, worldPoint - m_sweep.c);
+}
+
+void b2Body::SetAwake(bool flag)
+{
+	if (flag)
+	{
+		if ((m_flags & e_awakeFlag) == 0)
+		{
+			m_flags |= e_awakeFlag;
+			m_sleepTime = 0.0f;
+
+			// The whole island wakes up.
+			if (m_island)
+			{
+				m_world->m_islandGraph.WakeIsland(m_island);
+			}
+		}
+	}
+	else
+	{
+		m_flags &= ~e_awakeFlag;
+		m_sleepTime = 0.0f;
+		b2Velocity& velocity = GetVelocityState();
+		velocity.v.SetZero();
+		velocity.w = 0.0f;
+		b2Force& force = GetForceState();
+		force.force.SetZero();
+		force.torque = 0.0f;
+		m_speculativeDistance = 0.0f;
+	}
+}
+
+void b2Body::ApplyForce(const b2Vec2& force, const b2Vec2& point, bool wake)
+{
+	if (m_type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (wake && (m_flags & e_awakeFlag) == 0)
+	{
+		SetAwake(true);
+	}
+
+	// Don't accumulate a force if the body is sleeping.
+	if (m_flags & e_awakeFlag)
+	{
+		b2Force& state = GetForceState();
+		state.force += force;
+		state.torque += b2Cross(point - m_sweep.c, force);
+	}
+}
+
+void b2Body::ApplyForceToCenter(const b2Vec2& force, bool wake)
+{
+	if (m_type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (wake && (m_flags & e_awakeFlag) == 0)
+	{
+		SetAwake(true);
+	}
+
+	// Don't accumulate a force if the body is sleeping
+	if (m_flags & e_awakeFlag)
+	{
+		GetForceState().force += force;
+	}
+}
+
+void b2Body::ApplyTorque(float32 torque, bool wake)
+{
+	if (m_type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (wake && (m_flags & e_awakeFlag) == 0)
+	{
+		SetAwake(true);
+	}
+
+	// Don't accumulate a force if the body is sleeping
+	if (m_flags & e_awakeFlag)
+	{
+		GetForceState().torque += torque;
+	}
+}
+
+void b2Body::ApplyLinearImpulse(const b2Vec2& impulse, const b2Vec2& point, bool wake)
+{
+	if (m_type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (wake && (m_flags & e_awakeFlag) == 0)
+	{
+		SetAwake(true);
+	}
+
+	// Don't accumulate velocity if the body is sleeping
+	if (m_flags & e_awakeFlag)
+	{
+		const b2InverseMass& inverseMass = GetInverseMassState();
+		b2Velocity& velocity = GetVelocityState();
+		velocity.v += inverseMass.invMass * impulse;
+		velocity.w += inverseMass.invI * b2Cross(point - m_sweep.c, impulse);
+	}
+}
+
+void b2Body::ApplyAngularImpulse(float32 impulse, bool wake)
+{
+	if (m_type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (wake && (m_flags & e_awakeFlag) == 0)
+	{
+		SetAwake(true);
+	}
+
+	// Don't accumulate velocity if the body is sleeping
+	if (m_flags & e_awakeFlag)
+	{
+		GetVelocityState().w += GetInverseMassState().invI * impulse;
+	}
+}
+
 void b2Body::SetType(b2BodyType type)
 {
 	b2Assert(m_world->IsLocked() == false);
@@ -125,23 +334,27 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	// Static bodies have no island, so rebuild this body's links.
+	m_world->m_islandGraph.UnlinkBody(this);
+
 	m_type = type;
 
 	ResetMassData();
 
 	if (m_type == b2_staticBody)
 	{
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
+		GetVelocityState().v.SetZero();
+		GetVelocityState().w = 0.0f;
 		m_sweep.a0 = m_sweep.a;
 		m_sweep.c0 = m_sweep.c;
-		SynchronizeFixtures();
+		SynchronizeFixtures(0.0f);
 	}
 
 	SetAwake(true);
 
-	m_force.SetZero();
-	m_torque = 0.0f;
+	b2Force& force = GetForceState();
+	force.force.SetZero();
+	force.torque = 0.0f;
 
 	// Delete the attached contacts.
 	b2ContactEdge* ce = m_contactList;
@@ -163,6 +376,8 @@ void b2Body::SetType(b2BodyType type)
 			broadPhase->TouchProxy(f->m_proxies[i].proxyId);
 		}
 	}
+
+	m_world->m_islandGraph.LinkBody(this);
 }
 
 b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
@@ -175,7 +390,7 @@ b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 
 	b2BlockAllocator* allocator = &m_world->m_blockAllocator;
 
-	void* memory = allocator->Allocate(sizeof(b2Fixture));
+	void* memory = m_world->m_fixtureAllocator.Allocate(sizeof(b2Fixture));
 	b2Fixture* fixture = new (memory) b2Fixture;
 	fixture->Create(allocator, this, def);
 
@@ -213,6 +428,92 @@ b2Fixture* b2Body::CreateFixture(const b2Shape* shape, float32 density)
 	return CreateFixture(&def);
 }
 
+void b2Body::CreateFixtures(const b2FixtureDef* defs, int32 count,
+							b2Fixture** fixtures)
+{
+	b2Assert(m_world->IsLocked() == false);
+	if (m_world->IsLocked() == true)
+	{
+		return;
+	}
+
+	b2BlockAllocator* allocator = &m_world->m_blockAllocator;
+
+	int32 proxyCount = 0;
+	bool hasDensity = false;
+	for (int32 i = 0; i < count; ++i)
+	{
+		void* memory = m_world->m_fixtureAllocator.Allocate(sizeof(b2Fixture));
+		b2Fixture* fixture = new (memory) b2Fixture;
+		fixture->Create(allocator, this, &defs[i]);
+		fixture->m_body = this;
+
+		fixture->m_next = m_fixtureList;
+		m_fixtureList = fixture;
+		++m_fixtureCount;
+
+		proxyCount += fixture->GetProxyCapacity();
+		hasDensity = hasDensity || fixture->m_density > 0.0f;
+		if (fixtures)
+		{
+			fixtures[i] = fixture;
+		}
+	}
+
+	if ((m_flags & e_activeFlag) && proxyCount > 0)
+	{
+		// The new fixtures are at the front of the list.
+		b2StackAllocator* stack = &m_world->m_stackAllocator;
+		b2AABB* aabbs = (b2AABB*)stack->Allocate(proxyCount * sizeof(b2AABB));
+		void** userData = (void**)stack->Allocate(proxyCount * sizeof(void*));
+		int32* proxyIds = (int32*)stack->Allocate(proxyCount * sizeof(int32));
+
+		int32 index = 0;
+		b2Fixture* fixture = m_fixtureList;
+		for (int32 i = 0; i < count; ++i, fixture = fixture->m_next)
+		{
+			b2Assert(fixture->m_proxyCount == 0);
+			fixture->m_proxyCount = fixture->GetProxyCapacity();
+			const bool edgeTree = fixture->HasEdgeTree();
+			for (int32 j = 0; j < fixture->m_proxyCount; ++j)
+			{
+				b2FixtureProxy* proxy = fixture->m_proxies + j;
+				proxy->childIndex = edgeTree ? b2_edgeTreeChildIndex : j;
+				fixture->m_shape->ComputeAABB(&proxy->aabb, m_xf,
+											  proxy->childIndex);
+				proxy->fixture = fixture;
+				aabbs[index] = proxy->aabb;
+				userData[index] = proxy;
+				++index;
+			}
+		}
+
+		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+		broadPhase->CreateProxies(aabbs, userData, proxyCount, proxyIds);
+
+		index = 0;
+		fixture = m_fixtureList;
+		for (int32 i = 0; i < count; ++i, fixture = fixture->m_next)
+		{
+			for (int32 j = 0; j < fixture->m_proxyCount; ++j)
+			{
+				fixture->m_proxies[j].proxyId = proxyIds[index++];
+			}
+		}
+
+		stack->Free(proxyIds);
+		stack->Free(userData);
+		stack->Free(aabbs);
+	}
+
+	if (hasDensity)
+	{
+		ResetMassData();
+	}
+
+	m_world->m_flags |= b2World::e_newFixture;
+}
+
 void b2Body::DestroyFixture(b2Fixture* fixture)
 {
 	b2Assert(m_world->IsLocked() == false);
@@ -276,7 +577,7 @@ void b2Body::DestroyFixture(b2Fixture* fixture)
 	fixture->m_body = NULL;
 	fixture->m_next = NULL;
 	fixture->~b2Fixture();
-	allocator->Free(fixture, sizeof(b2Fixture));
+	m_world->m_fixtureAllocator.Free(fixture, sizeof(b2Fixture));
 
 	--m_fixtureCount;
 
@@ -287,10 +588,11 @@ void b2Body::DestroyFixture(b2Fixture* fixture)
 void b2Body::ResetMassData()
 {
 	// Compute mass data from shapes. Each shape has its own density.
+	b2InverseMass& inverseMass = GetInverseMassState();
 	m_mass = 0.0f;
-	m_invMass = 0.0f;
+	inverseMass.invMass = 0.0f;
 	m_I = 0.0f;
-	m_invI = 0.0f;
+	inverseMass.invI = 0.0f;
 	m_sweep.localCenter.SetZero();
 
 	// Static and kinematic bodies have zero mass.
@@ -323,14 +625,14 @@ void b2Body::ResetMassData()
 	// Compute center of mass.
 	if (m_mass > 0.0f)
 	{
-		m_invMass = 1.0f / m_mass;
-		localCenter *= m_invMass;
+		inverseMass.invMass = 1.0f / m_mass;
+		localCenter *= inverseMass.invMass;
 	}
 	else
 	{
 		// Force all dynamic bodies to have a positive mass.
 		m_mass = 1.0f;
-		m_invMass = 1.0f;
+		inverseMass.invMass = 1.0f;
 	}
 
 	if (m_I > 0.0f && (m_flags & e_fixedRotationFlag) == 0)
@@ -338,13 +640,13 @@ void b2Body::ResetMassData()
 		// Center the inertia about the center of mass.
 		m_I -= m_mass * b2Dot(localCenter, localCenter);
 		b2Assert(m_I > 0.0f);
-		m_invI = 1.0f / m_I;
+		inverseMass.invI = 1.0f / m_I;
 
 	}
 	else
 	{
 		m_I = 0.0f;
-		m_invI = 0.0f;
+		inverseMass.invI = 0.0f;
 	}
 
 	// Move center of mass.
@@ -353,7 +655,8 @@ void b2Body::ResetMassData()
 	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	b2Velocity& velocity = GetVelocityState();
+	velocity.v += b2Cross(velocity.w, m_sweep.c - oldCenter);
 }
 
 void b2Body::SetMassData(const b2MassData* massData)
@@ -369,9 +672,10 @@ void b2Body::SetMassData(const b2MassData* massData)
 		return;
 	}
 
-	m_invMass = 0.0f;
+	b2InverseMass& inverseMass = GetInverseMassState();
+	inverseMass.invMass = 0.0f;
 	m_I = 0.0f;
-	m_invI = 0.0f;
+	inverseMass.invI = 0.0f;
 
 	m_mass = massData->mass;
 	if (m_mass <= 0.0f)
@@ -379,13 +683,13 @@ void b2Body::SetMassData(const b2MassData* massData)
 		m_mass = 1.0f;
 	}
 
-	m_invMass = 1.0f / m_mass;
+	inverseMass.invMass = 1.0f / m_mass;
 
 	if (massData->I > 0.0f && (m_flags & b2Body::e_fixedRotationFlag) == 0)
 	{
 		m_I = massData->I - m_mass * b2Dot(massData->center, massData->center);
 		b2Assert(m_I > 0.0f);
-		m_invI = 1.0f / m_I;
+		inverseMass.invI = 1.0f / m_I;
 	}
 
 	// Move center of mass.
@@ -394,7 +698,8 @@ void b2Body::SetMassData(const b2MassData* massData)
 	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	b2Velocity& velocity = GetVelocityState();
+	velocity.v += b2Cross(velocity.w, m_sweep.c - oldCenter);
 }
 
 bool b2Body::ShouldCollide(const b2Body* other) const
@@ -445,17 +750,46 @@ void b2Body::SetTransform(const b2Vec2& position, float32 angle)
 	}
 }
 
-void b2Body::SynchronizeFixtures()
+void b2Body::SynchronizeFixtures(float32 dt)
 {
 	b2Transform xf1;
 	xf1.q.Set(m_sweep.a0);
 	xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
 
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+
+	if ((m_flags & e_speculativeFlag) == 0 || dt == 0.0f)
+	{
+		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->Synchronize(broadPhase, xf1, m_xf);
+		}
+		m_speculativeDistance = 0.0f;
+		return;
+	}
+
+	// Also cover where the body will be after the next step, so contacts
+	// exist before the body can pass through anything.
+	b2Transform xf2;
+	const b2Velocity& velocity = GetVelocityState();
+	xf2.q.Set(m_sweep.a + dt * velocity.w);
+	xf2.p = m_sweep.c + dt * velocity.v - b2Mul(xf2.q, m_sweep.localCenter);
+
+	float32 radius = 0.0f;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
-		f->Synchronize(broadPhase, xf1, m_xf);
+		f->Synchronize(broadPhase, xf1, m_xf, xf2);
+
+		for (int32 i = 0; i < f->m_proxyCount; ++i)
+		{
+			const b2AABB& aabb = f->m_proxies[i].aabb;
+			b2Vec2 r = b2Abs(aabb.GetCenter() - m_sweep.c) + aabb.GetExtents();
+			radius = b2Max(radius, r.Length());
+		}
 	}
+
+	m_speculativeDistance = dt * (velocity.v.Length() +
+		b2Abs(velocity.w) * radius);
 }
 
 void b2Body::SetActive(bool flag)
@@ -479,9 +813,13 @@ void b2Body::SetActive(bool flag)
 		}
 
 		// Contacts are created the next time step.
+
+		m_world->m_islandGraph.LinkBody(this);
 	}
 	else
 	{
+		m_world->m_islandGraph.UnlinkBody(this);
+
 		m_flags &= ~e_activeFlag;
 
 		// Destroy all proxies.
@@ -520,11 +858,111 @@ void b2Body::SetFixedRotation(bool flag)
 		m_flags &= ~e_fixedRotationFlag;
 	}
 
-	m_angularVelocity = 0.0f;
+	GetVelocityState().w = 0.0f;
 
 	ResetMassData();
 }
 
+void b2Body::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_id);
+	writer->Write(m_type);
+	writer->Write(m_flags);
+	writer->Write(m_xf);
+	writer->Write(m_xf0);
+	writer->Write(m_sweep);
+	writer->Write(GetVelocityState());
+	writer->Write(GetForceState().force);
+	writer->Write(GetForceState().torque);
+	writer->Write(m_mass);
+	writer->Write(GetInverseMassState().invMass);
+	writer->Write(m_I);
+	writer->Write(GetInverseMassState().invI);
+	writer->Write(m_linearDamping);
+	writer->Write(m_angularDamping);
+	writer->Write(m_gravityScale);
+	writer->Write(m_sleepTime);
+	writer->Write(m_speculativeDistance);
+	writer->WritePointer(m_userData);
+
+	writer->Write(m_fixtureCount);
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->Save(writer);
+	}
+}
+
+void b2Body::Load(b2SnapshotReader* reader)
+{
+	reader->Read(&m_id);
+	// The type is read as an integer, as it isn't a b2BodyType until it's
+	// checked.
+	const int32 type = reader->Read<int32>();
+	if (type < b2_staticBody || type > b2_dynamicBody)
+	{
+		reader->SetError();
+		m_type = b2_staticBody;
+	}
+	else
+	{
+		m_type = (b2BodyType)type;
+	}
+	reader->Read(&m_flags);
+	reader->Read(&m_xf);
+	reader->Read(&m_xf0);
+	reader->Read(&m_sweep);
+	reader->Read(&GetVelocityState());
+	reader->Read(&GetForceState().force);
+	reader->Read(&GetForceState().torque);
+	reader->Read(&m_mass);
+	reader->Read(&GetInverseMassState().invMass);
+	reader->Read(&m_I);
+	reader->Read(&GetInverseMassState().invI);
+	reader->Read(&m_linearDamping);
+	reader->Read(&m_angularDamping);
+	reader->Read(&m_gravityScale);
+	reader->Read(&m_sleepTime);
+	reader->Read(&m_speculativeDistance);
+	m_userData = reader->ReadPointer();
+
+	// Append the fixtures to keep the order of the list.
+	const int32 fixtureCount = reader->ReadCount(1);
+	b2Fixture** last = &m_fixtureList;
+	for (int32 i = 0; i < fixtureCount && reader->HasError() == false; ++i)
+	{
+		void* memory = m_world->m_fixtureAllocator.Allocate(sizeof(b2Fixture));
+		b2Fixture* fixture = new (memory) b2Fixture;
+		if (fixture->Load(reader, &m_world->m_blockAllocator, this) == false)
+		{
+			fixture->~b2Fixture();
+			m_world->m_fixtureAllocator.Free(memory, sizeof(b2Fixture));
+			break;
+		}
+		*last = fixture;
+		last = &fixture->m_next;
+		++m_fixtureCount;
+	}
+}
+
+b2Fixture* b2Body::LoadFixture(b2SnapshotReader* reader, b2Body** bodies,
+							   int32 bodyCount)
+{
+	const int32 bodyIndex = reader->ReadIndex(bodyCount);
+	const int32 fixtureIndex = bodyIndex >= 0 ?
+		reader->ReadIndex(bodies[bodyIndex]->m_fixtureCount) :
+		reader->Read<int32>();
+	if (reader->HasError())
+	{
+		return NULL;
+	}
+	b2Fixture* fixture = bodies[bodyIndex]->m_fixtureList;
+	for (int32 i = 0; i < fixtureIndex; ++i)
+	{
+		fixture = fixture->m_next;
+	}
+	return fixture;
+}
+
 void b2Body::Dump()
 {
 	int32 bodyIndex = m_islandIndex;
@@ -534,14 +972,16 @@ void b2Body::Dump()
 	b2Log("  bd.type = b2BodyType(%d);\n", m_type);
 	b2Log("  bd.position.Set(%.15lef, %.15lef);\n", m_xf.p.x, m_xf.p.y);
 	b2Log("  bd.angle = %.15lef;\n", m_sweep.a);
-	b2Log("  bd.linearVelocity.Set(%.15lef, %.15lef);\n", m_linearVelocity.x, m_linearVelocity.y);
-	b2Log("  bd.angularVelocity = %.15lef;\n", m_angularVelocity);
+	const b2Velocity& velocity = GetVelocityState();
+	b2Log("  bd.linearVelocity.Set(%.15lef, %.15lef);\n", velocity.v.x, velocity.v.y);
+	b2Log("  bd.angularVelocity = %.15lef;\n", velocity.w);
 	b2Log("  bd.linearDamping = %.15lef;\n", m_linearDamping);
 	b2Log("  bd.angularDamping = %.15lef;\n", m_angularDamping);
 	b2Log("  bd.allowSleep = bool(%d);\n", m_flags & e_autoSleepFlag);
 	b2Log("  bd.awake = bool(%d);\n", m_flags & e_awakeFlag);
 	b2Log("  bd.fixedRotation = bool(%d);\n", m_flags & e_fixedRotationFlag);
 	b2Log("  bd.bullet = bool(%d);\n", m_flags & e_bulletFlag);
+	b2Log("  bd.speculative = bool(%d);\n", m_flags & e_speculativeFlag);
 	b2Log("  bd.active = bool(%d);\n", m_flags & e_activeFlag);
 	b2Log("  bd.gravityScale = %.15lef;\n", m_gravityScale);
 	b2Log("  bodies[%d] = m_world->CreateBody(&bd);\n", m_islandIndex);
@@ -29,7 +29,13 @@ class b2Joint;
 class b2Contact;
 class b2Controller;
 class b2World;
+class b2SnapshotWriter;
+class b2SnapshotReader;
 struct b2FixtureDef;
+struct b2Velocity;
+struct b2Force;
+struct b2InverseMass;
+struct b2PersistentIsland;
 struct b2JointEdge;
 struct b2ContactEdge;
 
@@ -65,6 +71,7 @@ struct b2BodyDef
 		awake = true;
 		fixedRotation = false;
 		bullet = false;
+		speculative = false;
 		type = b2_staticBody;
 		active = true;
 		gravityScale = 1.0f;
@@ -118,6 +125,16 @@ struct b2BodyDef
 	/// @warning You should use this flag sparingly since it increases processing time.
 	bool bullet;
 
+	/// Should this body be kept from tunneling by speculative contacts instead
+	/// of continuous collision? At the end of each step the body's proxies are
+	/// grown to cover its motion over the next step, and contacts keep points
+	/// that are apart by up to that distance. The solver then only lets the
+	/// shapes close the gap. This skips the time of impact sub-steps for any
+	/// pair involving this body, including bullets, at the cost of some
+	/// restitution accuracy. The prediction assumes the next step uses the
+	/// same time step and takes effect from the body's second step.
+	bool speculative;
+
 	/// Does this body start out active?
 	bool active;
 
@@ -150,6 +167,18 @@ public:
 	/// @warning This function is locked during callbacks.
 	b2Fixture* CreateFixture(const b2Shape* shape, float32 density);
 
+	/// Create count fixtures at once, as if by calling CreateFixture() for
+	/// each definition in turn. Their proxies are built into the
+	/// broad-phase's tree with one build rather than inserted one by one,
+	/// which is much faster for the many fixtures of a level.
+	/// @param defs the fixture definitions.
+	/// @param count the number of definitions.
+	/// @param fixtures receives the fixtures in the order of defs. May be
+	/// NULL.
+	/// @warning This function is locked during callbacks.
+	void CreateFixtures(const b2FixtureDef* defs, int32 count,
+						b2Fixture** fixtures);
+
 	/// Destroy a fixture. This removes the fixture from the broad-phase and
 	/// destroys all contacts associated with this fixture. This will
 	/// automatically adjust the mass of the body if the body is dynamic and the
@@ -190,7 +219,7 @@ public:
 
 	/// Get the linear velocity of the center of mass.
 	/// @return the linear velocity of the center of mass.
-	const b2Vec2& GetLinearVelocity() const;
+	b2Vec2 GetLinearVelocity() const;
 
 	/// Set the angular velocity.
 	/// @param omega the new angular velocity in radians/second.
@@ -317,6 +346,13 @@ public:
 	/// Is this body treated like a bullet for continuous collision detection?
 	bool IsBullet() const;
 
+	/// Should this body use speculative contacts instead of continuous
+	/// collision? See b2BodyDef::speculative.
+	void SetSpeculative(bool flag);
+
+	/// Does this body use speculative contacts?
+	bool IsSpeculative() const;
+
 	/// You can disable sleeping on this body. If you disable sleeping, the
 	/// body will be woken.
 	void SetSleepingAllowed(bool flag);
@@ -382,6 +418,10 @@ public:
 	/// Set the user data. Use this to store your application specific data.
 	void SetUserData(void* data);
 
+	/// Get a number identifying the body. Each body created by a world gets
+	/// a new one, so it stays unique after the body is destroyed.
+	uint32 GetId() const;
+
 	/// Get the parent world of this body.
 	b2World* GetWorld();
 	const b2World* GetWorld() const;
@@ -405,10 +445,12 @@ private:
 
 	friend class b2World;
 	friend class b2Island;
+	friend class b2IslandGraph;
 	friend class b2ContactManager;
 	friend class b2ContactSolver;
 	friend class b2Contact;
 
+	friend class b2Joint;
 	friend class b2DistanceJoint;
 	friend class b2FrictionJoint;
 	friend class b2GearJoint;
@@ -433,13 +475,14 @@ private:
 		e_bulletFlag		= 0x0008,
 		e_fixedRotationFlag	= 0x0010,
 		e_activeFlag		= 0x0020,
-		e_toiFlag			= 0x0040
+		e_toiFlag			= 0x0040,
+		e_speculativeFlag	= 0x0080
 	};
 
 	b2Body(const b2BodyDef* bd, b2World* world);
 	~b2Body();
 
-	void SynchronizeFixtures();
+	void SynchronizeFixtures(float32 dt);
 	void SynchronizeTransform();
 
 	// This is used to prevent connected bodies from colliding.
@@ -448,22 +491,51 @@ private:
 
 	void Advance(float32 t);
 
+	// Write the state of the body and its fixtures to a snapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	// Read the state written by Save() into a new body which has its place
+	// in b2World's arrays, creating its fixtures. Invalid data flags an
+	// error on the reader, leaving the fixtures read so far.
+	void Load(b2SnapshotReader* reader);
+
+	// Read a fixture saved as the index of its body in b2World's array and
+	// its index in the body's list. Indices out of range flag an error on
+	// the reader and return NULL.
+	static b2Fixture* LoadFixture(b2SnapshotReader* reader, b2Body** bodies,
+								  int32 bodyCount);
+
+	// The velocity, the accumulated force and the inverse mass live in
+	// b2World's solver arrays at m_worldIndex, so islands read and solve
+	// them in place rather than copying them in and out.
+	b2Velocity& GetVelocityState();
+	const b2Velocity& GetVelocityState() const;
+	b2Force& GetForceState();
+	const b2Force& GetForceState() const;
+	b2InverseMass& GetInverseMassState();
+	const b2InverseMass& GetInverseMassState() const;
+
 	b2BodyType m_type;
 
 	uint16 m_flags;
 
 	int32 m_islandIndex;
 
+	// The persistent island of a body which is not static and is active,
+	// and its links in the island's body list.
+	b2PersistentIsland* m_island;
+	b2Body* m_islandPrev;
+	b2Body* m_islandNext;
+
+	// Index of this body in b2World::m_bodies.
+	int32 m_worldIndex;
+
+	uint32 m_id;
+
 	b2Transform m_xf;		// the body origin transform
 	b2Transform m_xf0;		// the previous transform for particle simulation
 	b2Sweep m_sweep;		// the swept motion for CCD
 
-	b2Vec2 m_linearVelocity;
-	float32 m_angularVelocity;
-
-	b2Vec2 m_force;
-	float32 m_torque;
-
 	b2World* m_world;
 	b2Body* m_prev;
 	b2Body* m_next;
@@ -474,10 +546,10 @@ private:
 	b2JointEdge* m_jointList;
 	b2ContactEdge* m_contactList;
 
-	float32 m_mass, m_invMass;
+	float32 m_mass;
 
 	// Rotational inertia about the center of mass.
-	float32 m_I, m_invI;
+	float32 m_I;
 
 	float32 m_linearDamping;
 	float32 m_angularDamping;
@@ -485,6 +557,9 @@ private:
 
 	float32 m_sleepTime;
 
+	// How far any point of a speculative body may move in the next step.
+	float32 m_speculativeDistance;
+
 	void* m_userData;
 };
 
@@ -518,46 +593,6 @@ inline const b2Vec2& b2Body::GetLocalCenter() const
 	return m_sweep.localCenter;
 }
 
-inline void b2Body::SetLinearVelocity(const b2Vec2& v)
-{
-	if (m_type == b2_staticBody)
-	{
-		return;
-	}
-
-	if (b2Dot(v,v) > 0.0f)
-	{
-		SetAwake(true);
-	}
-
-	m_linearVelocity = v;
-}
-
-inline const b2Vec2& b2Body::GetLinearVelocity() const
-{
-	return m_linearVelocity;
-}
-
-inline void b2Body::SetAngularVelocity(float32 w)
-{
-	if (m_type == b2_staticBody)
-	{
-		return;
-	}
-
-	if (w * w > 0.0f)
-	{
-		SetAwake(true);
-	}
-
-	m_angularVelocity = w;
-}
-
-inline float32 b2Body::GetAngularVelocity() const
-{
-	return m_angularVelocity;
-}
-
 inline float32 b2Body::GetMass() const
 {
 	return m_mass;
@@ -595,11 +630,6 @@ inline b2Vec2 b2Body::GetLocalVector(const b2Vec2& worldVector) const
 	return b2MulT(m_xf.q, worldVector);
 }
 
-inline b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
-{
-	return m_linearVelocity + b2Cross(m_angularVelocity, worldPoint - m_sweep.c);
-}
-
 inline b2Vec2 b2Body::GetLinearVelocityFromLocalPoint(const b2Vec2& localPoint) const
 {
 	return GetLinearVelocityFromWorldPoint(GetWorldPoint(localPoint));
@@ -652,27 +682,24 @@ inline bool b2Body::IsBullet() const
 	return (m_flags & e_bulletFlag) == e_bulletFlag;
 }
 
-inline void b2Body::SetAwake(bool flag)
+inline void b2Body::SetSpeculative(bool flag)
 {
 	if (flag)
 	{
-		if ((m_flags & e_awakeFlag) == 0)
-		{
-			m_flags |= e_awakeFlag;
-			m_sleepTime = 0.0f;
-		}
+		m_flags |= e_speculativeFlag;
 	}
 	else
 	{
-		m_flags &= ~e_awakeFlag;
-		m_sleepTime = 0.0f;
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
-		m_force.SetZero();
-		m_torque = 0.0f;
+		m_flags &= ~e_speculativeFlag;
+		m_speculativeDistance = 0.0f;
 	}
 }
 
+inline bool b2Body::IsSpeculative() const
+{
+	return (m_flags & e_speculativeFlag) == e_speculativeFlag;
+}
+
 inline bool b2Body::IsAwake() const
 {
 	return (m_flags & e_awakeFlag) == e_awakeFlag;
@@ -756,103 +783,6 @@ inline void* b2Body::GetUserData() const
 	return m_userData;
 }
 
-inline void b2Body::ApplyForce(const b2Vec2& force, const b2Vec2& point, bool wake)
-{
-	if (m_type != b2_dynamicBody)
-	{
-		return;
-	}
-
-	if (wake && (m_flags & e_awakeFlag) == 0)
-	{
-		SetAwake(true);
-	}
-
-	// Don't accumulate a force if the body is sleeping.
-	if (m_flags & e_awakeFlag)
-	{
-		m_force += force;
-		m_torque += b2Cross(point - m_sweep.c, force);
-	}
-}
-
-inline void b2Body::ApplyForceToCenter(const b2Vec2& force, bool wake)
-{
-	if (m_type != b2_dynamicBody)
-	{
-		return;
-	}
-
-	if (wake && (m_flags & e_awakeFlag) == 0)
-	{
-		SetAwake(true);
-	}
-
-	// Don't accumulate a force if the body is sleeping
-	if (m_flags & e_awakeFlag)
-	{
-		m_force += force;
-	}
-}
-
-inline void b2Body::ApplyTorque(float32 torque, bool wake)
-{
-	if (m_type != b2_dynamicBody)
-	{
-		return;
-	}
-
-	if (wake && (m_flags & e_awakeFlag) == 0)
-	{
-		SetAwake(true);
-	}
-
-	// Don't accumulate a force if the body is sleeping
-	if (m_flags & e_awakeFlag)
-	{
-		m_torque += torque;
-	}
-}
-
-inline void b2Body::ApplyLinearImpulse(const b2Vec2& impulse, const b2Vec2& point, bool wake)
-{
-	if (m_type != b2_dynamicBody)
-	{
-		return;
-	}
-
-	if (wake && (m_flags & e_awakeFlag) == 0)
-	{
-		SetAwake(true);
-	}
-
-	// Don't accumulate velocity if the body is sleeping
-	if (m_flags & e_awakeFlag)
-	{
-		m_linearVelocity += m_invMass * impulse;
-		m_angularVelocity += m_invI * b2Cross(point - m_sweep.c, impulse);
-	}
-}
-
-inline void b2Body::ApplyAngularImpulse(float32 impulse, bool wake)
-{
-	if (m_type != b2_dynamicBody)
-	{
-		return;
-	}
-
-	if (wake && (m_flags & e_awakeFlag) == 0)
-	{
-		SetAwake(true);
-	}
-
-	// Don't accumulate velocity if the body is sleeping
-	if (m_flags & e_awakeFlag)
-	{
-		m_angularVelocity += m_invI * impulse;
-	}
-}
-
 inline void b2Body::SynchronizeTransform()
 {
 	m_xf.q.Set(m_sweep.a);
@@ -869,6 +799,11 @@ inline void b2Body::Advance(float32 alpha)
 	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
 }
 
+inline uint32 b2Body::GetId() const
+{
+	return m_id;
+}
+
 inline b2World* b2Body::GetWorld()
 {
 	return m_world;
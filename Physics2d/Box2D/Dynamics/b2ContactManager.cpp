@@ -20,8 +20,17 @@
 #include <Box2D/Dynamics/b2ContactManager.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Trace.h>
+#include <Box2D/Common/b2Snapshot.h>
+#include <string.h>
+
+// Initial capacity of the contact array.
+static const int32 b2_minContactCapacity = 64;
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
@@ -30,11 +39,21 @@ b2ContactManager::b2ContactManager()
 {
 	m_contactList = NULL;
 	m_contactCount = 0;
+	m_contacts = NULL;
+	m_contactCapacity = 0;
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = NULL;
 }
 
+b2ContactManager::~b2ContactManager()
+{
+	if (m_contacts)
+	{
+		m_allocator->Free(m_contacts, m_contactCapacity * sizeof(b2Contact*));
+	}
+}
+
 void b2ContactManager::Destroy(b2Contact* c)
 {
 	b2Fixture* fixtureA = c->GetFixtureA();
@@ -47,6 +66,11 @@ void b2ContactManager::Destroy(b2Contact* c)
 		m_contactListener->EndContact(c);
 	}
 
+	if (c->m_island)
+	{
+		bodyA->m_world->m_islandGraph.UnlinkContact(c);
+	}
+
 	// Remove from the world.
 	if (c->m_prev)
 	{
@@ -63,6 +87,11 @@ void b2ContactManager::Destroy(b2Contact* c)
 		m_contactList = c->m_next;
 	}
 
+	// Fill the hole in the contact array with the last contact.
+	b2Contact* last = m_contacts[m_contactCount - 1];
+	m_contacts[c->m_managerIndex] = last;
+	last->m_managerIndex = c->m_managerIndex;
+
 	// Remove from body 1
 	if (c->m_nodeA.prev)
 	{
@@ -105,7 +134,10 @@ void b2ContactManager::Destroy(b2Contact* c)
 // contact list.
 void b2ContactManager::Collide()
 {
-	// Update awake contacts.
+	b2TraceZone("b2ContactManager::Collide");
+	// Update awake contacts. They are walked in list order rather than
+	// array order, since the order contacts begin touching in decides how
+	// islands are joined.
 	b2Contact* c = m_contactList;
 	while (c)
 	{
@@ -151,9 +183,23 @@ void b2ContactManager::Collide()
 			continue;
 		}
 
-		int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+		bool overlap;
+		if (fixtureA->HasEdgeTree())
+		{
+			overlap = TestEdgeOverlap(fixtureA, indexA,
+									  fixtureB->m_proxies[indexB].proxyId);
+		}
+		else if (fixtureB->HasEdgeTree())
+		{
+			overlap = TestEdgeOverlap(fixtureB, indexB,
+									  fixtureA->m_proxies[indexA].proxyId);
+		}
+		else
+		{
+			int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
+			int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
+			overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+		}
 
 		// Here we destroy contacts that cease to overlap in the broad-phase.
 		if (overlap == false)
@@ -175,17 +221,86 @@ void b2ContactManager::FindNewContacts()
 	m_broadPhase.UpdatePairs(this);
 }
 
+bool b2ContactManager::TestEdgeOverlap(const b2Fixture* chainFixture,
+									   int32 edgeIndex, int32 proxyId) const
+{
+	const b2ChainShape* chain = (const b2ChainShape*)chainFixture->GetShape();
+	b2AABB aabb = b2MulT(chainFixture->GetBody()->GetTransform(),
+						 m_broadPhase.GetFatAABB(proxyId));
+	return b2TestOverlap(chain->GetEdgeFatAABB(edgeIndex), aabb);
+}
+
+// Adds a contact for each edge of a chain with an edge tree which overlaps
+// the other proxy of a pair.
+struct b2EdgeTreePairQuery
+{
+	bool QueryCallback(int32 leafId)
+	{
+		int32 edgeIndex = (int32)(intptr_t)tree->GetUserData(leafId);
+		if (chainIsA)
+		{
+			manager->AddContact(chainFixture, edgeIndex, other->fixture,
+								other->childIndex);
+		}
+		else
+		{
+			manager->AddContact(other->fixture, other->childIndex,
+								chainFixture, edgeIndex);
+		}
+		return true;
+	}
+
+	b2ContactManager* manager;
+	const b2DynamicTree* tree;
+	b2Fixture* chainFixture;
+	const b2FixtureProxy* other;
+	bool chainIsA;
+};
+
 void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 {
 	b2FixtureProxy* proxyA = (b2FixtureProxy*)proxyUserDataA;
 	b2FixtureProxy* proxyB = (b2FixtureProxy*)proxyUserDataB;
 
-	b2Fixture* fixtureA = proxyA->fixture;
-	b2Fixture* fixtureB = proxyB->fixture;
+	const bool edgeTreeA = proxyA->childIndex == b2_edgeTreeChildIndex;
+	const bool edgeTreeB = proxyB->childIndex == b2_edgeTreeChildIndex;
+	if (!edgeTreeA && !edgeTreeB)
+	{
+		AddContact(proxyA->fixture, proxyA->childIndex,
+				   proxyB->fixture, proxyB->childIndex);
+		return;
+	}
+
+	// Chains don't collide with each other.
+	if (edgeTreeA && edgeTreeB)
+	{
+		return;
+	}
+
+	b2EdgeTreePairQuery query;
+	query.manager = this;
+	query.chainFixture = edgeTreeA ? proxyA->fixture : proxyB->fixture;
+	query.other = edgeTreeA ? proxyB : proxyA;
+	query.chainIsA = edgeTreeA;
 
-	int32 indexA = proxyA->childIndex;
-	int32 indexB = proxyB->childIndex;
+	b2Body* chainBody = query.chainFixture->GetBody();
+	b2Body* otherBody = query.other->fixture->GetBody();
+	if (chainBody == otherBody || otherBody->ShouldCollide(chainBody) == false)
+	{
+		return;
+	}
 
+	const b2ChainShape* chain =
+		(const b2ChainShape*)query.chainFixture->GetShape();
+	query.tree = chain->GetEdgeTree();
+	b2AABB aabb = b2MulT(chainBody->GetTransform(),
+						 m_broadPhase.GetFatAABB(query.other->proxyId));
+	query.tree->Query(&query, aabb);
+}
+
+void b2ContactManager::AddContact(b2Fixture* fixtureA, int32 indexA,
+								  b2Fixture* fixtureB, int32 indexB)
+{
 	b2Body* bodyA = fixtureA->GetBody();
 	b2Body* bodyB = fixtureB->GetBody();
 
@@ -258,6 +373,22 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 	}
 	m_contactList = c;
 
+	// Append to the contact array.
+	if (m_contactCount == m_contactCapacity)
+	{
+		b2Contact** oldContacts = m_contacts;
+		int32 oldCapacity = m_contactCapacity;
+		m_contactCapacity = b2Max(2 * m_contactCapacity, b2_minContactCapacity);
+		m_contacts = (b2Contact**)m_allocator->Allocate(m_contactCapacity * sizeof(b2Contact*));
+		if (oldContacts)
+		{
+			memcpy(m_contacts, oldContacts, m_contactCount * sizeof(b2Contact*));
+			m_allocator->Free(oldContacts, oldCapacity * sizeof(b2Contact*));
+		}
+	}
+	c->m_managerIndex = m_contactCount;
+	m_contacts[m_contactCount] = c;
+
 	// Connect to island graph.
 
 	// Connect to body A
@@ -293,3 +424,121 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 
 	++m_contactCount;
 }
+
+void b2ContactManager::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_contactCount);
+	for (int32 i = 0; i < m_contactCount; ++i)
+	{
+		const b2Contact* c = m_contacts[i];
+		const b2Fixture* fixtures[2] = { c->m_fixtureA, c->m_fixtureB };
+		const int32 childIndices[2] = { c->m_indexA, c->m_indexB };
+		for (int32 j = 0; j < 2; ++j)
+		{
+			const b2Body* body = fixtures[j]->m_body;
+			int32 fixtureIndex = 0;
+			for (const b2Fixture* f = body->m_fixtureList; f != fixtures[j];
+				 f = f->m_next)
+			{
+				++fixtureIndex;
+			}
+			writer->Write(body->m_worldIndex);
+			writer->Write(fixtureIndex);
+			writer->Write(childIndices[j]);
+		}
+		c->Save(writer);
+	}
+
+	for (const b2Contact* c = m_contactList; c; c = c->m_next)
+	{
+		writer->Write(c->m_managerIndex);
+	}
+}
+
+void b2ContactManager::Load(b2SnapshotReader* reader, b2Body** bodies,
+							int32 bodyCount)
+{
+	b2Assert(m_contactCount == 0);
+	const int32 contactCount = reader->ReadCount(1);
+	if (contactCount > m_contactCapacity)
+	{
+		if (m_contacts)
+		{
+			m_allocator->Free(m_contacts, m_contactCapacity * sizeof(b2Contact*));
+		}
+		m_contactCapacity = b2Max(contactCount, b2_minContactCapacity);
+		m_contacts = (b2Contact**)m_allocator->Allocate(m_contactCapacity * sizeof(b2Contact*));
+	}
+
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		b2Fixture* fixtures[2];
+		int32 childIndices[2];
+		for (int32 j = 0; j < 2; ++j)
+		{
+			fixtures[j] = b2Body::LoadFixture(reader, bodies, bodyCount);
+			reader->Read(&childIndices[j]);
+			if (fixtures[j] && (childIndices[j] < 0 ||
+				childIndices[j] >= fixtures[j]->m_shape->GetChildCount()))
+			{
+				reader->SetError();
+			}
+		}
+		if (reader->HasError() || fixtures[0]->m_body == fixtures[1]->m_body)
+		{
+			reader->SetError();
+			return;
+		}
+
+		// The fixtures were saved in the order Create() puts them, so they
+		// aren't swapped.
+		b2Contact* c = b2Contact::Create(fixtures[0], childIndices[0],
+										 fixtures[1], childIndices[1],
+										 m_allocator);
+		if (c == NULL)
+		{
+			reader->SetError();
+			return;
+		}
+		c->Load(reader);
+		c->m_managerIndex = i;
+		m_contacts[i] = c;
+		++m_contactCount;
+
+		// b2World::LoadSnapshot() links the nodes to the bodies.
+		c->m_nodeA.contact = c;
+		c->m_nodeB.contact = c;
+		if (c->m_fixtureA != fixtures[0])
+		{
+			reader->SetError();
+			return;
+		}
+	}
+
+	// Rebuild the list back to front, as each contact goes at the head.
+	int32* order = (int32*)b2Alloc(contactCount * sizeof(int32));
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		order[i] = reader->ReadIndex(contactCount);
+	}
+	m_contactList = NULL;
+	for (int32 i = contactCount - 1; i >= 0 && reader->HasError() == false;
+		 --i)
+	{
+		b2Contact* c = m_contacts[order[i]];
+		if (c->m_prev || c == m_contactList)
+		{
+			// Listed twice.
+			reader->SetError();
+			break;
+		}
+		c->m_prev = NULL;
+		c->m_next = m_contactList;
+		if (m_contactList)
+		{
+			m_contactList->m_prev = c;
+		}
+		m_contactList = c;
+	}
+	b2Free(order);
+}
@@ -26,6 +26,10 @@ class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
 class b2ParticleSystem;
+class b2Body;
+class b2Fixture;
+class b2SnapshotWriter;
+class b2SnapshotReader;
 
 // Delegate of b2World.
 class b2ContactManager
@@ -34,19 +38,46 @@ public:
 	friend class b2ParticleSystem;
 
 	b2ContactManager();
+	~b2ContactManager();
 
-	// Broad-phase callback.
+	// Broad-phase callback. A pair with a chain's edge tree proxy adds a
+	// contact for each edge overlapping the other proxy.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
 
+	// Create a contact between two fixture children unless one exists or
+	// filtering rejects it.
+	void AddContact(b2Fixture* fixtureA, int32 indexA,
+					b2Fixture* fixtureB, int32 indexB);
+
+	// Does an edge of a chain with an edge tree overlap a proxy? This is
+	// the test AddPair() finds the edges with.
+	bool TestEdgeOverlap(const b2Fixture* chainFixture, int32 edgeIndex,
+						 int32 proxyId) const;
+
 	void FindNewContacts();
 
 	void Destroy(b2Contact* c);
 
 	void Collide();
+
+	// Write the contacts to a snapshot, with their fixtures as the index of
+	// the body in b2World::m_bodies and of the fixture in the body's list.
+	void Save(b2SnapshotWriter* writer) const;
+
+	// Create the contacts written by Save() in an empty manager. They are
+	// not linked to their bodies. Invalid data flags an error on the
+	// reader, leaving the contacts read so far.
+	void Load(b2SnapshotReader* reader, b2Body** bodies, int32 bodyCount);
             
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
 	int32 m_contactCount;
+	// Pointers to the contacts in a dense array, indexing them for
+	// snapshots and checksums. Destroy() moves the last contact into the
+	// hole, so the order is not the list order; Collide() and the TOI
+	// passes walk the list, since their order changes results.
+	b2Contact** m_contacts;
+	int32 m_contactCapacity;
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
@@ -26,6 +26,7 @@
 #include <Box2D/Collision/b2BroadPhase.h>
 #include <Box2D/Collision/b2Collision.h>
 #include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2Snapshot.h>
 
 b2Fixture::b2Fixture()
 {
@@ -54,9 +55,9 @@ void b2Fixture::Create(b2BlockAllocator* allocator, b2Body* body, const b2Fixtur
 	m_shape = def->shape->Clone(allocator);
 
 	// Reserve proxy space
-	int32 childCount = m_shape->GetChildCount();
-	m_proxies = (b2FixtureProxy*)allocator->Allocate(childCount * sizeof(b2FixtureProxy));
-	for (int32 i = 0; i < childCount; ++i)
+	int32 proxyCapacity = GetProxyCapacity();
+	m_proxies = (b2FixtureProxy*)allocator->Allocate(proxyCapacity * sizeof(b2FixtureProxy));
+	for (int32 i = 0; i < proxyCapacity; ++i)
 	{
 		m_proxies[i].fixture = NULL;
 		m_proxies[i].proxyId = b2BroadPhase::e_nullProxy;
@@ -72,8 +73,7 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 	b2Assert(m_proxyCount == 0);
 
 	// Free the proxy array.
-	int32 childCount = m_shape->GetChildCount();
-	allocator->Free(m_proxies, childCount * sizeof(b2FixtureProxy));
+	allocator->Free(m_proxies, GetProxyCapacity() * sizeof(b2FixtureProxy));
 	m_proxies = NULL;
 
 	// Free the child shape.
@@ -119,20 +119,32 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 	m_shape = NULL;
 }
 
+bool b2Fixture::HasEdgeTree() const
+{
+	return m_shape->m_type == b2Shape::e_chain &&
+		((b2ChainShape*)m_shape)->GetEdgeTree() != NULL;
+}
+
+int32 b2Fixture::GetProxyCapacity() const
+{
+	return HasEdgeTree() ? 1 : m_shape->GetChildCount();
+}
+
 void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 {
 	b2Assert(m_proxyCount == 0);
 
 	// Create proxies in the broad-phase.
-	m_proxyCount = m_shape->GetChildCount();
+	m_proxyCount = GetProxyCapacity();
+	const bool edgeTree = HasEdgeTree();
 
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
 		b2FixtureProxy* proxy = m_proxies + i;
-		m_shape->ComputeAABB(&proxy->aabb, xf, i);
+		proxy->childIndex = edgeTree ? b2_edgeTreeChildIndex : i;
+		m_shape->ComputeAABB(&proxy->aabb, xf, proxy->childIndex);
 		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
 		proxy->fixture = this;
-		proxy->childIndex = i;
 	}
 }
 
@@ -170,6 +182,39 @@ void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transfo
 		b2Vec2 displacement = transform2.p - transform1.p;
 
 		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+		if (proxy->childIndex == b2_edgeTreeChildIndex)
+		{
+			// Edges may have moved onto fixtures already paired with the
+			// chain, so look for new contacts.
+			broadPhase->TouchProxy(proxy->proxyId);
+		}
+	}
+}
+
+void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2,
+							const b2Transform& transform3)
+{
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		b2FixtureProxy* proxy = m_proxies + i;
+
+		// Compute an AABB that covers the swept shape and its predicted
+		// motion (may miss some rotation effect).
+		b2AABB aabb1, aabb2, aabb3;
+		m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
+		m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
+		m_shape->ComputeAABB(&aabb3, transform3, proxy->childIndex);
+
+		proxy->aabb.Combine(aabb1, aabb2);
+		proxy->aabb.Combine(aabb3);
+
+		b2Vec2 displacement = transform3.p - transform1.p;
+
+		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+		if (proxy->childIndex == b2_edgeTreeChildIndex)
+		{
+			broadPhase->TouchProxy(proxy->proxyId);
+		}
 	}
 }
 
@@ -226,6 +271,194 @@ void b2Fixture::SetSensor(bool sensor)
 	}
 }
 
+void b2Fixture::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_density);
+	writer->Write(m_friction);
+	writer->Write(m_restitution);
+	writer->Write(m_filter);
+	writer->Write(m_isSensor);
+	writer->WritePointer(m_userData);
+
+	writer->Write(m_shape->m_type);
+	writer->Write(m_shape->m_radius);
+	switch (m_shape->m_type)
+	{
+	case b2Shape::e_circle:
+		{
+			const b2CircleShape* s = (const b2CircleShape*)m_shape;
+			writer->Write(s->m_p);
+		}
+		break;
+
+	case b2Shape::e_edge:
+		{
+			const b2EdgeShape* s = (const b2EdgeShape*)m_shape;
+			writer->Write(s->m_vertex0);
+			writer->Write(s->m_vertex1);
+			writer->Write(s->m_vertex2);
+			writer->Write(s->m_vertex3);
+			writer->Write(s->m_hasVertex0);
+			writer->Write(s->m_hasVertex3);
+		}
+		break;
+
+	case b2Shape::e_polygon:
+		{
+			const b2PolygonShape* s = (const b2PolygonShape*)m_shape;
+			writer->Write(s->m_centroid);
+			writer->Write(s->m_count);
+			writer->WriteArray(s->m_vertices, s->m_count);
+			writer->WriteArray(s->m_normals, s->m_count);
+		}
+		break;
+
+	case b2Shape::e_chain:
+		{
+			const b2ChainShape* s = (const b2ChainShape*)m_shape;
+			writer->Write(s->m_count);
+			writer->WriteArray(s->m_vertices, s->m_count);
+			writer->Write(s->m_prevVertex);
+			writer->Write(s->m_nextVertex);
+			writer->Write(s->m_hasPrevVertex);
+			writer->Write(s->m_hasNextVertex);
+			writer->Write(s->IsEdgeTreeEnabled());
+		}
+		break;
+
+	default:
+		b2Assert(false);
+		break;
+	}
+
+	writer->Write(m_proxyCount);
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		writer->Write(m_proxies[i].aabb);
+		writer->Write(m_proxies[i].proxyId);
+	}
+}
+
+bool b2Fixture::Load(b2SnapshotReader* reader, b2BlockAllocator* allocator, b2Body* body)
+{
+	b2FixtureDef def;
+	reader->Read(&def.density);
+	reader->Read(&def.friction);
+	reader->Read(&def.restitution);
+	reader->Read(&def.filter);
+	reader->Read(&def.isSensor);
+	def.userData = reader->ReadPointer();
+
+	// The shape is read into a local one, which Create() clones. Its type
+	// is read as an integer, as it isn't a b2Shape::Type until the switch
+	// has checked it.
+	const int32 type = reader->Read<int32>();
+	const float32 radius = reader->Read<float32>();
+	switch (type)
+	{
+	case b2Shape::e_circle:
+		{
+			b2CircleShape s;
+			s.m_radius = radius;
+			reader->Read(&s.m_p);
+			def.shape = &s;
+			Create(allocator, body, &def);
+		}
+		break;
+
+	case b2Shape::e_edge:
+		{
+			b2EdgeShape s;
+			s.m_radius = radius;
+			reader->Read(&s.m_vertex0);
+			reader->Read(&s.m_vertex1);
+			reader->Read(&s.m_vertex2);
+			reader->Read(&s.m_vertex3);
+			reader->Read(&s.m_hasVertex0);
+			reader->Read(&s.m_hasVertex3);
+			def.shape = &s;
+			Create(allocator, body, &def);
+		}
+		break;
+
+	case b2Shape::e_polygon:
+		{
+			b2PolygonShape s;
+			s.m_radius = radius;
+			reader->Read(&s.m_centroid);
+			reader->Read(&s.m_count);
+			if (s.m_count < 3 || s.m_count > b2_maxPolygonVertices)
+			{
+				reader->SetError();
+				return false;
+			}
+			reader->ReadArray(s.m_vertices, s.m_count);
+			reader->ReadArray(s.m_normals, s.m_count);
+			s.UpdateSoa();
+			def.shape = &s;
+			Create(allocator, body, &def);
+		}
+		break;
+
+	case b2Shape::e_chain:
+		{
+			const int32 count = reader->ReadCount(sizeof(b2Vec2));
+			if (count < 2)
+			{
+				reader->SetError();
+				return false;
+			}
+			b2Vec2* vertices = (b2Vec2*)b2Alloc(count * sizeof(b2Vec2));
+			reader->ReadArray(vertices, count);
+			for (int32 i = 1; i < count; ++i)
+			{
+				// CreateChain() asserts on vertices this close.
+				if (b2DistanceSquared(vertices[i - 1], vertices[i]) <=
+					b2_linearSlop * b2_linearSlop)
+				{
+					b2Free(vertices);
+					reader->SetError();
+					return false;
+				}
+			}
+			b2ChainShape s;
+			s.CreateChain(vertices, count);
+			b2Free(vertices);
+			s.m_radius = radius;
+			reader->Read(&s.m_prevVertex);
+			reader->Read(&s.m_nextVertex);
+			reader->Read(&s.m_hasPrevVertex);
+			reader->Read(&s.m_hasNextVertex);
+			s.SetEdgeTree(reader->Read<bool>());
+			def.shape = &s;
+			Create(allocator, body, &def);
+		}
+		break;
+
+	default:
+		reader->SetError();
+		return false;
+	}
+
+	reader->Read(&m_proxyCount);
+	if (m_proxyCount != 0 && m_proxyCount != GetProxyCapacity())
+	{
+		m_proxyCount = 0;
+		reader->SetError();
+		return true;
+	}
+	const bool edgeTree = HasEdgeTree();
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		b2FixtureProxy* proxy = m_proxies + i;
+		reader->Read(&proxy->aabb);
+		reader->Read(&proxy->proxyId);
+		proxy->fixture = this;
+		proxy->childIndex = edgeTree ? b2_edgeTreeChildIndex : i;
+	}
+	return true;
+}
+
 void b2Fixture::Dump(int32 bodyIndex)
 {
 	b2Log("    b2FixtureDef fd;\n");
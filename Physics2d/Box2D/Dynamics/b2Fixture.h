@@ -28,6 +28,8 @@ class b2BlockAllocator;
 class b2Body;
 class b2BroadPhase;
 class b2Fixture;
+class b2SnapshotWriter;
+class b2SnapshotReader;
 
 /// This holds contact filtering data.
 struct b2Filter
@@ -194,7 +196,8 @@ public:
 
 	/// Get the fixture's AABB. This AABB may be enlarge and/or stale.
 	/// If you need a more accurate AABB, compute it using the shape and
-	/// the body transform.
+	/// the body transform. A chain with an edge tree only has the AABB of
+	/// the whole chain, at index 0.
 	const b2AABB& GetAABB(int32 childIndex) const;
 
 	/// Dump this fixture to the log file.
@@ -214,12 +217,32 @@ protected:
 	void Create(b2BlockAllocator* allocator, b2Body* body, const b2FixtureDef* def);
 	void Destroy(b2BlockAllocator* allocator);
 
+	// Write the fixture and its shape to a snapshot.
+	void Save(b2SnapshotWriter* writer) const;
+
+	// Create a fixture written by Save(). The proxies keep the ids they were
+	// saved with, so they are only valid in the broad-phase saved with them.
+	// Invalid data flags an error on the reader. Returns false, creating
+	// nothing, if the shape couldn't be read.
+	bool Load(b2SnapshotReader* reader, b2BlockAllocator* allocator, b2Body* body);
+
+	// Does the shape keep its own tree over its children? Such fixtures
+	// have a single proxy. See b2ChainShape::SetEdgeTree().
+	bool HasEdgeTree() const;
+
+	// Get the number of proxies the fixture has while its body is active.
+	int32 GetProxyCapacity() const;
+
 	// These support body activation/deactivation.
 	void CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf);
 	void DestroyProxies(b2BroadPhase* broadPhase);
 
 	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
 
+	// Also covers xf3, where the body is predicted to be next step.
+	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2,
+					 const b2Transform& xf3);
+
 	float32 m_density;
 
 	b2Fixture* m_next;
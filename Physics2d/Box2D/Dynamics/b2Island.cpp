@@ -25,7 +25,44 @@
 #include <Box2D/Dynamics/Contacts/b2ContactSolver.h>
 #include <Box2D/Dynamics/Joints/b2Joint.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <Box2D/Common/b2FrameArena.h>
 #include <Box2D/Common/b2Timer.h>
+#include <Box2D/Common/b2Trace.h>
+
+#include <string.h>
+
+// Most colors the constraints of an island are split into. Constraints that
+// don't fit in these are solved serially after the colored ones.
+static const int32 b2_maxGraphColors = 64;
+
+// Fewest constraints of a color a thread takes at once.
+static const int32 b2_minColorRange = 16;
+
+// The constraints of an island grouped by color. The constraints of a color
+// share no bodies, so they can be solved in any order or at once, except
+// that contacts may share static and kinematic bodies since the contact
+// solver leaves those untouched. Group b2_maxGraphColors holds the
+// constraints that didn't get a color and all gear joints.
+struct b2ConstraintColoring
+{
+	b2ContactSolver* contactSolver;
+	b2SolverData* solverData;
+
+	// Contact indices and joints, grouped by color. Color c has the
+	// contacts [contactStarts[c], contactStarts[c + 1]), and likewise for
+	// joints.
+	int32* contacts;
+	b2Joint** joints;
+	int32 contactStarts[b2_maxGraphColors + 2];
+	int32 jointStarts[b2_maxGraphColors + 2];
+	int32 colorCount;
+
+	// The color and pass being solved by SolveColorRange().
+	int32 color;
+	bool solvePositions;
+	std::atomic<bool> positionsOkay;
+};
 
 /*
 Position Correction Notes
@@ -149,8 +186,16 @@ b2Island::b2Island(
 	int32 bodyCapacity,
 	int32 contactCapacity,
 	int32 jointCapacity,
+	b2Position* positions,
+	b2Velocity* velocities,
+	const b2Force* forces,
+	const b2InverseMass* inverseMasses,
+	b2FrameArena* arena,
 	b2StackAllocator* allocator,
-	b2ContactListener* listener)
+	b2ContactListener* listener,
+	b2TaskExecutor* taskExecutor,
+	int32 coloringThreshold,
+	bool deterministic)
 {
 	m_bodyCapacity = bodyCapacity;
 	m_contactCapacity = contactCapacity;
@@ -161,27 +206,27 @@ b2Island::b2Island(
 
 	m_allocator = allocator;
 	m_listener = listener;
-
-	m_bodies = (b2Body**)m_allocator->Allocate(bodyCapacity * sizeof(b2Body*));
-	m_contacts = (b2Contact**)m_allocator->Allocate(contactCapacity	 * sizeof(b2Contact*));
-	m_joints = (b2Joint**)m_allocator->Allocate(jointCapacity * sizeof(b2Joint*));
-
-	m_velocities = (b2Velocity*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Velocity));
-	m_positions = (b2Position*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Position));
-}
-
-b2Island::~b2Island()
-{
-	// Warning: the order should reverse the constructor order.
-	m_allocator->Free(m_positions);
-	m_allocator->Free(m_velocities);
-	m_allocator->Free(m_joints);
-	m_allocator->Free(m_contacts);
-	m_allocator->Free(m_bodies);
+	m_taskExecutor = taskExecutor;
+	m_coloringThreshold = coloringThreshold;
+	m_deterministic = deterministic;
+
+	// The island's arrays last until the end of the step. The contact
+	// solver's scratch comes from the stack allocator.
+	m_bodies = (b2Body**)arena->Allocate(bodyCapacity * sizeof(b2Body*));
+	m_contacts = (b2Contact**)arena->Allocate(contactCapacity	 * sizeof(b2Contact*));
+	m_joints = (b2Joint**)arena->Allocate(jointCapacity * sizeof(b2Joint*));
+
+	// Bodies are solved where they sit in the world's arrays, so the
+	// constraints index them by b2Body::m_worldIndex.
+	m_positions = positions;
+	m_velocities = velocities;
+	m_forces = forces;
+	m_inverseMasses = inverseMasses;
 }
 
 void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep)
 {
+	b2TraceZone("b2Island::Solve");
 	b2Timer timer;
 
 	float32 h = step.dt;
@@ -190,21 +235,25 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* b = m_bodies[i];
-
-		b2Vec2 c = b->m_sweep.c;
-		float32 a = b->m_sweep.a;
-		b2Vec2 v = b->m_linearVelocity;
-		float32 w = b->m_angularVelocity;
+		int32 index = b->m_worldIndex;
 
 		// Store positions for continuous collision.
 		b->m_sweep.c0 = b->m_sweep.c;
 		b->m_sweep.a0 = b->m_sweep.a;
 
+		m_positions[index].c = b->m_sweep.c;
+		m_positions[index].a = b->m_sweep.a;
+
 		if (b->m_type == b2_dynamicBody)
 		{
+			b2Vec2 v = m_velocities[index].v;
+			float32 w = m_velocities[index].w;
+			const b2Force& force = m_forces[index];
+			const b2InverseMass& inverseMass = m_inverseMasses[index];
+
 			// Integrate velocities.
-			v += h * (b->m_gravityScale * gravity + b->m_invMass * b->m_force);
-			w += h * b->m_invI * b->m_torque;
+			v += h * (b->m_gravityScale * gravity + inverseMass.invMass * force.force);
+			w += h * inverseMass.invI * force.torque;
 
 			// Apply damping.
 			// ODE: dv/dt + c * v = 0
@@ -215,12 +264,10 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			// v2 = v1 * 1 / (1 + c * dt)
 			v *= 1.0f / (1.0f + h * b->m_linearDamping);
 			w *= 1.0f / (1.0f + h * b->m_angularDamping);
-		}
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+			m_velocities[index].v = v;
+			m_velocities[index].w = w;
+		}
 	}
 
 	timer.Reset();
@@ -230,14 +277,21 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	solverData.step = step;
 	solverData.positions = m_positions;
 	solverData.velocities = m_velocities;
+	solverData.inverseMasses = m_inverseMasses;
 
 	// Initialize velocity constraints.
+	if (step.batchJoints)
+	{
+		SortJointsByType();
+	}
+
 	b2ContactSolverDef contactSolverDef;
 	contactSolverDef.step = step;
 	contactSolverDef.contacts = m_contacts;
 	contactSolverDef.count = m_contactCount;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.inverseMasses = m_inverseMasses;
 	contactSolverDef.allocator = m_allocator;
 
 	b2ContactSolver contactSolver(&contactSolverDef);
@@ -247,10 +301,19 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	{
 		contactSolver.WarmStart();
 	}
-	
-	for (int32 i = 0; i < m_jointCount; ++i)
+
+	b2Joint::Solve(m_joints, m_jointCount, solverData,
+				   b2Joint::e_initVelocityPass);
+
+	// Large islands are solved a color at a time, in parallel.
+	b2ConstraintColoring coloring;
+	const bool colored = (m_taskExecutor || m_deterministic) &&
+		m_contactCount + m_jointCount >= m_coloringThreshold;
+	if (colored)
 	{
-		m_joints[i]->InitVelocityConstraints(solverData);
+		coloring.contactSolver = &contactSolver;
+		coloring.solverData = &solverData;
+		ColorConstraints(&coloring);
 	}
 
 	profile->solveInit = timer.GetMilliseconds();
@@ -259,11 +322,15 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	timer.Reset();
 	for (int32 i = 0; i < step.velocityIterations; ++i)
 	{
-		for (int32 j = 0; j < m_jointCount; ++j)
+		if (colored)
 		{
-			m_joints[j]->SolveVelocityConstraints(solverData);
+			SolveColored(&coloring, b2Joint::e_solveVelocityPass);
+			continue;
 		}
 
+		b2Joint::Solve(m_joints, m_jointCount, solverData,
+					   b2Joint::e_solveVelocityPass);
+
 		contactSolver.SolveVelocityConstraints();
 	}
 
@@ -274,10 +341,11 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	// Integrate positions
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Vec2 c = m_positions[i].c;
-		float32 a = m_positions[i].a;
-		b2Vec2 v = m_velocities[i].v;
-		float32 w = m_velocities[i].w;
+		int32 index = m_bodies[i]->m_worldIndex;
+		b2Vec2 c = m_positions[index].c;
+		float32 a = m_positions[index].a;
+		b2Vec2 v = m_velocities[index].v;
+		float32 w = m_velocities[index].w;
 
 		// Check for large velocities
 		b2Vec2 translation = h * v;
@@ -298,10 +366,10 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		c += h * v;
 		a += h * w;
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		m_positions[index].c = c;
+		m_positions[index].a = a;
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
 	}
 
 	// Solve position constraints
@@ -309,13 +377,19 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	bool positionSolved = false;
 	for (int32 i = 0; i < step.positionIterations; ++i)
 	{
-		bool contactsOkay = contactSolver.SolvePositionConstraints();
-
-		bool jointsOkay = true;
-		for (int32 i = 0; i < m_jointCount; ++i)
+		bool contactsOkay;
+		bool jointsOkay;
+		if (colored)
+		{
+			contactsOkay = SolveColored(&coloring,
+										b2Joint::e_solvePositionPass);
+			jointsOkay = true;
+		}
+		else
 		{
-			bool jointOkay = m_joints[i]->SolvePositionConstraints(solverData);
-			jointsOkay = jointsOkay && jointOkay;
+			contactsOkay = contactSolver.SolvePositionConstraints();
+			jointsOkay = b2Joint::Solve(m_joints, m_jointCount, solverData,
+										b2Joint::e_solvePositionPass);
 		}
 
 		if (contactsOkay && jointsOkay)
@@ -326,14 +400,19 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		}
 	}
 
-	// Copy state buffers back to the bodies
+	if (colored)
+	{
+		FreeColoring(&coloring);
+	}
+
+	// Copy the positions back to the bodies. The velocities are already
+	// in place.
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* body = m_bodies[i];
-		body->m_sweep.c = m_positions[i].c;
-		body->m_sweep.a = m_positions[i].a;
-		body->m_linearVelocity = m_velocities[i].v;
-		body->m_angularVelocity = m_velocities[i].w;
+		int32 index = body->m_worldIndex;
+		body->m_sweep.c = m_positions[index].c;
+		body->m_sweep.a = m_positions[index].a;
 		body->SynchronizeTransform();
 	}
 
@@ -356,9 +435,10 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 				continue;
 			}
 
+			const b2Velocity& velocity = m_velocities[b->m_worldIndex];
 			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+				velocity.w * velocity.w > angTolSqr ||
+				b2Dot(velocity.v, velocity.v) > linTolSqr)
 			{
 				b->m_sleepTime = 0.0f;
 				minSleepTime = 0.0f;
@@ -383,17 +463,22 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 
 void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB)
 {
+	b2TraceZone("b2Island::SolveTOI");
 	b2Assert(toiIndexA < m_bodyCount);
 	b2Assert(toiIndexB < m_bodyCount);
 
-	// Initialize the body state.
+	// The constraints refer to bodies by their index in the world.
+	b2Body* toiBodyA = m_bodies[toiIndexA];
+	b2Body* toiBodyB = m_bodies[toiIndexB];
+	toiIndexA = toiBodyA->m_worldIndex;
+	toiIndexB = toiBodyB->m_worldIndex;
+
+	// Initialize the body positions. The velocities are already in place.
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* b = m_bodies[i];
-		m_positions[i].c = b->m_sweep.c;
-		m_positions[i].a = b->m_sweep.a;
-		m_velocities[i].v = b->m_linearVelocity;
-		m_velocities[i].w = b->m_angularVelocity;
+		m_positions[b->m_worldIndex].c = b->m_sweep.c;
+		m_positions[b->m_worldIndex].a = b->m_sweep.a;
 	}
 
 	b2ContactSolverDef contactSolverDef;
@@ -403,6 +488,7 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 	contactSolverDef.step = subStep;
 	contactSolverDef.positions = m_positions;
 	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.inverseMasses = m_inverseMasses;
 	b2ContactSolver contactSolver(&contactSolverDef);
 
 	// Solve position constraints.
@@ -449,10 +535,10 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 #endif
 
 	// Leap of faith to new safe state.
-	m_bodies[toiIndexA]->m_sweep.c0 = m_positions[toiIndexA].c;
-	m_bodies[toiIndexA]->m_sweep.a0 = m_positions[toiIndexA].a;
-	m_bodies[toiIndexB]->m_sweep.c0 = m_positions[toiIndexB].c;
-	m_bodies[toiIndexB]->m_sweep.a0 = m_positions[toiIndexB].a;
+	toiBodyA->m_sweep.c0 = m_positions[toiIndexA].c;
+	toiBodyA->m_sweep.a0 = m_positions[toiIndexA].a;
+	toiBodyB->m_sweep.c0 = m_positions[toiIndexB].c;
+	toiBodyB->m_sweep.a0 = m_positions[toiIndexB].a;
 
 	// No warm starting is needed for TOI events because warm
 	// starting impulses were applied in the discrete solver.
@@ -472,10 +558,11 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 	// Integrate positions
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Vec2 c = m_positions[i].c;
-		float32 a = m_positions[i].a;
-		b2Vec2 v = m_velocities[i].v;
-		float32 w = m_velocities[i].w;
+		int32 index = m_bodies[i]->m_worldIndex;
+		b2Vec2 c = m_positions[index].c;
+		float32 a = m_positions[index].a;
+		b2Vec2 v = m_velocities[index].v;
+		float32 w = m_velocities[index].w;
 
 		// Check for large velocities
 		b2Vec2 translation = h * v;
@@ -496,17 +583,15 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 		c += h * v;
 		a += h * w;
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		m_positions[index].c = c;
+		m_positions[index].a = a;
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
 
 		// Sync bodies
 		b2Body* body = m_bodies[i];
 		body->m_sweep.c = c;
 		body->m_sweep.a = a;
-		body->m_linearVelocity = v;
-		body->m_angularVelocity = w;
 		body->SynchronizeTransform();
 	}
 
@@ -524,6 +609,12 @@ void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 	{
 		b2Contact* c = m_contacts[i];
 
+		// Speculative contacts report once the shapes touch.
+		if (c->IsTouching() == false)
+		{
+			continue;
+		}
+
 		const b2ContactVelocityConstraint* vc = constraints + i;
 		
 		b2ContactImpulse impulse;
@@ -537,3 +628,229 @@ void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 		m_listener->PostSolve(c, &impulse);
 	}
 }
+
+void b2Island::SortJointsByType()
+{
+	if (m_jointCount < 2)
+	{
+		return;
+	}
+
+	// Counting sort, which is stable.
+	int32 offsets[b2_jointTypeCount + 1];
+	memset(offsets, 0, sizeof(offsets));
+	for (int32 i = 0; i < m_jointCount; ++i)
+	{
+		++offsets[m_joints[i]->m_type + 1];
+	}
+	if (offsets[m_joints[0]->m_type + 1] == m_jointCount)
+	{
+		// All joints are of the same type.
+		return;
+	}
+	for (int32 i = 1; i <= b2_jointTypeCount; ++i)
+	{
+		offsets[i] += offsets[i - 1];
+	}
+
+	b2Joint** sorted =
+		(b2Joint**)m_allocator->Allocate(m_jointCount * sizeof(b2Joint*));
+	for (int32 i = 0; i < m_jointCount; ++i)
+	{
+		sorted[offsets[m_joints[i]->m_type]++] = m_joints[i];
+	}
+	memcpy(m_joints, sorted, m_jointCount * sizeof(b2Joint*));
+	m_allocator->Free(sorted);
+}
+
+void b2Island::ColorConstraints(b2ConstraintColoring* coloring)
+{
+	coloring->contacts =
+		(int32*)m_allocator->Allocate(m_contactCount * sizeof(int32));
+	coloring->joints =
+		(b2Joint**)m_allocator->Allocate(m_jointCount * sizeof(b2Joint*));
+	uint64* bodyColors =
+		(uint64*)m_allocator->Allocate(m_bodyCount * sizeof(uint64));
+	int32* contactColors =
+		(int32*)m_allocator->Allocate(m_contactCount * sizeof(int32));
+	int32* jointColors =
+		(int32*)m_allocator->Allocate(m_jointCount * sizeof(int32));
+	memset(bodyColors, 0, m_bodyCount * sizeof(uint64));
+	memset(coloring->contactStarts, 0, sizeof(coloring->contactStarts));
+	memset(coloring->jointStarts, 0, sizeof(coloring->jointStarts));
+
+	// Greedily give each constraint the lowest color not yet used by its
+	// bodies. A contact doesn't claim a color on a body which can't move,
+	// so all the contacts on the ground can share a color. Joints write
+	// both their bodies, so they always claim both, and are colored first
+	// so that contacts avoid the colors of joints on a shared static body.
+	// A gear joint also writes the bodies of its two driving joints, which
+	// need not even be in this island, so gear joints always go in the
+	// serial group.
+	int32 colorCount = 0;
+	for (int32 i = 0; i < m_jointCount + m_contactCount; ++i)
+	{
+		b2Body* bodyA;
+		b2Body* bodyB;
+		if (i < m_jointCount)
+		{
+			bodyA = m_joints[i]->m_bodyA;
+			bodyB = m_joints[i]->m_bodyB;
+		}
+		else
+		{
+			b2Contact* contact = m_contacts[i - m_jointCount];
+			bodyA = contact->GetFixtureA()->GetBody();
+			bodyB = contact->GetFixtureB()->GetBody();
+		}
+		const bool isJoint = i < m_jointCount;
+		const bool claimA = isJoint || bodyA->m_type == b2_dynamicBody;
+		const bool claimB = isJoint || bodyB->m_type == b2_dynamicBody;
+
+		const uint64 used = bodyColors[bodyA->m_islandIndex] |
+			bodyColors[bodyB->m_islandIndex];
+		int32 color = isJoint && m_joints[i]->m_type == e_gearJoint ?
+			b2_maxGraphColors : 0;
+		while (color < b2_maxGraphColors && (used & ((uint64)1 << color)))
+		{
+			++color;
+		}
+		if (color < b2_maxGraphColors)
+		{
+			if (claimA)
+			{
+				bodyColors[bodyA->m_islandIndex] |= (uint64)1 << color;
+			}
+			if (claimB)
+			{
+				bodyColors[bodyB->m_islandIndex] |= (uint64)1 << color;
+			}
+			colorCount = b2Max(colorCount, color + 1);
+		}
+
+		if (isJoint)
+		{
+			jointColors[i] = color;
+			++coloring->jointStarts[color + 1];
+		}
+		else
+		{
+			contactColors[i - m_jointCount] = color;
+			++coloring->contactStarts[color + 1];
+		}
+	}
+	coloring->colorCount = colorCount;
+
+	// Group the constraints by color, keeping the island order within a
+	// color so joints sorted by type stay batched for b2Joint::Solve().
+	for (int32 c = 1; c <= b2_maxGraphColors + 1; ++c)
+	{
+		coloring->contactStarts[c] += coloring->contactStarts[c - 1];
+		coloring->jointStarts[c] += coloring->jointStarts[c - 1];
+	}
+	for (int32 i = 0; i < m_contactCount; ++i)
+	{
+		coloring->contacts[coloring->contactStarts[contactColors[i]]++] = i;
+	}
+	for (int32 i = 0; i < m_jointCount; ++i)
+	{
+		coloring->joints[coloring->jointStarts[jointColors[i]]++] =
+			m_joints[i];
+	}
+	// The fills above advanced each start to the next color's start.
+	for (int32 c = b2_maxGraphColors + 1; c > 0; --c)
+	{
+		coloring->contactStarts[c] = coloring->contactStarts[c - 1];
+		coloring->jointStarts[c] = coloring->jointStarts[c - 1];
+	}
+	coloring->contactStarts[0] = 0;
+	coloring->jointStarts[0] = 0;
+
+	m_allocator->Free(jointColors);
+	m_allocator->Free(contactColors);
+	m_allocator->Free(bodyColors);
+}
+
+void b2Island::FreeColoring(b2ConstraintColoring* coloring)
+{
+	m_allocator->Free(coloring->joints);
+	m_allocator->Free(coloring->contacts);
+}
+
+bool b2Island::SolveColored(b2ConstraintColoring* coloring,
+							b2Joint::SolverPass pass)
+{
+	b2Assert(pass == b2Joint::e_solveVelocityPass ||
+			 pass == b2Joint::e_solvePositionPass);
+	coloring->solvePositions = pass == b2Joint::e_solvePositionPass;
+	coloring->positionsOkay.store(true, std::memory_order_relaxed);
+	for (int32 c = 0; c < coloring->colorCount; ++c)
+	{
+		const int32 count =
+			coloring->jointStarts[c + 1] - coloring->jointStarts[c] +
+			coloring->contactStarts[c + 1] - coloring->contactStarts[c];
+		coloring->color = c;
+		if (m_taskExecutor)
+		{
+			m_taskExecutor->ParallelFor(&b2Island::SolveColorRange, coloring,
+										count, b2_minColorRange);
+		}
+		else
+		{
+			SolveColorRange(coloring, 0, count);
+		}
+	}
+
+	// Solve the constraints which didn't get a color.
+	coloring->color = b2_maxGraphColors;
+	const int32 count =
+		coloring->jointStarts[b2_maxGraphColors + 1] -
+		coloring->jointStarts[b2_maxGraphColors] +
+		coloring->contactStarts[b2_maxGraphColors + 1] -
+		coloring->contactStarts[b2_maxGraphColors];
+	SolveColorRange(coloring, 0, count);
+
+	return coloring->positionsOkay.load(std::memory_order_relaxed);
+}
+
+void b2Island::SolveColorRange(void* context, int32 begin, int32 end)
+{
+	b2ConstraintColoring* coloring = (b2ConstraintColoring*)context;
+	const int32 color = coloring->color;
+
+	// The range indexes the color's joints followed by its contacts. As in
+	// the serial solver, velocities are solved joints first and positions
+	// contacts first.
+	const int32 jointStart = coloring->jointStarts[color];
+	const int32 jointCount = coloring->jointStarts[color + 1] - jointStart;
+	const int32 jointBegin = b2Min(begin, jointCount);
+	const int32 jointEnd = b2Min(end, jointCount);
+	const int32 contactBegin = b2Max(begin - jointCount, 0);
+	const int32 contactEnd = b2Max(end - jointCount, 0);
+	b2Joint** joints = coloring->joints + jointStart + jointBegin;
+	const int32* contacts = coloring->contacts +
+		coloring->contactStarts[color] + contactBegin;
+
+	bool okay = true;
+	if (coloring->solvePositions)
+	{
+		bool contactsOkay = coloring->contactSolver->SolvePositionConstraints(
+			contacts, contactEnd - contactBegin);
+		bool jointsOkay = b2Joint::Solve(joints, jointEnd - jointBegin,
+										 *coloring->solverData,
+										 b2Joint::e_solvePositionPass);
+		okay = contactsOkay && jointsOkay;
+	}
+	else
+	{
+		b2Joint::Solve(joints, jointEnd - jointBegin, *coloring->solverData,
+					   b2Joint::e_solveVelocityPass);
+		coloring->contactSolver->SolveVelocityConstraints(
+			contacts, contactEnd - contactBegin);
+	}
+
+	if (!okay)
+	{
+		coloring->positionsOkay.store(false, std::memory_order_relaxed);
+	}
+}
@@ -22,21 +22,29 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Dynamics/b2Body.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
+#include <Box2D/Dynamics/Joints/b2Joint.h>
 
 class b2Contact;
-class b2Joint;
 class b2StackAllocator;
+class b2FrameArena;
 class b2ContactListener;
+class b2ContactSolver;
+class b2TaskExecutor;
 struct b2ContactVelocityConstraint;
 struct b2Profile;
+struct b2SolverData;
+struct b2ConstraintColoring;
 
 /// This is an internal class.
 class b2Island
 {
 public:
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
-			b2StackAllocator* allocator, b2ContactListener* listener);
-	~b2Island();
+			b2Position* positions, b2Velocity* velocities,
+			const b2Force* forces, const b2InverseMass* inverseMasses,
+			b2FrameArena* arena, b2StackAllocator* allocator,
+			b2ContactListener* listener, b2TaskExecutor* taskExecutor,
+			int32 coloringThreshold, bool deterministic);
 
 	void Clear()
 	{
@@ -57,6 +65,18 @@ public:
 		++m_bodyCount;
 	}
 
+	// Add a static body reached by the island's constraints, unless it
+	// was already added.
+	void AddStatic(b2Body* body)
+	{
+		if (body->m_type == b2_staticBody &&
+			(body->m_flags & b2Body::e_islandFlag) == 0)
+		{
+			body->m_flags |= b2Body::e_islandFlag;
+			Add(body);
+		}
+	}
+
 	void Add(b2Contact* contact)
 	{
 		b2Assert(m_contactCount < m_contactCapacity);
@@ -71,15 +91,43 @@ public:
 
 	void Report(const b2ContactVelocityConstraint* constraints);
 
+	// Group the joints by type, keeping their order within each type, so
+	// that b2Joint::Solve() can solve each type as one batch.
+	void SortJointsByType();
+
+	// Split the contacts and joints into colors whose constraints share no
+	// dynamic bodies, so that each color can be solved in parallel.
+	void ColorConstraints(b2ConstraintColoring* coloring);
+	void FreeColoring(b2ConstraintColoring* coloring);
+
+	// Run a solver pass over the colored constraints, one color at a time.
+	// Returns true if the position errors are within tolerance.
+	bool SolveColored(b2ConstraintColoring* coloring,
+					  b2Joint::SolverPass pass);
+
+	// Solve a range of the constraints of the current color.
+	static void SolveColorRange(void* context, int32 begin, int32 end);
+
 	b2StackAllocator* m_allocator;
 	b2ContactListener* m_listener;
 
+	// Solves islands of at least m_coloringThreshold constraints in
+	// parallel. NULL solves every island serially.
+	b2TaskExecutor* m_taskExecutor;
+	int32 m_coloringThreshold;
+	// Color islands even without an executor, so that the solve order
+	// doesn't depend on whether there is one.
+	bool m_deterministic;
+
 	b2Body** m_bodies;
 	b2Contact** m_contacts;
 	b2Joint** m_joints;
 
+	// The world's solver state, indexed by b2Body::m_worldIndex.
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
+	const b2Force* m_forces;
+	const b2InverseMass* m_inverseMasses;
 
 	int32 m_bodyCount;
 	int32 m_jointCount;
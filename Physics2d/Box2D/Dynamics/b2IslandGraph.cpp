@@ -0,0 +1,682 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <Box2D/Dynamics/b2IslandGraph.h>
+#include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Dynamics/Contacts/b2Contact.h>
+#include <Box2D/Dynamics/Joints/b2Joint.h>
+#include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Common/b2Snapshot.h>
+
+b2IslandGraph::b2IslandGraph()
+{
+	m_allocator = NULL;
+	m_awakeList = NULL;
+	m_pendingList = NULL;
+}
+
+b2PersistentIsland* b2IslandGraph::CreateIsland()
+{
+	b2PersistentIsland* island = (b2PersistentIsland*)m_allocator->Allocate(
+		sizeof(b2PersistentIsland));
+	island->parent = NULL;
+	island->nextPending = NULL;
+	island->bodyList = NULL;
+	island->contactList = NULL;
+	island->jointList = NULL;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->jointCount = 0;
+	island->constraintRemoveCount = 0;
+	island->prev = NULL;
+	island->next = NULL;
+	island->awake = false;
+	island->index = -1;
+	return island;
+}
+
+void b2IslandGraph::DestroyIsland(b2PersistentIsland* island)
+{
+	SleepIsland(island);
+	m_allocator->Free(island, sizeof(b2PersistentIsland));
+}
+
+template <typename T>
+void b2IslandGraph::AddToList(T** list, T* item, b2PersistentIsland* island)
+{
+	item->m_island = island;
+	item->m_islandPrev = NULL;
+	item->m_islandNext = *list;
+	if (*list)
+	{
+		(*list)->m_islandPrev = item;
+	}
+	*list = item;
+}
+
+template <typename T>
+void b2IslandGraph::RemoveFromList(T** list, T* item)
+{
+	if (item->m_islandPrev)
+	{
+		item->m_islandPrev->m_islandNext = item->m_islandNext;
+	}
+	if (item->m_islandNext)
+	{
+		item->m_islandNext->m_islandPrev = item->m_islandPrev;
+	}
+	if (*list == item)
+	{
+		*list = item->m_islandNext;
+	}
+	item->m_island = NULL;
+	item->m_islandPrev = NULL;
+	item->m_islandNext = NULL;
+}
+
+template <typename T>
+void b2IslandGraph::MoveList(T** to, T* from, b2PersistentIsland* island)
+{
+	if (from == NULL)
+	{
+		return;
+	}
+	T* last = from;
+	for (;;)
+	{
+		last->m_island = island;
+		if (last->m_islandNext == NULL)
+		{
+			break;
+		}
+		last = last->m_islandNext;
+	}
+	last->m_islandNext = *to;
+	if (*to)
+	{
+		(*to)->m_islandPrev = last;
+	}
+	*to = from;
+}
+
+b2PersistentIsland* b2IslandGraph::Find(b2PersistentIsland* island)
+{
+	b2PersistentIsland* root = island;
+	while (root->parent)
+	{
+		root = root->parent;
+	}
+
+	// Compress the path.
+	while (island != root)
+	{
+		b2PersistentIsland* parent = island->parent;
+		island->parent = root;
+		island = parent;
+	}
+	return root;
+}
+
+b2PersistentIsland* b2IslandGraph::Union(b2PersistentIsland* a,
+										 b2PersistentIsland* b)
+{
+	a = Find(a);
+	b = Find(b);
+	if (a == b)
+	{
+		return a;
+	}
+
+	// Join the smaller island to the larger so fewer members move when
+	// they are merged.
+	if (a->bodyCount < b->bodyCount)
+	{
+		b2Swap(a, b);
+	}
+	b->parent = a;
+	b->nextPending = m_pendingList;
+	m_pendingList = b;
+
+	if (b->awake)
+	{
+		WakeIsland(a);
+	}
+	return a;
+}
+
+b2PersistentIsland* b2IslandGraph::JoinBodies(b2Body* bodyA, b2Body* bodyB)
+{
+	b2PersistentIsland* islandA = bodyA->m_island;
+	b2PersistentIsland* islandB = bodyB->m_island;
+	if (islandA && islandB)
+	{
+		return Union(islandA, islandB);
+	}
+	if (islandA)
+	{
+		return Find(islandA);
+	}
+	if (islandB)
+	{
+		return Find(islandB);
+	}
+	return NULL;
+}
+
+void b2IslandGraph::CountRemoval(b2PersistentIsland* island, b2Body* bodyA,
+								 b2Body* bodyB)
+{
+	// A constraint with a static body never held the island together.
+	if (bodyA->m_island && bodyB->m_island)
+	{
+		++Find(island)->constraintRemoveCount;
+	}
+}
+
+void b2IslandGraph::LinkBody(b2Body* body)
+{
+	if (body->IsActive() == false)
+	{
+		return;
+	}
+
+	if (body->m_type != b2_staticBody)
+	{
+		b2Assert(body->m_island == NULL);
+		b2PersistentIsland* island = CreateIsland();
+		AddToList(&island->bodyList, body, island);
+		island->bodyCount = 1;
+		if (body->IsAwake())
+		{
+			WakeIsland(island);
+		}
+	}
+
+	for (b2JointEdge* je = body->m_jointList; je; je = je->next)
+	{
+		if (je->joint->m_island == NULL)
+		{
+			LinkJoint(je->joint);
+		}
+	}
+}
+
+void b2IslandGraph::UnlinkBody(b2Body* body)
+{
+	for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+	{
+		if (ce->contact->m_island)
+		{
+			UnlinkContact(ce->contact);
+		}
+	}
+	for (b2JointEdge* je = body->m_jointList; je; je = je->next)
+	{
+		if (je->joint->m_island)
+		{
+			UnlinkJoint(je->joint);
+		}
+	}
+
+	if (body->m_island == NULL)
+	{
+		return;
+	}
+
+	// Removing an island must not leave islands joined to it dangling.
+	MergeIslands();
+
+	b2PersistentIsland* island = body->m_island;
+	RemoveFromList(&island->bodyList, body);
+	--island->bodyCount;
+	if (island->bodyCount == 0)
+	{
+		b2Assert(island->contactCount == 0 && island->jointCount == 0);
+		DestroyIsland(island);
+	}
+}
+
+void b2IslandGraph::LinkContact(b2Contact* contact)
+{
+	b2Assert(contact->m_island == NULL);
+	b2PersistentIsland* island = JoinBodies(
+		contact->m_fixtureA->GetBody(), contact->m_fixtureB->GetBody());
+	b2Assert(island);
+	if (island)
+	{
+		AddToList(&island->contactList, contact, island);
+		++island->contactCount;
+	}
+}
+
+void b2IslandGraph::UnlinkContact(b2Contact* contact)
+{
+	b2PersistentIsland* island = contact->m_island;
+	b2Assert(island);
+	RemoveFromList(&island->contactList, contact);
+	--island->contactCount;
+	CountRemoval(island, contact->m_fixtureA->GetBody(),
+				 contact->m_fixtureB->GetBody());
+}
+
+void b2IslandGraph::LinkJoint(b2Joint* joint)
+{
+	b2Assert(joint->m_island == NULL);
+	if (joint->m_bodyA->IsActive() == false ||
+		joint->m_bodyB->IsActive() == false)
+	{
+		return;
+	}
+
+	b2PersistentIsland* island = JoinBodies(joint->m_bodyA, joint->m_bodyB);
+	if (island)
+	{
+		AddToList(&island->jointList, joint, island);
+		++island->jointCount;
+	}
+}
+
+void b2IslandGraph::UnlinkJoint(b2Joint* joint)
+{
+	b2PersistentIsland* island = joint->m_island;
+	b2Assert(island);
+	RemoveFromList(&island->jointList, joint);
+	--island->jointCount;
+	CountRemoval(island, joint->m_bodyA, joint->m_bodyB);
+}
+
+void b2IslandGraph::WakeIsland(b2PersistentIsland* island)
+{
+	island = Find(island);
+	if (island->awake)
+	{
+		return;
+	}
+	island->awake = true;
+	island->prev = NULL;
+	island->next = m_awakeList;
+	if (m_awakeList)
+	{
+		m_awakeList->prev = island;
+	}
+	m_awakeList = island;
+}
+
+void b2IslandGraph::SleepIsland(b2PersistentIsland* island)
+{
+	if (island->awake == false)
+	{
+		return;
+	}
+	if (island->prev)
+	{
+		island->prev->next = island->next;
+	}
+	if (island->next)
+	{
+		island->next->prev = island->prev;
+	}
+	if (island == m_awakeList)
+	{
+		m_awakeList = island->next;
+	}
+	island->prev = NULL;
+	island->next = NULL;
+	island->awake = false;
+}
+
+void b2IslandGraph::MergeIslands()
+{
+	// Point every joined island straight at its root before any of them
+	// is destroyed.
+	for (b2PersistentIsland* island = m_pendingList; island;
+		 island = island->nextPending)
+	{
+		Find(island);
+	}
+
+	b2PersistentIsland* island = m_pendingList;
+	m_pendingList = NULL;
+	while (island)
+	{
+		b2PersistentIsland* next = island->nextPending;
+		b2PersistentIsland* root = island->parent;
+		b2Assert(root && root->parent == NULL);
+
+		MoveList(&root->bodyList, island->bodyList, root);
+		MoveList(&root->contactList, island->contactList, root);
+		MoveList(&root->jointList, island->jointList, root);
+		root->bodyCount += island->bodyCount;
+		root->contactCount += island->contactCount;
+		root->jointCount += island->jointCount;
+		root->constraintRemoveCount += island->constraintRemoveCount;
+
+		DestroyIsland(island);
+		island = next;
+	}
+}
+
+void b2IslandGraph::SplitIsland(b2PersistentIsland* island,
+								b2StackAllocator* allocator)
+{
+	b2Assert(island->parent == NULL && m_pendingList == NULL);
+	const bool awake = island->awake;
+	const int32 bodyCount = island->bodyCount;
+	b2Body** bodies =
+		(b2Body**)allocator->Allocate(bodyCount * sizeof(b2Body*));
+	b2Body** stack =
+		(b2Body**)allocator->Allocate(bodyCount * sizeof(b2Body*));
+	int32 count = 0;
+	for (b2Body* b = island->bodyList; b; b = b->m_islandNext)
+	{
+		bodies[count++] = b;
+	}
+	b2Assert(count == bodyCount);
+
+	// Search the constraint graph from each body not yet in a new island.
+	// Members still pointing at the old island have not been reached.
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		b2Body* seed = bodies[i];
+		if (seed->m_island != island)
+		{
+			continue;
+		}
+
+		b2PersistentIsland* part = CreateIsland();
+		if (awake)
+		{
+			WakeIsland(part);
+		}
+
+		int32 stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_island = part;
+		while (stackCount > 0)
+		{
+			b2Body* b = stack[--stackCount];
+			AddToList(&part->bodyList, b, part);
+			++part->bodyCount;
+
+			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				b2Contact* contact = ce->contact;
+				if (contact->m_island != island)
+				{
+					continue;
+				}
+				AddToList(&part->contactList, contact, part);
+				++part->contactCount;
+
+				b2Body* other = ce->other;
+				if (other->m_island == island)
+				{
+					other->m_island = part;
+					stack[stackCount++] = other;
+				}
+			}
+
+			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				b2Joint* joint = je->joint;
+				if (joint->m_island != island)
+				{
+					continue;
+				}
+				AddToList(&part->jointList, joint, part);
+				++part->jointCount;
+
+				b2Body* other = je->other;
+				if (other->m_island == island)
+				{
+					other->m_island = part;
+					stack[stackCount++] = other;
+				}
+			}
+		}
+	}
+
+	allocator->Free(stack);
+	allocator->Free(bodies);
+	DestroyIsland(island);
+}
+
+template <typename T>
+void b2IslandGraph::SaveList(b2SnapshotWriter* writer, const T* list,
+							 int32 count, int32 T::* index)
+{
+	writer->Write(count);
+	for (const T* item = list; item; item = item->m_islandNext)
+	{
+		writer->Write(item->*index);
+	}
+}
+
+template <typename T>
+void b2IslandGraph::LoadList(b2SnapshotReader* reader, T** list, int32* count,
+							 T** items, int32 itemCount,
+							 b2PersistentIsland* island)
+{
+	*count = reader->ReadCount(sizeof(int32));
+	int32* indices = (int32*)b2Alloc(*count * sizeof(int32));
+	for (int32 i = 0; i < *count; ++i)
+	{
+		indices[i] = reader->ReadIndex(itemCount);
+	}
+	// Adding puts a member at the head, so add them from the back.
+	for (int32 i = *count - 1; i >= 0 && reader->HasError() == false; --i)
+	{
+		T* item = items[indices[i]];
+		if (item->m_island)
+		{
+			// In two islands, or twice in this one.
+			reader->SetError();
+			break;
+		}
+		AddToList(list, item, island);
+	}
+	b2Free(indices);
+}
+
+void b2IslandGraph::Save(b2SnapshotWriter* writer, b2Body* const* bodies,
+						 int32 bodyCount) const
+{
+	// Every island has a body, so numbering the islands of the bodies
+	// reaches them all, including those waiting to be merged.
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		if (bodies[i]->m_island)
+		{
+			bodies[i]->m_island->index = -1;
+		}
+	}
+	int32 islandCount = 0;
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		b2PersistentIsland* island = bodies[i]->m_island;
+		if (island && island->index == -1)
+		{
+			island->index = islandCount++;
+		}
+	}
+
+	// Write the islands in the order they were numbered.
+	writer->Write(islandCount);
+	int32 written = 0;
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const b2PersistentIsland* island = bodies[i]->m_island;
+		if (island == NULL || island->index != written)
+		{
+			continue;
+		}
+		++written;
+		writer->Write(island->parent ? island->parent->index : -1);
+		writer->Write(island->awake);
+		writer->Write(island->constraintRemoveCount);
+		SaveList(writer, island->bodyList, island->bodyCount,
+				 &b2Body::m_worldIndex);
+		SaveList(writer, island->contactList, island->contactCount,
+				 &b2Contact::m_managerIndex);
+		SaveList(writer, island->jointList, island->jointCount,
+				 &b2Joint::m_index);
+	}
+	b2Assert(written == islandCount);
+
+	int32 awakeCount = 0;
+	for (b2PersistentIsland* island = m_awakeList; island;
+		 island = island->next)
+	{
+		++awakeCount;
+	}
+	writer->Write(awakeCount);
+	for (b2PersistentIsland* island = m_awakeList; island;
+		 island = island->next)
+	{
+		writer->Write(island->index);
+	}
+
+	int32 pendingCount = 0;
+	for (b2PersistentIsland* island = m_pendingList; island;
+		 island = island->nextPending)
+	{
+		++pendingCount;
+	}
+	writer->Write(pendingCount);
+	for (b2PersistentIsland* island = m_pendingList; island;
+		 island = island->nextPending)
+	{
+		writer->Write(island->index);
+	}
+}
+
+void b2IslandGraph::Load(b2SnapshotReader* reader, b2Body** bodies,
+						 int32 bodyCount, b2Contact** contacts,
+						 int32 contactCount, b2Joint** joints,
+						 int32 jointCount)
+{
+	b2Assert(m_awakeList == NULL && m_pendingList == NULL);
+
+	const int32 islandCount = reader->ReadCount(1);
+	b2PersistentIsland** islands = (b2PersistentIsland**)b2Alloc(
+		islandCount * sizeof(b2PersistentIsland*));
+	int32* parents = (int32*)b2Alloc(islandCount * sizeof(int32));
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		islands[i] = CreateIsland();
+	}
+
+	for (int32 i = 0; i < islandCount && reader->HasError() == false; ++i)
+	{
+		b2PersistentIsland* island = islands[i];
+		parents[i] = reader->Read<int32>();
+		if (parents[i] < -1 || parents[i] >= islandCount)
+		{
+			reader->SetError();
+			break;
+		}
+		island->parent = parents[i] >= 0 ? islands[parents[i]] : NULL;
+		reader->Read(&island->awake);
+		reader->Read(&island->constraintRemoveCount);
+		LoadList(reader, &island->bodyList, &island->bodyCount, bodies,
+				 bodyCount, island);
+		LoadList(reader, &island->contactList, &island->contactCount,
+				 contacts, contactCount, island);
+		LoadList(reader, &island->jointList, &island->jointCount, joints,
+				 jointCount, island);
+	}
+
+	// The parents must lead to a root, or finding the root of an island
+	// would never end. Each walk stops at an island an earlier walk has
+	// seen, so meeting one of its own islands is a cycle.
+	int32* walks = (int32*)b2Alloc(islandCount * sizeof(int32));
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		walks[i] = -1;
+	}
+	for (int32 i = 0; i < islandCount && reader->HasError() == false; ++i)
+	{
+		int32 j = i;
+		while (j >= 0 && walks[j] == -1)
+		{
+			walks[j] = i;
+			j = parents[j];
+		}
+		if (j >= 0 && walks[j] == i)
+		{
+			reader->SetError();
+		}
+	}
+	b2Free(walks);
+	b2Free(parents);
+
+	// Rebuild the lists back to front, as each island goes at the head. An
+	// island already linked is listed twice.
+	const int32 awakeCount = reader->ReadCount(sizeof(int32));
+	int32* indices = (int32*)b2Alloc(awakeCount * sizeof(int32));
+	for (int32 i = 0; i < awakeCount; ++i)
+	{
+		indices[i] = reader->ReadIndex(islandCount);
+	}
+	for (int32 i = awakeCount - 1; i >= 0 && reader->HasError() == false;
+		 --i)
+	{
+		b2PersistentIsland* island = islands[indices[i]];
+		if (island->prev || island == m_awakeList)
+		{
+			reader->SetError();
+			break;
+		}
+		island->prev = NULL;
+		island->next = m_awakeList;
+		if (m_awakeList)
+		{
+			m_awakeList->prev = island;
+		}
+		m_awakeList = island;
+	}
+	b2Free(indices);
+
+	const int32 pendingCount = reader->ReadCount(sizeof(int32));
+	indices = (int32*)b2Alloc(pendingCount * sizeof(int32));
+	for (int32 i = 0; i < pendingCount; ++i)
+	{
+		indices[i] = reader->ReadIndex(islandCount);
+	}
+	b2PersistentIsland* lastPending = NULL;
+	for (int32 i = pendingCount - 1; i >= 0 && reader->HasError() == false;
+		 --i)
+	{
+		b2PersistentIsland* island = islands[indices[i]];
+		if (island->nextPending || island == lastPending)
+		{
+			reader->SetError();
+			break;
+		}
+		if (lastPending == NULL)
+		{
+			lastPending = island;
+		}
+		island->nextPending = m_pendingList;
+		m_pendingList = island;
+	}
+	b2Free(indices);
+
+	b2Free(islands);
+}
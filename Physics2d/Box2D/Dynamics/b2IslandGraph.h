@@ -0,0 +1,164 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_ISLAND_GRAPH_H
+#define B2_ISLAND_GRAPH_H
+
+#include <Box2D/Common/b2Settings.h>
+
+class b2Body;
+class b2Contact;
+class b2Joint;
+class b2BlockAllocator;
+class b2StackAllocator;
+class b2SnapshotWriter;
+class b2SnapshotReader;
+
+/// A set of bodies connected by touching contacts and joints, kept from
+/// step to step. Static bodies are not part of any island, so they don't
+/// connect the bodies resting on them. This is an internal struct.
+struct b2PersistentIsland
+{
+	// Union-find parent. An island joined to another keeps its members
+	// until b2IslandGraph::MergeIslands() moves them to the root. NULL for
+	// roots.
+	b2PersistentIsland* parent;
+	// Next island waiting to be merged into its root.
+	b2PersistentIsland* nextPending;
+
+	b2Body* bodyList;
+	b2Contact* contactList;
+	b2Joint* jointList;
+	int32 bodyCount;
+	int32 contactCount;
+	int32 jointCount;
+
+	// Number of constraints between two of the island's bodies removed
+	// since it was built. While this isn't zero the island may have come
+	// apart.
+	int32 constraintRemoveCount;
+
+	// Links in the list of awake islands.
+	b2PersistentIsland* prev;
+	b2PersistentIsland* next;
+	bool awake;
+
+	// Scratch index used while saving a snapshot.
+	int32 index;
+};
+
+/// Keeps the bodies of a world grouped into islands as contacts begin and
+/// end and joints come and go, so a step only visits the awake islands.
+/// Linking a contact or joint joins the islands of its bodies in a
+/// union-find forest. The joined islands are merged at the start of the
+/// next step. Unlinking only counts the removal, and an awake island with
+/// removals is split by a search over its own bodies before it is solved.
+/// This is an internal class.
+class b2IslandGraph
+{
+public:
+	b2IslandGraph();
+
+	/// Put an active body which is not static in an island of its own, and
+	/// link the joints of an active body.
+	void LinkBody(b2Body* body);
+
+	/// Take a body, its contacts and its joints out of their islands.
+	void UnlinkBody(b2Body* body);
+
+	/// Add a touching contact which is not a sensor to its bodies' island,
+	/// joining their islands.
+	void LinkContact(b2Contact* contact);
+	void UnlinkContact(b2Contact* contact);
+
+	/// Add a joint between active bodies to its bodies' island, joining
+	/// their islands. Joints with an inactive body are not linked.
+	void LinkJoint(b2Joint* joint);
+	void UnlinkJoint(b2Joint* joint);
+
+	/// Put the island to the list of awake islands.
+	void WakeIsland(b2PersistentIsland* island);
+
+	/// Take the island off the list of awake islands.
+	void SleepIsland(b2PersistentIsland* island);
+
+	/// Merge the islands joined since the last call into their roots.
+	void MergeIslands();
+
+	/// Replace an awake island with one island per connected set of its
+	/// bodies. The scratch memory comes from allocator.
+	void SplitIsland(b2PersistentIsland* island, b2StackAllocator* allocator);
+
+	/// Get the first awake island. Islands joined to another are not on
+	/// the list after MergeIslands().
+	b2PersistentIsland* GetAwakeIslandList() const { return m_awakeList; }
+
+	/// Find the root of an island.
+	static b2PersistentIsland* Find(b2PersistentIsland* island);
+
+	/// Write the islands of the bodies to a snapshot, with their members
+	/// as indices: bodies in the array, contacts in b2ContactManager's
+	/// array and joints by b2Joint::m_index.
+	void Save(b2SnapshotWriter* writer, b2Body* const* bodies,
+			  int32 bodyCount) const;
+
+	/// Rebuild the islands written by Save() in an empty graph. Invalid
+	/// data flags an error on the reader.
+	void Load(b2SnapshotReader* reader, b2Body** bodies, int32 bodyCount,
+			  b2Contact** contacts, int32 contactCount, b2Joint** joints,
+			  int32 jointCount);
+
+	b2BlockAllocator* m_allocator;
+
+private:
+	b2PersistentIsland* CreateIsland();
+	void DestroyIsland(b2PersistentIsland* island);
+
+	// Join the islands, returning the root.
+	b2PersistentIsland* Union(b2PersistentIsland* a, b2PersistentIsland* b);
+
+	// Get the island a constraint between the bodies belongs to, joining
+	// their islands. NULL if neither body has an island.
+	b2PersistentIsland* JoinBodies(b2Body* bodyA, b2Body* bodyB);
+
+	// Count a constraint between the bodies leaving island.
+	void CountRemoval(b2PersistentIsland* island, b2Body* bodyA,
+					  b2Body* bodyB);
+
+	// Helpers for the bodies', contacts' and joints' island lists.
+	template <typename T>
+	static void AddToList(T** list, T* item, b2PersistentIsland* island);
+	template <typename T>
+	static void RemoveFromList(T** list, T* item);
+	template <typename T>
+	static void MoveList(T** to, T* from, b2PersistentIsland* island);
+
+	// Write the members of an island list by their index, and read them
+	// back, looking the members up in items.
+	template <typename T>
+	static void SaveList(b2SnapshotWriter* writer, const T* list,
+						 int32 count, int32 T::* index);
+	template <typename T>
+	static void LoadList(b2SnapshotReader* reader, T** list, int32* count,
+						 T** items, int32 itemCount,
+						 b2PersistentIsland* island);
+
+	b2PersistentIsland* m_awakeList;
+	b2PersistentIsland* m_pendingList;
+};
+
+#endif
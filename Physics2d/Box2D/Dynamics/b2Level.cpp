@@ -0,0 +1,489 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <Box2D/Dynamics/b2Level.h>
+#include <Box2D/Dynamics/b2Body.h>
+#include <Box2D/Dynamics/b2Fixture.h>
+#include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Common/b2Snapshot.h>
+#include <Box2D/Common/b2Trace.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32 b2_levelMagic = 0x6c763262;
+static const int32 b2_levelVersion = 1;
+
+// Sections start at multiples of this many bytes.
+static const int32 b2_levelAlignment = 8;
+
+struct b2LevelHeader
+{
+	uint32 magic;
+	int32 version;
+	// The sizes of the records, which change with b2_maxPolygonVertices.
+	int32 chainSize;
+	int32 polygonSize;
+	int32 chainCount;
+	int32 polygonCount;
+	int32 vertexCount;
+	int32 chainOffset;
+	int32 polygonOffset;
+	int32 vertexOffset;
+	int32 size;
+	int32 padding;
+};
+
+static void b2WriteMaterial(b2LevelMaterial* material, const b2FixtureDef* def)
+{
+	memset(material, 0, sizeof(*material));
+	material->density = def->density;
+	material->friction = def->friction;
+	material->restitution = def->restitution;
+	material->categoryBits = def->filter.categoryBits;
+	material->maskBits = def->filter.maskBits;
+	material->groupIndex = def->filter.groupIndex;
+	material->isSensor = def->isSensor;
+}
+
+static void b2ReadMaterial(b2FixtureDef* def, const b2LevelMaterial& material)
+{
+	def->density = material.density;
+	def->friction = material.friction;
+	def->restitution = material.restitution;
+	def->filter.categoryBits = material.categoryBits;
+	def->filter.maskBits = material.maskBits;
+	def->filter.groupIndex = material.groupIndex;
+	def->isSensor = material.isSensor != 0;
+}
+
+static int32 b2AlignLevelOffset(int32 offset)
+{
+	return (offset + b2_levelAlignment - 1) & ~(b2_levelAlignment - 1);
+}
+
+b2LevelBuilder::b2LevelBuilder() :
+	m_chains(m_allocator),
+	m_polygons(m_allocator),
+	m_vertices(m_allocator)
+{
+}
+
+void b2LevelBuilder::AddFixture(const b2FixtureDef* def)
+{
+	switch (def->shape->GetType())
+	{
+	case b2Shape::e_chain:
+		{
+			const b2ChainShape* shape = (const b2ChainShape*)def->shape;
+			b2LevelChain& chain = m_chains.Append();
+			chain = b2LevelChain();
+			b2WriteMaterial(&chain.material, def);
+			chain.radius = shape->m_radius;
+			chain.firstVertex = m_vertices.GetCount();
+			chain.vertexCount = shape->m_count;
+			chain.flags =
+				(shape->m_hasPrevVertex ? b2LevelChain::e_hasPrevVertex : 0) |
+				(shape->m_hasNextVertex ? b2LevelChain::e_hasNextVertex : 0) |
+				(shape->IsEdgeTreeEnabled() ? b2LevelChain::e_edgeTree : 0);
+			chain.prevVertex = shape->m_prevVertex;
+			chain.nextVertex = shape->m_nextVertex;
+			m_vertices.Reserve(m_vertices.GetCount() + shape->m_count);
+			for (int32 i = 0; i < shape->m_count; ++i)
+			{
+				m_vertices.Append() = shape->m_vertices[i];
+			}
+		}
+		break;
+
+	case b2Shape::e_polygon:
+		{
+			const b2PolygonShape* shape = (const b2PolygonShape*)def->shape;
+			b2Assert(3 <= shape->m_count &&
+					 shape->m_count <= b2_maxPolygonVertices);
+			b2LevelPolygon& polygon = m_polygons.Append();
+			polygon = b2LevelPolygon();
+			b2WriteMaterial(&polygon.material, def);
+			polygon.radius = shape->m_radius;
+			polygon.count = shape->m_count;
+			polygon.centroid = shape->m_centroid;
+			memcpy(polygon.vertices, shape->m_vertices,
+				   shape->m_count * sizeof(b2Vec2));
+			memcpy(polygon.normals, shape->m_normals,
+				   shape->m_count * sizeof(b2Vec2));
+		}
+		break;
+
+	default:
+		// Levels only hold chains and polygons.
+		b2Assert(false);
+		break;
+	}
+}
+
+void b2LevelBuilder::Build(b2Snapshot* level) const
+{
+	b2LevelHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = b2_levelMagic;
+	header.version = b2_levelVersion;
+	header.chainSize = sizeof(b2LevelChain);
+	header.polygonSize = sizeof(b2LevelPolygon);
+	header.chainCount = m_chains.GetCount();
+	header.polygonCount = m_polygons.GetCount();
+	header.vertexCount = m_vertices.GetCount();
+	header.chainOffset = b2AlignLevelOffset(sizeof(header));
+	header.polygonOffset = b2AlignLevelOffset(
+		header.chainOffset + header.chainCount * header.chainSize);
+	header.vertexOffset = b2AlignLevelOffset(
+		header.polygonOffset + header.polygonCount * header.polygonSize);
+	header.size = header.vertexOffset +
+		header.vertexCount * (int32)sizeof(b2Vec2);
+
+	level->Clear();
+	level->Reserve(header.size);
+	b2SnapshotWriter writer(level);
+	const uint8 padding[b2_levelAlignment] = {0};
+	writer.Write(header);
+	writer.Write(padding, header.chainOffset - level->GetSize());
+	writer.WriteArray(m_chains.Data(), header.chainCount);
+	writer.Write(padding, header.polygonOffset - level->GetSize());
+	writer.WriteArray(m_polygons.Data(), header.polygonCount);
+	writer.Write(padding, header.vertexOffset - level->GetSize());
+	writer.WriteArray(m_vertices.Data(), header.vertexCount);
+	b2Assert(level->GetSize() == header.size);
+}
+
+b2Level::b2Level()
+{
+	m_mapping = NULL;
+	m_mappingSize = 0;
+	m_chains = NULL;
+	m_polygons = NULL;
+	m_vertices = NULL;
+	m_chainCount = 0;
+	m_polygonCount = 0;
+	m_vertexCount = 0;
+}
+
+b2Level::~b2Level()
+{
+	Close();
+}
+
+bool b2Level::Open(const char* fileName)
+{
+	b2TraceZone("b2Level::Open");
+	Close();
+
+#ifdef _WIN32
+	// Read the file where it can't be mapped.
+	FILE* file = fopen(fileName, "rb");
+	if (!file)
+	{
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size <= 0 || size > 0x7fffffff)
+	{
+		fclose(file);
+		return false;
+	}
+	m_mapping = b2Alloc((int32)size);
+	m_mappingSize = (int32)size;
+	const bool read = fread(m_mapping, 1, size, file) == (size_t)size;
+	fclose(file);
+#else
+	const int fileDescriptor = open(fileName, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	if (fstat(fileDescriptor, &status) != 0 || status.st_size <= 0 ||
+		status.st_size > 0x7fffffff)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+	void* mapping = mmap(NULL, (size_t)status.st_size, PROT_READ,
+						 MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+	m_mapping = mapping;
+	m_mappingSize = (int32)status.st_size;
+	const bool read = true;
+#endif
+
+	if (!read || !SetData((const uint8*)m_mapping, m_mappingSize))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool b2Level::Open(const void* data, int32 size)
+{
+	Close();
+	if (!SetData((const uint8*)data, size))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void b2Level::Close()
+{
+	if (m_mapping)
+	{
+#ifdef _WIN32
+		b2Free(m_mapping);
+#else
+		munmap(m_mapping, (size_t)m_mappingSize);
+#endif
+		m_mapping = NULL;
+		m_mappingSize = 0;
+	}
+	m_chains = NULL;
+	m_polygons = NULL;
+	m_vertices = NULL;
+	m_chainCount = 0;
+	m_polygonCount = 0;
+	m_vertexCount = 0;
+}
+
+// Does a section of count records of recordSize bytes at offset fit in a
+// level of size bytes?
+static bool b2IsLevelSectionValid(int32 offset, int32 count, int32 recordSize,
+								  int32 size)
+{
+	return count >= 0 && offset >= (int32)sizeof(b2LevelHeader) &&
+		offset % b2_levelAlignment == 0 &&
+		(int64)offset + (int64)count * recordSize <= size;
+}
+
+// Is the radius usable and is every vertex finite, with the same spacing
+// b2ChainShape::CreateChain asserts?
+static bool b2IsLevelChainValid(const b2LevelChain& chain,
+								const b2Vec2* vertices)
+{
+	if (!b2IsValid(chain.radius) || chain.radius < 0.0f ||
+		((chain.flags & b2LevelChain::e_hasPrevVertex) &&
+		 !chain.prevVertex.IsValid()) ||
+		((chain.flags & b2LevelChain::e_hasNextVertex) &&
+		 !chain.nextVertex.IsValid()))
+	{
+		return false;
+	}
+	for (int32 i = 0; i < chain.vertexCount; ++i)
+	{
+		if (!vertices[i].IsValid())
+		{
+			return false;
+		}
+		if (i > 0 && b2DistanceSquared(vertices[i - 1], vertices[i]) <=
+			b2_linearSlop * b2_linearSlop)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Is the polygon what b2PolygonShape::Set would have made: finite, convex
+// and counter-clockwise, with unit outward normals? The centroid is only
+// checked to be finite; Set forms it about the origin, so far from the
+// origin rounding can move it outside a small polygon.
+static bool b2IsLevelPolygonValid(const b2LevelPolygon& polygon)
+{
+	if (!b2IsValid(polygon.radius) || polygon.radius < 0.0f ||
+		!polygon.centroid.IsValid())
+	{
+		return false;
+	}
+	const int32 count = polygon.count;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2Vec2& v1 = polygon.vertices[i];
+		const b2Vec2& v2 = polygon.vertices[i + 1 < count ? i + 1 : 0];
+		const b2Vec2& normal = polygon.normals[i];
+		if (!v1.IsValid() || !normal.IsValid() ||
+			b2Abs(normal.LengthSquared() - 1.0f) > 10.0f * b2_epsilon)
+		{
+			return false;
+		}
+		const b2Vec2 edge = v2 - v1;
+		if (edge.LengthSquared() <= b2_epsilon * b2_epsilon ||
+			b2Abs(b2Dot(normal, edge)) > b2_linearSlop * edge.Length() ||
+			b2Cross(edge, normal) > 0.0f)
+		{
+			return false;
+		}
+		// Every vertex is behind every edge.
+		for (int32 j = 0; j < count; ++j)
+		{
+			if (b2Dot(normal, polygon.vertices[j] - v1) > b2_linearSlop)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool b2Level::SetData(const uint8* data, int32 size)
+{
+	b2LevelHeader header;
+	if (size < (int32)sizeof(header) || (uintptr_t)data % sizeof(float32))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != b2_levelMagic ||
+		header.version != b2_levelVersion ||
+		header.chainSize != (int32)sizeof(b2LevelChain) ||
+		header.polygonSize != (int32)sizeof(b2LevelPolygon) ||
+		header.size != size ||
+		!b2IsLevelSectionValid(header.chainOffset, header.chainCount,
+							   header.chainSize, size) ||
+		!b2IsLevelSectionValid(header.polygonOffset, header.polygonCount,
+							   header.polygonSize, size) ||
+		!b2IsLevelSectionValid(header.vertexOffset, header.vertexCount,
+							   sizeof(b2Vec2), size))
+	{
+		return false;
+	}
+
+	const b2Vec2* vertices = (const b2Vec2*)(data + header.vertexOffset);
+	const b2LevelChain* chains =
+		(const b2LevelChain*)(data + header.chainOffset);
+	for (int32 i = 0; i < header.chainCount; ++i)
+	{
+		const b2LevelChain& chain = chains[i];
+		if (chain.vertexCount < 2 || chain.firstVertex < 0 ||
+			chain.firstVertex > header.vertexCount - chain.vertexCount ||
+			!b2IsLevelChainValid(chain, vertices + chain.firstVertex))
+		{
+			return false;
+		}
+	}
+	const b2LevelPolygon* polygons =
+		(const b2LevelPolygon*)(data + header.polygonOffset);
+	for (int32 i = 0; i < header.polygonCount; ++i)
+	{
+		if (polygons[i].count < 3 ||
+			polygons[i].count > b2_maxPolygonVertices ||
+			!b2IsLevelPolygonValid(polygons[i]))
+		{
+			return false;
+		}
+	}
+
+	m_chains = chains;
+	m_polygons = polygons;
+	m_vertices = vertices;
+	m_chainCount = header.chainCount;
+	m_polygonCount = header.polygonCount;
+	m_vertexCount = header.vertexCount;
+	return true;
+}
+
+void b2Level::CreateFixtures(b2Body* body) const
+{
+	b2TraceZone("b2Level::CreateFixtures");
+
+	const int32 count = m_chainCount + m_polygonCount;
+	if (count == 0)
+	{
+		return;
+	}
+
+	// The shapes only live until the fixtures have cloned them. Chain
+	// clones share the level's vertices.
+	b2FixtureDef* defs = (b2FixtureDef*)b2Alloc(count * sizeof(b2FixtureDef));
+	b2ChainShape* chains = (b2ChainShape*)b2Alloc(
+		b2Max(m_chainCount, 1) * sizeof(b2ChainShape));
+	b2PolygonShape* polygons = (b2PolygonShape*)b2Alloc(
+		b2Max(m_polygonCount, 1) * sizeof(b2PolygonShape));
+
+	for (int32 i = 0; i < m_chainCount; ++i)
+	{
+		const b2LevelChain& chain = m_chains[i];
+		b2ChainShape* shape = new (&chains[i]) b2ChainShape;
+		shape->ShareVertices(m_vertices + chain.firstVertex, chain.vertexCount);
+		shape->m_radius = chain.radius;
+		if (chain.flags & b2LevelChain::e_hasPrevVertex)
+		{
+			shape->SetPrevVertex(chain.prevVertex);
+		}
+		if (chain.flags & b2LevelChain::e_hasNextVertex)
+		{
+			shape->SetNextVertex(chain.nextVertex);
+		}
+		shape->SetEdgeTree((chain.flags & b2LevelChain::e_edgeTree) != 0);
+
+		b2FixtureDef* def = new (&defs[i]) b2FixtureDef;
+		b2ReadMaterial(def, chain.material);
+		def->shape = shape;
+	}
+
+	for (int32 i = 0; i < m_polygonCount; ++i)
+	{
+		const b2LevelPolygon& polygon = m_polygons[i];
+		b2PolygonShape* shape = new (&polygons[i]) b2PolygonShape;
+		shape->m_radius = polygon.radius;
+		shape->m_count = polygon.count;
+		shape->m_centroid = polygon.centroid;
+		memcpy(shape->m_vertices, polygon.vertices,
+			   polygon.count * sizeof(b2Vec2));
+		memcpy(shape->m_normals, polygon.normals,
+			   polygon.count * sizeof(b2Vec2));
+		shape->UpdateSoa();
+
+		b2FixtureDef* def = new (&defs[m_chainCount + i]) b2FixtureDef;
+		b2ReadMaterial(def, polygon.material);
+		def->shape = shape;
+	}
+
+	body->CreateFixtures(defs, count, NULL);
+
+	for (int32 i = 0; i < m_chainCount; ++i)
+	{
+		chains[i].~b2ChainShape();
+	}
+	for (int32 i = 0; i < m_polygonCount; ++i)
+	{
+		polygons[i].~b2PolygonShape();
+	}
+	b2Free(polygons);
+	b2Free(chains);
+	b2Free(defs);
+}
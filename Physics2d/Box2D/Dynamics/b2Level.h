@@ -0,0 +1,167 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_LEVEL_H
+#define B2_LEVEL_H
+
+#include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2GrowableBuffer.h>
+#include <Box2D/Common/b2Math.h>
+#include <Box2D/Collision/Shapes/b2PolygonShape.h>
+
+class b2Body;
+class b2Snapshot;
+struct b2FixtureDef;
+
+/// Fixture settings of a shape in a level. This is an internal struct.
+struct b2LevelMaterial
+{
+	float32 density;
+	float32 friction;
+	float32 restitution;
+	uint16 categoryBits;
+	uint16 maskBits;
+	int16 groupIndex;
+	uint8 isSensor;
+	uint8 padding;
+};
+
+/// A chain of a level. Its vertices are in the level's vertex array.
+/// This is an internal struct.
+struct b2LevelChain
+{
+	enum
+	{
+		e_hasPrevVertex = 0x0001,
+		e_hasNextVertex = 0x0002,
+		e_edgeTree = 0x0004
+	};
+
+	b2LevelMaterial material;
+	float32 radius;
+	int32 firstVertex;
+	int32 vertexCount;
+	int32 flags;
+	b2Vec2 prevVertex;
+	b2Vec2 nextVertex;
+};
+
+/// A polygon of a level, as b2PolygonShape::Set() left it. This is an
+/// internal struct.
+struct b2LevelPolygon
+{
+	b2LevelMaterial material;
+	float32 radius;
+	int32 count;
+	b2Vec2 centroid;
+	b2Vec2 vertices[b2_maxPolygonVertices];
+	b2Vec2 normals[b2_maxPolygonVertices];
+};
+
+/// Compiles the static chains and polygons of a level into the format
+/// b2Level loads. Building the polygons, with their hulls, normals and
+/// centroids, is done once here rather than on every load.
+class b2LevelBuilder
+{
+public:
+	b2LevelBuilder();
+
+	/// Add a fixture with a chain or polygon shape. User data is not kept.
+	void AddFixture(const b2FixtureDef* def);
+
+	/// Write the level, e.g. to a file to be opened with b2Level::Open().
+	/// Levels hold values in the byte order of the machine that built
+	/// them.
+	void Build(b2Snapshot* level) const;
+
+private:
+	b2BlockAllocator m_allocator;
+	b2GrowableBuffer<b2LevelChain> m_chains;
+	b2GrowableBuffer<b2LevelPolygon> m_polygons;
+	b2GrowableBuffer<b2Vec2> m_vertices;
+};
+
+/// The static geometry of a level, mapped from a file built by
+/// b2LevelBuilder. Everything is checked once when the level is opened
+/// (section bounds, finite values, chain vertex spacing, and polygon
+/// convexity, winding and normals), so creating its fixtures
+/// does no geometry work: chains use the mapped vertices in place,
+/// polygons are copied as they are stored, and the proxies go into the
+/// broad-phase with one tree build.
+class b2Level
+{
+public:
+	b2Level();
+
+	/// Close the level.
+	~b2Level();
+
+	/// Map a level file into memory.
+	/// @return false if the file can't be read or isn't a valid level.
+	bool Open(const char* fileName);
+
+	/// Use a level which is already in memory, without copying it. The
+	/// data must stay unchanged until the level is closed and must be
+	/// aligned to four bytes.
+	/// @return false if the data isn't a valid level.
+	bool Open(const void* data, int32 size);
+
+	/// Unmap the level. Fixtures created from the level must be destroyed
+	/// first, as their chains use its vertices.
+	void Close();
+
+	/// Create the level's fixtures on a body, usually a static one.
+	/// @warning This function is locked during callbacks.
+	void CreateFixtures(b2Body* body) const;
+
+	/// Get the number of chains in the level.
+	int32 GetChainCount() const;
+
+	/// Get the number of polygons in the level.
+	int32 GetPolygonCount() const;
+
+private:
+	b2Level(const b2Level&);
+	b2Level& operator=(const b2Level&);
+
+	// Check the data and find its sections.
+	bool SetData(const uint8* data, int32 size);
+
+	// The memory mapped by Open() or, where files can't be mapped, read
+	// into. NULL when the level is in memory the caller owns.
+	void* m_mapping;
+	int32 m_mappingSize;
+
+	const b2LevelChain* m_chains;
+	const b2LevelPolygon* m_polygons;
+	const b2Vec2* m_vertices;
+	int32 m_chainCount;
+	int32 m_polygonCount;
+	int32 m_vertexCount;
+};
+
+inline int32 b2Level::GetChainCount() const
+{
+	return m_chainCount;
+}
+
+inline int32 b2Level::GetPolygonCount() const
+{
+	return m_polygonCount;
+}
+
+#endif
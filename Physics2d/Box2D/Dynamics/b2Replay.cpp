@@ -0,0 +1,802 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <Box2D/Dynamics/b2Replay.h>
+#include <Box2D/Dynamics/b2World.h>
+#include <Box2D/Particle/b2ParticleSystem.h>
+#include <Box2D/Common/b2Trace.h>
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const uint32 b2_replayMagic = 0x70723262;
+static const int32 b2_replayVersion = 1;
+
+// Size of a frame's header: whether it is a keyframe and the size of the
+// rest of the frame.
+static const int32 b2_replayFrameHeaderSize =
+	(int32)(sizeof(uint8) + sizeof(int32));
+
+// Bit of the change mask of a body whose type changed, after the bits of
+// the values.
+static const uint32 b2_replayTypeChanged = 1 << b2ReplayBodyState::e_valueCount;
+
+static inline int32 b2Quantize(float32 value, float64 inversePrecision)
+{
+	// Keep values far outside the range of the precision from overflowing.
+	const float64 limit = 2147483520.0;
+	const float64 scaled = (float64)value * inversePrecision;
+	return (int32)floor(b2Clamp(scaled, -limit, limit) + 0.5);
+}
+
+// Differences wrap around, so adding them back gives the exact value for
+// any pair of values.
+static inline int32 b2Difference(int32 a, int32 b)
+{
+	return (int32)((uint32)a - (uint32)b);
+}
+
+static inline int32 b2Sum(int32 a, int32 b)
+{
+	return (int32)((uint32)a + (uint32)b);
+}
+
+static inline bool b2ReplayBodyLess(const b2ReplayBodyState& a,
+									const b2ReplayBodyState& b)
+{
+	return a.id < b.id;
+}
+
+static inline bool b2ReplayBodyIdLess(const b2ReplayBody& a,
+									  const b2ReplayBody& b)
+{
+	return a.id < b.id;
+}
+
+// Write all of the bytes to a file descriptor, waiting out interruptions
+// and full non-blocking descriptors.
+static bool b2WriteAll(int32 fileDescriptor, const void* data, int32 size)
+{
+	const uint8* bytes = (const uint8*)data;
+	while (size > 0)
+	{
+#ifdef WIN32
+		const int64 written = _write(fileDescriptor, bytes, size);
+#else
+		const int64 written = write(fileDescriptor, bytes, size);
+#endif
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			return false;
+		}
+		bytes += written;
+		size -= (int32)written;
+	}
+	return true;
+}
+
+b2ReplayRecorder::b2ReplayRecorder(const b2World* world,
+								   const b2ReplayDef& def) :
+	m_bodies(m_allocator),
+	m_newBodies(m_allocator),
+	m_particleCounts(m_allocator),
+	m_newParticleCounts(m_allocator),
+	m_particles(m_allocator),
+	m_newParticles(m_allocator),
+	m_destroyedIds(m_allocator),
+	m_createdIndices(m_allocator),
+	m_changedIndices(m_allocator)
+{
+	b2Assert(def.positionPrecision > 0.0f);
+	b2Assert(def.anglePrecision > 0.0f);
+	b2Assert(def.velocityPrecision > 0.0f);
+	b2Assert(def.angularVelocityPrecision > 0.0f);
+	b2Assert(def.keyframeInterval > 0);
+
+	m_world = world;
+	m_def = def;
+	m_frameCount = 0;
+	m_queued = &m_buffers[0];
+	m_writing = &m_buffers[1];
+	m_busy = false;
+	m_exit = false;
+	m_error = false;
+
+	m_frame.Clear();
+	b2SnapshotWriter writer(&m_frame);
+	writer.Write(b2_replayMagic);
+	writer.Write(b2_replayVersion);
+	writer.Write(def.positionPrecision);
+	writer.Write(def.anglePrecision);
+	writer.Write(def.velocityPrecision);
+	writer.Write(def.angularVelocityPrecision);
+	writer.Write(def.keyframeInterval);
+	Output(NULL, 0, m_frame);
+
+	if (def.fileDescriptor >= 0)
+	{
+		m_writer = std::thread(&b2ReplayRecorder::WriterMain, this);
+	}
+}
+
+b2ReplayRecorder::~b2ReplayRecorder()
+{
+	if (m_writer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_exit = true;
+		}
+		m_queueChanged.notify_one();
+		m_writer.join();
+	}
+}
+
+void b2ReplayRecorder::RecordFrame()
+{
+	b2TraceZone("b2ReplayRecorder::RecordFrame");
+
+	// A keyframe is a frame encoded against an empty world.
+	const bool keyframe = m_frameCount % m_def.keyframeInterval == 0;
+	if (keyframe)
+	{
+		m_bodies.SetCount(0);
+		m_particleCounts.SetCount(0);
+		m_particles.SetCount(0);
+	}
+
+	CaptureWorld();
+
+	m_frame.Clear();
+	b2SnapshotWriter writer(&m_frame);
+	WriteBodies(&writer);
+	WriteParticles(&writer);
+
+	uint8 header[b2_replayFrameHeaderSize];
+	const int32 size = m_frame.GetSize();
+	header[0] = (uint8)keyframe;
+	memcpy(header + sizeof(uint8), &size, sizeof(size));
+	Output(header, sizeof(header), m_frame);
+
+	m_bodies.Swap(m_newBodies);
+	m_particleCounts.Swap(m_newParticleCounts);
+	m_particles.Swap(m_newParticles);
+	++m_frameCount;
+}
+
+void b2ReplayRecorder::CaptureWorld()
+{
+	const float64 inversePosition = 1.0 / m_def.positionPrecision;
+	const float64 inverseAngle = 1.0 / m_def.anglePrecision;
+	const float64 inverseVelocity = 1.0 / m_def.velocityPrecision;
+	const float64 inverseAngularVelocity =
+		1.0 / m_def.angularVelocityPrecision;
+
+	// The body list has the newest bodies first, so filling the array from
+	// the back usually leaves it sorted by id.
+	const int32 bodyCount = m_world->GetBodyCount();
+	m_newBodies.Reserve(bodyCount);
+	m_newBodies.SetCount(bodyCount);
+	b2ReplayBodyState* state = m_newBodies.End();
+	for (const b2Body* b = m_world->GetBodyList(); b; b = b->GetNext())
+	{
+		--state;
+		const b2Vec2& position = b->GetPosition();
+		const b2Vec2 linearVelocity = b->GetLinearVelocity();
+		state->id = b->GetId();
+		state->type = b->GetType();
+		state->values[b2ReplayBodyState::e_positionX] =
+			b2Quantize(position.x, inversePosition);
+		state->values[b2ReplayBodyState::e_positionY] =
+			b2Quantize(position.y, inversePosition);
+		state->values[b2ReplayBodyState::e_angle] =
+			b2Quantize(b->GetAngle(), inverseAngle);
+		state->values[b2ReplayBodyState::e_linearVelocityX] =
+			b2Quantize(linearVelocity.x, inverseVelocity);
+		state->values[b2ReplayBodyState::e_linearVelocityY] =
+			b2Quantize(linearVelocity.y, inverseVelocity);
+		state->values[b2ReplayBodyState::e_angularVelocity] =
+			b2Quantize(b->GetAngularVelocity(), inverseAngularVelocity);
+	}
+	b2Assert(state == m_newBodies.Begin());
+	for (int32 i = 1; i < bodyCount; ++i)
+	{
+		if (m_newBodies[i].id < m_newBodies[i - 1].id)
+		{
+			std::sort(m_newBodies.Begin(), m_newBodies.End(),
+					  b2ReplayBodyLess);
+			break;
+		}
+	}
+
+	// Particle systems are also listed newest first, and recorded oldest
+	// first so that creating a system doesn't renumber the others.
+	int32 systemCount = 0;
+	int32 particleCount = 0;
+	for (const b2ParticleSystem* p = m_world->GetParticleSystemList(); p;
+		 p = p->GetNext())
+	{
+		++systemCount;
+		particleCount += p->GetParticleCount();
+	}
+	m_newParticleCounts.Reserve(systemCount);
+	m_newParticleCounts.SetCount(systemCount);
+	m_newParticles.Reserve(2 * particleCount);
+	m_newParticles.SetCount(2 * particleCount);
+	int32 systemIndex = systemCount;
+	int32* values = m_newParticles.End();
+	for (const b2ParticleSystem* p = m_world->GetParticleSystemList(); p;
+		 p = p->GetNext())
+	{
+		const int32 count = p->GetParticleCount();
+		const b2Vec2* positions = p->GetPositionBuffer();
+		m_newParticleCounts[--systemIndex] = count;
+		values -= 2 * count;
+		for (int32 i = 0; i < count; ++i)
+		{
+			values[2 * i] = b2Quantize(positions[i].x, inversePosition);
+			values[2 * i + 1] = b2Quantize(positions[i].y, inversePosition);
+		}
+	}
+}
+
+void b2ReplayRecorder::WriteBodies(b2SnapshotWriter* writer)
+{
+	// Compare the bodies of the two frames, which are both sorted by id.
+	// Changed bodies are kept as pairs of indices into m_newBodies and
+	// m_bodies.
+	const b2ReplayBodyState* previous = m_bodies.Data();
+	const b2ReplayBodyState* current = m_newBodies.Data();
+	const int32 previousCount = m_bodies.GetCount();
+	const int32 currentCount = m_newBodies.GetCount();
+	m_destroyedIds.SetCount(0);
+	m_createdIndices.SetCount(0);
+	m_changedIndices.SetCount(0);
+	int32 i = 0, j = 0;
+	while (i < previousCount || j < currentCount)
+	{
+		if (j == currentCount ||
+			(i < previousCount && previous[i].id < current[j].id))
+		{
+			m_destroyedIds.Append() = previous[i++].id;
+		}
+		else if (i == previousCount || current[j].id < previous[i].id)
+		{
+			m_createdIndices.Append() = j++;
+		}
+		else
+		{
+			if (memcmp(&previous[i], &current[j], sizeof(current[j])))
+			{
+				m_changedIndices.Append() = j;
+				m_changedIndices.Append() = i;
+			}
+			++i;
+			++j;
+		}
+	}
+
+	// Ids are written as the gap from the id before.
+	uint32 id = 0;
+	writer->WriteVarint(m_destroyedIds.GetCount());
+	for (int32 k = 0; k < m_destroyedIds.GetCount(); ++k)
+	{
+		writer->WriteVarint(m_destroyedIds[k] - id);
+		id = m_destroyedIds[k];
+	}
+
+	id = 0;
+	writer->WriteVarint(m_createdIndices.GetCount());
+	for (int32 k = 0; k < m_createdIndices.GetCount(); ++k)
+	{
+		const b2ReplayBodyState& state = current[m_createdIndices[k]];
+		writer->WriteVarint(state.id - id);
+		writer->WriteVarint(state.type);
+		for (int32 v = 0; v < b2ReplayBodyState::e_valueCount; ++v)
+		{
+			writer->WriteSignedVarint(state.values[v]);
+		}
+		id = state.id;
+	}
+
+	id = 0;
+	writer->WriteVarint(m_changedIndices.GetCount() / 2);
+	for (int32 k = 0; k < m_changedIndices.GetCount(); k += 2)
+	{
+		const b2ReplayBodyState& state = current[m_changedIndices[k]];
+		const b2ReplayBodyState& before = previous[m_changedIndices[k + 1]];
+		uint32 mask = state.type != before.type ? b2_replayTypeChanged : 0;
+		for (int32 v = 0; v < b2ReplayBodyState::e_valueCount; ++v)
+		{
+			if (state.values[v] != before.values[v])
+			{
+				mask |= 1 << v;
+			}
+		}
+		writer->WriteVarint(state.id - id);
+		writer->WriteVarint(mask);
+		if (mask & b2_replayTypeChanged)
+		{
+			writer->WriteVarint(state.type);
+		}
+		for (int32 v = 0; v < b2ReplayBodyState::e_valueCount; ++v)
+		{
+			if (mask & (1 << v))
+			{
+				writer->WriteSignedVarint(
+					b2Difference(state.values[v], before.values[v]));
+			}
+		}
+		id = state.id;
+	}
+}
+
+void b2ReplayRecorder::WriteParticles(b2SnapshotWriter* writer)
+{
+	const int32 systemCount = m_newParticleCounts.GetCount();
+	const int32* previous = m_particles.Data();
+	const int32* current = m_newParticles.Data();
+	writer->WriteVarint(systemCount);
+	for (int32 s = 0; s < systemCount; ++s)
+	{
+		const int32 count = m_newParticleCounts[s];
+		const int32 previousCount =
+			s < m_particleCounts.GetCount() ? m_particleCounts[s] : 0;
+		writer->WriteVarint(count);
+
+		// Particles which were there in the frame before are written as
+		// the change in their position, new ones as their position.
+		const int32 sharedCount = 2 * b2Min(count, previousCount);
+		for (int32 i = 0; i < sharedCount; ++i)
+		{
+			writer->WriteSignedVarint(b2Difference(current[i], previous[i]));
+		}
+		for (int32 i = sharedCount; i < 2 * count; ++i)
+		{
+			writer->WriteSignedVarint(current[i]);
+		}
+		current += 2 * count;
+		previous += 2 * previousCount;
+	}
+}
+
+void b2ReplayRecorder::Output(const void* header, int32 headerSize,
+							  const b2Snapshot& bytes)
+{
+	if (m_def.fileDescriptor < 0)
+	{
+		b2SnapshotWriter writer(&m_recording);
+		writer.Write(header, headerSize);
+		writer.Write(bytes.GetData(), bytes.GetSize());
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_error)
+		{
+			return;
+		}
+		b2SnapshotWriter writer(m_queued);
+		writer.Write(header, headerSize);
+		writer.Write(bytes.GetData(), bytes.GetSize());
+	}
+	m_queueChanged.notify_one();
+}
+
+void b2ReplayRecorder::WriterMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		while (m_queued->GetSize() == 0 && !m_exit)
+		{
+			m_queueChanged.wait(lock);
+		}
+		if (m_queued->GetSize() == 0)
+		{
+			break;
+		}
+
+		// Write without the lock, so frames can be queued meanwhile.
+		b2Swap(m_queued, m_writing);
+		m_busy = true;
+		lock.unlock();
+		const bool written = b2WriteAll(m_def.fileDescriptor,
+										m_writing->GetData(),
+										m_writing->GetSize());
+		m_writing->Clear();
+		lock.lock();
+		m_busy = false;
+
+		if (!written)
+		{
+			m_error = true;
+			m_queued->Clear();
+		}
+		if (m_queued->GetSize() == 0)
+		{
+			m_drained.notify_all();
+		}
+	}
+}
+
+void b2ReplayRecorder::Flush()
+{
+	if (!m_writer.joinable())
+	{
+		return;
+	}
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_queued->GetSize() > 0 || m_busy)
+	{
+		m_drained.wait(lock);
+	}
+}
+
+bool b2ReplayRecorder::HasError() const
+{
+	std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(m_mutex));
+	return m_error;
+}
+
+b2ReplayPlayer::b2ReplayPlayer() :
+	m_frameOffsets(m_allocator),
+	m_state(m_allocator),
+	m_newState(m_allocator),
+	m_particleCounts(m_allocator),
+	m_newParticleCounts(m_allocator),
+	m_particles(m_allocator),
+	m_newParticles(m_allocator),
+	m_destroyedIds(m_allocator),
+	m_created(m_allocator),
+	m_bodies(m_allocator),
+	m_positions(m_allocator),
+	m_particleOffsets(m_allocator)
+{
+	m_frame = -1;
+}
+
+bool b2ReplayPlayer::Open(const void* data, int32 size)
+{
+	m_data.SetData(data, size);
+	m_frame = -1;
+	m_frameOffsets.SetCount(0);
+	m_state.SetCount(0);
+	m_particleCounts.SetCount(0);
+	m_particles.SetCount(0);
+	m_bodies.SetCount(0);
+	m_positions.SetCount(0);
+	m_particleOffsets.SetCount(0);
+
+	b2SnapshotReader reader(data, size);
+	if (reader.Read<uint32>() != b2_replayMagic ||
+		reader.Read<int32>() != b2_replayVersion)
+	{
+		return false;
+	}
+	reader.Read(&m_def.positionPrecision);
+	reader.Read(&m_def.anglePrecision);
+	reader.Read(&m_def.velocityPrecision);
+	reader.Read(&m_def.angularVelocityPrecision);
+	reader.Read(&m_def.keyframeInterval);
+	if (reader.HasError())
+	{
+		return false;
+	}
+
+	// Index the frames by walking their headers.
+	int32 offset = size - reader.GetRemaining();
+	while (size - offset >= b2_replayFrameHeaderSize)
+	{
+		b2SnapshotReader header((const uint8*)data + offset,
+								b2_replayFrameHeaderSize);
+		const uint8 keyframe = header.Read<uint8>();
+		const int32 frameSize = header.Read<int32>();
+		if (frameSize < 0 ||
+			frameSize > size - offset - b2_replayFrameHeaderSize ||
+			(m_frameOffsets.GetCount() == 0 && !keyframe))
+		{
+			break;
+		}
+		m_frameOffsets.Append() = offset;
+		offset += b2_replayFrameHeaderSize + frameSize;
+	}
+	return true;
+}
+
+bool b2ReplayPlayer::SeekFrame(int32 frame)
+{
+	b2TraceZone("b2ReplayPlayer::SeekFrame");
+
+	if (frame < 0 || frame >= GetFrameCount())
+	{
+		return false;
+	}
+	if (frame == m_frame)
+	{
+		return true;
+	}
+
+	const uint8* data = (const uint8*)m_data.GetData();
+	int32 keyframe = frame;
+	while (data[m_frameOffsets[keyframe]] == 0)
+	{
+		--keyframe;
+	}
+	const int32 first = m_frame >= keyframe && m_frame < frame ?
+		m_frame + 1 : keyframe;
+	for (int32 i = first; i <= frame; ++i)
+	{
+		if (!DecodeFrame(i))
+		{
+			m_frame = -1;
+			return false;
+		}
+	}
+	m_frame = frame;
+	Dequantize();
+	return true;
+}
+
+bool b2ReplayPlayer::DecodeFrame(int32 frame)
+{
+	const int32 offset = m_frameOffsets[frame];
+	b2SnapshotReader header((const uint8*)m_data.GetData() + offset,
+							b2_replayFrameHeaderSize);
+	const bool keyframe = header.Read<uint8>() != 0;
+	const int32 size = header.Read<int32>();
+	b2SnapshotReader reader((const uint8*)m_data.GetData() + offset +
+							b2_replayFrameHeaderSize, size);
+	if (keyframe)
+	{
+		m_state.SetCount(0);
+		m_particleCounts.SetCount(0);
+		m_particles.SetCount(0);
+	}
+	return ReadBodies(&reader) && ReadParticles(&reader) &&
+		!reader.HasError() && reader.GetRemaining() == 0;
+}
+
+bool b2ReplayPlayer::ReadBodies(b2SnapshotReader* reader)
+{
+	// Every entry takes at least a byte, so a count larger than the bytes
+	// left can only come from corrupt data.
+	const int32 destroyedCount = (int32)reader->ReadVarint();
+	if (destroyedCount < 0 || destroyedCount > reader->GetRemaining())
+	{
+		return false;
+	}
+	m_destroyedIds.Reserve(destroyedCount);
+	m_destroyedIds.SetCount(destroyedCount);
+	uint32 id = 0;
+	for (int32 k = 0; k < destroyedCount; ++k)
+	{
+		id += reader->ReadVarint();
+		m_destroyedIds[k] = id;
+	}
+
+	const int32 createdCount = (int32)reader->ReadVarint();
+	if (createdCount < 0 || createdCount > reader->GetRemaining())
+	{
+		return false;
+	}
+	m_created.Reserve(createdCount);
+	m_created.SetCount(createdCount);
+	id = 0;
+	for (int32 k = 0; k < createdCount; ++k)
+	{
+		b2ReplayBodyState& state = m_created[k];
+		id += reader->ReadVarint();
+		state.id = id;
+		state.type = (int32)reader->ReadVarint();
+		for (int32 v = 0; v < b2ReplayBodyState::e_valueCount; ++v)
+		{
+			state.values[v] = reader->ReadSignedVarint();
+		}
+	}
+
+	// Merge the bodies which are left with the new ones, all sorted by id.
+	const int32 previousCount = m_state.GetCount();
+	const int32 count = previousCount - destroyedCount + createdCount;
+	if (count < 0)
+	{
+		return false;
+	}
+	m_newState.Reserve(count);
+	m_newState.SetCount(count);
+	const b2ReplayBodyState* previous = m_state.Data();
+	b2ReplayBodyState* bodies = m_newState.Data();
+	int32 i = 0, d = 0, c = 0, n = 0;
+	while (i < previousCount || c < createdCount)
+	{
+		if (c == createdCount ||
+			(i < previousCount && previous[i].id < m_created[c].id))
+		{
+			if (d < destroyedCount && m_destroyedIds[d] == previous[i].id)
+			{
+				++d;
+			}
+			else if (n < count)
+			{
+				bodies[n++] = previous[i];
+			}
+			++i;
+		}
+		else if (n < count)
+		{
+			bodies[n++] = m_created[c++];
+		}
+		else
+		{
+			return false;
+		}
+	}
+	if (d != destroyedCount || n != count)
+	{
+		return false;
+	}
+
+	const int32 changedCount = (int32)reader->ReadVarint();
+	id = 0;
+	n = 0;
+	for (int32 k = 0; k < changedCount; ++k)
+	{
+		id += reader->ReadVarint();
+		while (n < count && bodies[n].id < id)
+		{
+			++n;
+		}
+		if (n == count || bodies[n].id != id)
+		{
+			return false;
+		}
+		b2ReplayBodyState& state = bodies[n];
+		const uint32 mask = reader->ReadVarint();
+		if (mask & b2_replayTypeChanged)
+		{
+			state.type = (int32)reader->ReadVarint();
+		}
+		for (int32 v = 0; v < b2ReplayBodyState::e_valueCount; ++v)
+		{
+			if (mask & (1 << v))
+			{
+				state.values[v] = b2Sum(state.values[v],
+										reader->ReadSignedVarint());
+			}
+		}
+	}
+
+	m_state.Swap(m_newState);
+	return !reader->HasError();
+}
+
+bool b2ReplayPlayer::ReadParticles(b2SnapshotReader* reader)
+{
+	const int32 systemCount = (int32)reader->ReadVarint();
+	if (systemCount < 0 || systemCount > reader->GetRemaining())
+	{
+		return false;
+	}
+	m_newParticleCounts.Reserve(systemCount);
+	m_newParticleCounts.SetCount(systemCount);
+	m_newParticles.SetCount(0);
+	const int32* previous = m_particles.Data();
+	for (int32 s = 0; s < systemCount; ++s)
+	{
+		const int32 count = (int32)reader->ReadVarint();
+		// Each particle takes at least two bytes.
+		if (count < 0 || count > reader->GetRemaining() / 2)
+		{
+			return false;
+		}
+		const int32 previousCount =
+			s < m_particleCounts.GetCount() ? m_particleCounts[s] : 0;
+		m_newParticleCounts[s] = count;
+
+		const int32 start = m_newParticles.GetCount();
+		m_newParticles.Reserve(start + 2 * count);
+		m_newParticles.SetCount(start + 2 * count);
+		int32* values = m_newParticles.Data() + start;
+		const int32 sharedCount = 2 * b2Min(count, previousCount);
+		for (int32 i = 0; i < sharedCount; ++i)
+		{
+			values[i] = b2Sum(previous[i], reader->ReadSignedVarint());
+		}
+		for (int32 i = sharedCount; i < 2 * count; ++i)
+		{
+			values[i] = reader->ReadSignedVarint();
+		}
+		previous += 2 * previousCount;
+	}
+
+	m_particleCounts.Swap(m_newParticleCounts);
+	m_particles.Swap(m_newParticles);
+	return !reader->HasError();
+}
+
+void b2ReplayPlayer::Dequantize()
+{
+	const int32 bodyCount = m_state.GetCount();
+	m_bodies.Reserve(bodyCount);
+	m_bodies.SetCount(bodyCount);
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const b2ReplayBodyState& state = m_state[i];
+		const int32* values = state.values;
+		b2ReplayBody& body = m_bodies[i];
+		body.id = state.id;
+		body.type = (b2BodyType)state.type;
+		body.position.Set(
+			values[b2ReplayBodyState::e_positionX] * m_def.positionPrecision,
+			values[b2ReplayBodyState::e_positionY] * m_def.positionPrecision);
+		body.angle = values[b2ReplayBodyState::e_angle] * m_def.anglePrecision;
+		body.linearVelocity.Set(
+			values[b2ReplayBodyState::e_linearVelocityX] *
+				m_def.velocityPrecision,
+			values[b2ReplayBodyState::e_linearVelocityY] *
+				m_def.velocityPrecision);
+		body.angularVelocity = values[b2ReplayBodyState::e_angularVelocity] *
+			m_def.angularVelocityPrecision;
+	}
+
+	const int32 systemCount = m_particleCounts.GetCount();
+	const int32 particleCount = m_particles.GetCount() / 2;
+	m_particleOffsets.Reserve(systemCount);
+	m_particleOffsets.SetCount(systemCount);
+	m_positions.Reserve(particleCount);
+	m_positions.SetCount(particleCount);
+	int32 offset = 0;
+	for (int32 s = 0; s < systemCount; ++s)
+	{
+		m_particleOffsets[s] = offset;
+		offset += m_particleCounts[s];
+	}
+	const int32* values = m_particles.Data();
+	for (int32 i = 0; i < particleCount; ++i)
+	{
+		m_positions[i].Set(values[2 * i] * m_def.positionPrecision,
+						   values[2 * i + 1] * m_def.positionPrecision);
+	}
+}
+
+const b2ReplayBody* b2ReplayPlayer::FindBody(uint32 id) const
+{
+	const b2ReplayBody* begin = m_bodies.Data();
+	const b2ReplayBody* end = begin + m_bodies.GetCount();
+	b2ReplayBody key;
+	key.id = id;
+	const b2ReplayBody* body = std::lower_bound(begin, end, key,
+		b2ReplayBodyIdLess);
+	return body != end && body->id == id ? body : NULL;
+}
@@ -0,0 +1,318 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_REPLAY_H
+#define B2_REPLAY_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <Box2D/Common/b2BlockAllocator.h>
+#include <Box2D/Common/b2GrowableBuffer.h>
+#include <Box2D/Common/b2Math.h>
+#include <Box2D/Common/b2Snapshot.h>
+#include <Box2D/Dynamics/b2Body.h>
+
+class b2World;
+
+/// Holds the settings of a b2ReplayRecorder.
+struct b2ReplayDef
+{
+	b2ReplayDef()
+	{
+		positionPrecision = 1.0f / 1024.0f;
+		anglePrecision = 1.0f / 4096.0f;
+		velocityPrecision = 1.0f / 256.0f;
+		angularVelocityPrecision = 1.0f / 1024.0f;
+		keyframeInterval = 60;
+		fileDescriptor = -1;
+	}
+
+	/// The step body and particle positions are rounded to, in meters.
+	float32 positionPrecision;
+
+	/// The step body angles are rounded to, in radians.
+	float32 anglePrecision;
+
+	/// The step linear velocities are rounded to, in meters per second.
+	float32 velocityPrecision;
+
+	/// The step angular velocities are rounded to, in radians per second.
+	float32 angularVelocityPrecision;
+
+	/// Number of frames from one keyframe to the next. A keyframe holds the
+	/// whole state, so b2ReplayPlayer decodes at most this many frames to
+	/// seek to any frame.
+	int32 keyframeInterval;
+
+	/// File descriptor the recording is written to, e.g. an open file or a
+	/// socket. The recorder writes on a thread of its own and doesn't close
+	/// it. -1 keeps the recording in memory. See
+	/// b2ReplayRecorder::GetRecording().
+	int32 fileDescriptor;
+};
+
+/// State of a body in a frame of a replay.
+struct b2ReplayBody
+{
+	/// See b2Body::GetId().
+	uint32 id;
+	b2BodyType type;
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+};
+
+/// Quantized state of a body. This is an internal struct.
+struct b2ReplayBodyState
+{
+	enum
+	{
+		e_positionX,
+		e_positionY,
+		e_angle,
+		e_linearVelocityX,
+		e_linearVelocityY,
+		e_angularVelocity,
+		e_valueCount
+	};
+
+	uint32 id;
+	int32 type;
+	int32 values[e_valueCount];
+};
+
+/// Records the bodies and particles of a world as a stream of frames,
+/// each holding what changed since the frame before: bodies created and
+/// destroyed, bodies whose quantized transform or velocity changed, and
+/// the particles' quantized position deltas as variable length integers.
+/// Resting bodies cost nothing and slow particles about two bytes each.
+/// Particles are matched from frame to frame by their index, so the
+/// particles after one which is destroyed cost more for a frame.
+/// Every b2ReplayDef::keyframeInterval frames a keyframe holds the whole
+/// state instead. Read the recording back with b2ReplayPlayer.
+class b2ReplayRecorder
+{
+public:
+	/// Start a recording of world, which must outlive the recorder.
+	b2ReplayRecorder(const b2World* world, const b2ReplayDef& def);
+
+	/// Wait for the recording to be written and stop the writer thread.
+	~b2ReplayRecorder();
+
+	/// Add a frame with the current state of the world. Call this after
+	/// each b2World::Step(). The frame is encoded on the calling thread
+	/// and handed to the writer thread, so slow writes don't hold up
+	/// stepping. Frames queue up in memory while the writer is behind.
+	void RecordFrame();
+
+	/// Wait until every frame recorded so far has been written.
+	void Flush();
+
+	/// Get the number of frames recorded.
+	int32 GetFrameCount() const;
+
+	/// Did writing to the file descriptor fail? Later frames are dropped
+	/// once it has.
+	bool HasError() const;
+
+	/// Get the recording, when it is kept in memory.
+	const b2Snapshot& GetRecording() const;
+
+private:
+	b2ReplayRecorder(const b2ReplayRecorder&);
+	b2ReplayRecorder& operator=(const b2ReplayRecorder&);
+
+	// Quantize the state of the world's bodies and particles into the
+	// current frame buffers.
+	void CaptureWorld();
+
+	void WriteBodies(b2SnapshotWriter* writer);
+	void WriteParticles(b2SnapshotWriter* writer);
+
+	// Hand a header and the bytes after it to the writer thread, or append
+	// them to the recording.
+	void Output(const void* header, int32 headerSize, const b2Snapshot& bytes);
+
+	// Body of the writer thread.
+	void WriterMain();
+
+	const b2World* m_world;
+	b2ReplayDef m_def;
+	int32 m_frameCount;
+
+	b2BlockAllocator m_allocator;
+
+	// State of the previous frame and the current one, with the bodies
+	// sorted by id and the particles of each system in a row.
+	b2GrowableBuffer<b2ReplayBodyState> m_bodies;
+	b2GrowableBuffer<b2ReplayBodyState> m_newBodies;
+	b2GrowableBuffer<int32> m_particleCounts;
+	b2GrowableBuffer<int32> m_newParticleCounts;
+	b2GrowableBuffer<int32> m_particles;
+	b2GrowableBuffer<int32> m_newParticles;
+
+	// The body changes found while encoding a frame.
+	b2GrowableBuffer<uint32> m_destroyedIds;
+	b2GrowableBuffer<int32> m_createdIndices;
+	b2GrowableBuffer<int32> m_changedIndices;
+
+	// The frame being encoded, without its header.
+	b2Snapshot m_frame;
+	b2Snapshot m_recording;
+
+	// Bytes waiting for the writer thread, and the bytes it is writing.
+	// The thread swaps the two under m_mutex.
+	b2Snapshot m_buffers[2];
+	b2Snapshot* m_queued;
+	b2Snapshot* m_writing;
+
+	std::thread m_writer;
+	std::mutex m_mutex;
+	// Signalled when bytes are queued or the recorder is destroyed.
+	std::condition_variable m_queueChanged;
+	// Signalled when the writer has written everything queued.
+	std::condition_variable m_drained;
+	bool m_busy;
+	bool m_exit;
+	bool m_error;
+};
+
+/// Reconstructs the frames of a recording made by b2ReplayRecorder.
+class b2ReplayPlayer
+{
+public:
+	b2ReplayPlayer();
+
+	/// Take a copy of a recording and index its frames. A frame cut off at
+	/// the end, e.g. by a crash while recording, is left out.
+	/// @return false if the data doesn't start like a recording.
+	bool Open(const void* data, int32 size);
+
+	/// Get the number of complete frames in the recording.
+	int32 GetFrameCount() const;
+
+	/// Reconstruct a frame. This decodes from the closest keyframe before
+	/// the frame, or onwards from the current frame when that is closer.
+	/// @return false if the frame is out of range or the data is corrupt.
+	bool SeekFrame(int32 frame);
+
+	/// Get the frame last reconstructed, or -1 before the first seek.
+	int32 GetFrame() const;
+
+	/// Get the bodies of the current frame, sorted by id.
+	const b2ReplayBody* GetBodies() const;
+	int32 GetBodyCount() const;
+
+	/// Find a body of the current frame by its id. NULL if it doesn't
+	/// exist in the frame.
+	const b2ReplayBody* FindBody(uint32 id) const;
+
+	/// Get the number of particle systems in the current frame, in the
+	/// order they were created.
+	int32 GetParticleSystemCount() const;
+
+	/// Get the particle positions of a particle system in the current frame.
+	const b2Vec2* GetParticlePositions(int32 systemIndex) const;
+	int32 GetParticleCount(int32 systemIndex) const;
+
+private:
+	b2ReplayPlayer(const b2ReplayPlayer&);
+	b2ReplayPlayer& operator=(const b2ReplayPlayer&);
+
+	// Apply a frame to the quantized state.
+	bool DecodeFrame(int32 frame);
+	bool ReadBodies(b2SnapshotReader* reader);
+	bool ReadParticles(b2SnapshotReader* reader);
+
+	// Convert the quantized state to the public arrays.
+	void Dequantize();
+
+	b2ReplayDef m_def;
+	b2Snapshot m_data;
+	int32 m_frame;
+
+	b2BlockAllocator m_allocator;
+
+	// Offset of each frame's header in m_data.
+	b2GrowableBuffer<int32> m_frameOffsets;
+
+	b2GrowableBuffer<b2ReplayBodyState> m_state;
+	b2GrowableBuffer<b2ReplayBodyState> m_newState;
+	b2GrowableBuffer<int32> m_particleCounts;
+	b2GrowableBuffer<int32> m_newParticleCounts;
+	b2GrowableBuffer<int32> m_particles;
+	b2GrowableBuffer<int32> m_newParticles;
+	b2GrowableBuffer<uint32> m_destroyedIds;
+	b2GrowableBuffer<b2ReplayBodyState> m_created;
+
+	b2GrowableBuffer<b2ReplayBody> m_bodies;
+	b2GrowableBuffer<b2Vec2> m_positions;
+	// Index of each particle system's first position in m_positions.
+	b2GrowableBuffer<int32> m_particleOffsets;
+};
+
+inline int32 b2ReplayRecorder::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+inline const b2Snapshot& b2ReplayRecorder::GetRecording() const
+{
+	return m_recording;
+}
+
+inline int32 b2ReplayPlayer::GetFrameCount() const
+{
+	return m_frameOffsets.GetCount();
+}
+
+inline int32 b2ReplayPlayer::GetFrame() const
+{
+	return m_frame;
+}
+
+inline const b2ReplayBody* b2ReplayPlayer::GetBodies() const
+{
+	return m_bodies.Data();
+}
+
+inline int32 b2ReplayPlayer::GetBodyCount() const
+{
+	return m_bodies.GetCount();
+}
+
+inline int32 b2ReplayPlayer::GetParticleSystemCount() const
+{
+	return m_particleOffsets.GetCount();
+}
+
+inline const b2Vec2* b2ReplayPlayer::GetParticlePositions(
+	int32 systemIndex) const
+{
+	b2Assert(0 <= systemIndex && systemIndex < GetParticleSystemCount());
+	return m_positions.Data() + m_particleOffsets[systemIndex];
+}
+
+inline int32 b2ReplayPlayer::GetParticleCount(int32 systemIndex) const
+{
+	b2Assert(0 <= systemIndex && systemIndex < GetParticleSystemCount());
+	return m_particleCounts[systemIndex];
+}
+
+#endif
@@ -45,6 +45,7 @@ struct b2TimeStep
 	int32 positionIterations;
 	int32 particleIterations;
 	bool warmStarting;
+	bool batchJoints;
 };
 
 /// This is an internal structure.
@@ -61,12 +62,27 @@ struct b2Velocity
 	float32 w;
 };
 
+/// This is an internal structure.
+struct b2Force
+{
+	b2Vec2 force;
+	float32 torque;
+};
+
+/// This is an internal structure.
+struct b2InverseMass
+{
+	float32 invMass;
+	float32 invI;
+};
+
 /// Solver Data
 struct b2SolverData
 {
 	b2TimeStep step;
 	b2Position* positions;
 	b2Velocity* velocities;
+	const b2InverseMass* inverseMasses;
 };
 
 #endif
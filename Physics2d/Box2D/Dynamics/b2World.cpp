@@ -33,13 +33,53 @@
 #include <Box2D/Collision/b2TimeOfImpact.h>
 #include <Box2D/Common/b2Draw.h>
 #include <Box2D/Common/b2Timer.h>
+#include <Box2D/Common/b2Trace.h>
+#include <Box2D/Common/b2Snapshot.h>
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <algorithm>
 #include <new>
 
-b2World::b2World(const b2Vec2& gravity)
+// Initial capacity of the body array.
+static const int32 b2_minBodyCapacity = 64;
+
+// Snapshots start with these, and LoadSnapshot() only reads snapshots with
+// the same version. Bump the version whenever the format changes.
+static const uint32 b2_snapshotMagic = 0x6e733262;
+static const int32 b2_snapshotVersion = 3;
+
+// Fewest packets of AABBs or rays handed to a task by b2World::QueryAABBs()
+// and b2World::RayCastClosest().
+static const int32 b2_minQueryPacketRange = 8;
+
+b2World::b2World(const b2Vec2& gravity) :
+	m_accountingAllocator(b2GetDefaultAllocator()),
+	m_blockAllocator(&m_accountingAllocator),
+	m_stackAllocator(&m_accountingAllocator),
+	m_frameArena(&m_accountingAllocator),
+	m_bodyAllocator(&m_accountingAllocator),
+	m_fixtureAllocator(&m_accountingAllocator),
+	m_contactAllocator(&m_accountingAllocator)
 {
 	Init(gravity);
 }
 
+b2World::b2World(const b2WorldDef* def) :
+	m_accountingAllocator(def->allocator ? def->allocator :
+						  b2GetDefaultAllocator()),
+	m_blockAllocator(&m_accountingAllocator),
+	m_stackAllocator(m_blockAllocator.GetAllocator()),
+	m_frameArena(m_blockAllocator.GetAllocator()),
+	m_bodyAllocator(m_blockAllocator.GetAllocator()),
+	m_fixtureAllocator(m_blockAllocator.GetAllocator()),
+	m_contactAllocator(m_blockAllocator.GetAllocator())
+{
+	Init(def->gravity);
+	SetMemoryBudget(def->memoryBudget);
+	SetTaskExecutor(def->taskExecutor);
+	SetColoringThreshold(def->coloringThreshold);
+	SetDeterministic(def->deterministic);
+}
+
 b2World::~b2World()
 {
 	// Some shapes allocate using b2Alloc.
@@ -65,6 +105,16 @@ b2World::~b2World()
 		DestroyParticleSystem(m_particleSystemList);
 	}
 
+	if (m_bodies)
+	{
+		m_blockAllocator.Free(m_bodies, m_bodyCapacity * sizeof(b2Body*));
+		m_blockAllocator.Free(m_positions, m_bodyCapacity * sizeof(b2Position));
+		m_blockAllocator.Free(m_velocities, m_bodyCapacity * sizeof(b2Velocity));
+		m_blockAllocator.Free(m_forces, m_bodyCapacity * sizeof(b2Force));
+		m_blockAllocator.Free(m_inverseMasses,
+							  m_bodyCapacity * sizeof(b2InverseMass));
+	}
+
 	// Even though the block allocator frees them for us, for safety,
 	// we should ensure that all buffers have been freed.
 	b2Assert(m_blockAllocator.GetNumGiantAllocations() == 0);
@@ -98,7 +148,23 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 		return NULL;
 	}
 
-	void* mem = m_blockAllocator.Allocate(sizeof(b2Body));
+	// Count the growth of the body arrays too.
+	int32 size = m_bodyAllocator.GetAllocationCost(sizeof(b2Body));
+	if (m_bodyCount == m_bodyCapacity)
+	{
+		int32 capacity = b2Max(2 * m_bodyCapacity, b2_minBodyCapacity);
+		size += m_blockAllocator.GetAllocationCost(capacity * sizeof(b2Body*)) +
+			m_blockAllocator.GetAllocationCost(capacity * sizeof(b2Position)) +
+			m_blockAllocator.GetAllocationCost(capacity * sizeof(b2Velocity)) +
+			m_blockAllocator.GetAllocationCost(capacity * sizeof(b2Force)) +
+			m_blockAllocator.GetAllocationCost(capacity * sizeof(b2InverseMass));
+	}
+	if (ExceedsMemoryBudget(size))
+	{
+		return NULL;
+	}
+
+	void* mem = m_bodyAllocator.Allocate(sizeof(b2Body));
 	b2Body* b = new (mem) b2Body(def, this);
 
 	// Add to world doubly linked list.
@@ -109,8 +175,34 @@ b2Body* b2World::CreateBody(const b2BodyDef* def)
 		m_bodyList->m_prev = b;
 	}
 	m_bodyList = b;
+
+	// Append to the body arrays.
+	if (m_bodyCount == m_bodyCapacity)
+	{
+		int32 oldCapacity = m_bodyCapacity;
+		m_bodyCapacity = b2Max(2 * m_bodyCapacity, b2_minBodyCapacity);
+		m_bodies = ReallocateBuffer(m_bodies, oldCapacity, m_bodyCapacity);
+		m_positions = ReallocateBuffer(m_positions, oldCapacity, m_bodyCapacity);
+		m_velocities = ReallocateBuffer(m_velocities, oldCapacity, m_bodyCapacity);
+		m_forces = ReallocateBuffer(m_forces, oldCapacity, m_bodyCapacity);
+		m_inverseMasses = ReallocateBuffer(m_inverseMasses, oldCapacity,
+										   m_bodyCapacity);
+	}
+	b->m_worldIndex = m_bodyCount;
+	b->m_id = m_nextBodyId++;
+	m_bodies[m_bodyCount] = b;
+	m_velocities[m_bodyCount].v = def->linearVelocity;
+	m_velocities[m_bodyCount].w = def->angularVelocity;
+	m_forces[m_bodyCount].force.SetZero();
+	m_forces[m_bodyCount].torque = 0.0f;
+	// A dynamic body has unit mass until its fixtures give it one.
+	m_inverseMasses[m_bodyCount].invMass =
+		def->type == b2_dynamicBody ? 1.0f : 0.0f;
+	m_inverseMasses[m_bodyCount].invI = 0.0f;
 	++m_bodyCount;
 
+	m_islandGraph.LinkBody(b);
+
 	return b;
 }
 
@@ -123,6 +215,8 @@ void b2World::DestroyBody(b2Body* b)
 		return;
 	}
 
+	m_islandGraph.UnlinkBody(b);
+
 	// Delete the attached joints.
 	b2JointEdge* je = b->m_jointList;
 	while (je)
@@ -166,7 +260,7 @@ void b2World::DestroyBody(b2Body* b)
 		f0->DestroyProxies(&m_contactManager.m_broadPhase);
 		f0->Destroy(&m_blockAllocator);
 		f0->~b2Fixture();
-		m_blockAllocator.Free(f0, sizeof(b2Fixture));
+		m_fixtureAllocator.Free(f0, sizeof(b2Fixture));
 
 		b->m_fixtureList = f;
 		b->m_fixtureCount -= 1;
@@ -190,9 +284,31 @@ void b2World::DestroyBody(b2Body* b)
 		m_bodyList = b->m_next;
 	}
 
+	// Fill the hole in the body arrays with the last body.
+	b2Body* last = m_bodies[m_bodyCount - 1];
+	m_bodies[b->m_worldIndex] = last;
+	m_velocities[b->m_worldIndex] = m_velocities[last->m_worldIndex];
+	m_forces[b->m_worldIndex] = m_forces[last->m_worldIndex];
+	m_inverseMasses[b->m_worldIndex] = m_inverseMasses[last->m_worldIndex];
+	last->m_worldIndex = b->m_worldIndex;
+
 	--m_bodyCount;
 	b->~b2Body();
-	m_blockAllocator.Free(b, sizeof(b2Body));
+	m_bodyAllocator.Free(b, sizeof(b2Body));
+}
+
+// Reallocate a buffer from the block allocator.
+template <typename T> T* b2World::ReallocateBuffer(
+	T* oldBuffer, int32 oldCapacity, int32 newCapacity)
+{
+	b2Assert(newCapacity > oldCapacity);
+	T* newBuffer = (T*)m_blockAllocator.Allocate(sizeof(T) * newCapacity);
+	if (oldBuffer)
+	{
+		memcpy(newBuffer, oldBuffer, sizeof(T) * oldCapacity);
+		m_blockAllocator.Free(oldBuffer, sizeof(T) * oldCapacity);
+	}
+	return newBuffer;
 }
 
 b2Joint* b2World::CreateJoint(const b2JointDef* def)
@@ -250,6 +366,8 @@ b2Joint* b2World::CreateJoint(const b2JointDef* def)
 		}
 	}
 
+	m_islandGraph.LinkJoint(j);
+
 	// Note: creating a joint doesn't wake the bodies.
 
 	return j;
@@ -327,6 +445,11 @@ void b2World::DestroyJoint(b2Joint* j)
 	j->m_edgeB.prev = NULL;
 	j->m_edgeB.next = NULL;
 
+	if (j->m_island)
+	{
+		m_islandGraph.UnlinkJoint(j);
+	}
+
 	b2Joint::Destroy(j, &m_blockAllocator);
 
 	b2Assert(m_jointCount > 0);
@@ -430,12 +553,21 @@ void b2World::Init(const b2Vec2& gravity)
 	m_jointList = NULL;
 	m_particleSystemList = NULL;
 
+	m_bodies = NULL;
+	m_bodyCapacity = 0;
+	m_positions = NULL;
+	m_velocities = NULL;
+	m_forces = NULL;
+	m_inverseMasses = NULL;
+
 	m_bodyCount = 0;
 	m_jointCount = 0;
+	m_nextBodyId = 0;
 
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_batchJoints = true;
 
 	m_stepComplete = true;
 
@@ -446,7 +578,14 @@ void b2World::Init(const b2Vec2& gravity)
 
 	m_inv_dt0 = 0.0f;
 
-	m_contactManager.m_allocator = &m_blockAllocator;
+	m_memoryBudget = 0;
+
+	m_taskExecutor = NULL;
+	m_coloringThreshold = b2_defaultColoringThreshold;
+	m_deterministic = false;
+
+	m_contactManager.m_allocator = &m_contactAllocator;
+	m_islandGraph.m_allocator = &m_blockAllocator;
 
 	m_liquidFunVersion = &b2_liquidFunVersion;
 	m_liquidFunVersionString = b2_liquidFunVersionString;
@@ -457,6 +596,7 @@ void b2World::Init(const b2Vec2& gravity)
 // Find islands, integrate and solve constraints, solve position constraints
 void b2World::Solve(const b2TimeStep& step)
 {
+	b2TraceZone("b2World::Solve");
 	// update previous transforms
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
@@ -471,138 +611,88 @@ void b2World::Solve(const b2TimeStep& step)
 	b2Island island(m_bodyCount,
 					m_contactManager.m_contactCount,
 					m_jointCount,
+					m_positions,
+					m_velocities,
+					m_forces,
+					m_inverseMasses,
+					&m_frameArena,
 					&m_stackAllocator,
-					m_contactManager.m_contactListener);
-
-	// Clear all the island flags.
-	for (b2Body* b = m_bodyList; b; b = b->m_next)
-	{
-		b->m_flags &= ~b2Body::e_islandFlag;
-	}
-	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
-	{
-		c->m_flags &= ~b2Contact::e_islandFlag;
-	}
-	for (b2Joint* j = m_jointList; j; j = j->m_next)
-	{
-		j->m_islandFlag = false;
+					m_contactManager.m_contactListener,
+					m_taskExecutor,
+					m_coloringThreshold,
+					m_deterministic);
+
+	// Join the islands linked since the last step and split those which
+	// may have come apart, so that each part is solved and sleeps on its
+	// own.
+	m_islandGraph.MergeIslands();
+	b2PersistentIsland* next;
+	for (b2PersistentIsland* pi = m_islandGraph.GetAwakeIslandList(); pi;
+		 pi = next)
+	{
+		next = pi->next;
+		if (pi->constraintRemoveCount > 0)
+		{
+			m_islandGraph.SplitIsland(pi, &m_stackAllocator);
+		}
 	}
 
-	// Build and simulate all awake islands.
-	int32 stackSize = m_bodyCount;
-	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
-	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
+	// The bodies moved by the solver.
+	b2Body** moved = (b2Body**)m_frameArena.Allocate(m_bodyCount * sizeof(b2Body*));
+	int32 movedCount = 0;
+
+	// Simulate all awake islands.
+	for (b2PersistentIsland* pi = m_islandGraph.GetAwakeIslandList(); pi;
+		 pi = next)
 	{
-		if (seed->m_flags & b2Body::e_islandFlag)
-		{
-			continue;
-		}
+		next = pi->next;
 
-		if (seed->IsAwake() == false || seed->IsActive() == false)
+		// An island is simulated while any of its bodies is awake. All of
+		// them may have been put to sleep since it was woken.
+		bool awake = false;
+		for (b2Body* b = pi->bodyList; b; b = b->m_islandNext)
 		{
-			continue;
+			if (b->IsAwake())
+			{
+				awake = true;
+				break;
+			}
 		}
-
-		// The seed can be dynamic or kinematic.
-		if (seed->GetType() == b2_staticBody)
+		if (awake == false)
 		{
+			m_islandGraph.SleepIsland(pi);
 			continue;
 		}
 
-		// Reset island and stack.
 		island.Clear();
-		int32 stackCount = 0;
-		stack[stackCount++] = seed;
-		seed->m_flags |= b2Body::e_islandFlag;
-
-		// Perform a depth first search (DFS) on the constraint graph.
-		while (stackCount > 0)
+		for (b2Body* b = pi->bodyList; b; b = b->m_islandNext)
 		{
-			// Grab the next body off the stack and add it to the island.
-			b2Body* b = stack[--stackCount];
-			b2Assert(b->IsActive() == true);
 			island.Add(b);
 
 			// Make sure the body is awake.
 			b->SetAwake(true);
 
-			// To keep islands as small as possible, we don't
-			// propagate islands across static bodies.
-			if (b->GetType() == b2_staticBody)
-			{
-				continue;
-			}
+			moved[movedCount++] = b;
+		}
 
-			// Search all contacts connected to this body.
-			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		for (b2Contact* c = pi->contactList; c; c = c->m_islandNext)
+		{
+			// Skip contacts disabled by the user.
+			if (c->IsEnabled() == false)
 			{
-				b2Contact* contact = ce->contact;
-
-				// Has this contact already been added to an island?
-				if (contact->m_flags & b2Contact::e_islandFlag)
-				{
-					continue;
-				}
-
-				// Is this contact solid and touching?
-				if (contact->IsEnabled() == false ||
-					contact->IsTouching() == false)
-				{
-					continue;
-				}
-
-				// Skip sensors.
-				bool sensorA = contact->m_fixtureA->m_isSensor;
-				bool sensorB = contact->m_fixtureB->m_isSensor;
-				if (sensorA || sensorB)
-				{
-					continue;
-				}
-
-				island.Add(contact);
-				contact->m_flags |= b2Contact::e_islandFlag;
-
-				b2Body* other = ce->other;
-
-				// Was the other body already added to this island?
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
-
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
+				continue;
 			}
 
-			// Search all joints connect to this body.
-			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
-			{
-				if (je->joint->m_islandFlag == true)
-				{
-					continue;
-				}
-
-				b2Body* other = je->other;
-
-				// Don't simulate joints connected to inactive bodies.
-				if (other->IsActive() == false)
-				{
-					continue;
-				}
-
-				island.Add(je->joint);
-				je->joint->m_islandFlag = true;
-
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
+			island.Add(c);
+			island.AddStatic(c->m_fixtureA->m_body);
+			island.AddStatic(c->m_fixtureB->m_body);
+		}
 
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
-			}
+		for (b2Joint* j = pi->jointList; j; j = j->m_islandNext)
+		{
+			island.Add(j);
+			island.AddStatic(j->m_bodyA);
+			island.AddStatic(j->m_bodyB);
 		}
 
 		b2Profile profile;
@@ -621,28 +711,22 @@ void b2World::Solve(const b2TimeStep& step)
 				b->m_flags &= ~b2Body::e_islandFlag;
 			}
 		}
-	}
 
-	m_stackAllocator.Free(stack);
+		// The solver puts the bodies of an island to sleep together.
+		if (pi->bodyList->IsAwake() == false)
+		{
+			m_islandGraph.SleepIsland(pi);
+		}
+	}
 
 	{
 		b2Timer timer;
-		// Synchronize fixtures, check for out of range bodies.
-		for (b2Body* b = m_bodyList; b; b = b->GetNext())
+		// Synchronize fixtures, check for out of range bodies. Bodies which
+		// were not in an awake island did not move.
+		for (int32 i = 0; i < movedCount; ++i)
 		{
-			// If a body was not in an island then it did not move.
-			if ((b->m_flags & b2Body::e_islandFlag) == 0)
-			{
-				continue;
-			}
-
-			if (b->GetType() == b2_staticBody)
-			{
-				continue;
-			}
-
 			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
+			moved[i]->SynchronizeFixtures(step.dt);
 		}
 
 		// Look for new contacts.
@@ -651,143 +735,236 @@ void b2World::Solve(const b2TimeStep& step)
 	}
 }
 
-// Find TOI contacts and solve them.
-void b2World::SolveTOI(const b2TimeStep& step)
+// A candidate TOI event in b2World::SolveTOI. order grows with every push,
+// so ties on alpha resolve in the order contacts were examined. An entry is
+// live only while it matches its contact's m_toiOrder.
+struct b2TOIEvent
 {
-	b2Island island(2 * b2_maxTOIContacts, b2_maxTOIContacts, 0, &m_stackAllocator, m_contactManager.m_contactListener);
+	b2Contact* contact;
+	float32 alpha;
+	uint32 order;
+};
 
-	if (m_stepComplete)
+// The std heap functions build max-heaps, so order events latest first.
+static inline bool b2TOIEventIsLater(const b2TOIEvent& a, const b2TOIEvent& b)
+{
+	return a.alpha > b.alpha || (a.alpha == b.alpha && a.order > b.order);
+}
+
+// Compute the time of impact of a contact within the current step, reusing
+// the cached value when it is still valid. Contacts that are not eligible for
+// continuous collision return 1.
+float32 b2World::ComputeTOI(b2Contact* c)
+{
+	// Is this contact disabled?
+	if (c->IsEnabled() == false)
 	{
-		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		return 1.0f;
+	}
+
+	// Prevent excessive sub-stepping.
+	if (c->m_toiCount > b2_maxSubSteps)
+	{
+		return 1.0f;
+	}
+
+	float32 alpha = 1.0f;
+	if (c->m_flags & b2Contact::e_toiFlag)
+	{
+		// This contact has a valid cached TOI.
+		alpha = c->m_toi;
+	}
+	else
+	{
+		b2Fixture* fA = c->GetFixtureA();
+		b2Fixture* fB = c->GetFixtureB();
+
+		// Is there a sensor?
+		if (fA->IsSensor() || fB->IsSensor())
 		{
-			b->m_flags &= ~b2Body::e_islandFlag;
-			b->m_sweep.alpha0 = 0.0f;
+			return 1.0f;
 		}
 
-		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		b2Body* bA = fA->GetBody();
+		b2Body* bB = fB->GetBody();
+
+		b2BodyType typeA = bA->m_type;
+		b2BodyType typeB = bB->m_type;
+		b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
+
+		bool activeA = bA->IsAwake() && typeA != b2_staticBody;
+		bool activeB = bB->IsAwake() && typeB != b2_staticBody;
+
+		// Is at least one body active (awake and dynamic or kinematic)?
+		if (activeA == false && activeB == false)
 		{
-			// Invalidate TOI
-			c->m_flags &= ~(b2Contact::e_toiFlag | b2Contact::e_islandFlag);
-			c->m_toiCount = 0;
-			c->m_toi = 1.0f;
+			return 1.0f;
 		}
-	}
 
-	// Find TOI events and solve them.
-	for (;;)
-	{
-		// Find the first TOI.
-		b2Contact* minContact = NULL;
-		float32 minAlpha = 1.0f;
+		// Speculative contacts keep these bodies from tunneling.
+		if (bA->IsSpeculative() || bB->IsSpeculative())
+		{
+			return 1.0f;
+		}
 
-		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
+		bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
+
+		// Are these two non-bullet dynamic bodies?
+		if (collideA == false && collideB == false)
 		{
-			// Is this contact disabled?
-			if (c->IsEnabled() == false)
-			{
-				continue;
-			}
+			return 1.0f;
+		}
 
-			// Prevent excessive sub-stepping.
-			if (c->m_toiCount > b2_maxSubSteps)
-			{
-				continue;
-			}
+		// Compute the TOI for this contact.
+		// Put the sweeps onto the same time interval.
+		float32 alpha0 = bA->m_sweep.alpha0;
 
-			float32 alpha = 1.0f;
-			if (c->m_flags & b2Contact::e_toiFlag)
-			{
-				// This contact has a valid cached TOI.
-				alpha = c->m_toi;
-			}
-			else
-			{
-				b2Fixture* fA = c->GetFixtureA();
-				b2Fixture* fB = c->GetFixtureB();
+		if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
+		{
+			alpha0 = bB->m_sweep.alpha0;
+			bA->m_sweep.Advance(alpha0);
+		}
+		else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
+		{
+			alpha0 = bA->m_sweep.alpha0;
+			bB->m_sweep.Advance(alpha0);
+		}
 
-				// Is there a sensor?
-				if (fA->IsSensor() || fB->IsSensor())
-				{
-					continue;
-				}
+		b2Assert(alpha0 < 1.0f);
 
-				b2Body* bA = fA->GetBody();
-				b2Body* bB = fB->GetBody();
+		int32 indexA = c->GetChildIndexA();
+		int32 indexB = c->GetChildIndexB();
 
-				b2BodyType typeA = bA->m_type;
-				b2BodyType typeB = bB->m_type;
-				b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
+		// Compute the time of impact in interval [0, minTOI]
+		b2TOIInput input;
+		input.proxyA.Set(fA->GetShape(), indexA);
+		input.proxyB.Set(fB->GetShape(), indexB);
+		input.sweepA = bA->m_sweep;
+		input.sweepB = bB->m_sweep;
+		input.tMax = 1.0f;
 
-				bool activeA = bA->IsAwake() && typeA != b2_staticBody;
-				bool activeB = bB->IsAwake() && typeB != b2_staticBody;
+		b2TOIOutput output;
+		b2TimeOfImpact(&output, &input);
 
-				// Is at least one body active (awake and dynamic or kinematic)?
-				if (activeA == false && activeB == false)
-				{
-					continue;
-				}
+		// Beta is the fraction of the remaining portion of the .
+		float32 beta = output.t;
+		if (output.state == b2TOIOutput::e_touching)
+		{
+			alpha = b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
+		}
+		else
+		{
+			alpha = 1.0f;
+		}
 
-				bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
-				bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
+		c->m_toi = alpha;
+		c->m_flags |= b2Contact::e_toiFlag;
+	}
+	return alpha;
+}
 
-				// Are these two non-bullet dynamic bodies?
-				if (collideA == false && collideB == false)
-				{
-					continue;
-				}
+// Push the contact's TOI onto the queue if it falls inside the step. Any
+// older entry for the contact becomes stale.
+void b2World::QueueTOI(b2Contact* c, b2GrowableBuffer<b2TOIEvent>& queue,
+					   uint32* order)
+{
+	float32 alpha = ComputeTOI(c);
+	if (alpha >= 1.0f)
+	{
+		c->m_toiOrder = 0;
+		return;
+	}
 
-				// Compute the TOI for this contact.
-				// Put the sweeps onto the same time interval.
-				float32 alpha0 = bA->m_sweep.alpha0;
+	b2TOIEvent& event = queue.Append();
+	event.contact = c;
+	event.alpha = alpha;
+	event.order = ++(*order);
+	c->m_toiOrder = event.order;
+	std::push_heap(queue.Begin(), queue.End(), b2TOIEventIsLater);
+}
 
-				if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
-				{
-					alpha0 = bB->m_sweep.alpha0;
-					bA->m_sweep.Advance(alpha0);
-				}
-				else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
-				{
-					alpha0 = bA->m_sweep.alpha0;
-					bB->m_sweep.Advance(alpha0);
-				}
+// Re-examine the contacts on a body that moved or woke up. Contacts with a
+// valid cached TOI already have an accurate entry in the queue (or need none).
+// Static bodies never move or wake, so their contacts are left alone.
+void b2World::QueueBodyTOIs(b2Body* body, b2GrowableBuffer<b2TOIEvent>& queue,
+							uint32* order)
+{
+	if (body->m_type == b2_staticBody)
+	{
+		return;
+	}
 
-				b2Assert(alpha0 < 1.0f);
+	for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
+	{
+		if ((ce->contact->m_flags & b2Contact::e_toiFlag) == 0)
+		{
+			QueueTOI(ce->contact, queue, order);
+		}
+	}
+}
 
-				int32 indexA = c->GetChildIndexA();
-				int32 indexB = c->GetChildIndexB();
+void b2World::SolveTOI(const b2TimeStep& step)
+{
+	b2TraceZone("b2World::SolveTOI");
+	b2Island island(2 * b2_maxTOIContacts, b2_maxTOIContacts, 0, m_positions, m_velocities, m_forces, m_inverseMasses, &m_frameArena, &m_stackAllocator, m_contactManager.m_contactListener, NULL, 0, false);
 
-				// Compute the time of impact in interval [0, minTOI]
-				b2TOIInput input;
-				input.proxyA.Set(fA->GetShape(), indexA);
-				input.proxyB.Set(fB->GetShape(), indexB);
-				input.sweepA = bA->m_sweep;
-				input.sweepB = bB->m_sweep;
-				input.tMax = 1.0f;
+	if (m_stepComplete)
+	{
+		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			b->m_flags &= ~b2Body::e_islandFlag;
+			b->m_sweep.alpha0 = 0.0f;
+		}
 
-				b2TOIOutput output;
-				b2TimeOfImpact(&output, &input);
+		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		{
+			// Invalidate TOI
+			c->m_flags &= ~(b2Contact::e_toiFlag | b2Contact::e_islandFlag);
+			c->m_toiCount = 0;
+			c->m_toi = 1.0f;
+		}
+	}
 
-				// Beta is the fraction of the remaining portion of the .
-				float32 beta = output.t;
-				if (output.state == b2TOIOutput::e_touching)
-				{
-					alpha = b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
-				}
-				else
-				{
-					alpha = 1.0f;
-				}
+	// Find TOI events and solve them. Candidate events live in a min-heap so
+	// only contacts touched by a sub-step are re-examined, rather than
+	// scanning every contact for each event.
+	b2GrowableBuffer<b2TOIEvent> queue(m_blockAllocator);
+	queue.Reserve(b2_maxTOIContacts);
+	uint32 order = 0;
+	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		QueueTOI(c, queue, &order);
+	}
 
-				c->m_toi = alpha;
-				c->m_flags |= b2Contact::e_toiFlag;
-			}
+	// Find TOI contacts and solve them.
+	for (;;)
+	{
+		// Find the first TOI.
+		b2Contact* minContact = NULL;
+		float32 minAlpha = 1.0f;
 
-			if (alpha < minAlpha)
+		while (queue.GetCount() > 0)
+		{
+			std::pop_heap(queue.Begin(), queue.End(), b2TOIEventIsLater);
+			b2TOIEvent event = queue[queue.GetCount() - 1];
+			queue.SetCount(queue.GetCount() - 1);
+
+			// Skip entries that were superseded or invalidated since they
+			// were queued.
+			b2Contact* c = event.contact;
+			if (c->m_toiOrder != event.order ||
+				(c->m_flags & b2Contact::e_toiFlag) == 0 ||
+				c->IsEnabled() == false ||
+				c->m_toiCount > b2_maxSubSteps)
 			{
-				// This is the minimum TOI found so far.
-				minContact = c;
-				minAlpha = alpha;
+				continue;
 			}
+
+			c->m_toiOrder = 0;
+			minContact = c;
+			minAlpha = event.alpha;
+			break;
 		}
 
 		if (minContact == NULL || 1.0f - 10.0f * b2_epsilon < minAlpha)
@@ -874,6 +1051,12 @@ void b2World::SolveTOI(const b2TimeStep& step)
 						continue;
 					}
 
+					// Speculative bodies stay out of TOI islands.
+					if (other->IsSpeculative())
+					{
+						continue;
+					}
+
 					// Skip sensors.
 					bool sensorA = contact->m_fixtureA->m_isSensor;
 					bool sensorB = contact->m_fixtureB->m_isSensor;
@@ -939,6 +1122,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.particleIterations = step.particleIterations;
 		subStep.warmStarting = false;
+		subStep.batchJoints = step.batchJoints;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -952,7 +1136,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				continue;
 			}
 
-			body->SynchronizeFixtures();
+			body->SynchronizeFixtures(step.dt);
 
 			// Invalidate all contact TOIs on this displaced body.
 			for (b2ContactEdge* ce = body->m_contactList; ce; ce = ce->next)
@@ -963,8 +1147,25 @@ void b2World::SolveTOI(const b2TimeStep& step)
 
 		// Commit fixture proxy movements to the broad-phase so that new contacts are created.
 		// Also, some contacts can be destroyed.
+		b2Contact* oldContactList = m_contactManager.m_contactList;
 		m_contactManager.FindNewContacts();
 
+		// Queue the contacts of the displaced bodies. Bodies that were
+		// woken, by the island or by a new contact, may have contacts that
+		// were skipped while they slept.
+		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		{
+			QueueBodyTOIs(island.m_bodies[i], queue, &order);
+		}
+
+		// New contacts are added to the front of the contact list.
+		for (b2Contact* c = m_contactManager.m_contactList;
+			 c != oldContactList; c = c->m_next)
+		{
+			QueueBodyTOIs(c->GetFixtureA()->GetBody(), queue, &order);
+			QueueBodyTOIs(c->GetFixtureB()->GetBody(), queue, &order);
+		}
+
 		if (m_subStepping)
 		{
 			m_stepComplete = false;
@@ -979,8 +1180,13 @@ void b2World::Step(
 	int32 positionIterations,
 	int32 particleIterations)
 {
+	b2TraceZone("b2World::Step");
 	b2Timer stepTimer;
 
+	// Size the stack for the largest step so far so that steady stepping
+	// doesn't touch the heap.
+	m_stackAllocator.Reserve(m_stackAllocator.GetMaxAllocation());
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_flags & e_newFixture)
 	{
@@ -1007,6 +1213,7 @@ void b2World::Step(
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.batchJoints = m_batchJoints;
 
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -1045,6 +1252,9 @@ void b2World::Step(
 		ClearForces();
 	}
 
+	// Scratch memory from this step is no longer referenced.
+	m_frameArena.Reset();
+
 	m_flags &= ~e_locked;
 
 	m_profile.step = stepTimer.GetMilliseconds();
@@ -1052,10 +1262,10 @@ void b2World::Step(
 
 void b2World::ClearForces()
 {
-	for (b2Body* body = m_bodyList; body; body = body->GetNext())
+	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		body->m_force.SetZero();
-		body->m_torque = 0.0f;
+		m_forces[i].force.SetZero();
+		m_forces[i].torque = 0.0f;
 	}
 }
 
@@ -1094,6 +1304,43 @@ void b2World::QueryShapeAABB(b2QueryCallback* callback, const b2Shape& shape,
 	QueryAABB(callback, aabb);
 }
 
+// Casts a ray against the edges of a chain with an edge tree. The tree is
+// in the chain's frame, so it gets the ray in that frame, which keeps the
+// fractions.
+struct b2WorldEdgeRayCastWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& localInput, int32 leafId)
+	{
+		int32 index = (int32)(intptr_t)tree->GetUserData(leafId);
+		b2RayCastInput input = *worldInput;
+		input.maxFraction = localInput.maxFraction;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, index);
+
+		if (hit)
+		{
+			float32 fraction = output.fraction;
+			b2Vec2 point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			float32 value =
+				callback->ReportFixture(fixture, point, output.normal, fraction);
+			if (value >= 0.0f)
+			{
+				// Zero ends both casts, a fraction clips both.
+				maxFraction = value;
+			}
+			return value;
+		}
+
+		return localInput.maxFraction;
+	}
+
+	const b2DynamicTree* tree;
+	b2Fixture* fixture;
+	const b2RayCastInput* worldInput;
+	b2RayCastCallback* callback;
+	float32 maxFraction;
+};
+
 struct b2WorldRayCastWrapper
 {
 	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
@@ -1102,6 +1349,24 @@ struct b2WorldRayCastWrapper
 		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
 		b2Fixture* fixture = proxy->fixture;
 		int32 index = proxy->childIndex;
+		if (index == b2_edgeTreeChildIndex)
+		{
+			const b2ChainShape* chain = (const b2ChainShape*)fixture->GetShape();
+			const b2Transform& xf = fixture->GetBody()->GetTransform();
+			b2WorldEdgeRayCastWrapper wrapper;
+			wrapper.tree = chain->GetEdgeTree();
+			wrapper.fixture = fixture;
+			wrapper.worldInput = &input;
+			wrapper.callback = callback;
+			wrapper.maxFraction = input.maxFraction;
+			b2RayCastInput localInput;
+			localInput.p1 = b2MulT(xf, input.p1);
+			localInput.p2 = b2MulT(xf, input.p2);
+			localInput.maxFraction = input.maxFraction;
+			wrapper.tree->RayCast(&wrapper, localInput);
+			return wrapper.maxFraction;
+		}
+
 		b2RayCastOutput output;
 		bool hit = fixture->RayCast(&output, input, index);
 
@@ -1138,7 +1403,273 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	}
 }
 
-void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
+// Run function on count packets, spread over the executor if there is one.
+static void b2RunPackets(b2TaskExecutor* executor, b2TaskRangeFunction function,
+						 void* context, int32 count)
+{
+	if (executor)
+	{
+		executor->ParallelFor(function, context, count, b2_minQueryPacketRange);
+	}
+	else
+	{
+		function(context, 0, count);
+	}
+}
+
+// Shared state of b2World::QueryAABBs(). The first pass counts the fixtures
+// found for each AABB into starts, the second writes them.
+struct b2WorldQueryBatch
+{
+	const b2BroadPhase* broadPhase;
+	const b2AABB* aabbs;
+	int32 count;
+	b2Fixture** fixtures;
+	int32 capacity;
+	int32* starts;
+	bool write;
+};
+
+// The AABBs of b2World::QueryAABBs() walked through the tree together.
+struct b2WorldQueryPacket
+{
+	const b2WorldQueryBatch* batch;
+	// Fixtures counted so far in the first pass, the next index to write
+	// to in the second.
+	int32 cursors[b2_treePacketSize];
+};
+
+static void b2WorldQueryPacketLeaf(void* context, int32 proxyId, int32 laneMask)
+{
+	b2WorldQueryPacket* packet = (b2WorldQueryPacket*)context;
+	const b2WorldQueryBatch* batch = packet->batch;
+	b2FixtureProxy* proxy =
+		(b2FixtureProxy*)batch->broadPhase->GetUserData(proxyId);
+	for (int32 l = 0; l < b2_treePacketSize; ++l)
+	{
+		if (laneMask & (1 << l))
+		{
+			const int32 index = packet->cursors[l]++;
+			if (batch->write && index < batch->capacity)
+			{
+				batch->fixtures[index] = proxy->fixture;
+			}
+		}
+	}
+}
+
+static void b2WorldQueryRange(void* context, int32 begin, int32 end)
+{
+	const b2WorldQueryBatch* batch = (const b2WorldQueryBatch*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		const int32 first = i * b2_treePacketSize;
+		const int32 count = b2Min(batch->count - first, b2_treePacketSize);
+		b2WorldQueryPacket packet;
+		packet.batch = batch;
+		for (int32 l = 0; l < count; ++l)
+		{
+			packet.cursors[l] = batch->write ? batch->starts[first + l] : 0;
+		}
+
+		batch->broadPhase->QueryPacket(&b2WorldQueryPacketLeaf, &packet,
+									   batch->aabbs + first, count);
+
+		if (!batch->write)
+		{
+			for (int32 l = 0; l < count; ++l)
+			{
+				batch->starts[first + l + 1] = packet.cursors[l];
+			}
+		}
+	}
+}
+
+int32 b2World::QueryAABBs(const b2AABB* aabbs, int32 count,
+						  b2Fixture** fixtures, int32 capacity,
+						  int32* starts) const
+{
+	b2TraceZone("b2World::QueryAABBs");
+	starts[0] = 0;
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	b2WorldQueryBatch batch;
+	batch.broadPhase = &m_contactManager.m_broadPhase;
+	batch.aabbs = aabbs;
+	batch.count = count;
+	batch.fixtures = fixtures;
+	batch.capacity = capacity;
+	batch.starts = starts;
+	const int32 packetCount =
+		(count + b2_treePacketSize - 1) / b2_treePacketSize;
+
+	// Count the fixtures of each AABB, so each can be written in place.
+	batch.write = false;
+	b2RunPackets(m_taskExecutor, &b2WorldQueryRange, &batch, packetCount);
+	for (int32 i = 0; i < count; ++i)
+	{
+		starts[i + 1] += starts[i];
+	}
+
+	batch.write = true;
+	b2RunPackets(m_taskExecutor, &b2WorldQueryRange, &batch, packetCount);
+	return starts[count];
+}
+
+// Finds the closest edge a ray hits in a chain with an edge tree.
+struct b2WorldEdgeClosestRayCast
+{
+	float32 RayCastCallback(const b2RayCastInput& localInput, int32 leafId)
+	{
+		int32 index = (int32)(intptr_t)tree->GetUserData(leafId);
+		b2RayCastInput input = *worldInput;
+		input.maxFraction = localInput.maxFraction;
+		b2RayCastOutput edgeOutput;
+		if (fixture->RayCast(&edgeOutput, input, index))
+		{
+			*output = edgeOutput;
+			hit = true;
+			return edgeOutput.fraction;
+		}
+		return localInput.maxFraction;
+	}
+
+	const b2DynamicTree* tree;
+	const b2Fixture* fixture;
+	const b2RayCastInput* worldInput;
+	b2RayCastOutput* output;
+	bool hit;
+};
+
+// Ray-cast a child of a fixture, or the closest edge of a chain's edge
+// tree for b2_edgeTreeChildIndex.
+static bool b2RayCastFixtureChild(const b2Fixture* fixture, int32 childIndex,
+								  const b2RayCastInput& input,
+								  b2RayCastOutput* output)
+{
+	if (childIndex != b2_edgeTreeChildIndex)
+	{
+		return fixture->RayCast(output, input, childIndex);
+	}
+
+	const b2ChainShape* chain = (const b2ChainShape*)fixture->GetShape();
+	const b2Transform& xf = fixture->GetBody()->GetTransform();
+	b2WorldEdgeClosestRayCast closest;
+	closest.tree = chain->GetEdgeTree();
+	closest.fixture = fixture;
+	closest.worldInput = &input;
+	closest.output = output;
+	closest.hit = false;
+	b2RayCastInput localInput;
+	localInput.p1 = b2MulT(xf, input.p1);
+	localInput.p2 = b2MulT(xf, input.p2);
+	localInput.maxFraction = input.maxFraction;
+	closest.tree->RayCast(&closest, localInput);
+	return closest.hit;
+}
+
+// Shared state of b2World::RayCastClosest().
+struct b2WorldRayCastBatch
+{
+	const b2BroadPhase* broadPhase;
+	const b2Vec2* points1;
+	const b2Vec2* points2;
+	int32 count;
+	b2RayCastHit* hits;
+};
+
+// The rays of b2World::RayCastClosest() cast through the tree together.
+struct b2WorldRayCastPacket
+{
+	const b2BroadPhase* broadPhase;
+	b2RayCastHit* hits;
+};
+
+static int32 b2WorldRayCastPacketLeaf(void* context, int32 proxyId,
+									  int32 laneMask, b2RayCastInput* inputs)
+{
+	b2WorldRayCastPacket* packet = (b2WorldRayCastPacket*)context;
+	b2FixtureProxy* proxy =
+		(b2FixtureProxy*)packet->broadPhase->GetUserData(proxyId);
+	b2Fixture* fixture = proxy->fixture;
+	if (fixture->IsSensor())
+	{
+		return 0;
+	}
+
+	for (int32 l = 0; l < b2_treePacketSize; ++l)
+	{
+		if ((laneMask & (1 << l)) == 0)
+		{
+			continue;
+		}
+
+		b2RayCastInput& input = inputs[l];
+		b2RayCastOutput output;
+		if (b2RayCastFixtureChild(fixture, proxy->childIndex, input, &output))
+		{
+			float32 fraction = output.fraction;
+			b2RayCastHit& hit = packet->hits[l];
+			hit.fixture = fixture;
+			hit.point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+			hit.normal = output.normal;
+			hit.fraction = fraction;
+
+			// Only closer hits matter now.
+			input.maxFraction = fraction;
+		}
+	}
+	return 0;
+}
+
+static void b2WorldRayCastRange(void* context, int32 begin, int32 end)
+{
+	const b2WorldRayCastBatch* batch = (const b2WorldRayCastBatch*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		const int32 first = i * b2_treePacketSize;
+		const int32 count = b2Min(batch->count - first, b2_treePacketSize);
+		b2RayCastInput inputs[b2_treePacketSize];
+		for (int32 l = 0; l < count; ++l)
+		{
+			inputs[l].p1 = batch->points1[first + l];
+			inputs[l].p2 = batch->points2[first + l];
+			inputs[l].maxFraction = 1.0f;
+
+			b2RayCastHit& hit = batch->hits[first + l];
+			hit.fixture = NULL;
+			hit.point = inputs[l].p2;
+			hit.normal.SetZero();
+			hit.fraction = 1.0f;
+		}
+
+		b2WorldRayCastPacket packet;
+		packet.broadPhase = batch->broadPhase;
+		packet.hits = batch->hits + first;
+		batch->broadPhase->RayCastPacket(&b2WorldRayCastPacketLeaf, &packet,
+										 inputs, count);
+	}
+}
+
+void b2World::RayCastClosest(const b2Vec2* points1, const b2Vec2* points2,
+							 int32 count, b2RayCastHit* hits) const
+{
+	b2TraceZone("b2World::RayCastClosest");
+	b2WorldRayCastBatch batch;
+	batch.broadPhase = &m_contactManager.m_broadPhase;
+	batch.points1 = points1;
+	batch.points2 = points2;
+	batch.count = count;
+	batch.hits = hits;
+	const int32 packetCount =
+		(count + b2_treePacketSize - 1) / b2_treePacketSize;
+	b2RunPackets(m_taskExecutor, &b2WorldRayCastRange, &batch, packetCount);
+}
+
+void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
 	switch (fixture->GetType())
 	{
@@ -1440,6 +1971,561 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 }
 
+int32 b2World::TrimMemory()
+{
+	b2Assert(IsLocked() == false);
+	return m_blockAllocator.Trim() + m_bodyAllocator.Trim() +
+		m_fixtureAllocator.Trim() + m_contactAllocator.Trim();
+}
+
+void b2World::GetMemoryStats(b2WorldMemoryStats* stats) const
+{
+	const b2BlockAllocator* allocators[] =
+	{
+		&m_blockAllocator, &m_bodyAllocator, &m_fixtureAllocator,
+		&m_contactAllocator
+	};
+	stats->blockBytes = 0;
+	stats->giantBytes = 0;
+	for (uint32 i = 0; i < B2_ARRAY_SIZE(allocators); ++i)
+	{
+		stats->blockBytes += allocators[i]->GetChunkBytes();
+		stats->giantBytes += allocators[i]->GetGiantBytes();
+	}
+
+	// Segment 0 is built into the stack allocator.
+	stats->stackBytes = 0;
+	for (int32 i = 1; i < m_stackAllocator.GetSegmentCount(); ++i)
+	{
+		stats->stackBytes += m_stackAllocator.GetSegmentCapacity(i);
+	}
+
+	stats->frameArenaBytes = m_frameArena.GetChunkBytes();
+
+	stats->particleBytes = 0;
+	for (const b2ParticleSystem* p = m_particleSystemList; p; p = p->GetNext())
+	{
+		stats->particleBytes += p->GetMemoryUsage();
+	}
+
+	stats->broadPhaseBytes = m_contactManager.m_broadPhase.GetMemoryUsage();
+	stats->allocatorBytes = m_accountingAllocator.GetAllocation();
+	stats->maxAllocatorBytes = m_accountingAllocator.GetMaxAllocation();
+	stats->totalBytes = stats->allocatorBytes + stats->broadPhaseBytes;
+	stats->budget = m_memoryBudget;
+}
+
+// Add the bits of value to an FNV-1a hash.
+static uint32 b2HashFloat(uint32 hash, float32 value)
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int32 i = 0; i < 4; ++i)
+	{
+		hash = (hash ^ (bits & 0xff)) * 16777619u;
+		bits >>= 8;
+	}
+	return hash;
+}
+
+static uint32 b2HashVec2(uint32 hash, const b2Vec2& v)
+{
+	return b2HashFloat(b2HashFloat(hash, v.x), v.y);
+}
+
+uint32 b2World::GetChecksum() const
+{
+	uint32 hash = 2166136261u;
+	for (const b2Body* b = m_bodyList; b; b = b->GetNext())
+	{
+		hash = b2HashVec2(hash, b->GetPosition());
+		hash = b2HashFloat(hash, b->GetAngle());
+		hash = b2HashVec2(hash, b->GetLinearVelocity());
+		hash = b2HashFloat(hash, b->GetAngularVelocity());
+	}
+
+	for (const b2ParticleSystem* p = m_particleSystemList; p; p = p->GetNext())
+	{
+		const b2Vec2* positions = p->GetPositionBuffer();
+		const b2Vec2* velocities = p->GetVelocityBuffer();
+		const int32 count = p->GetParticleCount();
+		for (int32 i = 0; i < count; ++i)
+		{
+			hash = b2HashVec2(hash, positions[i]);
+			hash = b2HashVec2(hash, velocities[i]);
+		}
+	}
+	return hash;
+}
+
+// Snapshots hold the sizes of the structs they copy whole, so builds which
+// lay them out differently don't read each other's snapshots.
+static void b2WriteSnapshotLayout(b2SnapshotWriter* writer)
+{
+	writer->Write((int32)sizeof(b2TreeNode));
+	writer->Write((int32)sizeof(b2Manifold));
+	writer->Write((int32)sizeof(b2ParticleContact));
+	writer->Write((int32)sizeof(b2ParticleTriad));
+}
+
+static bool b2ReadSnapshotLayout(b2SnapshotReader* reader)
+{
+	return
+		reader->Read<int32>() == (int32)sizeof(b2TreeNode) &&
+		reader->Read<int32>() == (int32)sizeof(b2Manifold) &&
+		reader->Read<int32>() == (int32)sizeof(b2ParticleContact) &&
+		reader->Read<int32>() == (int32)sizeof(b2ParticleTriad);
+}
+
+void b2World::SaveSnapshot(b2Snapshot* snapshot)
+{
+	b2Assert(IsLocked() == false);
+	b2TraceZone("b2World::SaveSnapshot");
+
+	snapshot->Clear();
+	b2SnapshotWriter writer(snapshot);
+	writer.Write(b2_snapshotMagic);
+	writer.Write(b2_snapshotVersion);
+	b2WriteSnapshotLayout(&writer);
+
+	writer.Write(m_flags);
+	writer.Write(m_gravity);
+	writer.Write(m_allowSleep);
+	writer.Write(m_inv_dt0);
+	writer.Write(m_warmStarting);
+	writer.Write(m_continuousPhysics);
+	writer.Write(m_subStepping);
+	writer.Write(m_stepComplete);
+	writer.Write(m_nextBodyId);
+
+	writer.Write(m_bodyCount);
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		m_bodies[i]->Save(&writer);
+	}
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		writer.Write(b->m_worldIndex);
+	}
+
+	// Joints are written from the oldest, which is at the end of the list,
+	// so the joints of a gear joint come before it.
+	b2Joint* oldest = m_jointList;
+	while (oldest && oldest->m_next)
+	{
+		oldest = oldest->m_next;
+	}
+	int32 jointIndex = 0;
+	for (b2Joint* j = oldest; j; j = j->m_prev)
+	{
+		j->m_index = jointIndex++;
+	}
+	writer.Write(m_jointCount);
+	for (b2Joint* j = oldest; j; j = j->m_prev)
+	{
+		j->Save(&writer);
+	}
+
+	m_contactManager.Save(&writer);
+
+	// The order of the bodies' edges decides the order constraints are
+	// solved in, so it's kept too.
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		const b2Body* b = m_bodies[i];
+		int32 count = 0;
+		for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			++count;
+		}
+		writer.Write(count);
+		for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			writer.Write(ce->contact->m_managerIndex);
+		}
+
+		count = 0;
+		for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+		{
+			++count;
+		}
+		writer.Write(count);
+		for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+		{
+			writer.Write(je->joint->m_index);
+		}
+	}
+
+	m_islandGraph.Save(&writer, m_bodies, m_bodyCount);
+	m_contactManager.m_broadPhase.Save(&writer);
+
+	// Particle systems are written from the end of the list, as creating
+	// them puts each at the head.
+	int32 particleSystemCount = 0;
+	b2ParticleSystem* lastSystem = NULL;
+	for (b2ParticleSystem* p = m_particleSystemList; p; p = p->m_next)
+	{
+		++particleSystemCount;
+		lastSystem = p;
+	}
+	writer.Write(particleSystemCount);
+	for (b2ParticleSystem* p = lastSystem; p; p = p->m_prev)
+	{
+		writer.Write(p->m_def);
+		p->Save(&writer);
+	}
+}
+
+bool b2World::LoadSnapshot(const b2Snapshot& snapshot)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return false;
+	}
+	b2TraceZone("b2World::LoadSnapshot");
+
+	b2SnapshotReader reader(snapshot.GetData(), snapshot.GetSize());
+	if (reader.Read<uint32>() != b2_snapshotMagic ||
+		reader.Read<int32>() != b2_snapshotVersion ||
+		b2ReadSnapshotLayout(&reader) == false)
+	{
+		return false;
+	}
+
+	// Load the snapshot into a scratch world first, so one which is
+	// corrupt or truncated is turned down before anything is torn down.
+	{
+		b2WorldDef def;
+		def.gravity = m_gravity;
+		def.allocator = m_accountingAllocator.GetAllocator();
+		b2World scratch(&def);
+		b2SnapshotReader scratchReader = reader;
+		if (scratch.LoadSnapshotState(&scratchReader) == false)
+		{
+			return false;
+		}
+	}
+
+	// Tear the world down quietly, as nothing is really going away.
+	b2DestructionListener* destructionListener = m_destructionListener;
+	b2ContactListener* contactListener = m_contactManager.m_contactListener;
+	b2ContactListener silentListener;
+	m_destructionListener = NULL;
+	m_contactManager.m_contactListener = &silentListener;
+	while (m_particleSystemList)
+	{
+		DestroyParticleSystem(m_particleSystemList);
+	}
+	while (m_jointList)
+	{
+		DestroyJoint(m_jointList);
+	}
+	while (m_bodyList)
+	{
+		DestroyBody(m_bodyList);
+	}
+	m_destructionListener = destructionListener;
+	m_contactManager.m_contactListener = contactListener;
+
+	const bool loaded = LoadSnapshotState(&reader);
+	b2Assert(loaded);
+	return loaded;
+}
+
+bool b2World::LoadSnapshotState(b2SnapshotReader* reader)
+{
+	b2Assert(m_bodyCount == 0 && m_jointCount == 0 &&
+			 m_particleSystemList == NULL);
+
+	reader->Read(&m_flags);
+	reader->Read(&m_gravity);
+	reader->Read(&m_allowSleep);
+	reader->Read(&m_inv_dt0);
+	reader->Read(&m_warmStarting);
+	reader->Read(&m_continuousPhysics);
+	reader->Read(&m_subStepping);
+	reader->Read(&m_stepComplete);
+	reader->Read(&m_nextBodyId);
+
+	// The bodies go straight into the arrays, as linking them to the island
+	// graph and the broad-phase would disturb the saved state. They're
+	// listed in array order until the saved order is read, so the
+	// destructor finds them if the rest of the snapshot is invalid.
+	const int32 bodyCount = reader->ReadCount(1);
+	if (bodyCount > m_bodyCapacity)
+	{
+		int32 oldCapacity = m_bodyCapacity;
+		m_bodyCapacity = b2Max(bodyCount, b2_minBodyCapacity);
+		m_bodies = ReallocateBuffer(m_bodies, oldCapacity, m_bodyCapacity);
+		m_positions = ReallocateBuffer(m_positions, oldCapacity, m_bodyCapacity);
+		m_velocities = ReallocateBuffer(m_velocities, oldCapacity, m_bodyCapacity);
+		m_forces = ReallocateBuffer(m_forces, oldCapacity, m_bodyCapacity);
+		m_inverseMasses = ReallocateBuffer(m_inverseMasses, oldCapacity,
+										   m_bodyCapacity);
+	}
+	b2Body* prevBody = NULL;
+	for (int32 i = 0; i < bodyCount && reader->HasError() == false; ++i)
+	{
+		b2BodyDef def;
+		void* mem = m_bodyAllocator.Allocate(sizeof(b2Body));
+		b2Body* b = new (mem) b2Body(&def, this);
+		b->m_worldIndex = i;
+		m_bodies[i] = b;
+		++m_bodyCount;
+		b->m_prev = prevBody;
+		if (prevBody)
+		{
+			prevBody->m_next = b;
+		}
+		else
+		{
+			m_bodyList = b;
+		}
+		prevBody = b;
+		b->Load(reader);
+	}
+	if (reader->HasError())
+	{
+		return false;
+	}
+
+	bool* listed = (bool*)m_stackAllocator.Allocate(bodyCount * sizeof(bool));
+	b2Body** order = (b2Body**)m_stackAllocator.Allocate(
+		bodyCount * sizeof(b2Body*));
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		listed[i] = false;
+	}
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const int32 index = reader->ReadIndex(bodyCount);
+		if (index < 0 || listed[index])
+		{
+			reader->SetError();
+			break;
+		}
+		listed[index] = true;
+		order[i] = m_bodies[index];
+	}
+	if (reader->HasError() == false)
+	{
+		b2Body** lastBody = &m_bodyList;
+		prevBody = NULL;
+		for (int32 i = 0; i < bodyCount; ++i)
+		{
+			b2Body* b = order[i];
+			b->m_prev = prevBody;
+			b->m_next = NULL;
+			*lastBody = b;
+			lastBody = &b->m_next;
+			prevBody = b;
+		}
+	}
+	m_stackAllocator.Free(order);
+	m_stackAllocator.Free(listed);
+	if (reader->HasError())
+	{
+		return false;
+	}
+
+	const int32 jointCount = reader->ReadCount(1);
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(
+		jointCount * sizeof(b2Joint*));
+	for (int32 i = 0; i < jointCount; ++i)
+	{
+		b2Joint* j = b2Joint::Load(reader, m_bodies, bodyCount, joints, i,
+								   &m_blockAllocator);
+		if (j == NULL)
+		{
+			break;
+		}
+		j->m_index = i;
+		joints[i] = j;
+		++m_jointCount;
+
+		j->m_prev = NULL;
+		j->m_next = m_jointList;
+		if (m_jointList)
+		{
+			m_jointList->m_prev = j;
+		}
+		m_jointList = j;
+
+		j->m_edgeA.joint = j;
+		j->m_edgeB.joint = j;
+	}
+
+	if (reader->HasError() == false)
+	{
+		m_contactManager.Load(reader, m_bodies, bodyCount);
+	}
+	b2Contact** contacts = m_contactManager.m_contacts;
+	const int32 contactCount = m_contactManager.m_contactCount;
+
+	// An edge's other body is set as it is linked, so an edge listed twice
+	// is caught, and counting the edges catches one never listed.
+	int32 contactEdgeCount = 0;
+	int32 jointEdgeCount = 0;
+	for (int32 i = 0; i < bodyCount && reader->HasError() == false; ++i)
+	{
+		b2Body* b = m_bodies[i];
+		b2ContactEdge* prevContactEdge = NULL;
+		for (int32 count = reader->ReadCount(sizeof(int32));
+			 count > 0 && reader->HasError() == false; --count)
+		{
+			const int32 index = reader->ReadIndex(contactCount);
+			if (index < 0)
+			{
+				break;
+			}
+			b2Contact* c = contacts[index];
+			b2Body* bodyA = c->m_fixtureA->m_body;
+			b2Body* bodyB = c->m_fixtureB->m_body;
+			b2ContactEdge* ce =
+				bodyA == b ? &c->m_nodeA : bodyB == b ? &c->m_nodeB : NULL;
+			if (ce == NULL || ce->other)
+			{
+				reader->SetError();
+				break;
+			}
+			ce->other = bodyA == b ? bodyB : bodyA;
+			ce->prev = prevContactEdge;
+			ce->next = NULL;
+			if (prevContactEdge)
+			{
+				prevContactEdge->next = ce;
+			}
+			else
+			{
+				b->m_contactList = ce;
+			}
+			prevContactEdge = ce;
+			++contactEdgeCount;
+		}
+
+		b2JointEdge* prevJointEdge = NULL;
+		for (int32 count = reader->ReadCount(sizeof(int32));
+			 count > 0 && reader->HasError() == false; --count)
+		{
+			const int32 index = reader->ReadIndex(m_jointCount);
+			if (index < 0)
+			{
+				break;
+			}
+			b2Joint* j = joints[index];
+			b2JointEdge* je = j->m_bodyA == b ? &j->m_edgeA :
+				j->m_bodyB == b ? &j->m_edgeB : NULL;
+			if (je == NULL || je->other)
+			{
+				reader->SetError();
+				break;
+			}
+			je->other = j->m_bodyA == b ? j->m_bodyB : j->m_bodyA;
+			je->prev = prevJointEdge;
+			je->next = NULL;
+			if (prevJointEdge)
+			{
+				prevJointEdge->next = je;
+			}
+			else
+			{
+				b->m_jointList = je;
+			}
+			prevJointEdge = je;
+			++jointEdgeCount;
+		}
+	}
+	if (contactEdgeCount != 2 * contactCount ||
+		jointEdgeCount != 2 * m_jointCount)
+	{
+		reader->SetError();
+	}
+
+	if (reader->HasError() == false)
+	{
+		m_islandGraph.Load(reader, m_bodies, bodyCount, contacts,
+						   contactCount, joints, m_jointCount);
+	}
+	m_stackAllocator.Free(joints);
+	if (reader->HasError())
+	{
+		return false;
+	}
+
+	// Every proxy in the broad-phase must belong to exactly one fixture.
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->Load(reader);
+	int32 proxyCount = 0;
+	for (int32 i = 0; i < bodyCount && reader->HasError() == false; ++i)
+	{
+		for (b2Fixture* f = m_bodies[i]->m_fixtureList; f; f = f->m_next)
+		{
+			for (int32 k = 0; k < f->m_proxyCount; ++k)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + k;
+				if (broadPhase->IsProxy(proxy->proxyId) == false ||
+					broadPhase->GetUserData(proxy->proxyId))
+				{
+					reader->SetError();
+					return false;
+				}
+				broadPhase->SetUserData(proxy->proxyId, proxy);
+				++proxyCount;
+			}
+		}
+	}
+	if (proxyCount != broadPhase->GetProxyCount())
+	{
+		reader->SetError();
+	}
+
+	const int32 particleSystemCount =
+		reader->ReadCount(sizeof(b2ParticleSystemDef));
+	for (int32 i = 0; i < particleSystemCount && reader->HasError() == false;
+		 ++i)
+	{
+		b2ParticleSystemDef def;
+		reader->Read(&def);
+		if (def.lifetimeGranularity <= 0.0f)
+		{
+			reader->SetError();
+			break;
+		}
+		b2ParticleSystem* p = CreateParticleSystem(&def);
+		p->Load(reader, m_bodies, bodyCount);
+	}
+
+	return reader->HasError() == false && reader->GetRemaining() == 0;
+}
+
+bool b2World::ExceedsMemoryBudget(int32 size) const
+{
+	if (m_memoryBudget == 0)
+	{
+		return false;
+	}
+	const int32 total = m_accountingAllocator.GetAllocation() +
+		m_contactManager.m_broadPhase.GetMemoryUsage();
+	return total + size > m_memoryBudget;
+}
+
+void b2World::DumpMemory() const
+{
+	b2Log("shapes, joints and buffers:\n");
+	m_blockAllocator.Dump();
+	b2Log("bodies:\n");
+	m_bodyAllocator.Dump();
+	b2Log("fixtures:\n");
+	m_fixtureAllocator.Dump();
+	b2Log("contacts:\n");
+	m_contactAllocator.Dump();
+
+	b2WorldMemoryStats stats;
+	GetMemoryStats(&stats);
+	b2Log("total %d bytes, budget %d\n", stats.totalBytes, stats.budget);
+}
+
 void b2World::Dump()
 {
 	if ((m_flags & e_locked) == e_locked)
@@ -23,7 +23,9 @@
 #include <Box2D/Common/b2Math.h>
 #include <Box2D/Common/b2BlockAllocator.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <Box2D/Common/b2FrameArena.h>
 #include <Box2D/Dynamics/b2ContactManager.h>
+#include <Box2D/Dynamics/b2IslandGraph.h>
 #include <Box2D/Dynamics/b2WorldCallbacks.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
 #include <Box2D/Particle/b2ParticleSystem.h>
@@ -37,6 +39,108 @@ class b2Draw;
 class b2Fixture;
 class b2Joint;
 class b2ParticleGroup;
+class b2Snapshot;
+class b2SnapshotReader;
+class b2TaskExecutor;
+
+/// Default for b2WorldDef::coloringThreshold.
+const int32 b2_defaultColoringThreshold = 256;
+struct b2TOIEvent;
+
+/// A world definition holds the data needed to construct a world.
+struct b2WorldDef
+{
+	/// This constructor sets the definition default values.
+	b2WorldDef()
+	{
+		gravity.Set(0.0f, -10.0f);
+		allocator = NULL;
+		memoryBudget = 0;
+		taskExecutor = NULL;
+		coloringThreshold = b2_defaultColoringThreshold;
+		deterministic = false;
+	}
+
+	/// The world gravity vector.
+	b2Vec2 gravity;
+
+	/// Where the world's allocators, and so its bodies, contacts and
+	/// particle buffers, get their memory. NULL uses b2Alloc / b2Free.
+	/// The allocator must outlive the world.
+	b2Allocator* allocator;
+
+	/// The most bytes the world may hold. See b2World::SetMemoryBudget().
+	/// 0 means there is no budget.
+	int32 memoryBudget;
+
+	/// Runs the parallel parts of a step. See b2World::SetTaskExecutor().
+	/// NULL solves everything on the calling thread.
+	b2TaskExecutor* taskExecutor;
+
+	/// See b2World::SetColoringThreshold().
+	int32 coloringThreshold;
+
+	/// See b2World::SetDeterministic().
+	bool deterministic;
+};
+
+/// The bytes held by a world, broken down by subsystem.
+/// See b2World::GetMemoryStats().
+struct b2WorldMemoryStats
+{
+	/// Chunks of the small object allocators that hold bodies, fixtures,
+	/// contacts, joints, shapes and small buffers.
+	int32 blockBytes;
+
+	/// Allocations too large for a block, such as the body and contact
+	/// arrays and large particle buffers.
+	int32 giantBytes;
+
+	/// Stack allocator segments spilled past the built-in one.
+	int32 stackBytes;
+
+	/// Chunks of the step scratch arena.
+	int32 frameArenaBytes;
+
+	/// Particle buffers and groups of all particle systems. These are held
+	/// in the block and giant allocations above. Buffers supplied with
+	/// b2ParticleSystem::Set*Buffer() are not counted.
+	int32 particleBytes;
+
+	/// The broad-phase tree and buffers. These come from b2Alloc rather
+	/// than the world's b2Allocator.
+	int32 broadPhaseBytes;
+
+	/// Bytes the world currently has from its b2Allocator. This includes
+	/// the edge trees of chains, see b2ChainShape::SetEdgeTree().
+	int32 allocatorBytes;
+
+	/// Most bytes the world has ever had from its b2Allocator at once.
+	int32 maxAllocatorBytes;
+
+	/// allocatorBytes plus broadPhaseBytes. This is what the memory budget
+	/// is checked against.
+	int32 totalBytes;
+
+	/// The memory budget, 0 if there is none.
+	int32 budget;
+};
+
+/// The closest fixture a ray hit. See b2World::RayCastClosest().
+struct b2RayCastHit
+{
+	/// The fixture hit, or NULL if the ray hit nothing.
+	b2Fixture* fixture;
+
+	/// The point of intersection.
+	b2Vec2 point;
+
+	/// The normal of the fixture at the point.
+	b2Vec2 normal;
+
+	/// The fraction of the ray from point1 to point2 at the point.
+	float32 fraction;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -48,6 +152,9 @@ public:
 	/// @param gravity the world gravity vector.
 	b2World(const b2Vec2& gravity);
 
+	/// Construct a world object from a definition.
+	explicit b2World(const b2WorldDef* def);
+
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
 
@@ -70,7 +177,8 @@ public:
 	void SetDebugDraw(b2Draw* debugDraw);
 
 	/// Create a rigid body given a definition. No reference to the definition
-	/// is retained.
+	/// is retained. Returns NULL if the body would take the world past its
+	/// memory budget.
 	/// @warning This function is locked during callbacks.
 	b2Body* CreateBody(const b2BodyDef* def);
 
@@ -168,6 +276,33 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Query the world for the fixtures that potentially overlap each of
+	/// count AABBs, without a callback. The fixtures found for aabbs[i] are
+	/// written to fixtures[starts[i]] up to fixtures[starts[i + 1] - 1], so
+	/// starts has count + 1 elements. Fixtures past capacity are counted
+	/// but not written. Particles are not queried. The AABBs are walked
+	/// through the broad-phase b2_treePacketSize at a time, and spread over
+	/// the task executor if there is one. The broad-phase is walked twice,
+	/// once to count and once to write, so on one thread this is slower
+	/// than calling QueryAABB() per AABB; use it when there is a task
+	/// executor with threads to spare or no callback is wanted.
+	/// See Benchmark/BatchQueryBenchmark.cpp.
+	/// @return the number of fixtures found. If this is more than capacity,
+	/// call again with a larger array.
+	int32 QueryAABBs(const b2AABB* aabbs, int32 count, b2Fixture** fixtures,
+					 int32 capacity, int32* starts) const;
+
+	/// Ray-cast the world for the closest fixture hit by each of count rays,
+	/// from points1[i] to points2[i], without a callback. The result of ray
+	/// i is written to hits[i]. Sensors and particles are ignored. The rays
+	/// are cast through the broad-phase b2_treePacketSize at a time, so it
+	/// is faster to put rays which start close together and go the same way
+	/// next to each other. Rays are spread over the task executor if there
+	/// is one. On one thread it is about as fast as calling RayCast() per
+	/// ray with a closest-hit callback. See Benchmark/BatchQueryBenchmark.cpp.
+	void RayCastClosest(const b2Vec2* points1, const b2Vec2* points2,
+						int32 count, b2RayCastHit* hits) const;
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A NULL body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -211,6 +346,12 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable grouping the joints of an island by type, so each
+	/// type is solved as one batch. Disabled, the joints are solved in
+	/// island order. Not saved in snapshots. For testing.
+	void SetJointBatching(bool flag) { m_batchJoints = flag; }
+	bool GetJointBatching() const { return m_batchJoints; }
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -263,6 +404,91 @@ public:
 	/// @warning this should be called outside of a time step.
 	void Dump();
 
+	/// Save the state of the world and its particle systems to a snapshot.
+	/// Steps after loading it with LoadSnapshot() are identical to the
+	/// steps after saving it.
+	/// @warning this should be called outside of a time step.
+	void SaveSnapshot(b2Snapshot* snapshot);
+
+	/// Replace the bodies, joints, contacts and particle systems of the
+	/// world with those in a snapshot from SaveSnapshot(). They are created
+	/// again, so pointers to the old ones and particle handles are no longer
+	/// valid, but user data is restored. Listeners, the contact filter, the
+	/// task executor and the memory budget are kept. The snapshot is
+	/// checked by loading it into a scratch world first, so loading takes
+	/// about twice as long as building the world would.
+	/// @warning this should be called outside of a time step.
+	/// @return false, leaving the world as it was, if the snapshot was saved
+	/// by an incompatible build, is truncated or has trailing bytes, or
+	/// holds a count or an index out of range.
+	bool LoadSnapshot(const b2Snapshot& snapshot);
+
+	/// Return the small object allocators' chunks that hold no live objects
+	/// to the world's b2Allocator, e.g. after destroying a level's bodies.
+	/// @warning this should be called outside of a time step.
+	/// @return the number of chunks released.
+	int32 TrimMemory();
+
+	/// Log the usage per size class of the small object allocators for
+	/// shapes, bodies, fixtures and contacts, and the world's total.
+	void DumpMemory() const;
+
+	/// Get the allocator the world's memory comes from.
+	b2Allocator* GetAllocator() const;
+
+	/// Get the bytes held by the world, broken down by subsystem.
+	void GetMemoryStats(b2WorldMemoryStats* stats) const;
+
+	/// Limit the bytes the world may hold. Once creating an object would
+	/// take the world past its budget, CreateBody() and
+	/// b2ParticleSystem::CreateParticleGroup() return NULL, and
+	/// b2ParticleSystem::CreateParticle() behaves as if the maximum particle
+	/// count was reached. Contacts and scratch memory needed by Step() are
+	/// not refused, so stepping can still take the world past its budget.
+	/// 0, the default, means there is no budget.
+	void SetMemoryBudget(int32 bytes);
+
+	/// Get the memory budget. 0 means there is no budget.
+	int32 GetMemoryBudget() const;
+
+	/// Set what runs the parallel parts of a step. Islands with at least
+	/// the coloring threshold of contacts and joints have their constraints
+	/// graph colored, so that constraints of a color share no dynamic
+	/// bodies, and each color is solved in parallel on the executor. Gear
+	/// joints, which also write the bodies of the joints they couple, are
+	/// always solved serially after the colors. This changes the order
+	/// constraints are solved in, so results differ slightly from the
+	/// serial solver. NULL, the default, solves everything on the calling
+	/// thread. The executor must outlive the world or be unset first.
+	void SetTaskExecutor(b2TaskExecutor* taskExecutor);
+
+	/// Get what runs the parallel parts of a step.
+	b2TaskExecutor* GetTaskExecutor() const;
+
+	/// Set the fewest contacts and joints an island needs to be solved in
+	/// parallel. Smaller islands are not worth coloring.
+	void SetColoringThreshold(int32 threshold);
+
+	/// Get the fewest contacts and joints an island needs to be solved in
+	/// parallel.
+	int32 GetColoringThreshold() const;
+
+	/// Make steps depend only on the calls made on the world, and not on
+	/// whether it has a task executor or how many threads that runs. Islands
+	/// of at least the coloring threshold are then graph colored and solved
+	/// a color at a time even without an executor. Steps are also bitwise
+	/// reproducible across platforms when the library is built with
+	/// B2_DETERMINISTIC. Off by default.
+	void SetDeterministic(bool flag);
+
+	/// Are steps independent of the task executor?
+	bool IsDeterministic() const;
+
+	/// Get a hash of the positions and velocities of every body and
+	/// particle. Comparing it each step between two runs of the same
+	/// simulation cheaply finds the first step where they diverge.
+	uint32 GetChecksum() const;
+
 	/// Get API version.
 	const b2Version* GetVersion() const {
 		return m_liquidFunVersion;
@@ -294,34 +520,92 @@ private:
 
 	friend class b2Body;
 	friend class b2Fixture;
+	friend class b2Contact;
 	friend class b2ContactManager;
 	friend class b2Controller;
 	friend class b2ParticleSystem;
 
 	void Init(const b2Vec2& gravity);
 
+	template <typename T> T* ReallocateBuffer(T* oldBuffer, int32 oldCapacity,
+											  int32 newCapacity);
+
+	// Would size more bytes take the world past its memory budget?
+	bool ExceedsMemoryBudget(int32 size) const;
+
+	// Read the state of a snapshot after its header into the world, which
+	// must be empty. Returns false on invalid data, leaving the world only
+	// fit to be destroyed.
+	bool LoadSnapshotState(b2SnapshotReader* reader);
+
 	void Solve(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
+	float32 ComputeTOI(b2Contact* contact);
+	void QueueTOI(b2Contact* contact, b2GrowableBuffer<b2TOIEvent>& queue,
+				  uint32* order);
+	void QueueBodyTOIs(b2Body* body, b2GrowableBuffer<b2TOIEvent>& queue,
+					   uint32* order);
 
 	void DrawJoint(b2Joint* joint);
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
 	void DrawParticleSystem(const b2ParticleSystem& system);
 
+	// Counts every byte the allocators below take from the world's
+	// b2Allocator, so it must be constructed before them.
+	b2AccountingAllocator m_accountingAllocator;
+	int32 m_memoryBudget;
+
+	b2TaskExecutor* m_taskExecutor;
+	int32 m_coloringThreshold;
+	bool m_deterministic;
+
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
+	b2FrameArena m_frameArena;
+
+	// Bodies, fixtures and contacts each get their own pool so that chunks
+	// hold only one kind of object. Objects never move once allocated:
+	// b2Body*, b2Fixture* and b2Contact* are the handles the API gives out,
+	// so there is no dense object storage and no index handle.
+	b2BlockAllocator m_bodyAllocator;
+	b2BlockAllocator m_fixtureAllocator;
+	b2BlockAllocator m_contactAllocator;
 
 	int32 m_flags;
 
 	b2ContactManager m_contactManager;
 
+	// The bodies grouped into islands, kept from step to step.
+	b2IslandGraph m_islandGraph;
+
 	b2Body* m_bodyList;
 	b2Joint* m_jointList;
 	b2ParticleSystem* m_particleSystemList;
 
+	// Pointers to the bodies in a dense array, whose indices address the
+	// solver arrays below. DestroyBody() moves the last body into the
+	// hole, so the order is not the list order; passes whose order changes
+	// results walk the list.
+	b2Body** m_bodies;
+	int32 m_bodyCapacity;
+
+	// Solver state of the bodies, indexed like m_bodies. The bodies'
+	// velocities, accumulated forces and inverse masses live here.
+	// m_positions holds the sweep centers and angles only while an island is
+	// being solved; b2Body::m_sweep stays the authority on position, as TOI,
+	// the broad-phase and the particles read it.
+	b2Position* m_positions;
+	b2Velocity* m_velocities;
+	b2Force* m_forces;
+	b2InverseMass* m_inverseMasses;
+
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
+	// Id of the next body created. See b2Body::GetId().
+	uint32 m_nextBodyId;
+
 	b2Vec2 m_gravity;
 	bool m_allowSleep;
 
@@ -336,6 +620,7 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_batchJoints;
 
 	bool m_stepComplete;
 
@@ -445,6 +730,53 @@ inline const b2Profile& b2World::GetProfile() const
 	return m_profile;
 }
 
+inline b2Allocator* b2World::GetAllocator() const
+{
+	return m_blockAllocator.GetAllocator();
+}
+
+inline void b2World::SetMemoryBudget(int32 bytes)
+{
+	b2Assert(bytes >= 0);
+	m_memoryBudget = bytes;
+}
+
+inline int32 b2World::GetMemoryBudget() const
+{
+	return m_memoryBudget;
+}
+
+inline void b2World::SetTaskExecutor(b2TaskExecutor* taskExecutor)
+{
+	m_taskExecutor = taskExecutor;
+}
+
+inline b2TaskExecutor* b2World::GetTaskExecutor() const
+{
+	return m_taskExecutor;
+}
+
+inline void b2World::SetColoringThreshold(int32 threshold)
+{
+	b2Assert(threshold >= 0);
+	m_coloringThreshold = threshold;
+}
+
+inline int32 b2World::GetColoringThreshold() const
+{
+	return m_coloringThreshold;
+}
+
+inline void b2World::SetDeterministic(bool flag)
+{
+	m_deterministic = flag;
+}
+
+inline bool b2World::IsDeterministic() const
+{
+	return m_deterministic;
+}
+
 #if LIQUIDFUN_EXTERNAL_LANGUAGE_API
 inline b2World::b2World(float32 gravityX, float32 gravityY)
 {
@@ -27,6 +27,8 @@
 #include <Box2D/Collision/Shapes/b2Shape.h>
 #include <Box2D/Collision/Shapes/b2EdgeShape.h>
 #include <Box2D/Collision/Shapes/b2ChainShape.h>
+#include <Box2D/Common/b2Trace.h>
+#include <Box2D/Common/b2Snapshot.h>
 #include <algorithm>
 
 // Define LIQUIDFUN_SIMD_TEST_VS_REFERENCE to run both SIMD and reference
@@ -160,11 +162,17 @@ public:
 	// (1.0, 0.7, 0.3, 0.0, -1.0, -2.0)
 	// would be sorted as
 	// (0.0, -1.0, -2.0, 1.0, 0.7, 0.3)
+	// Particles with the same lifetime are ordered by index, so that the
+	// order doesn't depend on the std::sort implementation.
 	bool operator() (const int32 particleIndexA,
 					 const int32 particleIndexB) const
 	{
 		const int32 expirationTimeA = m_expirationTimes[particleIndexA];
 		const int32 expirationTimeB = m_expirationTimes[particleIndexB];
+		if (expirationTimeA == expirationTimeB)
+		{
+			return particleIndexA < particleIndexB;
+		}
 		const bool infiniteExpirationTimeA = expirationTimeA <= 0.0f;
 		const bool infiniteExpirationTimeB = expirationTimeB <= 0.0f;
 		return infiniteExpirationTimeA == infiniteExpirationTimeB ?
@@ -187,8 +195,8 @@ struct LightweightPair
 	static bool Compare(const LightweightPair& left,
 						const LightweightPair& right)
 	{
-		return left.first < right.first &&
-			left.second < right.second;
+		return left.first < right.first ||
+			(left.first == right.first && left.second < right.second);
 	}
 
 };
@@ -349,7 +357,9 @@ static inline uint32 computeTag(float32 x, float32 y)
 
 static inline uint32 computeRelativeTag(uint32 tag, int32 x, int32 y)
 {
-	return tag + (y << yShift) + (x << xShift);
+	// Shift the offsets as unsigned, since shifting a negative value is
+	// undefined.
+	return tag + ((uint32)y << yShift) + ((uint32)x << xShift);
 }
 
 b2ParticleSystem::InsideBoundsEnumerator::InsideBoundsEnumerator(
@@ -394,6 +404,7 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 	m_triadBuffer(world->m_blockAllocator)
 {
 	b2Assert(def);
+	m_handleAllocator.SetAllocator(world->GetAllocator());
 	m_paused = false;
 	m_timestamp = 0;
 	m_allParticleFlags = 0;
@@ -402,6 +413,8 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 	m_needsUpdateAllGroupFlags = false;
 	m_hasForce = false;
 	m_iterationIndex = 0;
+	m_count = 0;
+	m_internalAllocatedCapacity = 0;
 
 	SetStrictContactCheck(def->strictContactCheck);
 	SetDensity(def->density);
@@ -409,8 +422,6 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 	SetRadius(def->radius);
 	SetMaxParticleCount(def->maxCount);
 
-	m_count = 0;
-	m_internalAllocatedCapacity = 0;
 	m_forceBuffer = NULL;
 	m_weightBuffer = NULL;
 	m_staticPressureBuffer = NULL;
@@ -433,6 +444,16 @@ b2ParticleSystem::b2ParticleSystem(const b2ParticleSystemDef* def,
 	m_expirationTimeBufferRequiresSorting = false;
 
 	SetDestructionByAge(m_def.destroyByAge);
+
+	// Reserve the capacity hints up front so steps that stay within them
+	// never reallocate.
+	if (m_def.particleCapacity > 0)
+	{
+		ReallocateInternalAllocatedBuffers(m_def.particleCapacity);
+		m_proxyBuffer.Reserve(m_def.particleCapacity);
+	}
+	m_contactBuffer.Reserve(m_def.contactCapacity);
+	m_bodyContactBuffer.Reserve(m_def.bodyContactCapacity);
 }
 
 b2ParticleSystem::~b2ParticleSystem()
@@ -486,14 +507,8 @@ template <typename T> T* b2ParticleSystem::ReallocateBuffer(
 	T* oldBuffer, int32 oldCapacity, int32 newCapacity)
 {
 	b2Assert(newCapacity > oldCapacity);
-	T* newBuffer = (T*) m_world->m_blockAllocator.Allocate(
-		sizeof(T) * newCapacity);
-	if (oldBuffer)
-	{
-		memcpy(newBuffer, oldBuffer, sizeof(T) * oldCapacity);
-		m_world->m_blockAllocator.Free(oldBuffer, sizeof(T) * oldCapacity);
-	}
-	return newBuffer;
+	return (T*) m_world->m_blockAllocator.Reallocate(
+		oldBuffer, sizeof(T) * oldCapacity, sizeof(T) * newCapacity);
 }
 
 // Reallocate a buffer
@@ -555,6 +570,416 @@ template <typename T> T* b2ParticleSystem::RequestBuffer(T* buffer)
 	return buffer;
 }
 
+// Get the bytes per particle a buffer takes, following the same rules as
+// ReallocateBuffer().
+template <typename T> int32 b2ParticleSystem::GetBufferBytes(
+	const T* buffer, int32 userSuppliedCapacity, bool deferred)
+{
+	return (!deferred || buffer) && !userSuppliedCapacity ? sizeof(T) : 0;
+}
+
+template <typename T> int32 b2ParticleSystem::GetBufferBytes(
+	const UserOverridableBuffer<T>& buffer, bool deferred)
+{
+	return GetBufferBytes(buffer.data, buffer.userSuppliedCapacity,
+						  deferred);
+}
+
+int32 b2ParticleSystem::GetBytesPerParticle() const
+{
+	return
+		GetBufferBytes(m_handleIndexBuffer, true) +
+		GetBufferBytes(m_flagsBuffer, false) +
+		GetBufferBytes(m_lastBodyContactStepBuffer, true) +
+		GetBufferBytes(m_bodyContactCountBuffer, true) +
+		GetBufferBytes(m_consecutiveContactStepsBuffer, true) +
+		GetBufferBytes(m_positionBuffer, false) +
+		GetBufferBytes(m_velocityBuffer, false) +
+		GetBufferBytes(m_forceBuffer, 0, false) +
+		GetBufferBytes(m_weightBuffer, 0, false) +
+		GetBufferBytes(m_staticPressureBuffer, 0, true) +
+		GetBufferBytes(m_accumulationBuffer, 0, false) +
+		GetBufferBytes(m_accumulation2Buffer, 0, true) +
+		GetBufferBytes(m_depthBuffer, 0, true) +
+		GetBufferBytes(m_colorBuffer, true) +
+		GetBufferBytes(m_groupBuffer, 0, false) +
+		GetBufferBytes(m_userDataBuffer, true) +
+		GetBufferBytes(m_expirationTimeBuffer, true) +
+		GetBufferBytes(m_indexByExpirationTimeBuffer, true);
+}
+
+int32 b2ParticleSystem::GetMemoryUsage() const
+{
+	return
+		(int32)sizeof(b2ParticleSystem) +
+		m_internalAllocatedCapacity * GetBytesPerParticle() +
+		m_stuckParticleBuffer.GetCapacity() * (int32)sizeof(int32) +
+		m_proxyBuffer.GetCapacity() * (int32)sizeof(Proxy) +
+		m_contactBuffer.GetCapacity() * (int32)sizeof(b2ParticleContact) +
+		m_bodyContactBuffer.GetCapacity() *
+			(int32)sizeof(b2ParticleBodyContact) +
+		m_pairBuffer.GetCapacity() * (int32)sizeof(b2ParticlePair) +
+		m_triadBuffer.GetCapacity() * (int32)sizeof(b2ParticleTriad) +
+		m_groupCount * (int32)sizeof(b2ParticleGroup);
+}
+
+template <typename T> void b2ParticleSystem::SaveBuffer(
+	b2SnapshotWriter* writer, const T* buffer) const
+{
+	writer->Write(buffer != NULL);
+	if (buffer)
+	{
+		writer->WriteArray(buffer, m_count);
+	}
+}
+
+template <typename T> T* b2ParticleSystem::LoadBuffer(
+	b2SnapshotReader* reader, T* buffer)
+{
+	if (reader->Read<bool>())
+	{
+		buffer = RequestBuffer(buffer);
+		reader->ReadArray(buffer, m_count);
+	}
+	return buffer;
+}
+
+template <typename T> void b2ParticleSystem::SaveGrowableBuffer(
+	b2SnapshotWriter* writer, const b2GrowableBuffer<T>& buffer)
+{
+	writer->Write(buffer.GetCount());
+	writer->WriteArray(buffer.Data(), buffer.GetCount());
+}
+
+template <typename T> void b2ParticleSystem::LoadGrowableBuffer(
+	b2SnapshotReader* reader, b2GrowableBuffer<T>* buffer)
+{
+	const int32 count = reader->ReadCount(sizeof(T));
+	buffer->Reserve(count);
+	buffer->SetCount(count);
+	reader->ReadArray(buffer->Data(), count);
+}
+
+void b2ParticleSystem::Save(b2SnapshotWriter* writer) const
+{
+	writer->Write(m_paused);
+	writer->Write(m_timestamp);
+	writer->Write(m_allParticleFlags);
+	writer->Write(m_needsUpdateAllParticleFlags);
+	writer->Write(m_allGroupFlags);
+	writer->Write(m_needsUpdateAllGroupFlags);
+	writer->Write(m_hasForce);
+	writer->Write(m_iterationIndex);
+	writer->Write(m_inverseDensity);
+	writer->Write(m_particleDiameter);
+	writer->Write(m_inverseDiameter);
+	writer->Write(m_squaredDiameter);
+	writer->Write(m_stuckThreshold);
+	writer->Write(m_timeElapsed);
+	writer->Write(m_expirationTimeBufferRequiresSorting);
+
+	// The buffers every particle has are copied whole. The scratch buffers
+	// are filled by each step before they're read, so they're left out.
+	writer->Write(m_count);
+	writer->Write(m_internalAllocatedCapacity);
+	writer->WriteArray(m_flagsBuffer.data, m_count);
+	writer->WriteArray(m_positionBuffer.data, m_count);
+	writer->WriteArray(m_velocityBuffer.data, m_count);
+	writer->WriteArray(m_weightBuffer, m_count);
+	SaveBuffer(writer, m_forceBuffer);
+	SaveBuffer(writer, m_staticPressureBuffer);
+	SaveBuffer(writer, m_depthBuffer);
+	SaveBuffer(writer, m_colorBuffer.data);
+	SaveBuffer(writer, m_lastBodyContactStepBuffer.data);
+	SaveBuffer(writer, m_bodyContactCountBuffer.data);
+	SaveBuffer(writer, m_consecutiveContactStepsBuffer.data);
+	SaveBuffer(writer, m_expirationTimeBuffer.data);
+	SaveBuffer(writer, m_indexByExpirationTimeBuffer.data);
+
+	const bool hasUserData = m_userDataBuffer.data != NULL;
+	writer->Write(hasUserData);
+	if (hasUserData)
+	{
+		for (int32 i = 0; i < m_count; ++i)
+		{
+			writer->WritePointer(m_userDataBuffer.data[i]);
+		}
+	}
+
+	// Only the indices of the particles with handles are kept, as the
+	// handles are allocated again.
+	int32 handleCount = 0;
+	if (m_handleIndexBuffer.data)
+	{
+		for (int32 i = 0; i < m_count; ++i)
+		{
+			handleCount += m_handleIndexBuffer.data[i] != NULL;
+		}
+	}
+	writer->Write(handleCount);
+	for (int32 i = 0; handleCount && i < m_count; ++i)
+	{
+		if (m_handleIndexBuffer.data[i])
+		{
+			writer->Write(i);
+		}
+	}
+
+	SaveGrowableBuffer(writer, m_stuckParticleBuffer);
+	SaveGrowableBuffer(writer, m_proxyBuffer);
+	SaveGrowableBuffer(writer, m_contactBuffer);
+	SaveGrowableBuffer(writer, m_pairBuffer);
+	SaveGrowableBuffer(writer, m_triadBuffer);
+
+	const int32 bodyContactCount = m_bodyContactBuffer.GetCount();
+	writer->Write(bodyContactCount);
+	for (int32 i = 0; i < bodyContactCount; ++i)
+	{
+		const b2ParticleBodyContact& contact = m_bodyContactBuffer[i];
+		int32 fixtureIndex = 0;
+		for (const b2Fixture* f = contact.body->GetFixtureList();
+			 f != contact.fixture; f = f->GetNext())
+		{
+			++fixtureIndex;
+		}
+		writer->Write(contact.index);
+		writer->Write(contact.body->m_worldIndex);
+		writer->Write(fixtureIndex);
+		writer->Write(contact.weight);
+		writer->Write(contact.normal);
+		writer->Write(contact.mass);
+	}
+
+	// The particles of a group are the range between its indices, so the
+	// group buffer is rebuilt from the ranges.
+	writer->Write(m_groupCount);
+	for (const b2ParticleGroup* group = m_groupList; group;
+		 group = group->m_next)
+	{
+		writer->Write(group->m_firstIndex);
+		writer->Write(group->m_lastIndex);
+		writer->Write(group->m_groupFlags);
+		writer->Write(group->m_strength);
+		writer->Write(group->m_timestamp);
+		writer->Write(group->m_mass);
+		writer->Write(group->m_inertia);
+		writer->Write(group->m_center);
+		writer->Write(group->m_linearVelocity);
+		writer->Write(group->m_angularVelocity);
+		writer->Write(group->m_transform);
+		writer->WritePointer(group->m_userData);
+	}
+}
+
+// Is index that of one of count particles?
+static bool b2IsParticleIndex(int32 index, int32 count)
+{
+	return 0 <= index && index < count;
+}
+
+void b2ParticleSystem::Load(b2SnapshotReader* reader, b2Body** bodies,
+							int32 bodyCount)
+{
+	b2Assert(m_count == 0 && m_groupList == NULL);
+
+	reader->Read(&m_paused);
+	reader->Read(&m_timestamp);
+	reader->Read(&m_allParticleFlags);
+	reader->Read(&m_needsUpdateAllParticleFlags);
+	reader->Read(&m_allGroupFlags);
+	reader->Read(&m_needsUpdateAllGroupFlags);
+	reader->Read(&m_hasForce);
+	reader->Read(&m_iterationIndex);
+	reader->Read(&m_inverseDensity);
+	reader->Read(&m_particleDiameter);
+	reader->Read(&m_inverseDiameter);
+	reader->Read(&m_squaredDiameter);
+	reader->Read(&m_stuckThreshold);
+	reader->Read(&m_timeElapsed);
+	reader->Read(&m_expirationTimeBufferRequiresSorting);
+
+	// Each particle takes at least its flags, position, velocity and
+	// weight. The capacity can't be checked against the data, so it's held
+	// to what the particles could have grown to.
+	const int32 count = reader->ReadCount(sizeof(uint32) + 2 * sizeof(b2Vec2) +
+										  sizeof(float32));
+	int32 capacity = reader->Read<int32>();
+	capacity = b2Min(capacity,
+					 b2Max(2 * count, b2_minParticleSystemBufferCapacity));
+	if (capacity > m_internalAllocatedCapacity)
+	{
+		ReallocateInternalAllocatedBuffers(capacity);
+	}
+	if (reader->HasError() || count > m_internalAllocatedCapacity)
+	{
+		reader->SetError();
+		return;
+	}
+	m_count = count;
+	reader->ReadArray(m_flagsBuffer.data, m_count);
+	reader->ReadArray(m_positionBuffer.data, m_count);
+	reader->ReadArray(m_velocityBuffer.data, m_count);
+	reader->ReadArray(m_weightBuffer, m_count);
+	m_forceBuffer = LoadBuffer(reader, m_forceBuffer);
+	m_staticPressureBuffer = LoadBuffer(reader, m_staticPressureBuffer);
+	m_depthBuffer = LoadBuffer(reader, m_depthBuffer);
+	m_colorBuffer.data = LoadBuffer(reader, m_colorBuffer.data);
+	m_lastBodyContactStepBuffer.data = LoadBuffer(
+		reader, m_lastBodyContactStepBuffer.data);
+	m_bodyContactCountBuffer.data = LoadBuffer(
+		reader, m_bodyContactCountBuffer.data);
+	m_consecutiveContactStepsBuffer.data = LoadBuffer(
+		reader, m_consecutiveContactStepsBuffer.data);
+	m_expirationTimeBuffer.data = LoadBuffer(
+		reader, m_expirationTimeBuffer.data);
+	m_indexByExpirationTimeBuffer.data = LoadBuffer(
+		reader, m_indexByExpirationTimeBuffer.data);
+
+	if (reader->Read<bool>())
+	{
+		m_userDataBuffer.data = RequestBuffer(m_userDataBuffer.data);
+		for (int32 i = 0; i < m_count; ++i)
+		{
+			m_userDataBuffer.data[i] = reader->ReadPointer();
+		}
+	}
+
+	if (m_handleIndexBuffer.data)
+	{
+		memset(m_handleIndexBuffer.data, 0,
+			   sizeof(*m_handleIndexBuffer.data) * m_count);
+	}
+	const int32 handleCount = reader->ReadCount(sizeof(int32));
+	for (int32 i = 0; i < handleCount; ++i)
+	{
+		const int32 index = reader->ReadIndex(m_count);
+		if (index < 0)
+		{
+			return;
+		}
+		GetParticleHandleFromIndex(index);
+	}
+
+	// Everything after the particles refers to them by index.
+	bool valid = true;
+	if (m_indexByExpirationTimeBuffer.data)
+	{
+		for (int32 i = 0; i < m_count; ++i)
+		{
+			valid &= b2IsParticleIndex(
+				m_indexByExpirationTimeBuffer.data[i], m_count);
+		}
+	}
+	LoadGrowableBuffer(reader, &m_stuckParticleBuffer);
+	for (int32 i = 0; i < m_stuckParticleBuffer.GetCount(); ++i)
+	{
+		valid &= b2IsParticleIndex(m_stuckParticleBuffer[i], m_count);
+	}
+	LoadGrowableBuffer(reader, &m_proxyBuffer);
+	for (int32 i = 0; i < m_proxyBuffer.GetCount(); ++i)
+	{
+		valid &= b2IsParticleIndex(m_proxyBuffer[i].index, m_count);
+	}
+	LoadGrowableBuffer(reader, &m_contactBuffer);
+	for (int32 i = 0; i < m_contactBuffer.GetCount(); ++i)
+	{
+		const b2ParticleContact& contact = m_contactBuffer[i];
+		valid &= b2IsParticleIndex(contact.GetIndexA(), m_count) &&
+			b2IsParticleIndex(contact.GetIndexB(), m_count);
+	}
+	LoadGrowableBuffer(reader, &m_pairBuffer);
+	for (int32 i = 0; i < m_pairBuffer.GetCount(); ++i)
+	{
+		const b2ParticlePair& pair = m_pairBuffer[i];
+		valid &= b2IsParticleIndex(pair.indexA, m_count) &&
+			b2IsParticleIndex(pair.indexB, m_count);
+	}
+	LoadGrowableBuffer(reader, &m_triadBuffer);
+	for (int32 i = 0; i < m_triadBuffer.GetCount(); ++i)
+	{
+		const b2ParticleTriad& triad = m_triadBuffer[i];
+		valid &= b2IsParticleIndex(triad.indexA, m_count) &&
+			b2IsParticleIndex(triad.indexB, m_count) &&
+			b2IsParticleIndex(triad.indexC, m_count);
+	}
+	if (valid == false)
+	{
+		reader->SetError();
+		return;
+	}
+
+	const int32 bodyContactCount = reader->ReadCount(1);
+	m_bodyContactBuffer.Reserve(bodyContactCount);
+	m_bodyContactBuffer.SetCount(bodyContactCount);
+	for (int32 i = 0; i < bodyContactCount; ++i)
+	{
+		b2ParticleBodyContact& contact = m_bodyContactBuffer[i];
+		contact.index = reader->ReadIndex(m_count);
+		contact.fixture = b2Body::LoadFixture(reader, bodies, bodyCount);
+		if (reader->HasError())
+		{
+			m_bodyContactBuffer.SetCount(0);
+			return;
+		}
+		contact.body = contact.fixture->GetBody();
+		reader->Read(&contact.weight);
+		reader->Read(&contact.normal);
+		reader->Read(&contact.mass);
+	}
+
+	// Append the groups to keep the order of the list.
+	if (m_count > 0)
+	{
+		memset(m_groupBuffer, 0, sizeof(*m_groupBuffer) * m_count);
+	}
+	const int32 groupCount = reader->ReadCount(1);
+	b2ParticleGroup* last = NULL;
+	for (int32 i = 0; i < groupCount; ++i)
+	{
+		void* mem = m_world->m_blockAllocator.Allocate(sizeof(b2ParticleGroup));
+		b2ParticleGroup* group = new (mem) b2ParticleGroup();
+		group->m_system = this;
+		reader->Read(&group->m_firstIndex);
+		reader->Read(&group->m_lastIndex);
+		reader->Read(&group->m_groupFlags);
+		reader->Read(&group->m_strength);
+		reader->Read(&group->m_timestamp);
+		reader->Read(&group->m_mass);
+		reader->Read(&group->m_inertia);
+		reader->Read(&group->m_center);
+		reader->Read(&group->m_linearVelocity);
+		reader->Read(&group->m_angularVelocity);
+		reader->Read(&group->m_transform);
+		group->m_userData = reader->ReadPointer();
+		if (reader->HasError() || group->m_firstIndex < 0 ||
+			group->m_firstIndex > group->m_lastIndex ||
+			group->m_lastIndex > m_count)
+		{
+			group->~b2ParticleGroup();
+			m_world->m_blockAllocator.Free(mem, sizeof(b2ParticleGroup));
+			reader->SetError();
+			break;
+		}
+		for (int32 j = group->m_firstIndex; j < group->m_lastIndex; ++j)
+		{
+			m_groupBuffer[j] = group;
+		}
+
+		group->m_prev = last;
+		group->m_next = NULL;
+		if (last)
+		{
+			last->m_next = group;
+		}
+		else
+		{
+			m_groupList = group;
+		}
+		last = group;
+		++m_groupCount;
+	}
+}
+
 b2ParticleColor* b2ParticleSystem::GetColorBuffer()
 {
 	m_colorBuffer.data = RequestBuffer(m_colorBuffer.data);
@@ -644,10 +1069,16 @@ int32 b2ParticleSystem::CreateParticle(const b2ParticleDef& def)
 
 	if (m_count >= m_internalAllocatedCapacity)
 	{
-		// Double the particle capacity.
+		// Double the particle capacity, unless that would take the world
+		// past its memory budget, in which case the system is full.
 		int32 capacity =
 			m_count ? 2 * m_count : b2_minParticleSystemBufferCapacity;
-		ReallocateInternalAllocatedBuffers(capacity);
+		if (!m_world->ExceedsMemoryBudget(
+				(capacity - m_internalAllocatedCapacity) *
+				(GetBytesPerParticle() + (int32)sizeof(Proxy))))
+		{
+			ReallocateInternalAllocatedBuffers(capacity);
+		}
 	}
 	if (m_count >= m_internalAllocatedCapacity)
 	{
@@ -764,6 +1195,37 @@ const b2ParticleHandle* b2ParticleSystem::GetParticleHandleFromIndex(
 	return handle;
 }
 
+#if LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+b2ParticleHandleAllocator* b2ParticleSystem::GetParticleHandleAllocator()
+{
+	return &m_handleAllocator;
+}
+
+void b2ParticleSystem::PrepareParticleHandles()
+{
+	m_handleIndexBuffer.data = RequestBuffer(m_handleIndexBuffer.data);
+}
+
+const b2ParticleHandle* b2ParticleSystem::GetParticleHandleFromIndex(
+	const int32 index, b2ParticleHandleCache* cache)
+{
+	b2Assert(index >= 0 && index < GetParticleCount() &&
+			 index != b2_invalidParticleIndex);
+	// Requesting the buffer here could race with other threads.
+	b2Assert(m_handleIndexBuffer.data);
+	b2ParticleHandle* handle = m_handleIndexBuffer.data[index];
+	if (handle)
+	{
+		return handle;
+	}
+	handle = m_handleAllocator.Allocate(cache);
+	b2Assert(handle);
+	handle->SetIndex(index);
+	m_handleIndexBuffer.data[index] = handle;
+	return handle;
+}
+#endif // LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+
 
 void b2ParticleSystem::DestroyParticle(
 	int32 index, bool callDestructionListener)
@@ -1049,6 +1511,13 @@ b2ParticleGroup* b2ParticleSystem::CreateParticleGroup(
 		return 0;
 	}
 
+	if (m_world->ExceedsMemoryBudget(
+			m_world->m_blockAllocator.GetAllocationCost(
+				sizeof(b2ParticleGroup))))
+	{
+		return NULL;
+	}
+
 	b2Transform transform;
 	transform.Set(groupDef.position, groupDef.angle);
 	int32 firstIndex = m_count;
@@ -1664,6 +2133,7 @@ void b2ParticleSystem::DestroyParticleGroup(b2ParticleGroup* group)
 
 void b2ParticleSystem::ComputeWeight()
 {
+	b2TraceZone("b2ParticleSystem::ComputeWeight");
 	// calculates the sum of contact-weights for each particle
 	// that means dimensionless density
 	memset(m_weightBuffer, 0, sizeof(*m_weightBuffer) * m_count);
@@ -1687,6 +2157,7 @@ void b2ParticleSystem::ComputeWeight()
 
 void b2ParticleSystem::ComputeDepth()
 {
+	b2TraceZone("b2ParticleSystem::ComputeDepth");
 	b2ParticleContact* contactGroups = (b2ParticleContact*) m_world->
 		m_stackAllocator.Allocate(sizeof(b2ParticleContact) * m_contactBuffer.GetCount());
 	int32 contactGroupsCount = 0;
@@ -2258,6 +2729,7 @@ void b2ParticleSystem::NotifyContactListenerPostContact(
 
 void b2ParticleSystem::UpdateContacts(bool exceptZombie)
 {
+	b2TraceZone("b2ParticleSystem::UpdateContacts");
 	UpdateProxies(m_proxyBuffer);
 	SortProxies(m_proxyBuffer);
 
@@ -2402,7 +2874,7 @@ static int32 FindItemIndexInFixedSet(const TypedFixedSetAllocator<T>& set,
 		const T* last = buffer + set.GetCount();
 		const T* found = std::lower_bound( buffer, buffer + set.GetCount(),
 											item, T::Compare);
-		if( found != last )
+		if( found != last && !T::Compare( item, *found ) )
 		{
 			return set.GetIndex( found );
 		}
@@ -2499,9 +2971,25 @@ int32 b2ParticlePairSet::Find(const ParticlePair& pair) const
 class b2FixtureParticleQueryCallback : public b2QueryCallback
 {
 public:
-	explicit b2FixtureParticleQueryCallback(b2ParticleSystem* system)
+	b2FixtureParticleQueryCallback(b2ParticleSystem* system,
+								   const b2AABB& aabb)
 	{
 		m_system = system;
+		m_aabb = aabb;
+		m_edgeFixture = NULL;
+		m_edgeTree = NULL;
+	}
+
+	// Receive an edge of a chain with an edge tree which overlaps the
+	// queried bounds, and report it like any other child, with its fat
+	// AABB as the broad-phase would have it.
+	bool QueryCallback(int32 leafId)
+	{
+		int32 childIndex = (int32)(intptr_t)m_edgeTree->GetUserData(leafId);
+		ReportChild(m_edgeFixture, childIndex,
+			b2Mul(m_edgeFixture->GetBody()->GetTransform(),
+				  m_edgeTree->GetFatAABB(leafId)));
+		return true;
 	}
 
 private:
@@ -2521,27 +3009,50 @@ private:
 			return true;
 		}
 		const b2Shape* shape = fixture->GetShape();
+		// A chain with an edge tree only has the proxy of the whole chain,
+		// so its edges under the queried bounds come from its tree.
+		if (shape->GetType() == b2Shape::e_chain &&
+			((const b2ChainShape*)shape)->GetEdgeTree() != NULL)
+		{
+			m_edgeFixture = fixture;
+			m_edgeTree = ((const b2ChainShape*)shape)->GetEdgeTree();
+			m_edgeTree->Query(this,
+				b2MulT(fixture->GetBody()->GetTransform(), m_aabb));
+			return true;
+		}
 		int32 childCount = shape->GetChildCount();
 		for (int32 childIndex = 0; childIndex < childCount; childIndex++)
 		{
-			b2AABB aabb = fixture->GetAABB(childIndex);
-			b2ParticleSystem::InsideBoundsEnumerator enumerator =
-								m_system->GetInsideBoundsEnumerator(aabb);
-			int32 index;
-			while ((index = enumerator.GetNext()) >= 0)
-			{
-				ReportFixtureAndParticle(fixture, childIndex, index);
-			}
+			ReportChild(fixture, childIndex, fixture->GetAABB(childIndex));
 		}
 		return true;
 	}
 
+	// Report each particle inside aabb, the bounds of a fixture's child.
+	void ReportChild(b2Fixture* fixture, int32 childIndex, const b2AABB& aabb)
+	{
+		b2ParticleSystem::InsideBoundsEnumerator enumerator =
+							m_system->GetInsideBoundsEnumerator(aabb);
+		int32 index;
+		while ((index = enumerator.GetNext()) >= 0)
+		{
+			ReportFixtureAndParticle(fixture, childIndex, index);
+		}
+	}
+
 	// Receive a fixture and a particle which may be overlapping.
 	virtual void ReportFixtureAndParticle(
 						b2Fixture* fixture, int32 childIndex, int32 index) = 0;
 
 protected:
 	b2ParticleSystem* m_system;
+
+private:
+	// The bounds of the particles being queried.
+	b2AABB m_aabb;
+	// The chain whose edge tree is being queried.
+	b2Fixture* m_edgeFixture;
+	const b2DynamicTree* m_edgeTree;
 };
 
 void b2ParticleSystem::NotifyBodyContactListenerPreContact(
@@ -2608,6 +3119,7 @@ void b2ParticleSystem::NotifyBodyContactListenerPostContact(
 
 void b2ParticleSystem::UpdateBodyContacts()
 {
+	b2TraceZone("b2ParticleSystem::UpdateBodyContacts");
 	// If the particle contact listener is enabled, generate a set of
 	// fixture / particle contacts.
 	FixtureParticleSet fixtureSet(&m_world->m_stackAllocator);
@@ -2689,15 +3201,18 @@ void b2ParticleSystem::UpdateBodyContacts()
 
 	public:
 		UpdateBodyContactsCallback(
-			b2ParticleSystem* system, b2ContactFilter* contactFilter):
-			b2FixtureParticleQueryCallback(system)
+			b2ParticleSystem* system, const b2AABB& aabb,
+			b2ContactFilter* contactFilter):
+			b2FixtureParticleQueryCallback(system, aabb)
 		{
 			m_contactFilter = contactFilter;
 		}
-	} callback(this, GetFixtureContactFilter());
+	};
 
 	b2AABB aabb;
 	ComputeAABB(&aabb);
+	UpdateBodyContactsCallback callback(this, aabb,
+										GetFixtureContactFilter());
 	m_world->QueryAABB(&callback, aabb);
 
 	if (m_def.strictContactCheck)
@@ -2708,6 +3223,50 @@ void b2ParticleSystem::UpdateBodyContacts()
 	NotifyBodyContactListenerPostContact(fixtureSet);
 }
 
+// Sort count items stably by compare, merging sorted runs back and forth
+// between items and scratch, which holds count items. Unlike
+// std::stable_sort this never allocates.
+template<typename T, typename Compare>
+static void StableSort(T* items, T* scratch, int32 count, Compare compare)
+{
+	// Insertion sort short runs.
+	const int32 runLength = 16;
+	for (int32 begin = 0; begin < count; begin += runLength)
+	{
+		const int32 end = b2Min(begin + runLength, count);
+		for (int32 i = begin + 1; i < end; ++i)
+		{
+			T item = items[i];
+			int32 j = i;
+			for (; j > begin && compare(item, items[j - 1]); --j)
+			{
+				items[j] = items[j - 1];
+			}
+			items[j] = item;
+		}
+	}
+
+	// Merge pairs of runs, doubling their length each pass. std::merge
+	// takes from the first run on ties, which keeps the sort stable.
+	T* from = items;
+	T* to = scratch;
+	for (int32 width = runLength; width < count; width *= 2)
+	{
+		for (int32 begin = 0; begin < count; begin += 2 * width)
+		{
+			const int32 middle = b2Min(begin + width, count);
+			const int32 end = b2Min(begin + 2 * width, count);
+			std::merge(from + begin, from + middle, from + middle, from + end,
+					   to + begin, compare);
+		}
+		std::swap(from, to);
+	}
+	if (from != items)
+	{
+		memcpy(items, from, sizeof(T) * count);
+	}
+}
+
 void b2ParticleSystem::RemoveSpuriousBodyContacts()
 {
 	// At this point we have a list of contact candidates based on AABB
@@ -2727,8 +3286,16 @@ void b2ParticleSystem::RemoveSpuriousBodyContacts()
 	//         it, otherwise discard as impossible
 	//      - repeat for up to n nearest contacts, currently we get good results
 	//        from n=3.
-	std::sort(m_bodyContactBuffer.Begin(), m_bodyContactBuffer.End(),
-				b2ParticleSystem::BodyContactCompare);
+	// The sort is stable so that contacts of the same weight stay in the
+	// order they were found in. Its scratch memory comes from the stack
+	// allocator, so steps don't allocate.
+	const int32 count = m_bodyContactBuffer.GetCount();
+	b2ParticleBodyContact* scratch = (b2ParticleBodyContact*)
+		m_world->m_stackAllocator.Allocate(
+			sizeof(b2ParticleBodyContact) * count);
+	StableSort(m_bodyContactBuffer.Begin(), scratch, count,
+			   b2ParticleSystem::BodyContactCompare);
+	m_world->m_stackAllocator.Free(scratch);
 
 	int32 discarded = 0;
 	std::remove_if(m_bodyContactBuffer.Begin(),
@@ -2752,6 +3319,7 @@ bool b2ParticleSystem::BodyContactCompare(const b2ParticleBodyContact &lhs,
 
 void b2ParticleSystem::SolveCollision(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveCollision");
 	// This function detects particles which are crossing boundary of bodies
 	// and modifies velocities of them so that they will move just in front of
 	// boundary. This function function also applies the reaction force to
@@ -2842,18 +3410,20 @@ void b2ParticleSystem::SolveCollision(const b2TimeStep& step)
 
 	public:
 		SolveCollisionCallback(
-			b2ParticleSystem* system, const b2TimeStep& step, b2ContactFilter* contactFilter) :
-			b2FixtureParticleQueryCallback(system)
+			b2ParticleSystem* system, const b2AABB& aabb,
+			const b2TimeStep& step, b2ContactFilter* contactFilter) :
+			b2FixtureParticleQueryCallback(system, aabb)
 		{
 			m_step = step;
 			m_contactFilter = contactFilter;
 		}
-	} callback(this, step, GetFixtureContactFilter());
+	} callback(this, aabb, step, GetFixtureContactFilter());
 	m_world->QueryAABB(&callback, aabb);
 }
 
 void b2ParticleSystem::SolveBarrier(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveBarrier");
 	// If a particle is passing between paired barrier particles,
 	// its velocity will be decelerated to avoid passing.
 	for (int32 i = 0; i < m_count; i++)
@@ -2973,6 +3543,7 @@ void b2ParticleSystem::SolveBarrier(const b2TimeStep& step)
 
 void b2ParticleSystem::Solve(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::Solve");
 	if (m_count == 0)
 	{
 		return;
@@ -3093,6 +3664,11 @@ void b2ParticleSystem::Solve(const b2TimeStep& step)
 			m_positionBuffer.data[i] += subStep.dt * m_velocityBuffer.data[i];
 		}
 	}
+	// Give back memory left over from a burst of contacts, but never drop
+	// below the capacity hints.
+	m_proxyBuffer.Shrink(m_def.particleCapacity);
+	m_contactBuffer.Shrink(m_def.contactCapacity);
+	m_bodyContactBuffer.Shrink(m_def.bodyContactCapacity);
 }
 
 void b2ParticleSystem::UpdateAllParticleFlags()
@@ -3118,6 +3694,7 @@ void b2ParticleSystem::UpdateAllGroupFlags()
 
 void b2ParticleSystem::LimitVelocity(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::LimitVelocity");
 	float32 criticalVelocitySquared = GetCriticalVelocitySquared(step);
 	for (int32 i = 0; i < m_count; i++)
 	{
@@ -3132,6 +3709,7 @@ void b2ParticleSystem::LimitVelocity(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveGravity(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveGravity");
 	b2Vec2 gravity = step.dt * m_def.gravityScale * m_world->GetGravity();
 	for (int32 i = 0; i < m_count; i++)
 	{
@@ -3141,6 +3719,7 @@ void b2ParticleSystem::SolveGravity(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveStaticPressure(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveStaticPressure");
 	m_staticPressureBuffer = RequestBuffer(m_staticPressureBuffer);
 	float32 criticalPressure = GetCriticalPressure(step);
 	float32 pressurePerWeight = m_def.staticPressureStrength * criticalPressure;
@@ -3195,6 +3774,7 @@ void b2ParticleSystem::SolveStaticPressure(const b2TimeStep& step)
 
 void b2ParticleSystem::SolvePressure(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolvePressure");
 	// calculates pressure as a linear function of density
 	float32 criticalPressure = GetCriticalPressure(step);
 	float32 pressurePerWeight = m_def.pressureStrength * criticalPressure;
@@ -3260,6 +3840,7 @@ void b2ParticleSystem::SolvePressure(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveDamping(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveDamping");
 	// reduces normal velocity of each contact
 	float32 linearDamping = m_def.dampingStrength;
 	float32 quadraticDamping = 1 / GetCriticalVelocity(step);
@@ -3384,6 +3965,7 @@ inline void b2ParticleSystem::ApplyDamping(
 
 void b2ParticleSystem::SolveRigidDamping()
 {
+	b2TraceZone("b2ParticleSystem::SolveRigidDamping");
 	// Apply impulse to rigid particle groups colliding with other objects
 	// to reduce relative velocity at the colliding point.
 	float32 damping = m_def.dampingStrength;
@@ -3477,6 +4059,7 @@ void b2ParticleSystem::SolveRigidDamping()
 
 void b2ParticleSystem::SolveExtraDamping()
 {
+	b2TraceZone("b2ParticleSystem::SolveExtraDamping");
 	// Applies additional damping force between bodies and particles which can
 	// produce strong repulsive force. Applying damping force multiple times
 	// is effective in suppressing vibration.
@@ -3506,6 +4089,7 @@ void b2ParticleSystem::SolveExtraDamping()
 
 void b2ParticleSystem::SolveWall()
 {
+	b2TraceZone("b2ParticleSystem::SolveWall");
 	for (int32 i = 0; i < m_count; i++)
 	{
 		if (m_flagsBuffer.data[i] & b2_wallParticle)
@@ -3517,6 +4101,7 @@ void b2ParticleSystem::SolveWall()
 
 void b2ParticleSystem::SolveRigid(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveRigid");
 	for (b2ParticleGroup* group = m_groupList; group; group = group->GetNext())
 	{
 		if (group->m_groupFlags & b2_rigidParticleGroup)
@@ -3543,6 +4128,7 @@ void b2ParticleSystem::SolveRigid(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveElastic(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveElastic");
 	float32 elasticStrength = step.inv_dt * m_def.elasticStrength;
 	for (int32 k = 0; k < m_triadBuffer.GetCount(); k++)
 	{
@@ -3585,6 +4171,7 @@ void b2ParticleSystem::SolveElastic(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveSpring(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveSpring");
 	float32 springStrength = step.inv_dt * m_def.springStrength;
 	for (int32 k = 0; k < m_pairBuffer.GetCount(); k++)
 	{
@@ -3612,6 +4199,7 @@ void b2ParticleSystem::SolveSpring(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveTensile(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveTensile");
 	b2Assert(m_accumulation2Buffer);
 	for (int32 i = 0; i < m_count; i++)
 	{
@@ -3660,6 +4248,7 @@ void b2ParticleSystem::SolveTensile(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveViscous()
 {
+	b2TraceZone("b2ParticleSystem::SolveViscous");
 	float32 viscousStrength = m_def.viscousStrength;
 	for (int32 k = 0; k < m_bodyContactBuffer.GetCount(); k++)
 	{
@@ -3696,6 +4285,7 @@ void b2ParticleSystem::SolveViscous()
 
 void b2ParticleSystem::SolveRepulsive(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveRepulsive");
 	float32 repulsiveStrength =
 		m_def.repulsiveStrength * GetCriticalVelocity(step);
 	for (int32 k = 0; k < m_contactBuffer.GetCount(); k++)
@@ -3719,6 +4309,7 @@ void b2ParticleSystem::SolveRepulsive(const b2TimeStep& step)
 
 void b2ParticleSystem::SolvePowder(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolvePowder");
 	float32 powderStrength = m_def.powderStrength * GetCriticalVelocity(step);
 	float32 minWeight = 1.0f - b2_particleStride;
 	for (int32 k = 0; k < m_contactBuffer.GetCount(); k++)
@@ -3742,6 +4333,7 @@ void b2ParticleSystem::SolvePowder(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveSolid(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveSolid");
 	// applies extra repulsive force from solid particle groups
 	b2Assert(m_depthBuffer);
 	float32 ejectionStrength = step.inv_dt * m_def.ejectionStrength;
@@ -3764,6 +4356,7 @@ void b2ParticleSystem::SolveSolid(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveForce(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveForce");
 	float32 velocityPerForce = step.dt * GetParticleInvMass();
 	for (int32 i = 0; i < m_count; i++)
 	{
@@ -3774,6 +4367,7 @@ void b2ParticleSystem::SolveForce(const b2TimeStep& step)
 
 void b2ParticleSystem::SolveColorMixing()
 {
+	b2TraceZone("b2ParticleSystem::SolveColorMixing");
 	// mixes color between contacting particles
 	b2Assert(m_colorBuffer.data);
 	const int32 colorMixing128 = (int32) (128 * m_def.colorMixingStrength);
@@ -3798,6 +4392,7 @@ void b2ParticleSystem::SolveColorMixing()
 
 void b2ParticleSystem::SolveZombie()
 {
+	b2TraceZone("b2ParticleSystem::SolveZombie");
 	// removes particles with zombie flag
 	int32 newCount = 0;
 	int32* newIndices = (int32*) m_world->m_stackAllocator.Allocate(
@@ -4040,6 +4635,7 @@ void b2ParticleSystem::SolveZombie()
 /// SetParticleLifetime().
 void b2ParticleSystem::SolveLifetimes(const b2TimeStep& step)
 {
+	b2TraceZone("b2ParticleSystem::SolveLifetimes");
 	b2Assert(m_expirationTimeBuffer.data);
 	b2Assert(m_indexByExpirationTimeBuffer.data);
 	// Update the time elapsed.
@@ -20,6 +20,9 @@
 
 #include <Box2D/Common/b2SlabAllocator.h>
 #include <Box2D/Common/b2GrowableBuffer.h>
+#if LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+#include <Box2D/Common/b2ConcurrentSlabAllocator.h>
+#endif // LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
 #include <Box2D/Particle/b2Particle.h>
 #include <Box2D/Dynamics/b2TimeStep.h>
 
@@ -49,6 +52,20 @@ struct b2Vec2;
 struct b2AABB;
 struct FindContactInput;
 struct FindContactCheck;
+class b2SnapshotWriter;
+class b2SnapshotReader;
+
+#if LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+/// Allocator for particle handles that threads other than the one stepping
+/// the world can allocate from and free to.
+typedef b2ConcurrentSlabAllocator<b2ParticleHandle> b2ParticleHandleAllocator;
+/// Free particle handles owned by one thread.
+/// @see b2ParticleSystem::GetParticleHandleFromIndex(int32,
+/// b2ParticleHandleCache*)
+typedef b2ParticleHandleAllocator::Cache b2ParticleHandleCache;
+#else
+typedef b2SlabAllocator<b2ParticleHandle> b2ParticleHandleAllocator;
+#endif // LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
 
 struct b2ParticleContact
 {
@@ -178,6 +195,9 @@ struct b2ParticleSystemDef
 		colorMixingStrength = 0.5f;
 		destroyByAge = true;
 		lifetimeGranularity = 1.0f / 60.0f;
+		particleCapacity = 0;
+		contactCapacity = 0;
+		bodyContactCapacity = 0;
 	}
 
 	/// Enable strict Particle/Body contact check.
@@ -275,6 +295,20 @@ struct b2ParticleSystemDef
 	/// With the value set to 1/60 the maximum lifetime or age of a particle is
 	/// 2.27 years.
 	float32 lifetimeGranularity;
+
+	/// Number of particles to allocate buffers for when the system is
+	/// created. Buffers still grow past this when needed, but a system that
+	/// stays within its hints never reallocates during a step.
+	/// 0 allocates lazily when the first particle is created.
+	int32 particleCapacity;
+
+	/// Number of particle / particle contacts to reserve space for.
+	/// Contact buffers do not shrink below this.
+	int32 contactCapacity;
+
+	/// Number of particle / body contacts to reserve space for.
+	/// Contact buffers do not shrink below this.
+	int32 bodyContactCapacity;
 };
 
 
@@ -294,6 +328,24 @@ public:
 	/// Please see #b2ParticleHandle for why you might want a handle.
 	const b2ParticleHandle* GetParticleHandleFromIndex(const int32 index);
 
+#if LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+	/// Get the allocator particle handles come from. Each thread that
+	/// creates handles needs its own b2ParticleHandleCache of it.
+	b2ParticleHandleAllocator* GetParticleHandleAllocator();
+
+	/// Allocate the map from particle indices to handles, so that handles
+	/// can be created from several threads.
+	void PrepareParticleHandles();
+
+	/// Retrieve a handle to the particle at the specified index, creating
+	/// it through the calling thread's cache. Several threads may call this
+	/// at once for different particles after PrepareParticleHandles(), as
+	/// long as no particles are created or destroyed and the world isn't
+	/// stepping meanwhile.
+	const b2ParticleHandle* GetParticleHandleFromIndex(
+		const int32 index, b2ParticleHandleCache* cache);
+#endif // LIQUIDFUN_CONCURRENT_PARTICLE_HANDLES
+
 	/// Destroy a particle.
 	/// The particle is removed after the next simulation step (see
 	/// b2World::Step()).
@@ -349,6 +401,10 @@ public:
 
 	/// Create a particle group whose properties have been defined. No
 	/// reference to the definition is retained.
+	/// Returns NULL if the world is at its memory budget. Like reaching the
+	/// maximum particle count, hitting the budget part way through leaves
+	/// the group with fewer particles than its definition asks for. The
+	/// contacts found between the new particles are not refused.
 	/// @warning This function is locked during callbacks.
 	b2ParticleGroup* CreateParticleGroup(const b2ParticleGroupDef& def);
 
@@ -379,6 +435,10 @@ public:
 	/// Get the maximum number of particles.
 	int32 GetMaxParticleCount() const;
 
+	/// Get the number of bytes held by the particle and contact buffers and
+	/// the groups. Buffers supplied with Set*Buffer() are not counted.
+	int32 GetMemoryUsage() const;
+
 	/// Set the maximum number of particles.
 	/// A value of 0 means there is no maximum. The particle buffers can
 	/// continue to grow while b2World's block allocator still has memory.
@@ -765,9 +825,11 @@ private:
 	{
 		int32 index;
 		uint32 tag;
+		// Proxies with the same tag are ordered by index, so that sorting
+		// gives the same order with every std::sort implementation.
 		friend inline bool operator<(const Proxy &a, const Proxy &b)
 		{
-			return a.tag < b.tag;
+			return a.tag < b.tag || (a.tag == b.tag && a.index < b.index);
 		}
 		friend inline bool operator<(uint32 a, const Proxy &b)
 		{
@@ -874,12 +936,34 @@ private:
 		UserOverridableBuffer<T>* buffer, int32 oldCapacity, int32 newCapacity,
 		bool deferred);
 	template <typename T> T* RequestBuffer(T* buffer);
+	template <typename T> static int32 GetBufferBytes(
+		const T* buffer, int32 userSuppliedCapacity, bool deferred);
+	template <typename T> static int32 GetBufferBytes(
+		const UserOverridableBuffer<T>& buffer, bool deferred);
+	/// Get the bytes per particle of the buffers the system allocates.
+	int32 GetBytesPerParticle() const;
 
 	/// Reallocate the handle / index map and schedule the allocation of a new
 	/// pool for handle allocation.
 	void ReallocateHandleBuffers(int32 newCapacity);
 
 	void ReallocateInternalAllocatedBuffers(int32 capacity);
+
+	/// Write the particles, their groups and connections to a snapshot.
+	void Save(b2SnapshotWriter* writer) const;
+	/// Read the particles written by Save() into a new system, looking the
+	/// bodies of body contacts up in b2World's body array. Invalid data
+	/// flags an error on the reader.
+	void Load(b2SnapshotReader* reader, b2Body** bodies, int32 bodyCount);
+	/// Write a per particle buffer which may not be allocated, and read it
+	/// back, allocating it if it was.
+	template <typename T> void SaveBuffer(
+		b2SnapshotWriter* writer, const T* buffer) const;
+	template <typename T> T* LoadBuffer(b2SnapshotReader* reader, T* buffer);
+	template <typename T> static void SaveGrowableBuffer(
+		b2SnapshotWriter* writer, const b2GrowableBuffer<T>& buffer);
+	template <typename T> static void LoadGrowableBuffer(
+		b2SnapshotReader* reader, b2GrowableBuffer<T>* buffer);
 	int32 CreateParticleForGroup(
 		const b2ParticleGroupDef& groupDef,
 		const b2Transform& xf, const b2Vec2& position);
@@ -1081,7 +1165,7 @@ private:
 	int32 m_count;
 	int32 m_internalAllocatedCapacity;
 	/// Allocator for b2ParticleHandle instances.
-	b2SlabAllocator<b2ParticleHandle> m_handleAllocator;
+	b2ParticleHandleAllocator m_handleAllocator;
 	/// Maps particle indicies to  handles.
 	UserOverridableBuffer<b2ParticleHandle*> m_handleIndexBuffer;
 	UserOverridableBuffer<uint32> m_flagsBuffer;
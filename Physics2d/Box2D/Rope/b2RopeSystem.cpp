@@ -0,0 +1,484 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#include <Box2D/Rope/b2RopeSystem.h>
+#include <Box2D/Common/b2Draw.h>
+#include <Box2D/Common/b2Lanes.h>
+#include <Box2D/Common/b2TaskExecutor.h>
+#include <string.h>
+
+// Fewest batches handed to a task by Step().
+static const int32 b2_minRopeBatchRange = 8;
+
+b2RopeSystem::b2RopeSystem()
+{
+	m_batches = NULL;
+	m_batchCount = 0;
+	m_batchCapacity = 0;
+	m_ropeCount = 0;
+	m_vertices = NULL;
+	m_vertexCount = 0;
+	m_vertexCapacity = 0;
+	m_taskExecutor = NULL;
+	m_timeStep = 0.0f;
+	m_iterations = 0;
+}
+
+b2RopeSystem::~b2RopeSystem()
+{
+	for (int32 i = 0; i < m_batchCount; ++i)
+	{
+		b2Free(m_batches[i].pxs);
+	}
+	b2Free(m_batches);
+	b2Free(m_vertices);
+}
+
+void b2RopeSystem::ResizeBatch(b2RopeBatch* batch, int32 vertexCount)
+{
+	const int32 n = b2_ropeLaneCount;
+	const int32 oldCount = batch->vertexCount;
+	float32* block = (float32*)b2Alloc(
+		(7 * vertexCount + (vertexCount - 1) + (vertexCount - 2)) * n *
+		sizeof(float32));
+	float32** arrays[] = {
+		&batch->pxs, &batch->pys, &batch->p0xs, &batch->p0ys,
+		&batch->vxs, &batch->vys, &batch->ims, &batch->Ls, &batch->as };
+	const int32 sizes[] = {
+		vertexCount, vertexCount, vertexCount, vertexCount,
+		vertexCount, vertexCount, vertexCount, vertexCount - 1,
+		vertexCount - 2 };
+	const int32 oldSizes[] = {
+		oldCount, oldCount, oldCount, oldCount,
+		oldCount, oldCount, oldCount, b2Max(oldCount - 1, 0),
+		b2Max(oldCount - 2, 0) };
+
+	// Padding vertices are static and have no velocity, so the new space
+	// is zeroed.
+	float32* oldBlock = batch->pxs;
+	float32* array = block;
+	for (int32 i = 0; i < (int32)B2_ARRAY_SIZE(arrays); ++i)
+	{
+		memset(array, 0, sizes[i] * n * sizeof(float32));
+		if (oldBlock)
+		{
+			memcpy(array, *arrays[i], oldSizes[i] * n * sizeof(float32));
+		}
+		*arrays[i] = array;
+		array += sizes[i] * n;
+	}
+	b2Free(oldBlock);
+	batch->vertexCount = vertexCount;
+}
+
+int32 b2RopeSystem::CreateRope(const b2RopeDef* def)
+{
+	b2Assert(def->count >= 3);
+	const int32 count = def->count;
+	const int32 lane = m_ropeCount % b2_ropeLaneCount;
+	if (lane == 0)
+	{
+		if (m_batchCount == m_batchCapacity)
+		{
+			b2RopeBatch* oldBatches = m_batches;
+			m_batchCapacity = b2Max(2 * m_batchCapacity, 16);
+			m_batches = (b2RopeBatch*)b2Alloc(
+				m_batchCapacity * sizeof(b2RopeBatch));
+			memcpy(m_batches, oldBatches, m_batchCount * sizeof(b2RopeBatch));
+			b2Free(oldBatches);
+		}
+		memset(&m_batches[m_batchCount], 0, sizeof(b2RopeBatch));
+		++m_batchCount;
+	}
+	b2RopeBatch* batch = &m_batches[m_batchCount - 1];
+	if (count > batch->vertexCount)
+	{
+		ResizeBatch(batch, count);
+	}
+
+	if (m_vertexCount + count > m_vertexCapacity)
+	{
+		b2Vec2* oldVertices = m_vertices;
+		m_vertexCapacity = b2Max(2 * m_vertexCapacity, m_vertexCount + count);
+		m_vertices = (b2Vec2*)b2Alloc(m_vertexCapacity * sizeof(b2Vec2));
+		memcpy(m_vertices, oldVertices, m_vertexCount * sizeof(b2Vec2));
+		b2Free(oldVertices);
+	}
+	batch->vertexOffsets[lane] = m_vertexCount;
+	memcpy(m_vertices + m_vertexCount, def->vertices, count * sizeof(b2Vec2));
+	m_vertexCount += count;
+
+	const int32 n = b2_ropeLaneCount;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2Vec2& p = def->vertices[i];
+		batch->pxs[n * i + lane] = p.x;
+		batch->pys[n * i + lane] = p.y;
+		batch->p0xs[n * i + lane] = p.x;
+		batch->p0ys[n * i + lane] = p.y;
+
+		float32 m = def->masses[i];
+		batch->ims[n * i + lane] = m > 0.0f ? 1.0f / m : 0.0f;
+	}
+
+	for (int32 i = 0; i < count - 1; ++i)
+	{
+		batch->Ls[n * i + lane] =
+			b2Distance(def->vertices[i], def->vertices[i + 1]);
+	}
+
+	for (int32 i = 0; i < count - 2; ++i)
+	{
+		b2Vec2 d1 = def->vertices[i + 1] - def->vertices[i];
+		b2Vec2 d2 = def->vertices[i + 2] - def->vertices[i + 1];
+		batch->as[n * i + lane] = b2Atan2(b2Cross(d1, d2), b2Dot(d1, d2));
+	}
+
+	batch->counts[lane] = count;
+	batch->gravityX[lane] = def->gravity.x;
+	batch->gravityY[lane] = def->gravity.y;
+	batch->damping[lane] = def->damping;
+	batch->k2[lane] = def->k2;
+	batch->k3[lane] = def->k3;
+	return m_ropeCount++;
+}
+
+int32 b2RopeSystem::GetRopeVertexOffset(int32 rope) const
+{
+	b2Assert(0 <= rope && rope < m_ropeCount);
+	return m_batches[rope / b2_ropeLaneCount].vertexOffsets[
+		rope % b2_ropeLaneCount];
+}
+
+int32 b2RopeSystem::GetRopeVertexCount(int32 rope) const
+{
+	b2Assert(0 <= rope && rope < m_ropeCount);
+	return m_batches[rope / b2_ropeLaneCount].counts[rope % b2_ropeLaneCount];
+}
+
+void b2RopeSystem::SetAngle(int32 rope, float32 angle)
+{
+	b2Assert(0 <= rope && rope < m_ropeCount);
+	b2RopeBatch* batch = &m_batches[rope / b2_ropeLaneCount];
+	const int32 lane = rope % b2_ropeLaneCount;
+	const int32 count3 = batch->counts[lane] - 2;
+	for (int32 i = 0; i < count3; ++i)
+	{
+		batch->as[b2_ropeLaneCount * i + lane] = angle;
+	}
+}
+
+void b2RopeSystem::Step(float32 h, int32 iterations)
+{
+	if (h == 0.0)
+	{
+		return;
+	}
+
+	m_timeStep = h;
+	m_iterations = iterations;
+	if (m_taskExecutor)
+	{
+		m_taskExecutor->ParallelFor(&b2RopeSystem::StepRange, this,
+									m_batchCount, b2_minRopeBatchRange);
+	}
+	else
+	{
+		StepRange(this, 0, m_batchCount);
+	}
+}
+
+void b2RopeSystem::StepRange(void* context, int32 begin, int32 end)
+{
+	b2RopeSystem* system = (b2RopeSystem*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		system->StepBatch(&system->m_batches[i]);
+	}
+}
+
+// The same steps as b2Rope::Step(), on all lanes at once.
+void b2RopeSystem::StepBatch(b2RopeBatch* batch)
+{
+	const int32 n = b2_ropeLaneCount;
+	const float32 h = m_timeStep;
+
+	float32 d[b2_ropeLaneCount];
+	for (int32 l = 0; l < n; ++l)
+	{
+		d[l] = b2Exp(- h * batch->damping[l]);
+	}
+
+	const b2Lanes zero = b2LanesSplat(0.0f);
+	const b2Lanes hs = b2LanesSplat(h);
+	const b2Lanes ds = b2LanesLoad(d);
+	const b2Lanes hgx = b2LanesMul(hs, b2LanesLoad(batch->gravityX));
+	const b2Lanes hgy = b2LanesMul(hs, b2LanesLoad(batch->gravityY));
+	for (int32 i = 0; i < batch->vertexCount * n; i += n)
+	{
+		const b2Lanes px = b2LanesLoad(batch->pxs + i);
+		const b2Lanes py = b2LanesLoad(batch->pys + i);
+		b2LanesStore(batch->p0xs + i, px);
+		b2LanesStore(batch->p0ys + i, py);
+
+		const b2Lanes dynamic =
+			b2LanesLess(zero, b2LanesLoad(batch->ims + i));
+		b2Lanes vx = b2LanesLoad(batch->vxs + i);
+		b2Lanes vy = b2LanesLoad(batch->vys + i);
+		vx = b2LanesSelect(dynamic, b2LanesAdd(vx, hgx), vx);
+		vy = b2LanesSelect(dynamic, b2LanesAdd(vy, hgy), vy);
+		vx = b2LanesMul(vx, ds);
+		vy = b2LanesMul(vy, ds);
+		b2LanesStore(batch->vxs + i, vx);
+		b2LanesStore(batch->vys + i, vy);
+		b2LanesStore(batch->pxs + i, b2LanesAdd(px, b2LanesMul(hs, vx)));
+		b2LanesStore(batch->pys + i, b2LanesAdd(py, b2LanesMul(hs, vy)));
+	}
+
+	for (int32 i = 0; i < m_iterations; ++i)
+	{
+		SolveC2(batch);
+		SolveC3(batch);
+		SolveC2(batch);
+	}
+
+	const b2Lanes inv_h = b2LanesSplat(1.0f / h);
+	for (int32 i = 0; i < batch->vertexCount * n; i += n)
+	{
+		b2LanesStore(batch->vxs + i, b2LanesMul(inv_h, b2LanesSub(
+			b2LanesLoad(batch->pxs + i), b2LanesLoad(batch->p0xs + i))));
+		b2LanesStore(batch->vys + i, b2LanesMul(inv_h, b2LanesSub(
+			b2LanesLoad(batch->pys + i), b2LanesLoad(batch->p0ys + i))));
+	}
+
+	// Copy the positions out to the vertex buffer.
+	for (int32 l = 0; l < n; ++l)
+	{
+		b2Vec2* vertices = m_vertices + batch->vertexOffsets[l];
+		for (int32 i = 0; i < batch->counts[l]; ++i)
+		{
+			vertices[i].Set(batch->pxs[n * i + l], batch->pys[n * i + l]);
+		}
+	}
+}
+
+void b2RopeSystem::SolveC2(b2RopeBatch* batch) const
+{
+	const int32 n = b2_ropeLaneCount;
+
+	// Lanes whose rope has a constraint i are those with i < counts2.
+	float32 counts2[b2_ropeLaneCount];
+	for (int32 l = 0; l < n; ++l)
+	{
+		counts2[l] = (float32)(batch->counts[l] - 1);
+	}
+	const b2Lanes laneCounts2 = b2LanesLoad(counts2);
+	const b2Lanes zero = b2LanesSplat(0.0f);
+	const b2Lanes one = b2LanesSplat(1.0f);
+	const b2Lanes epsilon = b2LanesSplat(b2_epsilon);
+	const b2Lanes k2 = b2LanesLoad(batch->k2);
+
+	const int32 count2 = batch->vertexCount - 1;
+	for (int32 i = 0; i < count2; ++i)
+	{
+		float32* px = batch->pxs + n * i;
+		float32* py = batch->pys + n * i;
+		const b2Lanes p1x = b2LanesLoad(px);
+		const b2Lanes p1y = b2LanesLoad(py);
+		const b2Lanes p2x = b2LanesLoad(px + n);
+		const b2Lanes p2y = b2LanesLoad(py + n);
+
+		// b2Vec2::Normalize() on all lanes.
+		b2Lanes dx = b2LanesSub(p2x, p1x);
+		b2Lanes dy = b2LanesSub(p2y, p1y);
+		const b2Lanes length = b2LanesSqrt(
+			b2LanesAdd(b2LanesMul(dx, dx), b2LanesMul(dy, dy)));
+		const b2Lanes normalized = b2LanesLessEqual(epsilon, length);
+		const b2Lanes invLength = b2LanesDiv(one, length);
+		dx = b2LanesSelect(normalized, b2LanesMul(dx, invLength), dx);
+		dy = b2LanesSelect(normalized, b2LanesMul(dy, invLength), dy);
+		const b2Lanes L = b2LanesSelect(normalized, length, zero);
+
+		const b2Lanes im1 = b2LanesLoad(batch->ims + n * i);
+		const b2Lanes im2 = b2LanesLoad(batch->ims + n * (i + 1));
+		const b2Lanes im = b2LanesAdd(im1, im2);
+		const b2Lanes active = b2LanesAnd(
+			b2LanesLess(b2LanesSplat((float32)i), laneCounts2),
+			b2LanesNotEqual(im, zero));
+		if (!b2LanesAny(active))
+		{
+			continue;
+		}
+
+		const b2Lanes s1 = b2LanesDiv(im1, im);
+		const b2Lanes s2 = b2LanesDiv(im2, im);
+		const b2Lanes C = b2LanesSub(b2LanesLoad(batch->Ls + n * i), L);
+		const b2Lanes f1 = b2LanesMul(b2LanesMul(k2, s1), C);
+		const b2Lanes f2 = b2LanesMul(b2LanesMul(k2, s2), C);
+
+		b2LanesStore(px, b2LanesSelect(active,
+			b2LanesSub(p1x, b2LanesMul(f1, dx)), p1x));
+		b2LanesStore(py, b2LanesSelect(active,
+			b2LanesSub(p1y, b2LanesMul(f1, dy)), p1y));
+		b2LanesStore(px + n, b2LanesSelect(active,
+			b2LanesAdd(p2x, b2LanesMul(f2, dx)), p2x));
+		b2LanesStore(py + n, b2LanesSelect(active,
+			b2LanesAdd(p2y, b2LanesMul(f2, dy)), p2y));
+	}
+}
+
+void b2RopeSystem::SolveC3(b2RopeBatch* batch) const
+{
+	const int32 n = b2_ropeLaneCount;
+
+	float32 counts3[b2_ropeLaneCount];
+	for (int32 l = 0; l < n; ++l)
+	{
+		counts3[l] = (float32)(batch->counts[l] - 2);
+	}
+	const b2Lanes laneCounts3 = b2LanesLoad(counts3);
+	const b2Lanes zero = b2LanesSplat(0.0f);
+	const b2Lanes one = b2LanesSplat(1.0f);
+	const b2Lanes minusOne = b2LanesSplat(-1.0f);
+	const b2Lanes minusK3 = b2LanesNeg(b2LanesLoad(batch->k3));
+
+	const int32 count3 = batch->vertexCount - 2;
+	for (int32 i = 0; i < count3; ++i)
+	{
+		float32* px = batch->pxs + n * i;
+		float32* py = batch->pys + n * i;
+		const b2Lanes p1x = b2LanesLoad(px);
+		const b2Lanes p1y = b2LanesLoad(py);
+		const b2Lanes p2x = b2LanesLoad(px + n);
+		const b2Lanes p2y = b2LanesLoad(py + n);
+		const b2Lanes p3x = b2LanesLoad(px + 2 * n);
+		const b2Lanes p3y = b2LanesLoad(py + 2 * n);
+
+		const b2Lanes m1 = b2LanesLoad(batch->ims + n * i);
+		const b2Lanes m2 = b2LanesLoad(batch->ims + n * (i + 1));
+		const b2Lanes m3 = b2LanesLoad(batch->ims + n * (i + 2));
+
+		const b2Lanes d1x = b2LanesSub(p2x, p1x);
+		const b2Lanes d1y = b2LanesSub(p2y, p1y);
+		const b2Lanes d2x = b2LanesSub(p3x, p2x);
+		const b2Lanes d2y = b2LanesSub(p3y, p2y);
+
+		const b2Lanes L1sqr =
+			b2LanesAdd(b2LanesMul(d1x, d1x), b2LanesMul(d1y, d1y));
+		const b2Lanes L2sqr =
+			b2LanesAdd(b2LanesMul(d2x, d2x), b2LanesMul(d2y, d2y));
+		b2Lanes active = b2LanesAnd(
+			b2LanesLess(b2LanesSplat((float32)i), laneCounts3),
+			b2LanesNotEqual(b2LanesMul(L1sqr, L2sqr), zero));
+		if (!b2LanesAny(active))
+		{
+			continue;
+		}
+
+		// Jd1 = (-1 / L1sqr) * d1.Skew(), Jd2 = (1 / L2sqr) * d2.Skew().
+		const b2Lanes c1 = b2LanesDiv(minusOne, L1sqr);
+		const b2Lanes c2 = b2LanesDiv(one, L2sqr);
+		const b2Lanes Jd1x = b2LanesMul(c1, b2LanesNeg(d1y));
+		const b2Lanes Jd1y = b2LanesMul(c1, d1x);
+		const b2Lanes Jd2x = b2LanesMul(c2, b2LanesNeg(d2y));
+		const b2Lanes Jd2y = b2LanesMul(c2, d2x);
+
+		const b2Lanes J1x = b2LanesNeg(Jd1x);
+		const b2Lanes J1y = b2LanesNeg(Jd1y);
+		const b2Lanes J2x = b2LanesSub(Jd1x, Jd2x);
+		const b2Lanes J2y = b2LanesSub(Jd1y, Jd2y);
+		const b2Lanes J3x = Jd2x;
+		const b2Lanes J3y = Jd2y;
+
+		b2Lanes mass = b2LanesAdd(b2LanesAdd(
+			b2LanesMul(m1, b2LanesAdd(b2LanesMul(J1x, J1x), b2LanesMul(J1y, J1y))),
+			b2LanesMul(m2, b2LanesAdd(b2LanesMul(J2x, J2x), b2LanesMul(J2y, J2y)))),
+			b2LanesMul(m3, b2LanesAdd(b2LanesMul(J3x, J3x), b2LanesMul(J3y, J3y))));
+		active = b2LanesAnd(active, b2LanesNotEqual(mass, zero));
+		if (!b2LanesAny(active))
+		{
+			continue;
+		}
+		mass = b2LanesDiv(one, mass);
+
+		// The angle has no SIMD version, so it is found one lane at a time.
+		float32 a[b2_ropeLaneCount];
+		float32 b[b2_ropeLaneCount];
+		float32 C[b2_ropeLaneCount];
+		b2LanesStore(a, b2LanesSub(b2LanesMul(d1x, d2y), b2LanesMul(d1y, d2x)));
+		b2LanesStore(b, b2LanesAdd(b2LanesMul(d1x, d2x), b2LanesMul(d1y, d2y)));
+		// Only the active lanes are solved. Their mask isn't zero in C.
+		b2LanesStore(C, active);
+		for (int32 l = 0; l < n; ++l)
+		{
+			if (C[l] == 0.0f)
+			{
+				continue;
+			}
+
+			const float32 restAngle = batch->as[n * i + l];
+			float32 angle = b2Atan2(a[l], b[l]);
+			C[l] = angle - restAngle;
+
+			while (C[l] > b2_pi)
+			{
+				angle -= 2 * b2_pi;
+				C[l] = angle - restAngle;
+			}
+
+			while (C[l] < -b2_pi)
+			{
+				angle += 2.0f * b2_pi;
+				C[l] = angle - restAngle;
+			}
+		}
+
+		const b2Lanes impulse =
+			b2LanesMul(b2LanesMul(minusK3, mass), b2LanesLoad(C));
+		const b2Lanes i1 = b2LanesMul(m1, impulse);
+		const b2Lanes i2 = b2LanesMul(m2, impulse);
+		const b2Lanes i3 = b2LanesMul(m3, impulse);
+
+		b2LanesStore(px, b2LanesSelect(active,
+			b2LanesAdd(p1x, b2LanesMul(i1, J1x)), p1x));
+		b2LanesStore(py, b2LanesSelect(active,
+			b2LanesAdd(p1y, b2LanesMul(i1, J1y)), p1y));
+		b2LanesStore(px + n, b2LanesSelect(active,
+			b2LanesAdd(p2x, b2LanesMul(i2, J2x)), p2x));
+		b2LanesStore(py + n, b2LanesSelect(active,
+			b2LanesAdd(p2y, b2LanesMul(i2, J2y)), p2y));
+		b2LanesStore(px + 2 * n, b2LanesSelect(active,
+			b2LanesAdd(p3x, b2LanesMul(i3, J3x)), p3x));
+		b2LanesStore(py + 2 * n, b2LanesSelect(active,
+			b2LanesAdd(p3y, b2LanesMul(i3, J3y)), p3y));
+	}
+}
+
+void b2RopeSystem::Draw(b2Draw* draw) const
+{
+	b2Color c(0.4f, 0.5f, 0.7f);
+
+	for (int32 rope = 0; rope < m_ropeCount; ++rope)
+	{
+		const b2Vec2* vertices = m_vertices + GetRopeVertexOffset(rope);
+		const int32 count = GetRopeVertexCount(rope);
+		for (int32 i = 0; i < count - 1; ++i)
+		{
+			draw->DrawSegment(vertices[i], vertices[i + 1], c);
+		}
+	}
+}
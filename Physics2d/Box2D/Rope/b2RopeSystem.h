@@ -0,0 +1,136 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef B2_ROPE_SYSTEM_H
+#define B2_ROPE_SYSTEM_H
+
+#include <Box2D/Common/b2Lanes.h>
+#include <Box2D/Rope/b2Rope.h>
+
+class b2Draw;
+class b2TaskExecutor;
+
+/// Number of ropes stepped together by b2RopeSystem, one per lane.
+#define b2_ropeLaneCount b2_laneCount
+
+/// Four ropes whose vertices are stored interleaved, so the n-th vertex of
+/// every rope is solved at once. Ropes shorter than the longest one are
+/// padded with static vertices whose constraints are switched off. This is
+/// an internal struct.
+struct b2RopeBatch
+{
+	// Number of vertices of each lane, 0 for a free lane.
+	int32 counts[b2_ropeLaneCount];
+	// Vertices of the longest rope.
+	int32 vertexCount;
+
+	// Arrays of vertexCount (Ls: vertexCount - 1, as: vertexCount - 2)
+	// groups of b2_ropeLaneCount values, all in one allocation.
+	float32* pxs;
+	float32* pys;
+	float32* p0xs;
+	float32* p0ys;
+	float32* vxs;
+	float32* vys;
+	float32* ims;
+	float32* Ls;
+	float32* as;
+
+	float32 gravityX[b2_ropeLaneCount];
+	float32 gravityY[b2_ropeLaneCount];
+	float32 damping[b2_ropeLaneCount];
+	float32 k2[b2_ropeLaneCount];
+	float32 k3[b2_ropeLaneCount];
+
+	// Offset of each lane's vertices in b2RopeSystem's vertex buffer.
+	int32 vertexOffsets[b2_ropeLaneCount];
+};
+
+/// Steps many ropes in one call. It gives the same results as a b2Rope per
+/// rope, but the ropes are solved b2_ropeLaneCount at a time with SIMD, and
+/// groups of them can be spread over a b2TaskExecutor's threads. This is
+/// much faster than b2Rope for lots of short ropes.
+class b2RopeSystem
+{
+public:
+	b2RopeSystem();
+	~b2RopeSystem();
+
+	/// Add a rope, returning its index. Indices start at 0 and go up by one
+	/// for each rope.
+	int32 CreateRope(const b2RopeDef* def);
+
+	/// Get the number of ropes.
+	int32 GetRopeCount() const { return m_ropeCount; }
+
+	/// Step every rope.
+	void Step(float32 timeStep, int32 iterations);
+
+	/// Step the ropes on an executor's threads, or on the calling thread if
+	/// NULL. The executor is not owned by the system.
+	void SetTaskExecutor(b2TaskExecutor* taskExecutor)
+	{
+		m_taskExecutor = taskExecutor;
+	}
+
+	/// Get the vertices of all ropes, one rope after another in the order
+	/// they were created. Updated by Step(), so it can be handed to a
+	/// renderer as is.
+	const b2Vec2* GetVertexBuffer() const { return m_vertices; }
+
+	/// Get the number of vertices in the vertex buffer.
+	int32 GetVertexCount() const { return m_vertexCount; }
+
+	/// Get the offset of a rope's first vertex in the vertex buffer.
+	int32 GetRopeVertexOffset(int32 rope) const;
+
+	/// Get the number of vertices of a rope.
+	int32 GetRopeVertexCount(int32 rope) const;
+
+	/// Set the rest angle between every pair of segments of a rope.
+	void SetAngle(int32 rope, float32 angle);
+
+	///
+	void Draw(b2Draw* draw) const;
+
+private:
+	// Resize a batch's arrays for vertexCount vertices, keeping its ropes.
+	void ResizeBatch(b2RopeBatch* batch, int32 vertexCount);
+
+	// Step the batches [begin, end).
+	static void StepRange(void* context, int32 begin, int32 end);
+	void StepBatch(b2RopeBatch* batch);
+	void SolveC2(b2RopeBatch* batch) const;
+	void SolveC3(b2RopeBatch* batch) const;
+
+	b2RopeBatch* m_batches;
+	int32 m_batchCount;
+	int32 m_batchCapacity;
+	int32 m_ropeCount;
+
+	b2Vec2* m_vertices;
+	int32 m_vertexCount;
+	int32 m_vertexCapacity;
+
+	b2TaskExecutor* m_taskExecutor;
+
+	// Parameters of the step in progress.
+	float32 m_timeStep;
+	int32 m_iterations;
+};
+
+#endif
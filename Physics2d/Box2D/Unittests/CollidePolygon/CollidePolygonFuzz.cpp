@@ -0,0 +1,136 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Fuzzes b2CollidePolygons() on random convex polygons in random poses and
+// checks each manifold against b2CollidePolygonsReference(). This only
+// tests something in SIMD builds. Build it with the library sources and
+// LIQUIDFUN_SIMD_SSE or LIQUIDFUN_SIMD_NEON defined, leaving out the other
+// programs under Unittests and Benchmark.
+//
+// The exit status is 1 if any manifold mismatches.
+
+#include <Box2D/Box2D.h>
+#include <math.h>
+#include <stdio.h>
+
+// Number of random polygon pairs collided.
+static const int32 k_pairCount = 200000;
+
+// Largest difference allowed between points of matching manifolds.
+static const float32 k_pointTolerance = b2_linearSlop * 0.01f;
+
+// Small linear congruential generator, so every platform sees the same
+// polygons.
+static uint32 s_seed = 12345;
+
+static float32 RandomFloat(float32 lo, float32 hi)
+{
+	s_seed = s_seed * 1664525 + 1013904223;
+	return lo + (hi - lo) * (float32)(s_seed >> 8) / (float32)(1 << 24);
+}
+
+// Build a random convex polygon with 3 to b2_maxPolygonVertices vertices.
+// Some are long and thin.
+static void RandomPolygon(b2PolygonShape* polygon)
+{
+	const int32 count = 3 + (int32)RandomFloat(0.0f,
+		(float32)(b2_maxPolygonVertices - 2) - 0.001f);
+	const float32 scaleX = RandomFloat(0.5f, 2.0f);
+	const float32 scaleY = RandomFloat(0.5f, 2.0f);
+	b2Vec2 points[b2_maxPolygonVertices];
+	for (int32 i = 0; i < count; ++i)
+	{
+		const float32 angle = 2.0f * b2_pi *
+			((float32)i + RandomFloat(0.0f, 0.5f)) / (float32)count;
+		const float32 radius = RandomFloat(0.5f, 1.0f);
+		points[i].Set(scaleX * radius * cosf(angle),
+					  scaleY * radius * sinf(angle));
+	}
+	polygon->Set(points, count);
+}
+
+static b2Transform RandomTransform()
+{
+	return b2Transform(b2Vec2(RandomFloat(-2.0f, 2.0f),
+							  RandomFloat(-2.0f, 2.0f)),
+					   b2Rot(RandomFloat(-b2_pi, b2_pi)));
+}
+
+static bool ManifoldsMatch(const b2Manifold& a, const b2Manifold& b)
+{
+	const float32 tolerance = k_pointTolerance * k_pointTolerance;
+	if (a.pointCount != b.pointCount)
+	{
+		return false;
+	}
+	if (a.pointCount == 0)
+	{
+		return true;
+	}
+	if (a.type != b.type ||
+		b2DistanceSquared(a.localNormal, b.localNormal) > tolerance ||
+		b2DistanceSquared(a.localPoint, b.localPoint) > tolerance)
+	{
+		return false;
+	}
+	for (int32 i = 0; i < a.pointCount; ++i)
+	{
+		if (a.points[i].id.key != b.points[i].id.key ||
+			b2DistanceSquared(a.points[i].localPoint,
+							  b.points[i].localPoint) > tolerance)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	int32 mismatchCount = 0;
+	int32 touchingCount = 0;
+	for (int32 i = 0; i < k_pairCount; ++i)
+	{
+		b2PolygonShape polygonA, polygonB;
+		RandomPolygon(&polygonA);
+		RandomPolygon(&polygonB);
+		const b2Transform xfA = RandomTransform();
+		const b2Transform xfB = RandomTransform();
+
+		b2Manifold manifold, reference;
+		b2CollidePolygons(&manifold, &polygonA, xfA, &polygonB, xfB);
+		b2CollidePolygonsReference(&reference, &polygonA, xfA, &polygonB,
+								   xfB);
+		if (reference.pointCount > 0)
+		{
+			++touchingCount;
+		}
+		if (!ManifoldsMatch(manifold, reference))
+		{
+			if (mismatchCount < 10)
+			{
+				printf("mismatch at pair %d: %d points, reference %d\n", i,
+					   manifold.pointCount, reference.pointCount);
+			}
+			++mismatchCount;
+		}
+	}
+	printf("%d pairs, %d touching, %d mismatches\n", k_pairCount,
+		   touchingCount, mismatchCount);
+	return mismatchCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Checks that b2GrowableBuffer::Shrink() gives memory back without leaking
+// blocks of its b2BlockAllocator. Build it with the library sources,
+// leaving out the other programs under Unittests and Benchmark. It runs
+// two tests:
+// - An emptied buffer is shrunk many times with no minimum capacity. It
+//   must stop at b2_minParticleSystemBufferCapacity, and once freed the
+//   allocator must have no live blocks and Trim() must release every chunk.
+// - b2BlockAllocator::Reallocate() to 0 bytes frees the block, for block
+//   and giant sizes.
+//
+// The exit status is 1 if any check fails.
+
+#include <Box2D/Box2D.h>
+#include <Box2D/Common/b2GrowableBuffer.h>
+#include <stdio.h>
+
+// Elements reserved before the buffer is emptied.
+static const int32 k_reservedCount = 4096;
+// Shrink() calls on the empty buffer, enough to halve it to nothing many
+// times over.
+static const int32 k_shrinkCount = 1200;
+
+// Count the blocks still allocated, and the chunks held, in all size
+// classes.
+static void CountBlocks(const b2BlockAllocator& allocator, int32* liveBlocks,
+						int32* chunks)
+{
+	*liveBlocks = 0;
+	*chunks = 0;
+	for (int32 i = 0; i < b2_blockSizes; ++i)
+	{
+		b2BlockSizeClassStats stats;
+		allocator.GetSizeClassStats(i, &stats);
+		*liveBlocks += stats.liveBlocks;
+		*chunks += stats.chunkCount;
+	}
+}
+
+static int32 TestShrink()
+{
+	int32 errors = 0;
+	b2BlockAllocator allocator;
+	{
+		b2GrowableBuffer<int32> buffer(allocator);
+		buffer.Reserve(k_reservedCount);
+		buffer.SetCount(0);
+		for (int32 i = 0; i < k_shrinkCount; ++i)
+		{
+			buffer.Shrink(0);
+		}
+		if (buffer.GetCapacity() != b2_minParticleSystemBufferCapacity ||
+			buffer.Data() == NULL)
+		{
+			printf("shrunk to capacity %d\n", buffer.GetCapacity());
+			++errors;
+		}
+		buffer.Free();
+	}
+	allocator.Trim();
+	int32 live, chunks;
+	CountBlocks(allocator, &live, &chunks);
+	if (live != 0 || chunks != 0)
+	{
+		printf("after Free() and Trim(): %d live blocks, %d chunks\n",
+			   live, chunks);
+		++errors;
+	}
+	return errors;
+}
+
+static int32 TestReallocateToZero()
+{
+	int32 errors = 0;
+	b2BlockAllocator allocator;
+	const int32 sizes[] = { 1, 64, b2_maxBlockSize, 4 * b2_maxBlockSize };
+	for (uint32 i = 0; i < B2_ARRAY_SIZE(sizes); ++i)
+	{
+		void* p = allocator.Allocate(sizes[i]);
+		if (allocator.Reallocate(p, sizes[i], 0) != NULL)
+		{
+			++errors;
+		}
+	}
+	allocator.Trim();
+	int32 live, chunks;
+	CountBlocks(allocator, &live, &chunks);
+	if (live != 0 || chunks != 0 || allocator.GetNumGiantAllocations() != 0)
+	{
+		printf("Reallocate() to 0 bytes leaked\n");
+		++errors;
+	}
+	return errors;
+}
+
+int main()
+{
+	const int32 errors = TestShrink() + TestReallocateToZero();
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
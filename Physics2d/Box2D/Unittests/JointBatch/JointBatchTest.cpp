@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Checks that solving an island's joints in type batches, as
+// b2World::SetJointBatching() enables, doesn't change what a jointed rig
+// settles to. Grouping the joints by type changes the order the solver
+// visits them in, so the steps differ bit for bit, but a rig at rest has
+// one pose. Hanging chains and a bridge, whose links mix joint types, are
+// stepped to rest with and without batching, and every body must end up
+// in the same place and at the same angle within a tolerance. The steps
+// are timed both ways as well. Build it with the library sources, leaving
+// out the other programs under Unittests and Benchmark.
+//
+// The exit status is 1 if any body's rest pose differs.
+
+#include <Box2D/Box2D.h>
+#include <stdio.h>
+#include <vector>
+
+// Hanging chains, and the links of each chain and of the bridge.
+static const int32 k_chainCount = 8;
+static const int32 k_linkCount = 24;
+// Steps run to let the rigs come to rest.
+static const int32 k_stepCount = 1800;
+
+static const float32 k_timeStep = 1.0f / 60.0f;
+static const int32 k_velocityIterations = 8;
+static const int32 k_positionIterations = 3;
+
+// Largest differences allowed between the two rest poses.
+static const float32 k_positionTolerance = 0.001f;
+static const float32 k_angleTolerance = 0.001f;
+
+// Join two links at anchor with a joint of the type picked by index, so
+// consecutive joints of a rig are of different types.
+static void CreateLinkJoint(b2World* world, b2Body* bodyA, b2Body* bodyB,
+							const b2Vec2& anchor, int32 index)
+{
+	switch (index % 4)
+	{
+	case 0:
+		{
+			b2RevoluteJointDef def;
+			def.Initialize(bodyA, bodyB, anchor);
+			world->CreateJoint(&def);
+		}
+		break;
+
+	case 1:
+		{
+			b2WeldJointDef def;
+			def.Initialize(bodyA, bodyB, anchor);
+			def.frequencyHz = 4.0f;
+			def.dampingRatio = 0.7f;
+			world->CreateJoint(&def);
+		}
+		break;
+
+	case 2:
+		{
+			b2WheelJointDef def;
+			def.Initialize(bodyA, bodyB, anchor, b2Vec2(1.0f, 0.0f));
+			def.frequencyHz = 4.0f;
+			def.dampingRatio = 0.7f;
+			world->CreateJoint(&def);
+		}
+		break;
+
+	case 3:
+		{
+			b2PrismaticJointDef def;
+			def.Initialize(bodyA, bodyB, anchor, b2Vec2(1.0f, 0.0f));
+			def.enableLimit = true;
+			def.lowerTranslation = -0.05f;
+			def.upperTranslation = 0.05f;
+			world->CreateJoint(&def);
+		}
+		break;
+	}
+}
+
+// Create the rigs, each link a damped box so the rigs come to rest.
+static void CreateRigs(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2PolygonShape link;
+	link.SetAsBox(0.5f, 0.125f);
+	b2FixtureDef fixtureDef;
+	fixtureDef.shape = &link;
+	fixtureDef.density = 20.0f;
+	// The links of a rig pass through each other.
+	fixtureDef.filter.groupIndex = -1;
+
+	b2BodyDef linkDef;
+	linkDef.type = b2_dynamicBody;
+	linkDef.linearDamping = 2.0f;
+	linkDef.angularDamping = 2.0f;
+
+	// Chains hanging from the ground, let go straight out to the side.
+	for (int32 chain = 0; chain < k_chainCount; ++chain)
+	{
+		const b2Vec2 origin(-60.0f + 8.0f * chain, 40.0f);
+		b2Body* prev = ground;
+		for (int32 i = 0; i < k_linkCount; ++i)
+		{
+			linkDef.position = origin + b2Vec2(0.5f + i, 0.0f);
+			b2Body* body = world->CreateBody(&linkDef);
+			body->CreateFixture(&fixtureDef);
+			CreateLinkJoint(world, prev, body,
+							origin + b2Vec2((float32)i, 0.0f), chain + i);
+			prev = body;
+		}
+	}
+
+	// A bridge hung between two ground anchors.
+	const b2Vec2 origin(20.0f, 10.0f);
+	b2Body* prev = ground;
+	for (int32 i = 0; i < k_linkCount; ++i)
+	{
+		linkDef.position = origin + b2Vec2(0.5f + i, 0.0f);
+		b2Body* body = world->CreateBody(&linkDef);
+		body->CreateFixture(&fixtureDef);
+		CreateLinkJoint(world, prev, body, origin + b2Vec2((float32)i, 0.0f),
+						i);
+		prev = body;
+	}
+	b2RevoluteJointDef end;
+	end.Initialize(prev, ground, origin + b2Vec2((float32)k_linkCount, 0.0f));
+	world->CreateJoint(&end);
+}
+
+// Step the rigs to rest, returning the time taken and the bodies' poses in
+// the order they were created.
+static float32 Settle(bool batchJoints, std::vector<b2Transform>* poses)
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetJointBatching(batchJoints);
+	// Sleeping would stop a rig wherever it got slow enough, rather than at
+	// rest.
+	world.SetAllowSleeping(false);
+	CreateRigs(&world);
+
+	b2Timer timer;
+	for (int32 i = 0; i < k_stepCount; ++i)
+	{
+		world.Step(k_timeStep, k_velocityIterations, k_positionIterations);
+	}
+	const float32 time = timer.GetMilliseconds();
+
+	// The body list is in reverse creation order.
+	poses->resize(world.GetBodyCount());
+	int32 index = world.GetBodyCount();
+	for (b2Body* b = world.GetBodyList(); b; b = b->GetNext())
+	{
+		(*poses)[--index] = b->GetTransform();
+	}
+	return time;
+}
+
+int main()
+{
+	std::vector<b2Transform> batched;
+	std::vector<b2Transform> unbatched;
+	const float32 batchedTime = Settle(true, &batched);
+	const float32 unbatchedTime = Settle(false, &unbatched);
+
+	int32 errors = 0;
+	float32 maxPositionError = 0.0f;
+	float32 maxAngleError = 0.0f;
+	for (uint32 i = 0; i < batched.size(); ++i)
+	{
+		const float32 positionError = b2Distance(batched[i].p, unbatched[i].p);
+		const float32 angleError =
+			b2Abs(b2MulT(batched[i].q, unbatched[i].q).GetAngle());
+		maxPositionError = b2Max(maxPositionError, positionError);
+		maxAngleError = b2Max(maxAngleError, angleError);
+		if (positionError > k_positionTolerance ||
+			angleError > k_angleTolerance)
+		{
+			printf("body %d rests at (%f, %f) %f batched, (%f, %f) %f not\n",
+				   i, batched[i].p.x, batched[i].p.y, batched[i].q.GetAngle(),
+				   unbatched[i].p.x, unbatched[i].p.y,
+				   unbatched[i].q.GetAngle());
+			++errors;
+		}
+	}
+	printf("%d bodies, %d steps: batched %.1f ms, unbatched %.1f ms, "
+		   "largest differences %f m, %f rad\n", (int32)batched.size(),
+		   k_stepCount, batchedTime, unbatchedTime, maxPositionError,
+		   maxAngleError);
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
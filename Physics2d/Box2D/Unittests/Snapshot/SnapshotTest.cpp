@@ -0,0 +1,355 @@
+/*
+* Copyright (c) 2014 Google, Inc.
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// Tests b2World::SaveSnapshot() and b2World::LoadSnapshot() on a world
+// with bodies of each shape, joints of each type and a particle system.
+// Saving, stepping, loading and stepping again must repeat the steps
+// exactly, checked with b2World::GetChecksum(). Then corrupted copies of
+// the snapshot, truncated, with bits flipped, with counts and indices
+// overwritten or with a byte appended, are loaded. Each must either load
+// or be refused leaving the world as it was. Build it with the library
+// sources, leaving out the other programs under Unittests and Benchmark,
+// and run it under AddressSanitizer and UndefinedBehaviorSanitizer as
+// well, which catch reads out of bounds of a corrupted snapshot.
+//
+// The exit status is 1 if any check fails.
+
+#include <Box2D/Box2D.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Steps before the snapshot is saved, and repeated after it is loaded.
+static const int32 k_settleStepCount = 60;
+static const int32 k_repeatStepCount = 120;
+// Corrupted snapshots loaded.
+static const int32 k_corruptionCount = 3000;
+
+static const float32 k_timeStep = 1.0f / 60.0f;
+static const int32 k_velocityIterations = 8;
+static const int32 k_positionIterations = 3;
+static const int32 k_particleIterations = 3;
+
+// Small linear congruential generator, so every platform sees the same
+// corruptions.
+static uint32 s_seed = 12345;
+
+static int32 RandomIndex(int32 count)
+{
+	s_seed = s_seed * 1664525 + 1013904223;
+	return (int32)((s_seed >> 8) % (uint32)count);
+}
+
+static void Step(b2World* world)
+{
+	world->Step(k_timeStep, k_velocityIterations, k_positionIterations,
+				k_particleIterations);
+}
+
+// Build a walled pile of boxes and circles, a rig with a joint of each
+// type, and water and an elastic block of particles.
+static void CreateWorld(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.Set(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	const b2Vec2 walls[4] =
+	{
+		b2Vec2(-40.0f, 0.0f), b2Vec2(-40.0f, 30.0f),
+		b2Vec2(40.0f, 30.0f), b2Vec2(40.0f, 0.0f)
+	};
+	b2ChainShape chain;
+	chain.CreateChain(walls, 4);
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	b2CircleShape circle;
+	circle.m_radius = 0.4f;
+	b2BodyDef bodyDef;
+	bodyDef.type = b2_dynamicBody;
+	b2Body* pile[60];
+	for (int32 i = 0; i < 60; ++i)
+	{
+		bodyDef.position.Set(-10.0f + (i % 10) * 1.1f, 1.0f + (i / 10) * 1.2f);
+		// The user data is saved as well.
+		bodyDef.userData = (void*)(intptr_t)(i + 1);
+		pile[i] = world->CreateBody(&bodyDef);
+		pile[i]->CreateFixture(i % 3 ? (b2Shape*)&box : &circle, 1.0f);
+	}
+	bodyDef.userData = NULL;
+
+	b2Body* bodies[8];
+	const b2Vec2 positions[8] =
+	{
+		b2Vec2(10.0f, 10.0f), b2Vec2(12.0f, 10.0f), b2Vec2(14.0f, 10.0f),
+		b2Vec2(16.0f, 10.0f), b2Vec2(20.0f, 5.0f), b2Vec2(-20.0f, 15.0f),
+		b2Vec2(-16.0f, 15.0f), b2Vec2(24.0f, 5.0f)
+	};
+	for (int32 i = 0; i < 8; ++i)
+	{
+		bodyDef.position = positions[i];
+		bodies[i] = world->CreateBody(&bodyDef);
+		bodies[i]->CreateFixture(i == 1 ? (b2Shape*)&circle : &box, 1.0f);
+	}
+
+	b2RevoluteJointDef revoluteDef;
+	revoluteDef.Initialize(ground, bodies[0], b2Vec2(10.0f, 12.0f));
+	revoluteDef.enableMotor = true;
+	revoluteDef.maxMotorTorque = 50.0f;
+	revoluteDef.motorSpeed = 1.0f;
+	b2Joint* revolute = world->CreateJoint(&revoluteDef);
+
+	b2PrismaticJointDef prismaticDef;
+	prismaticDef.Initialize(ground, bodies[1], positions[1],
+							b2Vec2(1.0f, 0.0f));
+	prismaticDef.enableLimit = true;
+	prismaticDef.lowerTranslation = -2.0f;
+	prismaticDef.upperTranslation = 2.0f;
+	b2Joint* prismatic = world->CreateJoint(&prismaticDef);
+
+	b2GearJointDef gearDef;
+	gearDef.bodyA = bodies[0];
+	gearDef.bodyB = bodies[1];
+	gearDef.joint1 = revolute;
+	gearDef.joint2 = prismatic;
+	gearDef.ratio = 2.0f;
+	world->CreateJoint(&gearDef);
+
+	b2DistanceJointDef distanceDef;
+	distanceDef.Initialize(bodies[1], bodies[2], positions[1], positions[2]);
+	distanceDef.frequencyHz = 4.0f;
+	world->CreateJoint(&distanceDef);
+
+	b2WeldJointDef weldDef;
+	weldDef.Initialize(bodies[2], bodies[3], b2Vec2(15.0f, 10.0f));
+	world->CreateJoint(&weldDef);
+
+	b2RopeJointDef ropeDef;
+	ropeDef.bodyA = ground;
+	ropeDef.bodyB = bodies[3];
+	ropeDef.localAnchorA.Set(16.0f, 20.0f);
+	ropeDef.maxLength = 12.0f;
+	world->CreateJoint(&ropeDef);
+
+	b2WheelJointDef wheelDef;
+	wheelDef.Initialize(ground, bodies[4], positions[4], b2Vec2(0.0f, 1.0f));
+	world->CreateJoint(&wheelDef);
+
+	b2PulleyJointDef pulleyDef;
+	pulleyDef.Initialize(bodies[5], bodies[6], b2Vec2(-20.0f, 25.0f),
+						 b2Vec2(-16.0f, 25.0f), positions[5], positions[6],
+						 1.5f);
+	world->CreateJoint(&pulleyDef);
+
+	b2FrictionJointDef frictionDef;
+	frictionDef.Initialize(ground, pile[5], pile[5]->GetPosition());
+	frictionDef.maxForce = 3.0f;
+	world->CreateJoint(&frictionDef);
+
+	b2MotorJointDef motorDef;
+	motorDef.Initialize(ground, pile[7]);
+	motorDef.maxForce = 10.0f;
+	world->CreateJoint(&motorDef);
+
+	b2MouseJointDef mouseDef;
+	mouseDef.bodyA = ground;
+	mouseDef.bodyB = bodies[7];
+	mouseDef.target = positions[7] + b2Vec2(1.0f, 3.0f);
+	mouseDef.maxForce = 100.0f;
+	world->CreateJoint(&mouseDef);
+
+	b2ParticleSystemDef particleSystemDef;
+	particleSystemDef.radius = 0.1f;
+	b2ParticleSystem* particleSystem =
+		world->CreateParticleSystem(&particleSystemDef);
+	particleSystem->SetStuckThreshold(5);
+
+	b2PolygonShape waterShape;
+	waterShape.SetAsBox(2.0f, 2.0f, b2Vec2(0.0f, 10.0f), 0.0f);
+	b2ParticleGroupDef waterDef;
+	waterDef.shape = &waterShape;
+	waterDef.flags = b2_waterParticle;
+	waterDef.color.Set(10, 20, 30, 255);
+	particleSystem->CreateParticleGroup(waterDef);
+
+	b2PolygonShape blockShape;
+	blockShape.SetAsBox(1.0f, 1.0f, b2Vec2(-25.0f, 5.0f), 0.0f);
+	b2ParticleGroupDef blockDef;
+	blockDef.shape = &blockShape;
+	blockDef.flags = b2_elasticParticle | b2_springParticle;
+	blockDef.groupFlags = b2_solidParticleGroup;
+	blockDef.userData = (void*)7;
+	particleSystem->CreateParticleGroup(blockDef);
+	particleSystem->GetParticleHandleFromIndex(3);
+}
+
+// Save, step, load and step again, then load the snapshot into a second
+// world and step both side by side.
+static int32 TestRestore()
+{
+	int32 errors = 0;
+	b2World world(b2Vec2(0.0f, -10.0f));
+	CreateWorld(&world);
+	for (int32 i = 0; i < k_settleStepCount; ++i)
+	{
+		Step(&world);
+	}
+
+	b2Snapshot snapshot;
+	world.SaveSnapshot(&snapshot);
+	uint32 checksums[k_repeatStepCount];
+	for (int32 i = 0; i < k_repeatStepCount; ++i)
+	{
+		Step(&world);
+		checksums[i] = world.GetChecksum();
+	}
+
+	if (!world.LoadSnapshot(snapshot))
+	{
+		printf("the snapshot was refused\n");
+		return 1;
+	}
+	for (int32 i = 0; i < k_repeatStepCount; ++i)
+	{
+		Step(&world);
+		if (world.GetChecksum() != checksums[i])
+		{
+			printf("step %d after loading differs\n", i);
+			++errors;
+			break;
+		}
+	}
+
+	b2World copy(b2Vec2(0.0f, 0.0f));
+	if (!copy.LoadSnapshot(snapshot))
+	{
+		printf("the snapshot was refused by another world\n");
+		return errors + 1;
+	}
+	for (int32 i = 0; i < k_repeatStepCount; ++i)
+	{
+		Step(&copy);
+		if (copy.GetChecksum() != checksums[i])
+		{
+			printf("step %d of another world differs\n", i);
+			++errors;
+			break;
+		}
+	}
+	if (copy.GetBodyList()->GetUserData() != world.GetBodyList()->GetUserData())
+	{
+		printf("user data wasn't restored\n");
+		++errors;
+	}
+	return errors;
+}
+
+// Overwrite part of a snapshot's bytes.
+static void Corrupt(std::vector<uint8>* bytes)
+{
+	const int32 size = (int32)bytes->size();
+	switch (RandomIndex(4))
+	{
+	case 0:
+		bytes->resize(RandomIndex(size));
+		break;
+
+	case 1:
+		for (int32 i = 1 + RandomIndex(4); i > 0; --i)
+		{
+			(*bytes)[RandomIndex(size)] ^= (uint8)(1 << RandomIndex(8));
+		}
+		break;
+
+	case 2:
+		{
+			// Counts and indices are int32s, so try small and negative ones.
+			const int32 value = RandomIndex(3) == 0 ?
+				-RandomIndex(5) : RandomIndex(1000);
+			memcpy(&(*bytes)[4 * RandomIndex(size / 4)], &value,
+				   sizeof(value));
+		}
+		break;
+
+	case 3:
+		bytes->push_back(0);
+		break;
+	}
+}
+
+// Load corrupted snapshots. A refused one must leave the world unchanged,
+// and one that loads must step and save again.
+static int32 TestCorruptSnapshots()
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	CreateWorld(&world);
+	for (int32 i = 0; i < k_settleStepCount; ++i)
+	{
+		Step(&world);
+	}
+	b2Snapshot snapshot;
+	world.SaveSnapshot(&snapshot);
+	const uint8* data = (const uint8*)snapshot.GetData();
+
+	int32 errors = 0;
+	int32 loadedCount = 0;
+	std::vector<uint8> bytes;
+	for (int32 i = 0; i < k_corruptionCount; ++i)
+	{
+		bytes.assign(data, data + snapshot.GetSize());
+		Corrupt(&bytes);
+		b2Snapshot corrupted;
+		corrupted.SetData(bytes.empty() ? NULL : &bytes[0],
+						  (int32)bytes.size());
+
+		const uint32 checksum = world.GetChecksum();
+		const int32 bodyCount = world.GetBodyCount();
+		if (world.LoadSnapshot(corrupted))
+		{
+			++loadedCount;
+			Step(&world);
+			b2Snapshot saved;
+			world.SaveSnapshot(&saved);
+			if (!world.LoadSnapshot(snapshot))
+			{
+				printf("the snapshot was refused after corruption %d\n", i);
+				return errors + 1;
+			}
+		}
+		else if (world.GetChecksum() != checksum ||
+				 world.GetBodyCount() != bodyCount)
+		{
+			printf("corruption %d was refused but changed the world\n", i);
+			++errors;
+		}
+	}
+	printf("%d corrupted snapshots, %d loaded\n", k_corruptionCount,
+		   loadedCount);
+	return errors;
+}
+
+int main()
+{
+	int32 errors = TestRestore();
+	errors += TestCorruptSnapshots();
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}